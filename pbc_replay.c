@@ -0,0 +1,423 @@
+/*******************************************************************************
+pbc_replay.c
+
+Licensed under GPLv3
+
+Runs a trace written by pypbc.start_trace() again, straight against PBC,
+with no Python in the way, and prints for each operation how many times it
+was done and the time it took in pypbc and here. Where the two differ is
+time spent in pypbc and the interpreter rather than in PBC.
+
+	pbc_replay [-c] trace
+
+Powers are done with PBC's own element_pow_*, whatever method the traced
+Pairing used. Operands the trace holds no value for are picked at random,
+as are strings parsed when values weren't recorded. With values recorded,
+-c checks every result against the one pypbc got.
+
+Build it with "make replay".
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pbc/pbc.h>
+
+#include "pypbc_trace.h"
+
+// the Fp backends a TRACE_PAIRING record's flags name; "native" gives the
+// same results as PBC's Montgomery Fp, and is replayed on it
+static const char *fp_backends[] = {"mont", "fast", "faster", "naive", "mont"};
+
+// what the table at the end shows for each operation
+static const char *op_names[] = {"apply", "pow", "mult", "from_hash", "parse", "str"};
+#define OP_COUNT 6
+
+typedef struct {
+	unsigned long long count;
+	unsigned long long traced_ns;
+	unsigned long long replayed_ns;
+	unsigned long long mismatches;
+} op_totals;
+
+// the pairings, indexed by their number in the trace. Elements point into
+// their pairing, so each has an allocation of its own that never moves.
+static struct pairing_s **pairings = NULL;
+static size_t pairing_count = 0;
+
+// the live elements, in an open-addressed table keyed by id; id 0 marks an
+// empty slot, and a slot whose element has been freed keeps its id with
+// live cleared so that lookups carry on past it
+typedef struct {
+	uint64_t id;
+	int live;
+	struct element_s e;
+} slot;
+
+static slot *slots = NULL;
+static size_t slot_count = 0;
+static size_t slots_used = 0;
+
+static void die(const char *message) {
+	fprintf(stderr, "pbc_replay: %s\n", message);
+	exit(1);
+}
+
+static unsigned long long clock_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static size_t slot_hash(uint64_t id) {
+	id ^= id >> 33;
+	id *= 0xff51afd7ed558ccdULL;
+	id ^= id >> 33;
+	return (size_t)id & (slot_count - 1);
+}
+
+// the slot holding id, or the empty one it would go in
+static slot *slot_find(uint64_t id) {
+	size_t i = slot_hash(id);
+	while (slots[i].id != 0 && slots[i].id != id) {
+		i = (i + 1) & (slot_count - 1);
+	}
+	return &slots[i];
+}
+
+// doubles the table, dropping the slots of freed elements. Pointers into
+// the table don't survive it.
+static void slots_grow(void) {
+	slot *old = slots;
+	size_t old_count = slot_count;
+	slot_count = slot_count ? slot_count * 2 : 1024;
+	slots = calloc(slot_count, sizeof(slot));
+	if (slots == NULL) {
+		die("out of memory");
+	}
+	slots_used = 0;
+	for (size_t i = 0; i < old_count; i++) {
+		if (old[i].live) {
+			slot *s = slot_find(old[i].id);
+			*s = old[i];
+			slots_used++;
+		}
+	}
+	free(old);
+}
+
+static struct pairing_s *pairing_of(uint32_t n) {
+	if (n == 0 || n > pairing_count) {
+		die("trace uses a pairing it never described");
+	}
+	return pairings[n - 1];
+}
+
+static void element_init_group(element_ptr e, int group, struct pairing_s *pairing) {
+	switch (group) {
+		case TRACE_G1: element_init_G1(e, pairing); break;
+		case TRACE_G2: element_init_G2(e, pairing); break;
+		case TRACE_GT: element_init_GT(e, pairing); break;
+		case TRACE_Zr: element_init_Zr(e, pairing); break;
+		default: die("trace names an unknown group");
+	}
+}
+
+// makes sure n more elements fit without the table growing
+static void slots_reserve(size_t n) {
+	while (2 * (slots_used + n) > slot_count) {
+		slots_grow();
+	}
+}
+
+// a new element with the given id, which replaces any element that had it;
+// there has to be room for it
+static element_ptr element_define(uint64_t id, int group, struct pairing_s *pairing) {
+	slot *s = slot_find(id);
+	if (s->live) {
+		element_clear(&s->e);
+	} else if (s->id == 0) {
+		slots_used++;
+	}
+	s->id = id;
+	s->live = 1;
+	element_init_group(&s->e, group, pairing);
+	return &s->e;
+}
+
+// the element with the given id; one the trace never gave a value for is
+// made up at random
+static element_ptr element_lookup(uint64_t id, int group, struct pairing_s *pairing) {
+	slot *s = slot_find(id);
+	if (s->live) {
+		return &s->e;
+	}
+	element_ptr e = element_define(id, group, pairing);
+	element_random(e);
+	return e;
+}
+
+static void element_forget(uint64_t id) {
+	if (slot_count > 0) {
+		slot *s = slot_find(id);
+		if (s->live) {
+			element_clear(&s->e);
+			s->live = 0;
+		}
+	}
+}
+
+// reads an integer operand of the given bits from the payload, or makes
+// up one that size if there's no value for it
+static void read_integer(mpz_t n, uint64_t bits, int negative, unsigned char **payload, int values) {
+	size_t count = (bits + 7) / 8;
+	if (values) {
+		mpz_import(n, count, 1, 1, 1, 0, *payload);
+		*payload += count;
+	} else {
+		pbc_mpz_randomb(n, bits);
+	}
+	if (negative) {
+		mpz_neg(n, n);
+	}
+}
+
+int main(int argc, char **argv) {
+	int check = 0;
+	const char *path = NULL;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-c") == 0) {
+			check = 1;
+		} else if (path == NULL) {
+			path = argv[i];
+		} else {
+			path = NULL;
+			break;
+		}
+	}
+	if (path == NULL) {
+		fprintf(stderr, "usage: pbc_replay [-c] trace\n");
+		return 2;
+	}
+	FILE *fp = fopen(path, "rb");
+	if (fp == NULL) {
+		perror(path);
+		return 1;
+	}
+
+	pypbc_trace_header header;
+	if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, PYPBC_TRACE_MAGIC, 8) != 0) {
+		die("not a pypbc trace");
+	}
+	if (header.version != PYPBC_TRACE_VERSION) {
+		die("trace is from another version of pypbc, or a host of the other byte order");
+	}
+	int values = header.flags & TRACE_VALUES;
+	if (check && !values) {
+		die("-c needs a trace written with values=True");
+	}
+
+	op_totals totals[OP_COUNT];
+	memset(totals, 0, sizeof(totals));
+	unsigned char *payload = NULL;
+	size_t payload_size = 0;
+	unsigned char *scratch = NULL;
+	size_t scratch_size = 0;
+	pypbc_trace_record record;
+	mpz_t n;
+	mpz_init(n);
+
+	while (fread(&record, sizeof(record), 1, fp) == 1) {
+		if (record.length + 1 > payload_size) {
+			payload_size = record.length + 1;
+			payload = realloc(payload, payload_size);
+			if (payload == NULL) {
+				die("out of memory");
+			}
+		}
+		if (record.length > 0 && fread(payload, record.length, 1, fp) != 1) {
+			die("trace ends part way through a record");
+		}
+		unsigned char *at = payload;
+
+		if (record.op == TRACE_PAIRING) {
+			// pairings are numbered from 1 in the order they're described
+			if (record.pairing != pairing_count + 1 || record.flags > 4) {
+				die("malformed pairing record");
+			}
+			pairings = realloc(pairings, (pairing_count + 1) * sizeof(*pairings));
+			if (pairings == NULL || (pairings[pairing_count] = malloc(sizeof(struct pairing_s))) == NULL) {
+				die("out of memory");
+			}
+			payload[record.length] = 0;
+			pbc_param_t params;
+			if (pbc_param_init_set_str(params, (char *)payload) != 0) {
+				die("trace holds parameters PBC can't read");
+			}
+			pbc_tweak_use_fp((char *)fp_backends[record.flags]);
+			pairing_init_pbc_param(pairings[pairing_count], params);
+			pbc_param_clear(params);
+			pairing_count++;
+			continue;
+		}
+		// an operation defines at most three elements: its result, and
+		// operands the trace has no value for
+		slots_reserve(3);
+		if (record.op == TRACE_VALUE) {
+			element_ptr e = element_define(record.out, record.group, pairing_of(record.pairing));
+			element_from_bytes(e, payload);
+			continue;
+		}
+		if (record.op == TRACE_FREE) {
+			element_forget(record.out);
+			continue;
+		}
+		if (record.op >= OP_COUNT) {
+			die("trace holds an operation this pbc_replay doesn't know");
+		}
+
+		struct pairing_s *pairing = pairing_of(record.pairing);
+		element_ptr a = NULL, b = NULL;
+		if (record.a_kind == TRACE_ARG_ELEMENT) {
+			a = element_lookup(record.a, record.a_group, pairing);
+		}
+		if (record.b_kind == TRACE_ARG_ELEMENT) {
+			b = element_lookup(record.b, record.b_group, pairing);
+		}
+		// integer and string operands, in payload order
+		if (record.a_kind == TRACE_ARG_INTEGER) {
+			read_integer(n, record.a, record.flags & TRACE_A_NEGATIVE, &at, values);
+		}
+		if (record.b_kind == TRACE_ARG_INTEGER) {
+			read_integer(n, record.b, record.flags & TRACE_B_NEGATIVE, &at, values);
+		}
+		unsigned char *bytes = at;
+		size_t bytes_len = record.a_kind == TRACE_ARG_BYTES ? record.a : 0;
+		if (values) {
+			at += bytes_len;
+		} else if (bytes_len > 0) {
+			// what was hashed doesn't change how long hashing it takes
+			if (bytes_len > scratch_size) {
+				scratch = realloc(scratch, bytes_len);
+				if (scratch == NULL) {
+					die("out of memory");
+				}
+				memset(scratch, 0, bytes_len);
+				scratch_size = bytes_len;
+			}
+			bytes = scratch;
+		}
+
+		element_ptr out;
+		if (record.op == TRACE_STR) {
+			out = element_lookup(record.out, record.group, pairing);
+		} else {
+			out = element_define(record.out, record.group, pairing);
+		}
+
+		unsigned long long start = clock_ns();
+		switch (record.op) {
+			case TRACE_APPLY:
+				pairing_apply(out, a, b, pairing);
+				break;
+			case TRACE_POW:
+				if (b != NULL) {
+					element_pow_zn(out, a, b);
+				} else {
+					element_pow_mpz(out, a, n);
+				}
+				break;
+			case TRACE_MULT:
+				// as pypbc does it: a product in the group, or a power by
+				// an integer or an element of Zr
+				if (b == NULL) {
+					element_mul_mpz(out, a, n);
+				} else if (record.b_group != TRACE_Zr) {
+					element_mul(out, a, b);
+				} else {
+					element_mul_zn(out, a, b);
+				}
+				break;
+			case TRACE_FROM_HASH:
+				element_from_hash(out, bytes, (int)bytes_len);
+				break;
+			case TRACE_PARSE:
+				if (a != NULL) {
+					element_set(out, a);
+				} else if (record.a_kind == TRACE_ARG_INTEGER) {
+					element_set_mpz(out, n);
+				} else if (values) {
+					// pypbc's own parsing is of hex, which is close enough
+					// to reading the bytes it comes to
+					element_from_bytes(out, at);
+				} else {
+					element_random(out);
+				}
+				break;
+			case TRACE_STR: {
+				int length = element_length_in_bytes(out);
+				if ((size_t)length > scratch_size) {
+					scratch = realloc(scratch, length);
+					if (scratch == NULL) {
+						die("out of memory");
+					}
+					scratch_size = length;
+				}
+				element_to_bytes(scratch, out);
+				break;
+			}
+		}
+		unsigned long long took = clock_ns() - start;
+
+		op_totals *t = &totals[record.op];
+		t->count++;
+		t->traced_ns += record.ns;
+		t->replayed_ns += took;
+		if (check && record.op != TRACE_STR) {
+			int length = element_length_in_bytes(out);
+			if (at + length > payload + record.length) {
+				die("malformed record: result value missing");
+			}
+			if ((size_t)length > scratch_size) {
+				scratch = realloc(scratch, length);
+				if (scratch == NULL) {
+					die("out of memory");
+				}
+				scratch_size = length;
+			}
+			element_to_bytes(scratch, out);
+			if (memcmp(scratch, at, length) != 0) {
+				t->mismatches++;
+			}
+		}
+	}
+	if (!feof(fp)) {
+		die("trace ends part way through a record");
+	}
+	fclose(fp);
+
+	printf("%-10s %10s %12s %12s %8s", "operation", "count", "traced ms", "replayed ms", "ratio");
+	printf(check ? " %10s\n" : "\n", "mismatches");
+	for (int i = 0; i < OP_COUNT; i++) {
+		op_totals *t = &totals[i];
+		if (t->count == 0) {
+			continue;
+		}
+		printf("%-10s %10llu %12.3f %12.3f %8.2f", op_names[i], t->count, t->traced_ns / 1e6, t->replayed_ns / 1e6,
+			t->replayed_ns ? (double)t->traced_ns / t->replayed_ns : 0.0);
+		if (check) {
+			printf(" %10llu", t->mismatches);
+		}
+		printf("\n");
+	}
+
+	int mismatched = 0;
+	for (int i = 0; i < OP_COUNT; i++) {
+		mismatched |= totals[i].mismatches != 0;
+	}
+	mpz_clear(n);
+	free(payload);
+	free(scratch);
+	return mismatched ? 1 : 0;
+}
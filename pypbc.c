@@ -1,5 +1,26 @@
 #include "pypbc.h"
+#define PYPBC_MODULE
+#include "pypbc_capi.h"
+#include "pypbc_trace.h"
+#include "pypbc_mont.h"
 #include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+
+// how to ask the C library the size of a block, where it can be asked
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#define native_block_size(ptr) malloc_size(ptr)
+#elif defined(__linux__)
+#include <malloc.h>
+#define native_block_size(ptr) malloc_usable_size(ptr)
+#elif defined(__FreeBSD__)
+#include <malloc_np.h>
+#define native_block_size(ptr) malloc_usable_size(ptr)
+#endif
 
 /*******************************************************************************
 pypbc.c
@@ -14,18 +35,50 @@ Released 11 October 2009
 This file contains the types and functions needed to use PBC from Python3.
 *******************************************************************************/
 
-long PBC_EC_Compressed = (1);
+// finds the module state from the type of one of our own objects
+pypbc_state *pypbc_state_from_type(PyTypeObject *type) {
+	PyObject *module = PyType_GetModuleByDef(type, &pypbc_module);
+	if (module == NULL) {
+		return NULL;
+	}
+	return (pypbc_state *)PyModule_GetState(module);
+}
+
+// the binary number slots get called with our Element on either side
+static pypbc_state *pypbc_state_of_either(PyObject *a, PyObject *b) {
+	PyObject *module = PyType_GetModuleByDef(Py_TYPE(a), &pypbc_module);
+	if (module == NULL) {
+		PyErr_Clear();
+		module = PyType_GetModuleByDef(Py_TYPE(b), &pypbc_module);
+	}
+	if (module == NULL) {
+		return NULL;
+	}
+	return (pypbc_state *)PyModule_GetState(module);
+}
 
 PyDoc_STRVAR(pynum_to_mpz__doc__, 
 	"Converts a Python long type to a GMP MPZ type");
-void pynum_to_mpz(PyObject *n, mpz_t new_n) {
+// new_n must not have been initialised; it is whether or not this works,
+// so the caller always clears it. Returns -1 with an exception set if n
+// can't be converted.
+int pynum_to_mpz(PyObject *n, mpz_t new_n) {
+	mpz_init(new_n);
 	// coerce it into a string
 	PyObject *n_unicode = PyNumber_ToBase(n, 10);
-	PyObject *n_bytes = PyUnicode_AsASCIIString(n_unicode);
-	char *n_char = PyBytes_AsString(n_bytes);
+	if (n_unicode == NULL) {
+		return -1;
+	}
+	const char *n_char = PyUnicode_AsUTF8(n_unicode);
+	if (n_char == NULL) {
+		Py_DECREF(n_unicode);
+		return -1;
+	}
 
 	// build the mpz_t n
-	mpz_init_set_str(new_n, n_char, 10);
+	mpz_set_str(new_n, n_char, 10);
+	Py_DECREF(n_unicode);
+	return 0;
 }
 
 PyDoc_STRVAR(mpz_to_pynum__doc__,
@@ -37,8 +90,10 @@ PyObject *mpz_to_pynum(mpz_t n) {
 	// convert the string to a python long
 	PyObject *l = PyLong_FromString(s, NULL, 10);
 	
-	// clean up
-	free(s);
+	// clean up, with whatever GMP allocated the string with
+	void (*gmp_free)(void *, size_t);
+	mp_get_memory_functions(NULL, NULL, &gmp_free);
+	gmp_free(s, strlen(s) + 1);
 	
 	// return it
 	return l;
@@ -47,15 +102,229 @@ PyObject *mpz_to_pynum(mpz_t n) {
 PyDoc_STRVAR(set_point_format_compressed__doc__,
 	"Set option to use compressed (sign + X) point format.");
 PyObject *set_point_format_compressed(PyObject *self, PyObject *args) {
-	PBC_EC_Compressed = 1;
-	return PyLong_FromLong(PBC_EC_Compressed);
+	// the default lives in this interpreter's module state
+	pypbc_state *state = PyModule_GetState(self);
+	state->point_compressed = 1;
+	return PyLong_FromLong(state->point_compressed);
 }
 
 PyDoc_STRVAR(set_point_format_uncompressed__doc__,
 	"Set option to use uncompressed (X,Y) point format.");
 PyObject *set_point_format_uncompressed(PyObject *self, PyObject *args) {
-	PBC_EC_Compressed = 0;
-	return PyLong_FromLong(PBC_EC_Compressed);
+	pypbc_state *state = PyModule_GetState(self);
+	state->point_compressed = 0;
+	return PyLong_FromLong(state->point_compressed);
+}
+
+// PBC's implementations of Fp, for pbc_tweak_use_fp: Montgomery (PBC's
+// default), fixed-limb ("fast"), fixed-limb Montgomery ("faster"), and
+// plain GMP ("naive"); and our own, "native", which is PBC's Montgomery
+// with the multiplication swapped for a fixed-limb kernel where one fits
+static const char *fp_backends[] = {"mont", "fast", "faster", "naive", "native", NULL};
+#define FP_NATIVE (fp_backends[4])
+
+// PBC keeps the choice of Fp in a global that every field it sets up reads,
+// pairings and parameter generation alike. It stays at the default, and a
+// Pairing that wants another backend holds this lock for writing while it
+// switches, builds and switches back; everything else that sets up fields
+// holds it for reading, so never sees the switch.
+static pthread_rwlock_t fp_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// around anything that sets up PBC fields with the default backend
+static void fp_default_lock(void) {
+	pthread_rwlock_rdlock(&fp_lock);
+}
+
+static void fp_default_unlock(void) {
+	pthread_rwlock_unlock(&fp_lock);
+}
+
+// the entry in fp_backends called name, or NULL with ValueError set
+static const char *fp_backend_lookup(const char *name) {
+	for (int i = 0; fp_backends[i] != NULL; i++) {
+		if (strcmp(name, fp_backends[i]) == 0) {
+			return fp_backends[i];
+		}
+	}
+	PyErr_SetString(PyExc_ValueError, "Fp backend must be one of 'mont', 'fast', 'faster', 'naive' or 'native'.");
+	return NULL;
+}
+
+PyDoc_STRVAR(set_fp_backend__doc__,
+"set_fp_backend(name) -> None\n\n\
+Chooses which of PBC's implementations of Fp the Pairings built after this\n\
+use for their base fields and Zr: 'mont' (Montgomery, the default), 'fast'\n\
+or 'faster' (fixed numbers of limbs, the latter with Montgomery reduction),\n\
+or 'naive' (plain GMP). 'native' is 'mont' with pypbc's own Montgomery\n\
+multiplication for primes of 3, 4 or 8 64-bit limbs (160, 256 or 512\n\
+bits, say), using mulx where the processor has it; Pairing.fp_kernels\n\
+says which fields got it.\n\
+Pairing(params, fp=name) overrides it for one Pairing. Existing Pairings\n\
+keep what they were built with.");
+PyObject *set_fp_backend(PyObject *self, PyObject *args) {
+	const char *name;
+	if (!PyArg_ParseTuple(args, "s", &name)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	const char *backend = fp_backend_lookup(name);
+	if (backend == NULL) {
+		return NULL;
+	}
+	// the default lives in this interpreter's module state
+	pypbc_state *state = PyModule_GetState(self);
+	state->fp_backend = backend;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(get_fp_backend__doc__,
+"get_fp_backend() -> str\n\n\
+The Fp implementation new Pairings use; see set_fp_backend.");
+PyObject *get_fp_backend(PyObject *self, PyObject *unused) {
+	pypbc_state *state = PyModule_GetState(self);
+	return PyUnicode_FromString(state->fp_backend);
+}
+
+#if defined(PYPBC_MONT) && GMP_LIMB_BITS == 64 && GMP_NAIL_BITS == 0
+#define NATIVE_FP 1
+
+// PBC's Montgomery Fp, as montfp.c lays out a field and its elements
+typedef struct {
+	size_t limbs;
+	size_t bytes;
+	mp_limb_t *primelimbs;
+	mp_limb_t negpinv;
+	mp_limb_t *R;
+	mp_limb_t *R3;
+} mont_field_data;
+
+typedef struct {
+	char flag;
+	mp_limb_t *d;
+} mont_element_data;
+
+// the flag montfp.c marks a nonzero product with, read off one of its own
+static char mont_nonzero;
+
+// a multiplication and squaring for PBC's Montgomery Fp, on a kernel
+#define NATIVE_FP_OPS(kernel) \
+static void native_mul_##kernel(element_ptr c, element_ptr a, element_ptr b) { \
+	mont_element_data *ad = a->data, *bd = b->data, *cd = c->data; \
+	if (!ad->flag || !bd->flag) { \
+		element_set0(c); \
+		return; \
+	} \
+	mont_field_data *p = c->field->data; \
+	pypbc_mont_##kernel((uint64_t *)cd->d, (uint64_t *)ad->d, (uint64_t *)bd->d, (uint64_t *)p->primelimbs, p->negpinv); \
+	cd->flag = __atomic_load_n(&mont_nonzero, __ATOMIC_RELAXED); \
+} \
+static void native_square_##kernel(element_ptr c, element_ptr a) { \
+	native_mul_##kernel(c, a, a); \
+}
+#ifdef PYPBC_MONT_MULX
+NATIVE_FP_OPS(mulx_3)
+NATIVE_FP_OPS(mulx_4)
+NATIVE_FP_OPS(mulx_8)
+#endif
+NATIVE_FP_OPS(portable_3)
+NATIVE_FP_OPS(portable_4)
+
+static const struct {
+	pypbc_mont_fn kernel;
+	void (*mul)(element_ptr, element_ptr, element_ptr);
+	void (*square)(element_ptr, element_ptr);
+} native_fp_ops[] = {
+#ifdef PYPBC_MONT_MULX
+	{pypbc_mont_mulx_3, native_mul_mulx_3, native_square_mulx_3},
+	{pypbc_mont_mulx_4, native_mul_mulx_4, native_square_mulx_4},
+	{pypbc_mont_mulx_8, native_mul_mulx_8, native_square_mulx_8},
+#endif
+	{pypbc_mont_portable_3, native_mul_portable_3, native_square_portable_3},
+	{pypbc_mont_portable_4, native_mul_portable_4, native_square_portable_4},
+	{NULL, NULL, NULL}
+};
+
+// whether mul gives the same limbs and flag as f's own multiplication, on
+// the largest element and a spread of others hashed from their index
+static int native_fp_agrees(field_ptr f, void (*mul)(element_ptr, element_ptr, element_ptr)) {
+	element_t x, y, want, got;
+	element_init(x, f);
+	element_init(y, f);
+	element_init(want, f);
+	element_init(got, f);
+	mont_field_data *p = f->data;
+	int agrees = 1;
+	for (int i = 0; i < 64 && agrees; i++) {
+		if (i == 0) {
+			element_set_si(x, -1);
+			element_set_si(y, -1);
+		} else {
+			element_from_hash(x, &i, sizeof(i));
+			element_square(y, x);
+			element_add(y, y, x);
+		}
+		element_mul(want, x, y);
+		mul(got, x, y);
+		mont_element_data *wd = want->data, *gd = got->data;
+		agrees = wd->flag == gd->flag && memcmp(wd->d, gd->d, p->bytes) == 0;
+	}
+	element_clear(x);
+	element_clear(y);
+	element_clear(want);
+	element_clear(got);
+	return agrees;
+}
+
+// swaps f's multiplication for a kernel if f is PBC's Montgomery Fp of a
+// size there's one for, and the kernel agrees with it; the kernel's name,
+// or NULL if f is left as it was
+static const char *native_fp_install(field_ptr f) {
+	field_t mont;
+	field_init_mont_fp(mont, f->order);
+	int same = mont->mul == f->mul && mont->square == f->square;
+	field_clear(mont);
+	if (!same) {
+		return NULL;
+	}
+	mont_field_data *p = f->data;
+	const pypbc_mont_kernel *kernel = pypbc_mont_pick(p->limbs);
+	if (kernel == NULL) {
+		return NULL;
+	}
+	int i = 0;
+	while (native_fp_ops[i].kernel != kernel->mul) {
+		i++;
+	}
+
+	// the flag of a nonzero product, which is the same for every field
+	element_t one;
+	element_init(one, f);
+	element_set1(one);
+	element_mul(one, one, one);
+	__atomic_store_n(&mont_nonzero, ((mont_element_data *)one->data)->flag, __ATOMIC_RELAXED);
+	element_clear(one);
+
+	if (!native_fp_agrees(f, native_fp_ops[i].mul)) {
+		return NULL;
+	}
+	f->mul = native_fp_ops[i].mul;
+	f->square = native_fp_ops[i].square;
+	return kernel->name;
+}
+#endif
+
+// the fields of a pairing "native" puts kernels on
+static const char *native_fp_fields[] = {"Zr", "Fq"};
+
+// puts kernels on a "native" pairing's Zr and base field, before anything
+// else uses them, naming each one's kernel in kernels (or NULL, for a field
+// left with PBC's multiplication)
+static void native_fp_setup(pairing_ptr pairing, const char *kernels[2]) {
+	kernels[0] = kernels[1] = NULL;
+#ifdef NATIVE_FP
+	kernels[0] = native_fp_install(pairing->Zr);
+	kernels[1] = native_fp_install(curve_field_a_coeff(pairing->G1)->field);
+#endif
 }
 
 PyDoc_STRVAR(get_random_prime__doc__,
@@ -97,13 +366,14 @@ PyObject *get_random(PyObject *self, PyObject *args) {
 		return NULL;
 	}
 	
-	// create the storage number
+	// create the storage number, and cast max to an mpz
 	mpz_t a, b;
-	mpz_init(a);
 	mpz_init(b);
-	
-	// cast it to an mpz
-	pynum_to_mpz(max, a);
+	if (pynum_to_mpz(max, a) < 0) {
+		mpz_clear(a);
+		mpz_clear(b);
+		return NULL;
+	}
 	
 	// get a value
 	pbc_mpz_random(b, a);
@@ -119,18 +389,643 @@ PyObject *get_random(PyObject *self, PyObject *args) {
 	return lng;
 }
 
+/*******************************************************************************
+*						Memory							      *
+*******************************************************************************/
+
+// Everything PBC and GMP allocate goes through the functions below, which
+// hand it on to the allocator that was there before and keep count. They
+// report each block to tracemalloc, in PYPBC_TRACEMALLOC_DOMAIN, when the
+// thread has a Python thread state attached: without one there is no
+// Python call site to charge the block to, and taking the GIL here could
+// deadlock.
+
+// bytes PBC and GMP have allocated on this thread, less what it has freed;
+// __sizeof__ reads it either side of building a copy of something
+static __thread long long native_thread_bytes = 0;
+
+// GMP's allocator before ours
+static void *(*gmp_prev_alloc)(size_t);
+static void *(*gmp_prev_realloc)(void *, size_t, size_t);
+static void (*gmp_prev_free)(void *, size_t);
+
+// whether this thread is running Python code. PyGILState_Check() can't
+// say: once there is a subinterpreter it answers yes on every thread,
+// including the native ones the async pool and apply_batch run on.
+static int native_thread_attached(void) {
+#if PY_VERSION_HEX >= 0x030D0000
+	return PyThreadState_GetUnchecked() != NULL;
+#else
+	return _PyThreadState_UncheckedGet() != NULL;
+#endif
+}
+
+static void native_track(void *ptr, size_t size) {
+	native_thread_bytes += size;
+	if (native_thread_attached()) {
+		PyTraceMalloc_Track(PYPBC_TRACEMALLOC_DOMAIN, (uintptr_t)ptr, size);
+	}
+}
+
+static void native_untrack(void *ptr, size_t size) {
+	native_thread_bytes -= size;
+	if (native_thread_attached()) {
+		PyTraceMalloc_Untrack(PYPBC_TRACEMALLOC_DOMAIN, (uintptr_t)ptr);
+	}
+}
+
+// GMP tells us the size of every block, and dies itself if it can't get one
+static void *gmp_track_alloc(size_t size) {
+	void *ptr = gmp_prev_alloc(size);
+	native_track(ptr, size);
+	return ptr;
+}
+
+// the old block is untracked first: once it's freed its address can go to
+// another thread, which would track it before we got round to untracking
+static void *gmp_track_realloc(void *ptr, size_t old_size, size_t new_size) {
+	native_untrack(ptr, old_size);
+	void *moved = gmp_prev_realloc(ptr, old_size, new_size);
+	native_track(moved, new_size);
+	return moved;
+}
+
+static void gmp_track_free(void *ptr, size_t size) {
+	native_untrack(ptr, size);
+	gmp_prev_free(ptr, size);
+}
+
+#ifdef native_block_size
+// PBC doesn't say what it frees, so its blocks are measured; like PBC's own
+// allocator, these die rather than return NULL. Where the C library can't
+// measure them PBC's are left out of the count, and only GMP's are kept.
+static void *pbc_track_alloc(size_t size) {
+	void *ptr = malloc(size);
+	if (ptr == NULL) {
+		pbc_die("out of memory");
+	}
+	native_track(ptr, native_block_size(ptr));
+	return ptr;
+}
+
+static void *pbc_track_realloc(void *ptr, size_t size) {
+	if (ptr != NULL) {
+		native_untrack(ptr, native_block_size(ptr));
+	}
+	void *moved = realloc(ptr, size);
+	if (moved == NULL && size != 0) {
+		pbc_die("out of memory");
+	}
+	if (moved != NULL) {
+		native_track(moved, native_block_size(moved));
+	}
+	return moved;
+}
+
+static void pbc_track_free(void *ptr) {
+	if (ptr != NULL) {
+		native_untrack(ptr, native_block_size(ptr));
+		free(ptr);
+	}
+}
+#endif
+
+static void native_hooks_setup(void) {
+	mp_get_memory_functions(&gmp_prev_alloc, &gmp_prev_realloc, &gmp_prev_free);
+	mp_set_memory_functions(gmp_track_alloc, gmp_track_realloc, gmp_track_free);
+#ifdef native_block_size
+	pbc_set_memory_functions(pbc_track_alloc, pbc_track_realloc, pbc_track_free);
+#endif
+}
+
+// puts the functions above in place, once per process, however many
+// interpreters import us
+static pthread_once_t native_hooks_once = PTHREAD_ONCE_INIT;
+
+void native_hooks_install(void) {
+	pthread_once(&native_hooks_once, native_hooks_setup);
+}
+
+// bytes PBC and GMP hold for e, which is what they allocate for a copy
+static long long element_native_size(element_ptr e) {
+	long long before = native_thread_bytes;
+	element_t copy;
+	element_init_same_as(copy, e);
+	element_set(copy, e);
+	long long size = native_thread_bytes - before;
+	element_clear(copy);
+	return size;
+}
+
+PyDoc_STRVAR(Element_sizeof__doc__,
+"element.__sizeof__() -> int\n\n\
+The bytes the element takes up, the PBC and GMP storage behind it included.");
+PyObject *Element_sizeof(Element *self, PyObject *unused) {
+	long long size = Py_TYPE(self)->tp_basicsize;
+	if (self->ready) {
+		size += element_native_size(self->pbc_element);
+	}
+	return PyLong_FromLongLong(size);
+}
+
+PyDoc_STRVAR(Pairing_sizeof__doc__,
+"pairing.__sizeof__() -> int\n\n\
+The bytes the pairing takes up, including what PBC built for it and what\n\
+GLV and factors= added, but not its Parameters or its Elements.");
+PyObject *Pairing_sizeof(Pairing *self, PyObject *unused) {
+	long long size = Py_TYPE(self)->tp_basicsize;
+	size += __atomic_load_n(&self->native_size, __ATOMIC_RELAXED);
+	return PyLong_FromLongLong(size);
+}
+
+PyDoc_STRVAR(Parameters_sizeof__doc__,
+"parameters.__sizeof__() -> int\n\n\
+The bytes the parameters take up, the PBC and GMP storage behind them\n\
+included.");
+PyObject *Parameters_sizeof(Parameters *self, PyObject *unused) {
+	long long size = Py_TYPE(self)->tp_basicsize;
+	if (self->ready) {
+		// PBC can't copy parameters, but it can read back what it writes,
+		// and allocates the same for that as for these
+		char *text = NULL;
+		size_t length = 0;
+		FILE *fp = open_memstream(&text, &length);
+		if (fp == NULL) {
+			return PyErr_SetFromErrno(PyExc_OSError);
+		}
+		pbc_param_out_str(fp, self->pbc_params);
+		fclose(fp);
+		long long before = native_thread_bytes;
+		pbc_param_t copy;
+		if (pbc_param_init_set_buf(copy, text, length) == 0) {
+			size += native_thread_bytes - before;
+			pbc_param_clear(copy);
+		}
+		free(text);
+	}
+	return PyLong_FromLongLong(size);
+}
+
+/*******************************************************************************
+*						Hashing							      *
+*******************************************************************************/
+
+// SHA-256 round constants
+static const uint32_t sha256_k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+// runs the compression function over one 64 byte block
+static void sha256_compress(sha256_ctx *ctx, const unsigned char *block) {
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+	// load the message schedule
+	for (i = 0; i < 16; i++) {
+		w[i] = ((uint32_t)block[4*i] << 24) | ((uint32_t)block[4*i+1] << 16) |
+			((uint32_t)block[4*i+2] << 8) | (uint32_t)block[4*i+3];
+	}
+	for (i = 16; i < 64; i++) {
+		uint32_t s0 = SHA256_ROTR(w[i-15], 7) ^ SHA256_ROTR(w[i-15], 18) ^ (w[i-15] >> 3);
+		uint32_t s1 = SHA256_ROTR(w[i-2], 17) ^ SHA256_ROTR(w[i-2], 19) ^ (w[i-2] >> 10);
+		w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+
+	a = ctx->state[0]; b = ctx->state[1]; c = ctx->state[2]; d = ctx->state[3];
+	e = ctx->state[4]; f = ctx->state[5]; g = ctx->state[6]; h = ctx->state[7];
+
+	// the 64 rounds
+	for (i = 0; i < 64; i++) {
+		t1 = h + (SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25)) +
+			((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+		t2 = (SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22)) +
+			((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+	ctx->state[4] += e; ctx->state[5] += f; ctx->state[6] += g; ctx->state[7] += h;
+}
+
+void sha256_init(sha256_ctx *ctx) {
+	static const uint32_t iv[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	memcpy(ctx->state, iv, sizeof(iv));
+	ctx->length = 0;
+	ctx->used = 0;
+}
+
+void sha256_update(sha256_ctx *ctx, const unsigned char *data, size_t len) {
+	ctx->length += len;
+	// top up a partially filled block first
+	if (ctx->used) {
+		size_t take = 64 - ctx->used;
+		if (take > len) {
+			take = len;
+		}
+		memcpy(ctx->block + ctx->used, data, take);
+		ctx->used += take;
+		data += take;
+		len -= take;
+		if (ctx->used < 64) {
+			return;
+		}
+		sha256_compress(ctx, ctx->block);
+		ctx->used = 0;
+	}
+	// then run whole blocks straight out of the caller's buffer
+	while (len >= 64) {
+		sha256_compress(ctx, data);
+		data += 64;
+		len -= 64;
+	}
+	// and keep the tail for later
+	memcpy(ctx->block, data, len);
+	ctx->used = len;
+}
+
+void sha256_final(sha256_ctx *ctx, unsigned char digest[SHA256_DIGEST_SIZE]) {
+	uint64_t bits = ctx->length << 3;
+	int i;
+
+	// pad with a one bit, zeroes, and the message length in bits
+	ctx->block[ctx->used++] = 0x80;
+	if (ctx->used > 56) {
+		memset(ctx->block + ctx->used, 0, 64 - ctx->used);
+		sha256_compress(ctx, ctx->block);
+		ctx->used = 0;
+	}
+	memset(ctx->block + ctx->used, 0, 56 - ctx->used);
+	for (i = 0; i < 8; i++) {
+		ctx->block[56 + i] = (unsigned char)(bits >> (56 - 8*i));
+	}
+	sha256_compress(ctx, ctx->block);
+
+	// write out the state big-endian
+	for (i = 0; i < 8; i++) {
+		digest[4*i] = (unsigned char)(ctx->state[i] >> 24);
+		digest[4*i+1] = (unsigned char)(ctx->state[i] >> 16);
+		digest[4*i+2] = (unsigned char)(ctx->state[i] >> 8);
+		digest[4*i+3] = (unsigned char)ctx->state[i];
+	}
+}
+
+// fills view with the bytes to be hashed: str is taken as UTF-8, anything
+// else has to support the buffer protocol
+int hash_input_get_buffer(PyObject *data, Py_buffer *view) {
+	if (PyUnicode_Check(data)) {
+		Py_ssize_t size;
+		const char *utf8 = PyUnicode_AsUTF8AndSize(data, &size);
+		if (utf8 == NULL) {
+			return -1;
+		}
+		// the UTF-8 form is cached on the str, so borrowing it is safe
+		return PyBuffer_FillInfo(view, data, (void *)utf8, size, 1, PyBUF_SIMPLE);
+	}
+	if (PyObject_GetBuffer(data, view, PyBUF_SIMPLE) < 0) {
+		PyErr_SetString(PyExc_TypeError, "expected str or a bytes-like object.");
+		return -1;
+	}
+	return 0;
+}
+
+/*******************************************************************************
+*						Randomness							      *
+*******************************************************************************/
+
+#define CHACHA20_ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define CHACHA20_QR(a, b, c, d) \
+	a += b; d ^= a; d = CHACHA20_ROTL(d, 16); \
+	c += d; b ^= c; b = CHACHA20_ROTL(b, 12); \
+	a += b; d ^= a; d = CHACHA20_ROTL(d, 8); \
+	c += d; b ^= c; b = CHACHA20_ROTL(b, 7);
+
+// produces the next 64 byte block of keystream and bumps the block counter
+static void chacha20_block(chacha20_stream *stream) {
+	uint32_t x[16];
+	int i;
+	memcpy(x, stream->input, sizeof(x));
+	for (i = 0; i < 10; i++) {
+		CHACHA20_QR(x[0], x[4], x[8], x[12]);
+		CHACHA20_QR(x[1], x[5], x[9], x[13]);
+		CHACHA20_QR(x[2], x[6], x[10], x[14]);
+		CHACHA20_QR(x[3], x[7], x[11], x[15]);
+		CHACHA20_QR(x[0], x[5], x[10], x[15]);
+		CHACHA20_QR(x[1], x[6], x[11], x[12]);
+		CHACHA20_QR(x[2], x[7], x[8], x[13]);
+		CHACHA20_QR(x[3], x[4], x[9], x[14]);
+	}
+	for (i = 0; i < 16; i++) {
+		uint32_t v = x[i] + stream->input[i];
+		stream->block[4*i] = (unsigned char)v;
+		stream->block[4*i+1] = (unsigned char)(v >> 8);
+		stream->block[4*i+2] = (unsigned char)(v >> 16);
+		stream->block[4*i+3] = (unsigned char)(v >> 24);
+	}
+	// 64 bit block counter in words 12 and 13
+	if (++stream->input[12] == 0) {
+		stream->input[13]++;
+	}
+	stream->available = 64;
+}
+
+// keys a stream; the stream id takes the place of the nonce so that every
+// thread drawing from the same key gets its own independent keystream
+static void chacha20_setup(chacha20_stream *stream, const uint32_t key[8], uint64_t stream_id) {
+	// "expand 32-byte k"
+	stream->input[0] = 0x61707865;
+	stream->input[1] = 0x3320646e;
+	stream->input[2] = 0x79622d32;
+	stream->input[3] = 0x6b206574;
+	memcpy(&stream->input[4], key, 8 * sizeof(uint32_t));
+	stream->input[12] = 0;
+	stream->input[13] = 0;
+	stream->input[14] = (uint32_t)stream_id;
+	stream->input[15] = (uint32_t)(stream_id >> 32);
+	stream->available = 0;
+}
+
+void chacha20_keystream(chacha20_stream *stream, unsigned char *out, size_t len) {
+	while (len) {
+		if (!stream->available) {
+			chacha20_block(stream);
+		}
+		size_t take = (size_t)stream->available < len ? (size_t)stream->available : len;
+		memcpy(out, stream->block + (64 - stream->available), take);
+		stream->available -= (int)take;
+		out += take;
+		len -= take;
+	}
+}
+
+// the key of the installed RandomSource. PBC's random hook is process wide,
+// so this is too; threads rekey from it whenever the generation moves on.
+// Every install, from any interpreter, bumps rng_installs.
+static pthread_mutex_t rng_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t rng_key[8];
+static uint64_t rng_generation = 0;
+static uint64_t rng_next_stream = 0;
+static uint64_t rng_installs = 0;
+// whether the installed key came from a seed, and so should be kept
+static int rng_deterministic = 0;
+static pthread_once_t rng_atfork_once = PTHREAD_ONCE_INIT;
+
+// every thread keeps its own keystream, so drawing needs no locking
+static __thread chacha20_stream rng_thread_stream;
+
+// the function PBC calls for all of its randomness while a RandomSource is
+// installed: sets z to a uniformly random value in [0, limit)
+static void RandomSource_mpz_random(mpz_t z, mpz_t limit, void *data) {
+	chacha20_stream *stream = &rng_thread_stream;
+	unsigned char buf[256];
+
+	if (mpz_sgn(limit) <= 0) {
+		mpz_set_ui(z, 0);
+		return;
+	}
+
+	// pick up a new key if the source has changed since we last drew
+	if (stream->generation != __atomic_load_n(&rng_generation, __ATOMIC_ACQUIRE)) {
+		pthread_mutex_lock(&rng_lock);
+		chacha20_setup(stream, rng_key, rng_next_stream++);
+		stream->generation = rng_generation;
+		pthread_mutex_unlock(&rng_lock);
+	}
+
+	size_t bits = mpz_sizeinbase(limit, 2);
+	size_t len = (bits + 7) / 8;
+	// limits too long for buf are drawn a buffer at a time, most significant
+	// first, which takes the same keystream bytes as drawing them all at once
+	size_t head = len % sizeof(buf) ? len % sizeof(buf) : sizeof(buf);
+	mpz_t chunk;
+	mpz_init(chunk);
+	// draw just enough bits and reject anything past the limit
+	do {
+		chacha20_keystream(stream, buf, head);
+		buf[0] &= 0xff >> (8 * len - bits);
+		mpz_import(z, head, 1, 1, 0, 0, buf);
+		for (size_t done = head; done < len; done += sizeof(buf)) {
+			chacha20_keystream(stream, buf, sizeof(buf));
+			mpz_import(chunk, sizeof(buf), 1, 1, 0, 0, buf);
+			mpz_mul_2exp(z, z, 8 * sizeof(buf));
+			mpz_add(z, z, chunk);
+		}
+	} while (mpz_cmp(z, limit) >= 0);
+	mpz_clear(chunk);
+}
+
+// fork() copies every thread's keystream into the child, which would then
+// draw what its parent and siblings draw. Hold the lock across the fork so
+// the key is whole, and give the child a fresh key of its own unless the
+// source was seeded for reproducibility.
+static void rng_atfork_prepare(void) {
+	pthread_mutex_lock(&rng_lock);
+}
+
+static void rng_atfork_parent(void) {
+	pthread_mutex_unlock(&rng_lock);
+}
+
+static void rng_atfork_child(void) {
+	if (!rng_deterministic) {
+		uint32_t fresh[8];
+		ssize_t got = 0;
+		int fd = open("/dev/urandom", O_RDONLY);
+		if (fd >= 0) {
+			got = read(fd, fresh, sizeof(fresh));
+			close(fd);
+		}
+		if (got == (ssize_t)sizeof(fresh)) {
+			memcpy(rng_key, fresh, sizeof(rng_key));
+		} else {
+			// no urandom; the pid and time at least set the child apart
+			struct timespec ts;
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			rng_key[0] ^= (uint32_t)getpid();
+			rng_key[1] ^= (uint32_t)ts.tv_nsec;
+			rng_key[2] ^= (uint32_t)ts.tv_sec;
+		}
+		rng_next_stream = 0;
+		rng_generation++;
+	}
+	pthread_mutex_unlock(&rng_lock);
+}
+
+static void rng_atfork_setup(void) {
+	pthread_atfork(rng_atfork_prepare, rng_atfork_parent, rng_atfork_child);
+}
+
+// installs source (a RandomSource or None) as PBC's random source
+static PyObject *random_source_install(pypbc_state *state, PyObject *source) {
+	if (source != Py_None && !PyObject_TypeCheck(source, state->RandomSourceType)) {
+		PyErr_SetString(PyExc_TypeError, "expected RandomSource or None.");
+		return NULL;
+	}
+
+	pthread_mutex_lock(&rng_lock);
+	if (source == Py_None) {
+		pbc_random_set_file("/dev/urandom");
+	} else {
+		RandomSource *rs = (RandomSource *)source;
+		pthread_once(&rng_atfork_once, rng_atfork_setup);
+		memcpy(rng_key, rs->key, sizeof(rng_key));
+		rng_deterministic = rs->deterministic;
+		rng_next_stream = 0;
+		__atomic_store_n(&rng_generation, rng_generation + 1, __ATOMIC_RELEASE);
+		pbc_random_set_function(RandomSource_mpz_random, NULL);
+	}
+	state->random_installed = __atomic_add_fetch(&rng_installs, 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&rng_lock);
+
+	// keep the installed source around so get_random_source can hand it back
+	Py_INCREF(source);
+	Py_XSETREF(state->random_source, source);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(set_random_source__doc__,
+"set_random_source(source) -> None\n\n\
+Makes PBC draw all of its randomness (Element.random, get_random,\n\
+get_random_prime, ...) from the given RandomSource. Passing None goes back\n\
+to reading /dev/urandom. PBC has one random source for the whole process,\n\
+so this applies to every interpreter in it.");
+PyObject *set_random_source(PyObject *self, PyObject *source) {
+	return random_source_install(PyModule_GetState(self), source);
+}
+
+PyDoc_STRVAR(get_random_source__doc__,
+	"Returns the RandomSource installed from this interpreter, or None when reading /dev/urandom.");
+PyObject *get_random_source(PyObject *self, PyObject *unused) {
+	pypbc_state *state = PyModule_GetState(self);
+	// anything since installed from another interpreter isn't ours to return
+	if (state->random_source == NULL || state->random_installed != __atomic_load_n(&rng_installs, __ATOMIC_ACQUIRE)) {
+		Py_RETURN_NONE;
+	}
+	Py_INCREF(state->random_source);
+	return state->random_source;
+}
+
 /*******************************************************************************
 *						Params							      *
 *******************************************************************************/
 PyDoc_STRVAR(Parameters__doc__,
 "A representation of the parameters of an elliptic curve.\n\n\
-There are three basic ways to instantiate a Parameters object:\n\
+There are four basic ways to instantiate a Parameters object:\n\
 Parameters(param_string=s) -> a set of parameters built according to s.\n\
 Parameters(n=x, short=True/False) -> a type A1 or F curve.\n\
 Parameters(qbits=q, rbits=r, short=True/False) -> type A or E curve.\n\
+Parameters(family='d'||'g', D=d, qbits=q) -> type D (MNT) or G curve.\n\
+Parameters.load(path) -> parameters previously written by parameters.save(path).\n\
+\n\
+Types D and G are found by the CM method from the discriminant D, taking\n\
+the largest curve with a q of at most qbits bits. Without D, a known good\n\
+discriminant is picked for qbits (or the smallest one, without qbits).\n\
+Their pairings are asymmetric: G1 and G2 are different groups, and\n\
+pairing.apply takes an element of each, in that order.\n\
 \n\
 These objects are essentially only used for creating Pairings.");
 
+// discriminants known to give curves, with the size of q they give; these
+// are the ones behind PBC's d159, d201, d224 and g149 parameter files
+static const struct {
+	char family;
+	unsigned int D;
+	int qbits;
+} cm_curves[] = {
+	{'d', 9563, 159},
+	{'d', 62003, 201},
+	{'d', 496659, 224},
+	{'g', 35707, 149},
+	{0, 0, 0}
+};
+
+// checks the family, and fills in D and qbits from cm_curves where they're
+// left as 0; returns -1 with ValueError set if that can't be done
+static int cm_resolve(const char *family, unsigned int *D, int *qbits) {
+	if (strcmp(family, "d") != 0 && strcmp(family, "g") != 0) {
+		PyErr_SetString(PyExc_ValueError, "family must be 'd' or 'g'.");
+		return -1;
+	}
+	if (*D != 0) {
+		if (*qbits <= 0) {
+			PyErr_SetString(PyExc_ValueError, "qbits must be given along with D.");
+			return -1;
+		}
+		return 0;
+	}
+	// the largest known curve that fits, or the smallest if there's no limit
+	int best = -1;
+	for (int i = 0; cm_curves[i].family; i++) {
+		if (cm_curves[i].family != family[0]) {
+			continue;
+		}
+		if (*qbits == 0 ? best < 0 : cm_curves[i].qbits <= *qbits && (best < 0 || cm_curves[i].qbits > cm_curves[best].qbits)) {
+			best = i;
+		}
+	}
+	if (best < 0) {
+		PyErr_SetString(PyExc_ValueError, "no known discriminant gives a curve that small; please provide D.");
+		return -1;
+	}
+	*D = cm_curves[best].D;
+	if (*qbits == 0) {
+		*qbits = cm_curves[best].qbits;
+	}
+	return 0;
+}
+
+// remembers the largest curve the CM search has come across
+static int cm_keep_largest(pbc_cm_ptr cm, void *data) {
+	pbc_cm_ptr best = (pbc_cm_ptr)data;
+	if (mpz_cmp(cm->q, best->q) > 0) {
+		mpz_set(best->q, cm->q);
+		mpz_set(best->n, cm->n);
+		mpz_set(best->h, cm->h);
+		mpz_set(best->r, cm->r);
+		best->D = cm->D;
+		best->k = cm->k;
+	}
+	// keep looking
+	return 0;
+}
+
+// builds type D or G parameters from the largest curve with discriminant D
+// and a q of at most qbits bits; returns -1, leaving params alone, if there
+// is none. Touches no Python state.
+static int cm_generate(pbc_param_t params, char family, unsigned int D, int qbits) {
+	pbc_cm_t best;
+	pbc_cm_init(best);
+	mpz_set_ui(best->q, 0);
+	if (family == 'd') {
+		pbc_cm_search_d(cm_keep_largest, best, D, qbits);
+	} else {
+		pbc_cm_search_g(cm_keep_largest, best, D, qbits);
+	}
+	int found = mpz_sgn(best->q) > 0;
+	if (found) {
+		if (family == 'd') {
+			pbc_param_init_d_gen(params, best);
+		} else {
+			pbc_param_init_g_gen(params, best);
+		}
+	}
+	pbc_cm_clear(best);
+	return found ? 0 : -1;
+}
+
 // allocate the object
 PyObject *Parameters_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
 	// create the new Parameterss object
@@ -146,12 +1041,12 @@ PyObject *Parameters_new(PyTypeObject *type, PyObject *args, PyObject *kwds) {
 	return (PyObject *)self;
 }
 
-// Parameters(param_string=str, n=long, qbits=long, rbits=long, short=True/False) -> Parameters
+// Parameters(param_string=str, n=long, qbits=long, rbits=long, short=True/False, family=str, D=int) -> Parameters
 int Parameters_init(Parameters *self, PyObject *args, PyObject *kwargs) {
-	char *kwds[] = {"param_string", "n", "qbits", "rbits", "short", NULL};
+	char *kwds[] = {"param_string", "n", "qbits", "rbits", "short", "family", "D", NULL};
 	// if the parameters are given as a string
 	char *param_string = NULL;
-	size_t s_len = 0;
+	Py_ssize_t s_len = 0;
 	// for type A1 and F fields, F if short is provided and True
 	PyObject *n = NULL;
 	// for type A and E fields, E if short is provided and True
@@ -159,21 +1054,31 @@ int Parameters_init(Parameters *self, PyObject *args, PyObject *kwargs) {
 	int rbits = 0;
 	// for the above
 	PyObject *is_short = NULL;
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|s#OiiO", kwds, &param_string, &s_len, &n, &qbits, &rbits, &is_short)) {
+	// for type D and G fields, with qbits as the limit on q
+	const char *family = NULL;
+	unsigned int D = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|s#OiiOsI", kwds, &param_string, &s_len, &n, &qbits, &rbits, &is_short, &family, &D)) {
 		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
 		return -1;
 	}
 	
-	// we have three basic signatures- the first take n, the second take
-	// qbits and rbits, and the third take just a string. I will refer to them
-	// as s_type, n_type and qr_type, and the following checks to see 
-	// which the poor sap is trying to build, and tries to stop them if they 
-	// appear confused.
+	// we have four basic signatures- the first take n, the second take
+	// qbits and rbits, the third take just a string, and the fourth a
+	// family. I will refer to them as s_type, n_type, qr_type and cm_type,
+	// and the following checks to see which the poor sap is trying to
+	// build, and tries to stop them if they appear confused.
 	int s_type = 0;
 	int n_type = 0;
 	int qr_type = 0;
+	int cm_type = 0;
+	// if a family is provided, we're cm_type
+	if (family && !param_string && !n && !rbits && !is_short) {
+		cm_type = 1;
+	} else if (family || D) {
+		PyErr_SetString(PyExc_ValueError, "family and D only go with qbits.");
+		return -1;
 	// if just the string is provided, we're s_type
-	if (param_string && !n && !qbits && !rbits && !is_short) {
+	} else if (param_string && !n && !qbits && !rbits && !is_short) {
 		s_type = 1;
 	// if n is provided, and qbits and rbits are not, we're n_type
 	} else if (n && !(qbits || rbits)) {
@@ -189,7 +1094,10 @@ int Parameters_init(Parameters *self, PyObject *args, PyObject *kwargs) {
 	
 	// now we handle s_type curve generation
 	if (s_type) {
-		pbc_param_init_set_buf(self->pbc_params, param_string, s_len);
+		if (pbc_param_init_set_buf(self->pbc_params, param_string, s_len)) {
+			PyErr_SetString(PyExc_ValueError, "could not parse parameter string.");
+			return -1;
+		}
 	}
 	
 	// now we handle n_type curve generation
@@ -205,24 +1113,48 @@ int Parameters_init(Parameters *self, PyObject *args, PyObject *kwargs) {
 		if (is_short == Py_True) {
 			// convert n to an integer
 			size_t bits = PyNumber_AsSsize_t(n, PyExc_OverflowError);
+			fp_default_lock();
 			pbc_param_init_f_gen(self->pbc_params, (int)bits);
+			fp_default_unlock();
 		} else {
 			// convert n to mpz_t
 			mpz_t new_n;
-			pynum_to_mpz(n, new_n);
+			if (pynum_to_mpz(n, new_n) < 0) {
+				mpz_clear(new_n);
+				return -1;
+			}
 			// build the Parameters
+			fp_default_lock();
 			pbc_param_init_a1_gen(self->pbc_params, new_n);
+			fp_default_unlock();
+			mpz_clear(new_n);
 		}
 	}
 	
 	// now we handle qr_type
 	if (qr_type) {
 		// now we check the is_short argument, generating A if not and E if so.
+		fp_default_lock();
 		if (is_short == Py_True) {
 			pbc_param_init_e_gen(self->pbc_params, rbits, qbits);
 		} else {
 			pbc_param_init_a_gen(self->pbc_params, rbits, qbits);
 		}
+		fp_default_unlock();
+	}
+
+	// and cm_type, by a search that may come up empty
+	if (cm_type) {
+		if (cm_resolve(family, &D, &qbits) < 0) {
+			return -1;
+		}
+		fp_default_lock();
+		int found = cm_generate(self->pbc_params, family[0], D, qbits);
+		fp_default_unlock();
+		if (found < 0) {
+			PyErr_Format(PyExc_ValueError, "no type %s curve with D = %u has a q of at most %d bits.", family, D, qbits);
+			return -1;
+		}
 	}
 	
 	// you're ready!
@@ -231,345 +1163,1712 @@ int Parameters_init(Parameters *self, PyObject *args, PyObject *kwargs) {
 	return 0;
 }
 
-// Parameters(param_string=str, n=long, qbits=long, rbits=long, short=True/False) -> Parameters
+// str(parameters) -> the parameters in PBC's text format
 PyObject* Parameters_str(Parameters *parameters) {
 	FILE *fp;
 	PyObject *param;
-	// int size;
-	// build the string buffer- AIEEE! MAGIC CONSTANT!
-	char buffer[4096];
-	// PBC wants to write parameters to a FILE, so we make one
-	fp = fmemopen((void *)buffer, sizeof(buffer), "w+");
-	// write pairing params into buffer
-	if (fp != NULL) {
-		pbc_param_out_str(fp, parameters->pbc_params);
-		fclose(fp);
-		param = PyUnicode_FromString(buffer);
-	} else {
-		param = PyUnicode_FromString("");
+	char *buffer = NULL;
+	size_t size = 0;
+	// PBC wants to write parameters to a FILE, so we make one that grows
+	// with whatever it writes
+	fp = open_memstream(&buffer, &size);
+	if (fp == NULL) {
+		return PyErr_SetFromErrno(PyExc_OSError);
 	}
+	// write pairing params into buffer
+	pbc_param_out_str(fp, parameters->pbc_params);
+	fclose(fp);
+	param = PyUnicode_FromStringAndSize(buffer, size);
+	free(buffer);
 	
 	return param;
 }
 
-// deallocates the object when done
-void Parameters_dealloc(Parameters *parameters) {
-	// kill the Parameters
-	if(parameters->ready) {
-		pbc_param_clear(parameters->pbc_params);
+PyDoc_STRVAR(Parameters_save__doc__,
+"parameters.save(path) -> None\n\n\
+Writes the parameters to path in PBC's text format, so that a later\n\
+Parameters.load(path) can skip generating them again.");
+PyObject *Parameters_save(Parameters *self, PyObject *args) {
+	PyObject *path;
+	if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path)) {
+		return NULL;
+	}
+	if (!self->ready) {
+		Py_DECREF(path);
+		PyErr_SetString(PyExc_ValueError, "Parameters have not been initialised.");
+		return NULL;
 	}
-	// free the actual object
-	Py_TYPE(parameters)->tp_free((PyObject*)parameters);
-}
+
+	FILE *fp = fopen(PyBytes_AS_STRING(path), "w");
+	if (fp == NULL) {
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		Py_DECREF(path);
+		return NULL;
+	}
+	pbc_param_out_str(fp, self->pbc_params);
+	if (fclose(fp) != 0) {
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		Py_DECREF(path);
+		return NULL;
+	}
+	Py_DECREF(path);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(Parameters_load__doc__,
+"Parameters.load(path) -> Parameters\n\n\
+Reads parameters written by parameters.save(path), or any other file in\n\
+PBC's text format.");
+PyObject *Parameters_load(PyObject *cls, PyObject *args) {
+	PyObject *path;
+	if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path)) {
+		return NULL;
+	}
+
+	FILE *fp = fopen(PyBytes_AS_STRING(path), "r");
+	if (fp == NULL) {
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		Py_DECREF(path);
+		return NULL;
+	}
+
+	// slurp the whole file, however large it is
+	char *buffer = NULL;
+	size_t size = 0, used = 0, got;
+	do {
+		if (used == size) {
+			size = size ? 2 * size : 4096;
+			char *grown = PyMem_Realloc(buffer, size);
+			if (grown == NULL) {
+				PyMem_Free(buffer);
+				fclose(fp);
+				Py_DECREF(path);
+				return PyErr_NoMemory();
+			}
+			buffer = grown;
+		}
+		got = fread(buffer + used, 1, size - used, fp);
+		used += got;
+	} while (got > 0);
+	if (ferror(fp)) {
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		PyMem_Free(buffer);
+		fclose(fp);
+		Py_DECREF(path);
+		return NULL;
+	}
+	fclose(fp);
+	Py_DECREF(path);
+
+	// build the Parameters from what we read
+	Parameters *self = (Parameters *)Parameters_new((PyTypeObject *)cls, NULL, NULL);
+	if (self == NULL) {
+		PyMem_Free(buffer);
+		return NULL;
+	}
+	if (pbc_param_init_set_buf(self->pbc_params, buffer, used)) {
+		PyMem_Free(buffer);
+		Py_DECREF(self);
+		PyErr_SetString(PyExc_ValueError, "could not parse parameter file.");
+		return NULL;
+	}
+	PyMem_Free(buffer);
+	self->ready = 1;
+	return (PyObject *)self;
+}
+
+// deallocates the object when done
+void Parameters_dealloc(Parameters *parameters) {
+	// kill the Parameters
+	if(parameters->ready) {
+		pbc_param_clear(parameters->pbc_params);
+	}
+	// free the actual object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(parameters);
+	type->tp_free((PyObject*)parameters);
+	Py_DECREF(type);
+}
 
 PyMemberDef Parameters_members[] = {
 	{NULL}
 };
 
 PyMethodDef Parameters_methods[] = {
+	{"save", (PyCFunction)Parameters_save, METH_VARARGS, Parameters_save__doc__},
+	{"load", (PyCFunction)Parameters_load, METH_VARARGS | METH_CLASS, Parameters_load__doc__},
+	{"__sizeof__", (PyCFunction)Parameters_sizeof, METH_NOARGS, Parameters_sizeof__doc__},
 	{NULL}
 };
 
-PyTypeObject ParametersType = {
-	PyVarObject_HEAD_INIT(NULL, 0)
-	"pypbc.Parameters",             /*tp_name*/
-	sizeof(Parameters),             /*tp_basicsize*/
-	0,                         /*tp_itemsize*/
-	(destructor)Parameters_dealloc, /*tp_dealloc*/
-	0,                         /*tp_print*/
-	0,                         /*tp_getattr*/
-	0,                         /*tp_setattr*/
-	0,                         /*tp_compare*/
-	Parameters_str,                         /*tp_repr*/
-	0,                         /*tp_as_number*/
-	0,                         /*tp_as_sequence*/
-	0,                         /*tp_as_mapping*/
-	0,                         /*tp_hash */
-	0,                         /*tp_call*/
-	Parameters_str,                         /*tp_str*/
-	0,                         /*tp_getattro*/
-	0,                         /*tp_setattro*/
-	0,                         /*tp_as_buffer*/
-	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
-	Parameters__doc__,           /* tp_doc */
-	0,		               /* tp_traverse */
-	0,		               /* tp_clear */
-	0,		               /* tp_richcompare */
-	0,		               /* tp_weaklistoffset */
-	0,		               /* tp_iter */
-	0,		               /* tp_iternext */
-	Parameters_methods,             /* tp_methods */
-	Parameters_members,             /* tp_members */
-	0,                         /* tp_getset */
-	0,                         /* tp_base */
-	0,                         /* tp_dict */
-	0,                         /* tp_descr_get */
-	0,                         /* tp_descr_set */
-	0,                         /* tp_dictoffset */
-	(initproc)Parameters_init,      /* tp_init */
-	0,                         /* tp_alloc */
-	Parameters_new,                 /* tp_new */
+PyType_Slot Parameters_slots[] = {
+	{Py_tp_dealloc, Parameters_dealloc},
+	{Py_tp_repr, Parameters_str},
+	{Py_tp_str, Parameters_str},
+	{Py_tp_doc, (void *)Parameters__doc__},
+	{Py_tp_methods, Parameters_methods},
+	{Py_tp_members, Parameters_members},
+	{Py_tp_init, Parameters_init},
+	{Py_tp_new, Parameters_new},
+	{0, NULL}
 };
 
+PyType_Spec Parameters_spec = {
+	"pypbc.Parameters",
+	sizeof(Parameters),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	Parameters_slots
+};
 
 /*******************************************************************************
-*						Pairings							      *
+*						Background generation							      *
 *******************************************************************************/
 
-PyDoc_STRVAR(Pairing__doc__,
-"Pairing(parameters) -> Pairing object\n\n\
-Represents a bilinear pairing, frequently referred to as e-hat.\n");
-// allocate the object
-PyObject *Pairing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
-	// create the new Pairing object
-	Pairing *self = (Pairing *)type->tp_alloc(type, 0);
-	// you are not prepared!
-	self->ready = 0;
-	// make sure it actually worked
-	if (!self) {
-		PyErr_SetString(PyExc_TypeError, "could not create Pairing object.");
+// guards the queue feeding the worker pool behind the *_async methods, and
+// every pypbc_interp
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_cond = PTHREAD_COND_INITIALIZER;
+// signalled whenever a native thread lets go of an interpreter
+static pthread_cond_t interp_cond = PTHREAD_COND_INITIALIZER;
+
+// makes the record for the calling interpreter; needs the GIL
+static pypbc_interp *interp_new(void) {
+	pypbc_interp *record = PyMem_RawCalloc(1, sizeof(pypbc_interp));
+	if (record == NULL) {
+		PyErr_NoMemory();
 		return NULL;
 	}
-	
-	return (PyObject*) self;
+	record->interp = PyInterpreterState_Get();
+	record->alive = 1;
+	record->refs = 1;
+	return record;
 }
 
-// Pairing(params) -> Pairing
-int Pairing_init(Pairing *self, PyObject *args) {
-	// only argument is the Parameters
-	PyObject *parameters;
-	if (!PyArg_ParseTuple(args, "O", &parameters)) {
-		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
-		// XXX notice this flags errors on -1, not NULL!
-		return -1;
+// every job in flight holds a reference, as does the module
+static void interp_retain(pypbc_interp *record) {
+	pthread_mutex_lock(&pool_lock);
+	record->refs++;
+	pthread_mutex_unlock(&pool_lock);
+}
+
+static void interp_release(pypbc_interp *record) {
+	pthread_mutex_lock(&pool_lock);
+	int last = --record->refs == 0;
+	pthread_mutex_unlock(&pool_lock);
+	if (last) {
+		PyMem_RawFree(record);
 	}
-	
-	// check to make sure we're getting params
-	if(!PyObject_TypeCheck(parameters, &ParametersType)) {
-		PyErr_SetString(PyExc_TypeError, "expected Parameter, got something else.");
-		return -1;
+}
+
+// gives the calling native thread a thread state in the record's
+// interpreter and takes that interpreter's GIL. Returns NULL, touching
+// nothing, once the interpreter has started shutting down.
+static PyThreadState *interp_attach(pypbc_interp *record) {
+	pthread_mutex_lock(&pool_lock);
+	int alive = record->alive;
+	if (alive) {
+		record->attached++;
 	}
-	
-	// cast the Parameters
-	Parameters *param = (Parameters*)parameters;
-	// use the Parameters to init the pairing
-	pairing_init_pbc_param(self->pbc_pairing, param->pbc_params);
-	// you're ready
-	self->ready = 1;
-	// all's clear	
-	return 0;
+	pthread_mutex_unlock(&pool_lock);
+	if (!alive) {
+		return NULL;
+	}
+
+	PyThreadState *tstate = PyThreadState_New(record->interp);
+	if (tstate == NULL) {
+		pthread_mutex_lock(&pool_lock);
+		record->attached--;
+		pthread_cond_broadcast(&interp_cond);
+		pthread_mutex_unlock(&pool_lock);
+		return NULL;
+	}
+	PyEval_RestoreThread(tstate);
+	return tstate;
 }
-		
-// deallocates the object when done
-void Pairing_dealloc(Pairing *pairing) {
-	// kill the pairing element
-	if (pairing->ready) {
-		pairing_clear(pairing->pbc_pairing);
+
+// undoes interp_attach
+static void interp_detach(pypbc_interp *record, PyThreadState *tstate) {
+	PyThreadState_Clear(tstate);
+	PyThreadState_DeleteCurrent();
+	pthread_mutex_lock(&pool_lock);
+	record->attached--;
+	pthread_cond_broadcast(&interp_cond);
+	pthread_mutex_unlock(&pool_lock);
+}
+
+// a batch of prime searches: each slot starts out as a random candidate
+// and ends up as the next prime after it
+typedef struct {
+	mpz_t *primes;
+	Py_ssize_t count;
+	Py_ssize_t next;
+} prime_search;
+
+static void *prime_search_worker(void *arg) {
+	prime_search *search = (prime_search *)arg;
+	Py_ssize_t i;
+	// keep taking candidates until there are none left
+	while ((i = __atomic_fetch_add(&search->next, 1, __ATOMIC_RELAXED)) < search->count) {
+		mpz_nextprime(search->primes[i], search->primes[i]);
 	}
-	// free the actual object
-	Py_TYPE(pairing)->tp_free((PyObject*)pairing);
+	return NULL;
 }
 
-// applies the bilinear map action
-// pairing.apply(Element e1, Element e2) -> Element e3
-PyObject* Pairing_apply(PyObject *self, PyObject *args) {
-	// process our arguments
-	// we need two elements
-	PyObject *element_1;
-	PyObject *element_2;
-	if (!PyArg_ParseTuple(args, "OO", &element_1, &element_2)) {
+// runs the searches on up to one native thread per core; safe to call
+// without the GIL
+static void prime_search_run(prime_search *search) {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	Py_ssize_t nthreads = search->count < cores ? search->count : cores;
+	pthread_t threads[256];
+	Py_ssize_t started = 0, i;
+
+	if (nthreads > 256) {
+		nthreads = 256;
+	}
+	search->next = 0;
+	// the calling thread is one of the workers
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&threads[started], NULL, prime_search_worker, search) == 0) {
+			started++;
+		}
+	}
+	prime_search_worker(search);
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+}
+
+// draws the random starting points; needs the GIL, since it goes through
+// PBC's random source
+static prime_search *prime_search_new(Py_ssize_t count, int num_bits) {
+	prime_search *search = PyMem_RawCalloc(1, sizeof(prime_search));
+	if (search == NULL) {
+		return NULL;
+	}
+	search->primes = PyMem_RawCalloc(count ? count : 1, sizeof(mpz_t));
+	if (search->primes == NULL) {
+		PyMem_RawFree(search);
+		return NULL;
+	}
+	search->count = count;
+	Py_ssize_t i;
+	for (i = 0; i < count; i++) {
+		mpz_init(search->primes[i]);
+		pbc_mpz_randomb(search->primes[i], num_bits);
+	}
+	return search;
+}
+
+static void prime_search_free(prime_search *search) {
+	Py_ssize_t i;
+	for (i = 0; i < search->count; i++) {
+		mpz_clear(search->primes[i]);
+	}
+	PyMem_RawFree(search->primes);
+	PyMem_RawFree(search);
+}
+
+static PyObject *prime_search_result(prime_search *search) {
+	PyObject *result = PyList_New(search->count);
+	Py_ssize_t i;
+	if (result == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < search->count; i++) {
+		PyObject *prime = mpz_to_pynum(search->primes[i]);
+		if (prime == NULL) {
+			Py_DECREF(result);
+			return NULL;
+		}
+		PyList_SET_ITEM(result, i, prime);
+	}
+	return result;
+}
+
+// parses (n, bits) for the get_random_primes family
+static prime_search *prime_search_from_args(PyObject *args) {
+	Py_ssize_t count;
+	int num_bits;
+	if (!PyArg_ParseTuple(args, "ni", &count, &num_bits)) {
 		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
 		return NULL;
 	}
-	
-	// check the types on the arguments
-	if(!PyObject_TypeCheck(element_1, &ElementType)){
-		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+	if (count < 0 || num_bits < 1) {
+		PyErr_SetString(PyExc_ValueError, "n must not be negative and bits must be positive.");
 		return NULL;
 	}
-	if(!PyObject_TypeCheck(element_2, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+	prime_search *search = prime_search_new(count, num_bits);
+	if (search == NULL) {
+		PyErr_NoMemory();
+	}
+	return search;
+}
+
+PyDoc_STRVAR(get_random_primes__doc__,
+"get_random_primes(n, bits) -> list of n random primes of the given bitlength\n\n\
+The searches run in parallel on native threads, one per core, without the GIL.");
+PyObject *get_random_primes(PyObject *self, PyObject *args) {
+	prime_search *search = prime_search_from_args(args);
+	if (search == NULL) {
 		return NULL;
 	}
+	Py_BEGIN_ALLOW_THREADS
+	prime_search_run(search);
+	Py_END_ALLOW_THREADS
+	PyObject *result = prime_search_result(search);
+	prime_search_free(search);
+	return result;
+}
 
-	// extract the actual elements
-	Element *e1 = (Element*)element_1;
-	Element *e2 = (Element*)element_2;
-	
-	// extract the pairing object
-	Pairing *p = (Pairing*)self;
-	
-	// we build a third element to store the outcome
-	Element *e3 = (Element *)ElementType.tp_alloc(&ElementType, 0);
-	element_init_GT(e3->pbc_element, p->pbc_pairing);
-	e3->group = GT;
-	
-	// and apply the pairing
-	pairing_apply(e3->pbc_element, e1->pbc_element, e2->pbc_element, p->pbc_pairing);
-	
-	// incref the pairing we depend on
-	Py_INCREF(p);
-	
-	// set the pairing
-	e3->pairing = e1->pairing;
-	
-	// mark it ready
-	e3->ready = 1;
+// what a background job is going to build
+enum BackgroundKind {BG_PRIMES, BG_PARAMS_A1, BG_PARAMS_F, BG_PARAMS_A, BG_PARAMS_E, BG_PARAMS_D, BG_PARAMS_G};
 
-	// cast and return the object
-	return (PyObject*)e3;
+typedef struct {
+	enum BackgroundKind kind;
+	prime_search *search;
+	mpz_t n;
+	int bits;
+	int qbits;
+	int rbits;
+	// the discriminant for types D and G, and whether a curve was found
+	unsigned int D;
+	int failed;
+	pbc_param_t params;
+	PyObject *future;
+	// the interpreter to report back to, and the type to report in
+	pypbc_interp *owner;
+	PyObject *params_type;
+} background_job;
+
+// frees the native parts of a job; the Python parts are released by
+// background_job_complete
+static void background_job_free(background_job *job) {
+	if (job->search) {
+		prime_search_free(job->search);
+	}
+	if (job->kind == BG_PARAMS_A1) {
+		mpz_clear(job->n);
+	}
+	if (job->owner) {
+		interp_release(job->owner);
+	}
+	PyMem_RawFree(job);
 }
 
-PyMemberDef Pairing_members[] = {
-	{NULL}
-};
+// hands the finished work to the future; called with the GIL held
+static void background_job_complete(background_job *job) {
+	PyObject *result = NULL;
+	if (job->kind == BG_PRIMES) {
+		result = prime_search_result(job->search);
+	} else if (job->failed) {
+		PyErr_Format(PyExc_ValueError, "no type %c curve with D = %u has a q of at most %d bits.", job->kind == BG_PARAMS_D ? 'd' : 'g', job->D, job->qbits);
+	} else {
+		Parameters *params = (Parameters *)Parameters_new((PyTypeObject *)job->params_type, NULL, NULL);
+		if (params != NULL) {
+			// move the generated parameters into the new object
+			params->pbc_params[0] = job->params[0];
+			params->ready = 1;
+		} else {
+			pbc_param_clear(job->params);
+		}
+		result = (PyObject *)params;
+	}
 
-PyMethodDef Pairing_methods[] = {
-	{"apply", Pairing_apply, METH_VARARGS, "applies the pairing."},
-	{NULL}
-};
+	PyObject *ret;
+	if (result != NULL) {
+		ret = PyObject_CallMethod(job->future, "set_result", "O", result);
+		Py_DECREF(result);
+	} else {
+		PyObject *type, *value, *traceback;
+		PyErr_Fetch(&type, &value, &traceback);
+		PyErr_NormalizeException(&type, &value, &traceback);
+		ret = PyObject_CallMethod(job->future, "set_exception", "O", value);
+		Py_XDECREF(type);
+		Py_XDECREF(value);
+		Py_XDECREF(traceback);
+	}
+	if (ret == NULL) {
+		PyErr_WriteUnraisable(job->future);
+	}
+	Py_XDECREF(ret);
+	Py_DECREF(job->future);
+	Py_DECREF(job->params_type);
+}
 
-PyTypeObject PairingType = {
-	PyVarObject_HEAD_INIT(NULL, 0)
-	"pypbc.Pairing",             /*tp_name*/
-	sizeof(Pairing),             /*tp_basicsize*/
-	0,                         /*tp_itemsize*/
-	(destructor)Pairing_dealloc, /*tp_dealloc*/
-	0,                         /*tp_print*/
-	0,                         /*tp_getattr*/
-	0,                         /*tp_setattr*/
-	0,			   /*tp_reserved*/
-	0,                         /*tp_repr*/
-	0,                         /*tp_as_number*/
-	0,                         /*tp_as_sequence*/
-	0,                         /*tp_as_mapping*/
-	0,                         /*tp_hash */
-	0,                         /*tp_call*/
-	0,                         /*tp_str*/
-	0,                         /*tp_getattro*/
-	0,                         /*tp_setattro*/
-	0,                         /*tp_as_buffer*/
-	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
-	Pairing__doc__,           /* tp_doc */
-	0,		               /* tp_traverse */
-	0,		               /* tp_clear */
-	0,		               /* tp_richcompare */
-	0,		               /* tp_weaklistoffset */
-	0,		               /* tp_iter */
-	0,		               /* tp_iternext */
-	Pairing_methods,             /* tp_methods */
-	Pairing_members,             /* tp_members */
-	0,                         /* tp_getset */
-	0,                         /* tp_base */
-	0,                         /* tp_dict */
-	0,                         /* tp_descr_get */
-	0,                         /* tp_descr_set */
-	0,                         /* tp_dictoffset */
-	(initproc)Pairing_init,      /* tp_init */
-	0,                         /* tp_alloc */
-	Pairing_new,                 /* tp_new */
-};
+static void *background_job_run(void *arg) {
+	background_job *job = (background_job *)arg;
 
-/*******************************************************************************
-*						Elements							      *
-*******************************************************************************/
+	// the slow part, with no Python state touched
+	fp_default_lock();
+	switch (job->kind) {
+		case BG_PRIMES: prime_search_run(job->search); break;
+		case BG_PARAMS_A1: pbc_param_init_a1_gen(job->params, job->n); break;
+		case BG_PARAMS_F: pbc_param_init_f_gen(job->params, job->bits); break;
+		case BG_PARAMS_A: pbc_param_init_a_gen(job->params, job->rbits, job->qbits); break;
+		case BG_PARAMS_E: pbc_param_init_e_gen(job->params, job->rbits, job->qbits); break;
+		case BG_PARAMS_D: job->failed = cm_generate(job->params, 'd', job->D, job->qbits) < 0; break;
+		case BG_PARAMS_G: job->failed = cm_generate(job->params, 'g', job->D, job->qbits) < 0; break;
+	}
+	fp_default_unlock();
 
-PyDoc_STRVAR(Element__doc__,
-"Represents an element of a bilinear group.\n\n\
-Basic usage:\n\
-\n\
-Element(pairing, G1||G2||GT||Zr, value=v) -> Element\n\
-Element.one(pairing, G1||G2||GT||Zr) -> identity element for the given group.\n\
-Element.zero(pairing, G1||G2||GT||Zr) -> identity element for the given group.\n\
-Element.random(pairing, G1||G2||GT||Zr) -> random element of the given group.\n\
-Element.from_hash(pairing, G1||G2||GT||Zr -> element whose value is determined by the given hash value.\n\
-\n\
-Most of the basic arithmetic operations apply. Please note that many of them\n\
-do not make sense between groups, and that not all of these are checked for.");
+	// and then back into the interpreter that asked, to resolve the future
+	PyThreadState *tstate = interp_attach(job->owner);
+	if (tstate != NULL) {
+		background_job_complete(job);
+		interp_detach(job->owner, tstate);
+	}
+	background_job_free(job);
+	return NULL;
+}
 
-Element *Element_create(void) {
-	// build ourselves
-	Element *self = (Element*)(&ElementType)->tp_alloc(&ElementType, 0);
-	if(self == NULL) {
+// starts the job on a detached native thread and returns its future
+static PyObject *background_job_start(pypbc_state *state, background_job *job) {
+	PyObject *futures = PyImport_ImportModule("concurrent.futures");
+	if (futures == NULL) {
+		background_job_free(job);
 		return NULL;
 	}
-	self->pairing = NULL;
-	self->ready = 0;
-	return self;
-}
-// allocate the object
-PyObject *Element_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
-	// build ourselves
-	Element *self = Element_create();
-	// cast it and send it on
-	return (PyObject*)self;
+	job->future = PyObject_CallMethod(futures, "Future", NULL);
+	Py_DECREF(futures);
+	if (job->future == NULL) {
+		background_job_free(job);
+		return NULL;
+	}
+	// the work can't be called back once it's started, so say so up front
+	PyObject *ret = PyObject_CallMethod(job->future, "set_running_or_notify_cancel", NULL);
+	if (ret == NULL) {
+		Py_DECREF(job->future);
+		background_job_free(job);
+		return NULL;
+	}
+	Py_DECREF(ret);
+	interp_retain(state->interp);
+	job->owner = state->interp;
+	Py_INCREF(state->ParametersType);
+	job->params_type = (PyObject *)state->ParametersType;
+
+	// one reference for us to return, one for the thread
+	PyObject *future = job->future;
+	Py_INCREF(future);
+
+	pthread_t thread;
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	int err = pthread_create(&thread, &attr, background_job_run, job);
+	pthread_attr_destroy(&attr);
+	if (err != 0) {
+		errno = err;
+		PyErr_SetFromErrno(PyExc_OSError);
+		Py_DECREF(job->future);
+		Py_DECREF(job->params_type);
+		Py_DECREF(future);
+		background_job_free(job);
+		return NULL;
+	}
+	return future;
 }
 
-// Element(pairing, group, value=Element/long) -> Element
-int Element_init(PyObject *py_self, PyObject *args, PyObject *kwargs) {
-	// required arguments are the pairing and the group
-	PyObject *pypairing;
-	enum Group group;
-	int ii;
-	// optional value argument
-	PyObject *value = NULL;
-	char *keys[] = {"pairing", "group", "value", NULL};
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|O", keys, &pypairing, &group, &value)) {
-		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
-		// XXX notice this flags errors on -1, not NULL!
-		return -1;
+PyDoc_STRVAR(get_random_primes_async__doc__,
+"get_random_primes_async(n, bits) -> concurrent.futures.Future\n\n\
+Like get_random_primes, but returns at once. The future resolves to the\n\
+list of primes; use asyncio.wrap_future to await it.");
+PyObject *get_random_primes_async(PyObject *self, PyObject *args) {
+	prime_search *search = prime_search_from_args(args);
+	if (search == NULL) {
+		return NULL;
 	}
-	
-	// check the type of arguments
-	if(!PyObject_TypeCheck(pypairing, &PairingType)) {
-		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
-		return -1;
+	background_job *job = PyMem_RawCalloc(1, sizeof(background_job));
+	if (job == NULL) {
+		prime_search_free(search);
+		return PyErr_NoMemory();
 	}
-	
-	// build the element pointer
-	Element *self = (Element*)py_self;
+	job->kind = BG_PRIMES;
+	job->search = search;
+	return background_job_start(PyModule_GetState(self), job);
+}
 
-	// store the pairing and incref it, since we depend on its existence
-	Py_INCREF(pypairing);
-	self->pairing = pypairing;
-	
-	// cast the arguments
-	Pairing *prepairing = (Pairing*)pypairing;
+PyDoc_STRVAR(generate_parameters_async__doc__,
+"generate_parameters_async(n=x, qbits=q, rbits=r, short=True/False, family=f, D=d) -> concurrent.futures.Future\n\n\
+Generates a type A1 or F curve (given n), a type A or E curve (given qbits\n\
+and rbits) or a type D or G curve (given family) on a native thread, exactly\n\
+as Parameters(...) would, and returns at once. The future resolves to the Parameters; use asyncio.wrap_future to\n\
+await it.");
+PyObject *generate_parameters_async(PyObject *self, PyObject *args, PyObject *kwargs) {
+	char *kwds[] = {"n", "qbits", "rbits", "short", "family", "D", NULL};
+	PyObject *n = NULL;
+	int qbits = 0;
+	int rbits = 0;
+	PyObject *is_short = NULL;
+	const char *family = NULL;
+	unsigned int D = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OiiOsI", kwds, &n, &qbits, &rbits, &is_short, &family, &D)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
 
-	// use the arguments to init the element
-	switch(group) {
-		case G1: element_init_G1(self->pbc_element, prepairing->pbc_pairing); break;
-		case G2: element_init_G2(self->pbc_element, prepairing->pbc_pairing); break;
-		case GT: element_init_GT(self->pbc_element, prepairing->pbc_pairing); break;
-		case Zr: element_init_Zr(self->pbc_element, prepairing->pbc_pairing); break;
-		default: return -1;
+	background_job *job = PyMem_RawCalloc(1, sizeof(background_job));
+	if (job == NULL) {
+		return PyErr_NoMemory();
 	}
-	
-	// set the group argument
-	self->group = group;
 
-	// handle the value argument
-	if (value != NULL) {
-		// if it's a long...
-		if (PyLong_Check(value)) {
-			// convert it to an mpz
-			mpz_t new_n;
-			pynum_to_mpz(value, new_n);
-			element_set_mpz(self->pbc_element, new_n);
-		// if it's another element
-		} else if (PyObject_TypeCheck(value, &ElementType)) {
-			// set the value
-			Element *e = (Element*)value;
-			element_set(self->pbc_element, e->pbc_element);
-		} else {
+	// the same signatures as Parameters, less the string
+	if (family && !n && !rbits && !is_short) {
+		if (cm_resolve(family, &D, &qbits) < 0) {
+			PyMem_RawFree(job);
+			return NULL;
+		}
+		job->kind = family[0] == 'd' ? BG_PARAMS_D : BG_PARAMS_G;
+		job->D = D;
+		job->qbits = qbits;
+	} else if (family || D) {
+		PyMem_RawFree(job);
+		PyErr_SetString(PyExc_ValueError, "family and D only go with qbits.");
+		return NULL;
+	} else if (n && !(qbits || rbits)) {
+		if (!PyLong_Check(n)) {
+			PyMem_RawFree(job);
+			PyErr_SetString(PyExc_TypeError, "Expected long, got something else.");
+			return NULL;
+		}
+		if (is_short == Py_True) {
+			job->kind = BG_PARAMS_F;
+			job->bits = (int)PyNumber_AsSsize_t(n, PyExc_OverflowError);
+			if (job->bits == -1 && PyErr_Occurred()) {
+				PyMem_RawFree(job);
+				return NULL;
+			}
+		} else {
+			job->kind = BG_PARAMS_A1;
+			if (pynum_to_mpz(n, job->n) < 0) {
+				mpz_clear(job->n);
+				PyMem_RawFree(job);
+				return NULL;
+			}
+		}
+	} else if (qbits && rbits && !n) {
+		job->kind = is_short == Py_True ? BG_PARAMS_E : BG_PARAMS_A;
+		job->qbits = qbits;
+		job->rbits = rbits;
+	} else {
+		PyMem_RawFree(job);
+		PyErr_SetString(PyExc_ValueError, "Impossible to determine desired curve type, please provide n or (qbits and rbits).");
+		return NULL;
+	}
+	return background_job_start(PyModule_GetState(self), job);
+}
+
+// registered with atexit in each interpreter, so that native threads
+// finishing after it has started shutting down leave it alone
+PyObject *background_atexit(PyObject *self, PyObject *unused) {
+	pypbc_interp *record = ((pypbc_state *)PyModule_GetState(self))->interp;
+	// let go of the GIL, so anyone already inside can finish and get out
+	Py_BEGIN_ALLOW_THREADS
+	pthread_mutex_lock(&pool_lock);
+	record->alive = 0;
+	while (record->attached > 0) {
+		pthread_cond_wait(&interp_cond, &pool_lock);
+	}
+	pthread_mutex_unlock(&pool_lock);
+	Py_END_ALLOW_THREADS
+	Py_RETURN_NONE;
+}
+
+PyMethodDef background_atexit_def = {
+	"_background_atexit", background_atexit, METH_NOARGS, NULL
+};
+
+
+/*******************************************************************************
+*						Statistics							      *
+*******************************************************************************/
+
+// whether operations are being counted, traced, or both. With neither, an
+// operation costs one relaxed load of this; counting costs two clock
+// readings and a few atomic adds.
+#define INSTRUMENT_STATS 1
+#define INSTRUMENT_TRACE 2
+static int instrument_flags = 0;
+
+static void trace_operation(enum StatOp op, Element *out, PyObject *a, PyObject *b, uint64_t ns);
+
+// the names Pairing.stats() gives each StatOp
+static const char *stats_names[STAT_COUNT] = {"apply", "pow", "mult", "from_hash", "parse", "str"};
+
+// what a thread has done since it entered a scope; scopes nest, and what is
+// counted in one is counted in all of those around it
+typedef struct stats_scope {
+	pypbc_stats stats;
+	struct stats_scope *outer;
+} stats_scope;
+
+static __thread stats_scope *stats_thread_scope = NULL;
+
+uint64_t stats_begin(void) {
+	if (!__atomic_load_n(&instrument_flags, __ATOMIC_RELAXED)) {
+		return 0;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void stats_end(enum StatOp op, Element *out, PyObject *a, PyObject *b, uint64_t start) {
+	// everything was off when the operation began
+	if (start == 0) {
+		return;
+	}
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec - start;
+	int flags = __atomic_load_n(&instrument_flags, __ATOMIC_RELAXED);
+	if (flags & INSTRUMENT_STATS) {
+		// the pairing's counters are shared between threads
+		pypbc_stats *stats = &((Pairing *)out->pairing)->stats;
+		__atomic_fetch_add(&stats->count[op], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&stats->ns[op], ns, __ATOMIC_RELAXED);
+		// the scope's belong to this thread alone
+		if (stats_thread_scope != NULL) {
+			stats_thread_scope->stats.count[op]++;
+			stats_thread_scope->stats.ns[op] += ns;
+		}
+	}
+	if (flags & INSTRUMENT_TRACE) {
+		trace_operation(op, out, a, b, ns);
+	}
+}
+
+// {name: {"count": n, "ns": t}} for each operation
+static PyObject *stats_to_dict(pypbc_stats *stats) {
+	PyObject *result = PyDict_New();
+	if (result == NULL) {
+		return NULL;
+	}
+	for (int i = 0; i < STAT_COUNT; i++) {
+		PyObject *entry = Py_BuildValue("{s:K,s:K}",
+			"count", (unsigned long long)__atomic_load_n(&stats->count[i], __ATOMIC_RELAXED),
+			"ns", (unsigned long long)__atomic_load_n(&stats->ns[i], __ATOMIC_RELAXED));
+		if (entry == NULL || PyDict_SetItemString(result, stats_names[i], entry) < 0) {
+			Py_XDECREF(entry);
+			Py_DECREF(result);
+			return NULL;
+		}
+		Py_DECREF(entry);
+	}
+	return result;
+}
+
+PyDoc_STRVAR(set_stats_enabled__doc__,
+"set_stats_enabled(flag) -> None\n\n\
+Switches the counting and timing of pairings, powers, products, hashes into\n\
+a group, parsing and str() on or off for every Pairing; see Pairing.stats().\n\
+It starts off.");
+PyObject *set_stats_enabled(PyObject *self, PyObject *flag) {
+	int on = PyObject_IsTrue(flag);
+	if (on < 0) {
+		return NULL;
+	}
+	if (on) {
+		__atomic_fetch_or(&instrument_flags, INSTRUMENT_STATS, __ATOMIC_RELAXED);
+	} else {
+		__atomic_fetch_and(&instrument_flags, ~INSTRUMENT_STATS, __ATOMIC_RELAXED);
+	}
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(get_stats_enabled__doc__,
+"get_stats_enabled() -> bool\n\n\
+Whether operations are being counted; see set_stats_enabled.");
+PyObject *get_stats_enabled(PyObject *self, PyObject *unused) {
+	return PyBool_FromLong(__atomic_load_n(&instrument_flags, __ATOMIC_RELAXED) & INSTRUMENT_STATS);
+}
+
+PyDoc_STRVAR(_stats_scope_enter__doc__,
+"_stats_scope_enter() -> None\n\n\
+Starts a new scope on this thread, nested in any it is already in. Use\n\
+pypbc.stats_scope rather than calling this directly.");
+PyObject *_stats_scope_enter(PyObject *self, PyObject *unused) {
+	stats_scope *scope = PyMem_RawCalloc(1, sizeof(stats_scope));
+	if (scope == NULL) {
+		return PyErr_NoMemory();
+	}
+	scope->outer = stats_thread_scope;
+	stats_thread_scope = scope;
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(_stats_scope_exit__doc__,
+"_stats_scope_exit() -> dict\n\n\
+Leaves this thread's innermost scope, and returns what was done on the\n\
+thread inside it, across every Pairing, in the form Pairing.stats() uses.");
+PyObject *_stats_scope_exit(PyObject *self, PyObject *unused) {
+	stats_scope *scope = stats_thread_scope;
+	if (scope == NULL) {
+		PyErr_SetString(PyExc_RuntimeError, "not in a statistics scope.");
+		return NULL;
+	}
+	stats_thread_scope = scope->outer;
+	// the scope around this one saw all of it too
+	if (scope->outer != NULL) {
+		for (int i = 0; i < STAT_COUNT; i++) {
+			scope->outer->stats.count[i] += scope->stats.count[i];
+			scope->outer->stats.ns[i] += scope->stats.ns[i];
+		}
+	}
+	PyObject *result = stats_to_dict(&scope->stats);
+	PyMem_RawFree(scope);
+	return result;
+}
+
+PyDoc_STRVAR(Pairing_stats__doc__,
+"pairing.stats() -> dict\n\n\
+How many times each operation has been done on this pairing's elements\n\
+while statistics were on, and the nanoseconds spent on them, as\n\
+{name: {'count': n, 'ns': t}} for 'apply' (pairings), 'pow' (powers),\n\
+'mult' (products, which are powers in G1 and G2), 'from_hash', 'parse'\n\
+(Elements built from a value) and 'str'. Powers and pairings done by the\n\
+*_async methods are not counted.");
+PyObject *Pairing_stats(Pairing *self, PyObject *unused) {
+	return stats_to_dict(&self->stats);
+}
+
+// pairing.reset_stats() -> None
+PyObject *Pairing_reset_stats(Pairing *self, PyObject *unused) {
+	for (int i = 0; i < STAT_COUNT; i++) {
+		__atomic_store_n(&self->stats.count[i], 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&self->stats.ns[i], 0, __ATOMIC_RELAXED);
+	}
+	Py_RETURN_NONE;
+}
+
+/*******************************************************************************
+*						Tracing							      *
+*******************************************************************************/
+
+// the trace being written, if any; see pypbc_trace.h for its format.
+// trace_lock serialises everything below, and nothing holding it calls
+// back into Python. Where there is one it's a PyMutex, which lets go of
+// the thread state while it waits, so a stop-the-world collection can't
+// be kept waiting by a thread queued up for it.
+#if PY_VERSION_HEX >= 0x030D0000
+static PyMutex trace_lock = {0};
+#define trace_lock_acquire() PyMutex_Lock(&trace_lock)
+#define trace_lock_release() PyMutex_Unlock(&trace_lock)
+#else
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+#define trace_lock_acquire() pthread_mutex_lock(&trace_lock)
+#define trace_lock_release() pthread_mutex_unlock(&trace_lock)
+#endif
+static FILE *trace_file = NULL;
+static int trace_values = 0;
+static uint64_t trace_records = 0;
+// the errno of a write that failed, which stopped the trace
+static int trace_error = 0;
+
+// ids carry the trace they were handed out in in their top bits, so that
+// the ids Pairings and Elements kept from an earlier trace don't count in
+// this one
+#define TRACE_ID_SHIFT 40
+static uint64_t trace_generation = 0;
+static uint64_t trace_next_element = 0;
+static uint64_t trace_next_pairing = 0;
+
+// the payload of the record being built
+static unsigned char *trace_payload = NULL;
+static size_t trace_payload_size = 0;
+static size_t trace_payload_used = 0;
+
+// whether id was handed out in the current trace
+static int trace_id_current(uint64_t id) {
+	return id != 0 && (id >> TRACE_ID_SHIFT) == trace_generation;
+}
+
+// room for n more bytes of payload, or NULL if there isn't any to be had
+static unsigned char *trace_reserve(size_t n) {
+	if (trace_payload_used + n > trace_payload_size) {
+		size_t size = trace_payload_size ? trace_payload_size : 1024;
+		while (size < trace_payload_used + n) {
+			size *= 2;
+		}
+		unsigned char *grown = PyMem_RawRealloc(trace_payload, size);
+		if (grown == NULL) {
+			return NULL;
+		}
+		trace_payload = grown;
+		trace_payload_size = size;
+	}
+	return trace_payload + trace_payload_used;
+}
+
+// appends n bytes to the payload; values that don't fit are left out
+static void trace_append(const void *data, size_t n) {
+	unsigned char *room = trace_reserve(n);
+	if (room != NULL) {
+		memcpy(room, data, n);
+		trace_payload_used += n;
+	}
+}
+
+// appends e in element_to_bytes format
+static void trace_append_element(element_ptr e) {
+	int n = element_length_in_bytes(e);
+	unsigned char *room = trace_reserve(n);
+	if (room != NULL) {
+		element_to_bytes(room, e);
+		trace_payload_used += n;
+	}
+}
+
+// writes record with the payload built up for it, and starts a new one. A
+// failed write closes the trace, and stop_trace reports why.
+static void trace_write(pypbc_trace_record *record) {
+	record->length = (uint32_t)trace_payload_used;
+	trace_payload_used = 0;
+	if (trace_file == NULL) {
+		return;
+	}
+	if (fwrite(record, sizeof(*record), 1, trace_file) != 1 ||
+		(record->length > 0 && fwrite(trace_payload, record->length, 1, trace_file) != 1)) {
+		trace_error = errno ? errno : EIO;
+		fclose(trace_file);
+		trace_file = NULL;
+		__atomic_fetch_and(&instrument_flags, ~INSTRUMENT_TRACE, __ATOMIC_RELAXED);
+		return;
+	}
+	trace_records++;
+}
+
+// the pairing's number in this trace, describing it first if it's new
+static uint32_t trace_pairing(Pairing *pairing) {
+	if (!trace_id_current(pairing->trace_id)) {
+		pairing->trace_id = (trace_generation << TRACE_ID_SHIFT) | ++trace_next_pairing;
+		pypbc_trace_record record = {0};
+		record.op = TRACE_PAIRING;
+		record.pairing = (uint32_t)trace_next_pairing;
+		for (int i = 0; fp_backends[i] != NULL; i++) {
+			if (fp_backends[i] == pairing->fp_backend) {
+				record.flags = i;
+			}
+		}
+		char *text = NULL;
+		size_t size = 0;
+		FILE *fp = open_memstream(&text, &size);
+		if (fp != NULL) {
+			pbc_param_out_str(fp, ((Parameters *)pairing->parameters)->pbc_params);
+			fclose(fp);
+			trace_append(text, size);
+			free(text);
+		}
+		trace_write(&record);
+	}
+	return (uint32_t)(pairing->trace_id & 0xffffffff);
+}
+
+// the element's id in this trace; an element the trace hasn't seen before
+// is given one, and its value is written out first if values are wanted
+static uint64_t trace_element(Element *e) {
+	if (!trace_id_current(e->trace_id)) {
+		e->trace_id = (trace_generation << TRACE_ID_SHIFT) | ++trace_next_element;
+		if (trace_values) {
+			pypbc_trace_record record = {0};
+			record.op = TRACE_VALUE;
+			record.group = e->group;
+			record.pairing = trace_pairing((Pairing *)e->pairing);
+			record.out = e->trace_id;
+			trace_append_element(e->pbc_element);
+			trace_write(&record);
+		}
+	}
+	return e->trace_id;
+}
+
+// an operand as a trace record describes it, worked out before trace_lock
+// is taken since getting at an integer's or a buffer's contents can run
+// Python code
+typedef struct {
+	uint8_t kind;
+	uint8_t group;
+	int negative;
+	uint64_t field;
+	// the operand if it's an element
+	Element *element;
+	// the contents of any other operand, if values are wanted
+	unsigned char *data;
+	size_t size;
+} trace_arg;
+
+// fills in arg for the operand obj, with its contents if values is set.
+// Tracing never makes an operation fail, so an operand that can't be read
+// is left out.
+static void trace_arg_collect(pypbc_state *state, PyObject *obj, int values, trace_arg *arg) {
+	memset(arg, 0, sizeof(*arg));
+	if (obj == NULL) {
+		arg->kind = TRACE_ARG_NONE;
+	} else if (PyObject_TypeCheck(obj, state->ElementType)) {
+		arg->kind = TRACE_ARG_ELEMENT;
+		arg->group = ((Element *)obj)->group;
+		arg->element = (Element *)obj;
+	} else if (PyLong_Check(obj)) {
+		mpz_t n;
+		if (pynum_to_mpz(obj, n) < 0) {
+			PyErr_Clear();
+		}
+		arg->kind = TRACE_ARG_INTEGER;
+		arg->field = mpz_sizeinbase(n, 2);
+		arg->negative = mpz_sgn(n) < 0;
+		if (values) {
+			arg->data = PyMem_RawMalloc((arg->field + 7) / 8 + 1);
+			if (arg->data != NULL) {
+				mpz_export(arg->data, &arg->size, 1, 1, 1, 0, n);
+			}
+		}
+		mpz_clear(n);
+	} else {
+		Py_buffer view;
+		if (hash_input_get_buffer(obj, &view) < 0) {
+			PyErr_Clear();
+			arg->kind = TRACE_ARG_NONE;
+			return;
+		}
+		arg->kind = TRACE_ARG_BYTES;
+		arg->field = view.len;
+		if (values) {
+			arg->data = PyMem_RawMalloc(view.len + 1);
+			if (arg->data != NULL) {
+				memcpy(arg->data, view.buf, view.len);
+				arg->size = view.len;
+			}
+		}
+		PyBuffer_Release(&view);
+	}
+}
+
+// fills in the kind, group and id or size of an operand in a record, and
+// appends the contents of one that isn't an element to its payload
+static void trace_operand(trace_arg *arg, uint8_t *kind, uint8_t *group, uint64_t *field) {
+	*kind = arg->kind;
+	*group = arg->group;
+	if (arg->element != NULL) {
+		*field = trace_element(arg->element);
+	} else {
+		*field = arg->field;
+		if (arg->data != NULL) {
+			trace_append(arg->data, arg->size);
+		}
+	}
+}
+
+// writes out an operation that took ns and made out from a and b
+static void trace_operation(enum StatOp op, Element *out, PyObject *a, PyObject *b, uint64_t ns) {
+	pypbc_state *state = pypbc_state_of(out);
+	if (state == NULL) {
+		PyErr_Clear();
+		return;
+	}
+	// a trace started since we looked may want values we didn't read
+	int values = __atomic_load_n(&trace_values, __ATOMIC_RELAXED);
+	trace_arg args[2];
+	trace_arg_collect(state, a, values, &args[0]);
+	trace_arg_collect(state, b, values, &args[1]);
+	trace_lock_acquire();
+	if (trace_file != NULL && trace_values == values) {
+		pypbc_trace_record record = {0};
+		record.op = op;
+		record.group = out->group;
+		record.ns = ns;
+		record.pairing = trace_pairing((Pairing *)out->pairing);
+		// elements the trace hasn't seen yet get records of their own, which
+		// have to be written before this one's payload is started
+		if (op == STAT_STR) {
+			trace_element(out);
+		}
+		for (int i = 0; i < 2; i++) {
+			if (args[i].element != NULL) {
+				trace_element(args[i].element);
+			}
+		}
+		trace_operand(&args[0], &record.a_kind, &record.a_group, &record.a);
+		trace_operand(&args[1], &record.b_kind, &record.b_group, &record.b);
+		if (args[0].negative) {
+			record.flags |= TRACE_A_NEGATIVE;
+		}
+		if (args[1].negative) {
+			record.flags |= TRACE_B_NEGATIVE;
+		}
+		if (op == STAT_STR) {
+			// the element printed isn't new
+			record.out = out->trace_id;
+		} else {
+			record.out = out->trace_id = (trace_generation << TRACE_ID_SHIFT) | ++trace_next_element;
+			if (trace_values) {
+				trace_append_element(out->pbc_element);
+			}
+		}
+		trace_write(&record);
+	}
+	trace_lock_release();
+	PyMem_RawFree(args[0].data);
+	PyMem_RawFree(args[1].data);
+}
+
+// writes out that the program is done with e
+static void trace_free(Element *e) {
+	trace_lock_acquire();
+	if (trace_file != NULL && trace_id_current(e->trace_id)) {
+		pypbc_trace_record record = {0};
+		record.op = TRACE_FREE;
+		record.group = e->group;
+		record.pairing = (uint32_t)(((Pairing *)e->pairing)->trace_id & 0xffffffff);
+		record.out = e->trace_id;
+		trace_write(&record);
+	}
+	trace_lock_release();
+}
+
+PyDoc_STRVAR(start_trace__doc__,
+"start_trace(path, values=False) -> None\n\n\
+Starts recording every pairing, power, product, hash into a group, parse\n\
+and str() to the file at path, in the binary format pypbc_trace.h\n\
+describes, until stop_trace(). Each record names the operation, the groups\n\
+and identities of its operands, and the nanoseconds it took. With\n\
+values=True it also carries their values, which makes the trace far bigger\n\
+and means it holds whatever secrets went through it. pbc_replay runs a\n\
+trace again against PBC alone.");
+PyObject *start_trace(PyObject *self, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"path", "values", NULL};
+	PyObject *path;
+	int values = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&|p", keys, PyUnicode_FSConverter, &path, &values)) {
+		return NULL;
+	}
+	trace_lock_acquire();
+	if (trace_file != NULL) {
+		trace_lock_release();
+		Py_DECREF(path);
+		PyErr_SetString(PyExc_RuntimeError, "a trace is already being written.");
+		return NULL;
+	}
+	FILE *fp = fopen(PyBytes_AS_STRING(path), "wb");
+	pypbc_trace_header header = {PYPBC_TRACE_MAGIC, PYPBC_TRACE_VERSION, values ? TRACE_VALUES : 0};
+	if (fp == NULL || fwrite(&header, sizeof(header), 1, fp) != 1) {
+		if (fp != NULL) {
+			fclose(fp);
+		}
+		trace_lock_release();
+		PyErr_SetFromErrnoWithFilenameObject(PyExc_OSError, path);
+		Py_DECREF(path);
+		return NULL;
+	}
+	Py_DECREF(path);
+	trace_file = fp;
+	__atomic_store_n(&trace_values, values, __ATOMIC_RELAXED);
+	trace_records = 0;
+	trace_error = 0;
+	trace_generation++;
+	trace_next_element = 0;
+	trace_next_pairing = 0;
+	__atomic_fetch_or(&instrument_flags, INSTRUMENT_TRACE, __ATOMIC_RELAXED);
+	trace_lock_release();
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(stop_trace__doc__,
+"stop_trace() -> int\n\n\
+Finishes the trace start_trace began, and returns how many records it\n\
+holds. Raises OSError if writing it failed part way.");
+PyObject *stop_trace(PyObject *self, PyObject *unused) {
+	trace_lock_acquire();
+	__atomic_fetch_and(&instrument_flags, ~INSTRUMENT_TRACE, __ATOMIC_RELAXED);
+	if (trace_file != NULL && fclose(trace_file) != 0) {
+		trace_error = errno;
+	}
+	trace_file = NULL;
+	PyMem_RawFree(trace_payload);
+	trace_payload = NULL;
+	trace_payload_size = 0;
+	trace_payload_used = 0;
+	int error = trace_error;
+	uint64_t records = trace_records;
+	trace_error = 0;
+	trace_lock_release();
+	if (error) {
+		errno = error;
+		return PyErr_SetFromErrno(PyExc_OSError);
+	}
+	return PyLong_FromUnsignedLongLong(records);
+}
+
+/*******************************************************************************
+*						Pairings							      *
+*******************************************************************************/
+
+PyDoc_STRVAR(Pairing__doc__,
+"Pairing(parameters, tune=False, fp=None) -> Pairing object\n\n\
+Represents a bilinear pairing, frequently referred to as e-hat.\n\
+With tune=True, each group's exponentiation method is picked by timing\n\
+them all (see tune_pow). fp picks PBC's implementation of Fp for this\n\
+Pairing, in place of the one set_fp_backend chose.\n\
+\n\
+For a composite order (type A1) pairing, factors=(p, q, ...) gives the\n\
+primes the order is made of. The pairing then offers project() and\n\
+random_subgroup(), works powers in Zr by the CRT, and raises elements it\n\
+knows to lie in some of the subgroups to exponents reduced modulo their\n\
+orders.\n\
+Pairing.intern(parameters) returns a shared Pairing instead.\n\
+\n\
+A Pairing and its Elements may be used from several threads at once.\n");
+// allocate the object
+PyObject *Pairing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+	// create the new Pairing object
+	Pairing *self = (Pairing *)type->tp_alloc(type, 0);
+	// you are not prepared!
+	self->ready = 0;
+	// make sure it actually worked
+	if (!self) {
+		PyErr_SetString(PyExc_TypeError, "could not create Pairing object.");
+		return NULL;
+	}
+	
+	return (PyObject*) self;
+}
+
+// Pairing(params, tune=False, fp=None, factors=None) -> Pairing
+int Pairing_init(Pairing *self, PyObject *args, PyObject *kwargs) {
+	// the Parameters, whether to tune exponentiation, the Fp backend, and
+	// the factors of a composite group order
+	char *keys[] = {"parameters", "tune", "fp", "factors", NULL};
+	PyObject *parameters;
+	int tune = 0;
+	const char *fp = NULL;
+	PyObject *factors = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|pzO", keys, &parameters, &tune, &fp, &factors)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		// XXX notice this flags errors on -1, not NULL!
+		return -1;
+	}
+	
+	// check to make sure we're getting params
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return -1;
+	}
+	if(!PyObject_TypeCheck(parameters, state->ParametersType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Parameter, got something else.");
+		return -1;
+	}
+	
+	// pick the Fp backend
+	const char *backend = fp != NULL ? fp_backend_lookup(fp) : state->fp_backend;
+	if (backend == NULL) {
+		return -1;
+	}
+
+	// cast the Parameters
+	Parameters *param = (Parameters*)parameters;
+	// everything PBC and GMP allocate from here on is the pairing's
+	long long before = native_thread_bytes;
+
+	// use the Parameters to init the pairing, with the backend in force only
+	// for as long as that takes. A parameter generation can hold the lock
+	// for a long time, so wait for it without the GIL.
+	const char *kernels[2] = {NULL, NULL};
+	Py_BEGIN_ALLOW_THREADS
+	if (backend == fp_backends[0] || backend == FP_NATIVE) {
+		fp_default_lock();
+		pairing_init_pbc_param(self->pbc_pairing, param->pbc_params);
+		fp_default_unlock();
+		if (backend == FP_NATIVE) {
+			native_fp_setup(self->pbc_pairing, kernels);
+		}
+	} else {
+		pthread_rwlock_wrlock(&fp_lock);
+		pbc_tweak_use_fp((char *)backend);
+		pairing_init_pbc_param(self->pbc_pairing, param->pbc_params);
+		pbc_tweak_use_fp((char *)fp_backends[0]);
+		pthread_rwlock_unlock(&fp_lock);
+	}
+	Py_END_ALLOW_THREADS
+	self->fp_backend = backend;
+	self->fp_kernels = PyDict_New();
+	for (int i = 0; i < 2 && self->fp_kernels != NULL; i++) {
+		if (kernels[i] == NULL) {
+			continue;
+		}
+		PyObject *name = PyUnicode_FromString(kernels[i]);
+		if (name == NULL || PyDict_SetItemString(self->fp_kernels, native_fp_fields[i], name) < 0) {
+			Py_CLEAR(self->fp_kernels);
+		}
+		Py_XDECREF(name);
+	}
+	if (self->fp_kernels == NULL) {
+		pairing_clear(self->pbc_pairing);
+		return -1;
+	}
+
+	// PBC sets some things up the first time they're used, like the
+	// nonresidue behind square roots in the base field. Hashing into each
+	// group does that now, before the pairing can be shared between threads.
+	element_t warm;
+	element_init_G1(warm, self->pbc_pairing);
+	element_from_hash(warm, "pypbc", 5);
+	element_clear(warm);
+	element_init_G2(warm, self->pbc_pairing);
+	element_from_hash(warm, "pypbc", 5);
+	element_clear(warm);
+
+	// where GT has the cyclotomic shortcuts, use them by default
+	element_init_GT(warm, self->pbc_pairing);
+	self->gt_quadratic = gt_is_quadratic(warm);
+	element_clear(warm);
+	if (self->gt_quadratic) {
+		self->pow_config[GT] = POW_CONFIG(POW_CYCLOTOMIC, 0);
+	}
+
+	// with the factors of the order, set up the CRT and the subgroups
+	if (factors != Py_None && composite_setup(self, factors) < 0) {
+		composite_clear(self);
+		pairing_clear(self->pbc_pairing);
+		return -1;
+	}
+
+	// pick the fastest way to raise each group to a power, if asked
+	if (tune) {
+		Py_BEGIN_ALLOW_THREADS
+		pairing_tune_pow(self);
+		Py_END_ALLOW_THREADS
+	}
+
+	self->native_size = native_thread_bytes - before;
+
+	// keep the Parameters, which a trace describes the pairing by
+	Py_INCREF(parameters);
+	self->parameters = parameters;
+
+	// you're ready
+	self->ready = 1;
+	// all's clear	
+	return 0;
+}
+		
+// deallocates the object when done
+void Pairing_dealloc(Pairing *pairing) {
+	// kill the pairing element, and anything we built on it
+	if (pairing->ready) {
+		glv_clear(&pairing->glv_groups[0]);
+		glv_clear(&pairing->glv_groups[1]);
+		composite_clear(pairing);
+		pairing_clear(pairing->pbc_pairing);
+	}
+	Py_XDECREF(pairing->parameters);
+	Py_XDECREF(pairing->fp_kernels);
+	// free the actual object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(pairing);
+	type->tp_free((PyObject*)pairing);
+	Py_DECREF(type);
+}
+
+// checks that e1 and e2 can be paired: an element of G1 and one of G2, in
+// that order, or on a symmetric pairing any two of G1 and G2. Returns -1
+// with ValueError set if not.
+static int pairing_check_inputs(Pairing *pairing, Element *e1, Element *e2) {
+	int ok;
+	// elements of another Pairing live in other fields, maybe of other sizes
+	if (e1->pairing != (PyObject *)pairing || e2->pairing != (PyObject *)pairing) {
+		PyErr_SetString(PyExc_ValueError, "elements must belong to the pairing applied to them.");
+		return -1;
+	}
+	if (pairing_is_symmetric(pairing->pbc_pairing)) {
+		ok = (e1->group == G1 || e1->group == G2) && (e2->group == G1 || e2->group == G2);
+	} else {
+		ok = e1->group == G1 && e2->group == G2;
+	}
+	if (!ok) {
+		PyErr_SetString(PyExc_ValueError, "expected an element of G1 and one of G2.");
+		return -1;
+	}
+	return 0;
+}
+
+// applies the bilinear map action
+// pairing.apply(Element e1, Element e2) -> Element e3
+PyObject* Pairing_apply(PyObject *self, PyObject *const *args, Py_ssize_t nargs) {
+	// process our arguments
+	// we need two elements
+	if (nargs != 2) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	PyObject *element_1 = args[0];
+	PyObject *element_2 = args[1];
+	
+	// check the types on the arguments
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	if(!PyObject_TypeCheck(element_1, state->ElementType)){
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return NULL;
+	}
+	if(!PyObject_TypeCheck(element_2, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return NULL;
+	}
+
+	// extract the actual elements
+	Element *e1 = (Element*)element_1;
+	Element *e2 = (Element*)element_2;
+	
+	// extract the pairing object
+	Pairing *p = (Pairing*)self;
+	if (pairing_check_inputs(p, e1, e2) < 0) {
+		return NULL;
+	}
+	
+	// we build a third element to store the outcome
+	uint64_t start = stats_begin();
+	Element *e3 = Element_create(state);
+	if (e3 == NULL) {
+		return NULL;
+	}
+	element_init_GT(e3->pbc_element, p->pbc_pairing);
+	e3->group = GT;
+	
+	// incref the pairing we depend on, and set it
+	Py_INCREF(self);
+	e3->pairing = self;
+	
+	// mark it ready
+	e3->ready = 1;
+	
+	// and apply the pairing
+	pairing_apply(e3->pbc_element, e1->pbc_element, e2->pbc_element, p->pbc_pairing);
+	// the outcome only has components in subgroups both sides have
+	e3->subgroups = e1->subgroups && e2->subgroups ? e1->subgroups & e2->subgroups : e1->subgroups | e2->subgroups;
+	stats_end(STAT_APPLY, e3, element_1, element_2, start);
+
+	// cast and return the object
+	return (PyObject*)e3;
+}
+
+// pairing.is_symmetric() -> bool
+PyObject *Pairing_is_symmetric(Pairing *self, PyObject *unused) {
+	return PyBool_FromLong(pairing_is_symmetric(self->pbc_pairing));
+}
+
+PyDoc_STRVAR(Pairing_intern__doc__,
+"Pairing.intern(parameters) -> Pairing\n\n\
+Returns the one Pairing for these parameters in this interpreter, building\n\
+it the first time. Parameters that print the same share a Pairing (one\n\
+per Fp backend, see set_fp_backend), so workers pay for pairing setup once\n\
+rather than every time they ask for one. Called on a subclass, it builds\n\
+and hands back instances of that subclass, kept apart from Pairing's own.");
+PyObject *Pairing_intern(PyObject *cls, PyObject *parameters) {
+	// the table lives in this interpreter's module state
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)cls);
+	if (state == NULL) {
+		return NULL;
+	}
+	// check to make sure we're getting params
+	if(!PyObject_TypeCheck(parameters, state->ParametersType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Parameter, got something else.");
+		return NULL;
+	}
+	if (!((Parameters *)parameters)->ready) {
+		PyErr_SetString(PyExc_ValueError, "Parameters have not been initialised.");
+		return NULL;
+	}
+
+	// key the table on the class, and the hash of the canonical parameter
+	// string and the Fp backend it would be built with
+	PyObject *text = Parameters_str((Parameters *)parameters);
+	if (text == NULL) {
+		return NULL;
+	}
+	Py_ssize_t len;
+	const char *utf8 = PyUnicode_AsUTF8AndSize(text, &len);
+	if (utf8 == NULL) {
+		Py_DECREF(text);
+		return NULL;
+	}
+	unsigned char digest[SHA256_DIGEST_SIZE];
+	sha256_ctx ctx;
+	sha256_init(&ctx);
+	sha256_update(&ctx, (const unsigned char *)utf8, len);
+	sha256_update(&ctx, (const unsigned char *)state->fp_backend, strlen(state->fp_backend) + 1);
+	sha256_final(&ctx, digest);
+	Py_DECREF(text);
+	PyObject *hash = PyBytes_FromStringAndSize((char *)digest, SHA256_DIGEST_SIZE);
+	if (hash == NULL) {
+		return NULL;
+	}
+	PyObject *key = PyTuple_Pack(2, cls, hash);
+	Py_DECREF(hash);
+	if (key == NULL) {
+		return NULL;
+	}
+
+	// hand back the one we already have...
+	PyObject *pairing;
+#if PY_VERSION_HEX >= 0x030D0000
+	// a borrowed reference could be dropped under us without a GIL
+	if (PyDict_GetItemRef(state->pairing_intern, key, &pairing) != 0) {
+		Py_DECREF(key);
+		return pairing;
+	}
+#else
+	pairing = PyDict_GetItemWithError(state->pairing_intern, key);
+	if (pairing != NULL) {
+		Py_DECREF(key);
+		Py_INCREF(pairing);
+		return pairing;
+	}
+	if (PyErr_Occurred()) {
+		Py_DECREF(key);
+		return NULL;
+	}
+#endif
+
+	// ...or build it and remember it. Without a GIL two threads can get
+	// here at once, so only the first one in gets to keep theirs.
+	PyObject *built = PyObject_CallOneArg(cls, parameters);
+	if (built == NULL) {
+		Py_DECREF(key);
+		return NULL;
+	}
+#if PY_VERSION_HEX >= 0x030D0000
+	if (PyDict_SetDefaultRef(state->pairing_intern, key, built, &pairing) < 0) {
+		pairing = NULL;
+	}
+#else
+	pairing = PyDict_SetDefault(state->pairing_intern, key, built);
+	Py_XINCREF(pairing);
+#endif
+	Py_DECREF(built);
+	Py_DECREF(key);
+	return pairing;
+}
+
+PyDoc_STRVAR(clear_pairing_cache__doc__,
+	"Forgets every Pairing handed out by Pairing.intern.");
+PyObject *clear_pairing_cache(PyObject *self, PyObject *unused) {
+	PyDict_Clear(((pypbc_state *)PyModule_GetState(self))->pairing_intern);
+	Py_RETURN_NONE;
+}
+
+PyMemberDef Pairing_members[] = {
+	{"fp_backend", T_STRING, offsetof(Pairing, fp_backend), READONLY, "The Fp implementation the pairing was built with."},
+	{"fp_kernels", T_OBJECT, offsetof(Pairing, fp_kernels), READONLY, "The fields ('Zr', 'Fq') the 'native' Fp backend put a kernel on, and which ('mulx' or 'portable')."},
+	{"factors", T_OBJECT, offsetof(Pairing, factor_tuple), READONLY, "The factors of the group order the pairing was given, or None."},
+	{NULL}
+};
+
+PyMethodDef Pairing_methods[] = {
+	{"apply", (PyCFunction)(void(*)(void))Pairing_apply, METH_FASTCALL, "applies the pairing."},
+	{"intern", (PyCFunction)Pairing_intern, METH_O | METH_CLASS, Pairing_intern__doc__},
+	{"apply_async", Pairing_apply_async, METH_VARARGS, "applies the pairing on a worker thread; returns an awaitable."},
+	{"apply_product_async", Pairing_apply_product_async, METH_O, "computes a multi-pairing on a worker thread; returns an awaitable."},
+	{"apply_batch", Pairing_apply_batch, METH_O, "applies the pairing to a list of (a, b) pairs, or tuples of them for multi-pairings, on native threads; returns a list of results."},
+	{"set_glv", (PyCFunction)Pairing_set_glv, METH_VARARGS, "uses the GLV method for scalar multiplication where the curve allows it (type F); returns whether it is in use."},
+	{"set_pow_method", (PyCFunction)Pairing_set_pow_method, METH_VARARGS | METH_KEYWORDS, "sets the method ('pbc', 'fixed', 'sliding', 'wnaf' or 'cyclotomic') and window width used for powers in a group."},
+	{"get_pow_method", (PyCFunction)Pairing_get_pow_method, METH_VARARGS, "returns the (method, window) used for powers in a group."},
+	{"tune_pow", (PyCFunction)Pairing_tune_pow, METH_NOARGS, "times each method in G1, G2 and GT, keeps the fastest, and returns what was picked."},
+	{"is_symmetric", (PyCFunction)Pairing_is_symmetric, METH_NOARGS, "returns whether G1 and G2 are the same group."},
+	{"project", (PyCFunction)Pairing_project, METH_VARARGS, "projects an element onto the subgroup of the i-th factor of the order."},
+	{"random_subgroup", (PyCFunction)Pairing_random_subgroup, METH_VARARGS, "returns a random element of the subgroup of G1, G2 or GT of the i-th factor of the order."},
+	{"stats", (PyCFunction)Pairing_stats, METH_NOARGS, Pairing_stats__doc__},
+	{"reset_stats", (PyCFunction)Pairing_reset_stats, METH_NOARGS, "zeroes the pairing's operation counts and times."},
+	{"__sizeof__", (PyCFunction)Pairing_sizeof, METH_NOARGS, Pairing_sizeof__doc__},
+	{NULL}
+};
+
+PyType_Slot Pairing_slots[] = {
+	{Py_tp_dealloc, Pairing_dealloc},
+	{Py_tp_doc, (void *)Pairing__doc__},
+	{Py_tp_methods, Pairing_methods},
+	{Py_tp_members, Pairing_members},
+	{Py_tp_init, Pairing_init},
+	{Py_tp_new, Pairing_new},
+	{0, NULL}
+};
+
+PyType_Spec Pairing_spec = {
+	"pypbc.Pairing",
+	sizeof(Pairing),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	Pairing_slots
+};
+
+/*******************************************************************************
+*						Elements							      *
+*******************************************************************************/
+
+PyDoc_STRVAR(Element__doc__,
+"Represents an element of a bilinear group.\n\n\
+Basic usage:\n\
+\n\
+Element(pairing, G1||G2||GT||Zr, value=v) -> Element\n\
+Element.one(pairing, G1||G2||GT||Zr) -> identity element for the given group.\n\
+Element.zero(pairing, G1||G2||GT||Zr) -> identity element for the given group.\n\
+Element.random(pairing, G1||G2||GT||Zr) -> random element of the given group.\n\
+Element.random_many(pairing, G1||G2||Zr, n) -> list of n random elements of the given group.\n\
+Element.from_hash(pairing, G1||G2||GT||Zr, hash) -> element whose value is determined by the given hash value.\n\
+Element.from_hash_many(pairing, G1||G2||GT||Zr, messages) -> list of elements for the SHA-256 digests of messages.\n\
+\n\
+Most of the basic arithmetic operations apply. Please note that many of them\n\
+do not make sense between groups, and that not all of these are checked for.");
+
+Element *Element_create(pypbc_state *state) {
+	// build ourselves
+	Element *self = (Element*)state->ElementType->tp_alloc(state->ElementType, 0);
+	if(self == NULL) {
+		return NULL;
+	}
+	self->pairing = NULL;
+	self->ready = 0;
+	return self;
+}
+
+// attaches a freshly created element to the pairing and initialises it in
+// the given group, setting an exception and returning -1 on failure
+int Element_init_group(Element *self, PyObject *pypairing, enum Group group) {
+	// cast the arguments
+	Pairing *prepairing = (Pairing*)pypairing;
+
+	// use the arguments to init the element
+	switch(group) {
+		case G1: element_init_G1(self->pbc_element, prepairing->pbc_pairing); break;
+		case G2: element_init_G2(self->pbc_element, prepairing->pbc_pairing); break;
+		case GT: element_init_GT(self->pbc_element, prepairing->pbc_pairing); break;
+		case Zr: element_init_Zr(self->pbc_element, prepairing->pbc_pairing); break;
+		default: PyErr_SetString(PyExc_ValueError, "Invalid group."); return -1;
+	}
+
+	// store the pairing and incref it, since we depend on its existence
+	Py_INCREF(pypairing);
+	self->pairing = pypairing;
+	self->group = group;
+	self->ready = 1;
+	return 0;
+}
+// allocate the object
+PyObject *Element_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+	// build ourselves
+	Element *self = (Element*)type->tp_alloc(type, 0);
+	if(self == NULL) {
+		return NULL;
+	}
+	self->pairing = NULL;
+	self->ready = 0;
+	// cast it and send it on
+	return (PyObject*)self;
+}
+
+// reads a group constant the way the "i" format would
+static int parse_group(PyObject *arg, enum Group *group) {
+	long value = PyLong_AsLong(arg);
+	if (value == -1 && PyErr_Occurred()) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return -1;
+	}
+	*group = (enum Group)value;
+	return 0;
+}
+
+// checks the (pairing, group, ...) arguments of the METH_FASTCALL class
+// methods, returning the module state or NULL with an exception set
+static pypbc_state *Element_fast_args(PyObject *cls, PyObject *const *args, Py_ssize_t nargs, Py_ssize_t expected, enum Group *group) {
+	if (nargs != expected) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	if (parse_group(args[1], group) < 0) {
+		return NULL;
+	}
+
+	// check the type of arguments
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)cls);
+	if (state == NULL) {
+		return NULL;
+	}
+	if(!PyObject_TypeCheck(args[0], state->PairingType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return NULL;
+	}
+	return state;
+}
+
+// fills in a freshly allocated element from the constructor's arguments;
+// shared by tp_init and the vectorcall constructor
+static int Element_setup(pypbc_state *state, PyObject *py_self, PyObject *pypairing, enum Group group, PyObject *value) {
+	int ii;
+
+	// check the type of arguments
+	if(!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return -1;
+	}
+	
+	// build the element pointer
+	Element *self = (Element*)py_self;
+
+	// store the pairing and incref it, since we depend on its existence
+	Py_INCREF(pypairing);
+	self->pairing = pypairing;
+	
+	// cast the arguments
+	Pairing *prepairing = (Pairing*)pypairing;
+
+	// use the arguments to init the element
+	switch(group) {
+		case G1: element_init_G1(self->pbc_element, prepairing->pbc_pairing); break;
+		case G2: element_init_G2(self->pbc_element, prepairing->pbc_pairing); break;
+		case GT: element_init_GT(self->pbc_element, prepairing->pbc_pairing); break;
+		case Zr: element_init_Zr(self->pbc_element, prepairing->pbc_pairing); break;
+		default: PyErr_SetString(PyExc_ValueError, "Invalid group."); return -1;
+	}
+	
+	// set the group argument, and mark the element as needing clearing,
+	// whether or not setting its value works out
+	self->group = group;
+	self->ready = 1;
+
+	// handle the value argument
+	if (value != NULL) {
+		// if it's a long...
+		if (PyLong_Check(value)) {
+			// convert it to an mpz
+			mpz_t new_n;
+			int ret = pynum_to_mpz(value, new_n);
+			if (ret == 0) {
+				element_set_mpz(self->pbc_element, new_n);
+			}
+			mpz_clear(new_n);
+			if (ret < 0) {
+				return -1;
+			}
+		// if it's another element
+		} else if (PyObject_TypeCheck(value, state->ElementType)) {
+			// set the value
+			Element *e = (Element*)value;
+			element_set(self->pbc_element, e->pbc_element);
+		} else {
 			int bytesize;
 			char *cstr;
 			char str[4096];
 			unsigned char nextch;
 			Py_ssize_t s_str;
 			cstr = PyUnicode_AsUTF8AndSize(value, &s_str);
-			strncpy(str,cstr,s_str);
-			if (str != NULL) {
+			if (cstr == NULL) {
+				PyErr_Clear();
+			} else if (s_str >= (Py_ssize_t)sizeof(str)) {
+				PyErr_SetString(PyExc_ValueError, "value is too long.");
+				return -1;
+			} else {
+				memcpy(str, cstr, s_str + 1);
+			}
+			if (cstr != NULL) {
 				unsigned char byteval[4096];
 				// printf("parsing string for value \"%s\"\n", string);
 				// value is a string, see if encoded EC Point or Fp2 tuple
@@ -582,817 +2881,4921 @@ int Element_init(PyObject *py_self, PyObject *args, PyObject *kwargs) {
 					for (ii = 3; ii < (bytesize+3); ii++) {
 						str[ii-1] = str[ii];
 					}
-					// copy y coord fives place to left 
-					for (ii = 2+bytesize; ii < 2+(2*bytesize); ii++){
-						str[ii] = str[ii+5];
+					// copy y coord fives place to left 
+					for (ii = 2+bytesize; ii < 2+(2*bytesize); ii++){
+						str[ii] = str[ii+5];
+					}
+					str[2+(2*bytesize)] = 0x00;
+					//printf("smushed tuple %s\n", &str[2]);
+					//printf("length = %d, bytesize=%d\n", strlen(&str[2]), bytesize);
+					// unhandled type, fail hard
+					//PyErr_SetString(PyExc_TypeError, "invalid type for argument 'value'");
+					//return -1;
+					for (ii = 0 ; ii < bytesize ; ii++ ) {
+						sscanf(&str[2+(2*ii)], "%2hhx", &byteval[ii]);
+					}
+					//printf("compressed\n");
+					ii = element_from_bytes(self->pbc_element, byteval);
+					// you're ready!
+					self->ready = 1;
+					// we're clear
+					return 0;
+				printf("parsed\n");
+				} else if (strncmp(str, "00", 2) == 0) {
+					// assume EC Point at infinity
+					element_set0(self->pbc_element);
+					self->ready = 1;
+					return 0;
+				} else if (strncmp(str, "02", 2) == 0) {
+					// even EC Point?
+					// printf("even, compressed EC Point\n");
+					bytesize = (s_str >> 1) - 1;
+					byteval[bytesize] = 0x00;
+				} else if (strncmp(str, "03", 2) == 0) {
+					// odd EC Point?
+					// printf("odd, compressed EC Point\n");
+					bytesize = (s_str >> 1) - 1;
+					byteval[bytesize] = 0x01;
+				} else if (strncmp(str, "04", 2) == 0) {
+					// uncompressed EC Point?
+					// printf("uncompressed EC Point"\n);
+					bytesize = ((s_str >> 1) - 1) >> 1;
+					sscanf(&str[s_str - 1], "%2hhx", &byteval[bytesize]);
+					byteval[bytesize] &= 0x01;
+				}
+				for (ii = 0 ; ii < bytesize ; ii++ ) {
+					sscanf(&str[2+(2*ii)], "%2hhx", &byteval[ii]);
+				}
+				ii = element_from_bytes_compressed(self->pbc_element, byteval);
+				// printf("element_from_bytes_compressed returned %d\n", ii);
+			} else {
+				// unrecognized type, fail hard
+				PyErr_SetString(PyExc_TypeError, "invalid type for argument 'value'");
+				return -1;
+			}
+		}
+	} else {
+		element_set0(self->pbc_element);
+	}
+	
+	// you're ready!
+	self->ready = 1;
+	// we're clear
+	return 0;
+}
+
+// Element(pairing, group, value=Element/long) -> Element
+int Element_init(PyObject *py_self, PyObject *args, PyObject *kwargs) {
+	// required arguments are the pairing and the group
+	PyObject *pypairing;
+	enum Group group;
+	// optional value argument
+	PyObject *value = NULL;
+	char *keys[] = {"pairing", "group", "value", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|O", keys, &pypairing, &group, &value)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		// XXX notice this flags errors on -1, not NULL!
+		return -1;
+	}
+	
+	pypbc_state *state = pypbc_state_of(py_self);
+	if (state == NULL) {
+		return -1;
+	}
+	uint64_t start = value != NULL ? stats_begin() : 0;
+	if (Element_setup(state, py_self, pypairing, group, value) < 0) {
+		return -1;
+	}
+	stats_end(STAT_PARSE, (Element*)py_self, value, NULL, start);
+	return 0;
+}
+
+// calling the Element type itself. Positional calls skip building an args
+// tuple and the trip through tp_new and tp_init; anything with keywords
+// goes the long way round.
+PyObject *Element_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames) {
+	Py_ssize_t nargs = PyVectorcall_NARGS(nargsf);
+	Py_ssize_t i;
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)type);
+	if (state == NULL) {
+		return NULL;
+	}
+
+	if (kwnames == NULL && (nargs == 2 || nargs == 3) && type == (PyObject *)state->ElementType) {
+		enum Group group;
+		if (parse_group(args[1], &group) < 0) {
+			return NULL;
+		}
+		Element *self = Element_create(state);
+		if (self == NULL) {
+			return NULL;
+		}
+		uint64_t start = nargs == 3 ? stats_begin() : 0;
+		if (Element_setup(state, (PyObject *)self, args[0], group, nargs == 3 ? args[2] : NULL) < 0) {
+			Py_DECREF(self);
+			return NULL;
+		}
+		stats_end(STAT_PARSE, self, nargs == 3 ? args[2] : NULL, NULL, start);
+		return (PyObject *)self;
+	}
+
+	// rebuild what tp_new and tp_init expect
+	PyObject *tuple = PyTuple_New(nargs);
+	PyObject *kwargs = NULL;
+	PyObject *self = NULL;
+	if (tuple == NULL) {
+		return NULL;
+	}
+	for (i = 0; i < nargs; i++) {
+		Py_INCREF(args[i]);
+		PyTuple_SET_ITEM(tuple, i, args[i]);
+	}
+	if (kwnames != NULL) {
+		kwargs = PyDict_New();
+		if (kwargs == NULL) {
+			goto done;
+		}
+		for (i = 0; i < PyTuple_GET_SIZE(kwnames); i++) {
+			if (PyDict_SetItem(kwargs, PyTuple_GET_ITEM(kwnames, i), args[nargs + i]) < 0) {
+				goto done;
+			}
+		}
+	}
+	self = Element_new((PyTypeObject *)type, tuple, kwargs);
+	if (self != NULL && Element_init(self, tuple, kwargs) < 0) {
+		Py_CLEAR(self);
+	}
+done:
+	Py_DECREF(tuple);
+	Py_XDECREF(kwargs);
+	return self;
+}
+
+// Element.from_hash(pairing, group, hash) -> Element
+PyObject *Element_from_hash(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+	// required arguments are the pairing, the group, and the hashed value
+	enum Group group;
+	pypbc_state *state = Element_fast_args(cls, args, nargs, 3, &group);
+	if (state == NULL) {
+		return NULL;
+	}
+
+	// get at the raw bytes of the hash value
+	Py_buffer hash;
+	if (hash_input_get_buffer(args[2], &hash) < 0) {
+		return NULL;
+	}
+	// PBC takes the length as an int; cutting it short would hash something
+	// else
+	if (hash.len > INT_MAX) {
+		PyBuffer_Release(&hash);
+		PyErr_SetString(PyExc_OverflowError, "hash value is too long.");
+		return NULL;
+	}
+
+	// build ourselves
+	Element *self = Element_create(state);
+	if (self == NULL || Element_init_group(self, args[0], group) < 0) {
+		PyBuffer_Release(&hash);
+		Py_XDECREF(self);
+		return NULL;
+	}
+
+	// make the element from the hash
+	uint64_t start = stats_begin();
+	element_from_hash(self->pbc_element, hash.buf, (int)hash.len);
+	stats_end(STAT_FROM_HASH, self, args[2], NULL, start);
+	PyBuffer_Release(&hash);
+
+	// we're clear
+	return (PyObject*)self;
+}
+
+PyDoc_STRVAR(Element_from_hash_many__doc__,
+"Element.from_hash_many(pairing, group, messages) -> list of Elements\n\n\
+Digests each message (str or bytes-like) with SHA-256 and maps the digest\n\
+into the given group, so that the result for m is the same as\n\
+Element.from_hash(pairing, group, sha256(m).digest()). The digesting and\n\
+mapping run in a single loop without the GIL.");
+PyObject *Element_from_hash_many(PyObject *cls, PyObject *args) {
+	// required arguments are the pairing, the group, and the messages
+	PyObject *pypairing;
+	enum Group group;
+	PyObject *messages;
+	if (!PyArg_ParseTuple(args, "OiO", &pypairing, &group, &messages)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+
+	// check the type of arguments
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)cls);
+	if (state == NULL) {
+		return NULL;
+	}
+	if(!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return NULL;
+	}
+
+	PyObject *seq = PySequence_Fast(messages, "messages must be iterable.");
+	if (seq == NULL) {
+		return NULL;
+	}
+	Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+	Py_ssize_t i, acquired = 0;
+
+	// hold on to every message buffer for the duration of the loop
+	Py_buffer *views = PyMem_Calloc(n ? n : 1, sizeof(Py_buffer));
+	Element **elements = PyMem_Calloc(n ? n : 1, sizeof(Element *));
+	PyObject *result = PyList_New(n);
+	if (views == NULL || elements == NULL || result == NULL) {
+		PyErr_NoMemory();
+		goto error;
+	}
+
+	// build all of the output elements while we still hold the GIL
+	for (i = 0; i < n; i++) {
+		if (hash_input_get_buffer(PySequence_Fast_GET_ITEM(seq, i), &views[i]) < 0) {
+			goto error;
+		}
+		acquired++;
+		Element *e = Element_create(state);
+		if (e == NULL) {
+			goto error;
+		}
+		// the list owns it from here on, even if initialising it fails
+		PyList_SET_ITEM(result, i, (PyObject *)e);
+		if (Element_init_group(e, pypairing, group) < 0) {
+			goto error;
+		}
+		elements[i] = e;
+	}
+
+	if (n > 0) {
+		unsigned char digest[SHA256_DIGEST_SIZE];
+		sha256_ctx ctx;
+		// the first one runs with the GIL held, so that whatever PBC sets up
+		// lazily the first time it maps into a group is in place before we
+		// let other threads in
+		sha256_init(&ctx);
+		sha256_update(&ctx, views[0].buf, views[0].len);
+		sha256_final(&ctx, digest);
+		element_from_hash(elements[0]->pbc_element, digest, SHA256_DIGEST_SIZE);
+
+		Py_BEGIN_ALLOW_THREADS
+		for (i = 1; i < n; i++) {
+			sha256_init(&ctx);
+			sha256_update(&ctx, views[i].buf, views[i].len);
+			sha256_final(&ctx, digest);
+			element_from_hash(elements[i]->pbc_element, digest, SHA256_DIGEST_SIZE);
+		}
+		Py_END_ALLOW_THREADS
+	}
+
+	// clean up
+	for (i = 0; i < acquired; i++) {
+		PyBuffer_Release(&views[i]);
+	}
+	PyMem_Free(views);
+	PyMem_Free(elements);
+	Py_DECREF(seq);
+	return result;
+
+error:
+	for (i = 0; i < acquired; i++) {
+		PyBuffer_Release(&views[i]);
+	}
+	PyMem_Free(views);
+	PyMem_Free(elements);
+	Py_XDECREF(result);
+	Py_DECREF(seq);
+	return NULL;
+}
+
+// Element.random(pairing, group) -> Element
+PyObject *Element_random(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+	assert(cls != NULL);
+	// required arguments are the pairing and the group
+	enum Group group;
+	pypbc_state *state = Element_fast_args(cls, args, nargs, 2, &group);
+	if (state == NULL) {
+		return NULL;
+	}
+	// there's no drawing from GT directly
+	if (group == GT) {
+		PyErr_SetString(PyExc_ValueError, "Invalid group.");
+		return NULL;
+	}
+
+	// build ourselves
+	Element *self = Element_create(state);
+	if (self == NULL || Element_init_group(self, args[0], group) < 0) {
+		Py_XDECREF(self);
+		return NULL;
+	}
+	
+	// make the element random
+	element_random(self->pbc_element);
+	
+	// we're clear
+	return (PyObject*)self;
+}
+
+PyDoc_STRVAR(Element_random_many__doc__,
+"Element.random_many(pairing, group, n) -> list of n random Elements\n\n\
+Draws n random elements of G1, G2 or Zr in a single loop without the GIL.");
+PyObject *Element_random_many(PyObject *cls, PyObject *args) {
+	// required arguments are the pairing, the group and the count
+	PyObject *pypairing;
+	enum Group group;
+	Py_ssize_t n;
+	if (!PyArg_ParseTuple(args, "Oin", &pypairing, &group, &n)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+
+	// check the type of arguments
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)cls);
+	if (state == NULL) {
+		return NULL;
+	}
+	if(!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return NULL;
+	}
+	if (group == GT) {
+		PyErr_SetString(PyExc_ValueError, "Invalid group.");
+		return NULL;
+	}
+	if (n < 0) {
+		PyErr_SetString(PyExc_ValueError, "n must not be negative.");
+		return NULL;
+	}
+
+	Py_ssize_t i;
+	Element **elements = PyMem_Calloc(n ? n : 1, sizeof(Element *));
+	PyObject *result = PyList_New(n);
+	if (elements == NULL || result == NULL) {
+		PyMem_Free(elements);
+		Py_XDECREF(result);
+		return PyErr_NoMemory();
+	}
+
+	// build all of the output elements while we still hold the GIL
+	for (i = 0; i < n; i++) {
+		Element *e = Element_create(state);
+		if (e == NULL) {
+			goto error;
+		}
+		PyList_SET_ITEM(result, i, (PyObject *)e);
+		if (Element_init_group(e, pypairing, group) < 0) {
+			goto error;
+		}
+		elements[i] = e;
+	}
+
+	if (n > 0) {
+		// as in from_hash_many, the first draw sets up anything PBC
+		// initialises lazily before other threads are let in
+		element_random(elements[0]->pbc_element);
+		Py_BEGIN_ALLOW_THREADS
+		for (i = 1; i < n; i++) {
+			element_random(elements[i]->pbc_element);
+		}
+		Py_END_ALLOW_THREADS
+	}
+
+	PyMem_Free(elements);
+	return result;
+
+error:
+	PyMem_Free(elements);
+	Py_DECREF(result);
+	return NULL;
+}
+
+// Element.zero(pairing, group) -> Element
+PyObject *Element_zero(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+	// required arguments are the pairing and the group
+	enum Group group;
+	pypbc_state *state = Element_fast_args(cls, args, nargs, 2, &group);
+	if (state == NULL) {
+		return NULL;
+	}
+	
+	// build ourselves
+	Element *self = Element_create(state);
+	if (self == NULL || Element_init_group(self, args[0], group) < 0) {
+		Py_XDECREF(self);
+		return NULL;
+	}
+		
+	// set the element to 0
+	element_set0(self->pbc_element);
+	
+	// we're clear
+	return (PyObject*)self;
+}
+
+// Element.one(pairing, group) -> Element
+PyObject *Element_one(PyObject *cls, PyObject *const *args, Py_ssize_t nargs) {
+	// required arguments are the pairing and the group
+	enum Group group;
+	pypbc_state *state = Element_fast_args(cls, args, nargs, 2, &group);
+	if (state == NULL) {
+		return NULL;
+	}
+	
+	// build ourselves
+	Element *self = Element_create(state);
+	if (self == NULL || Element_init_group(self, args[0], group) < 0) {
+		Py_XDECREF(self);
+		return NULL;
+	}
+		
+	// set the element to 1
+	element_set1(self->pbc_element);
+	
+	// we're clear
+	return (PyObject*)self;
+}
+
+// deallocates the object when done
+void Element_dealloc(Element *element) {
+	// let the trace know, if it has seen it
+	if (element->trace_id != 0 && (__atomic_load_n(&instrument_flags, __ATOMIC_RELAXED) & INSTRUMENT_TRACE)) {
+		trace_free(element);
+	}
+	// clear the internal element
+	if (element->ready){
+		element_clear(element->pbc_element);
+	}
+	// decref the pairing
+	Py_XDECREF(element->pairing);
+	// free the object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(element);
+	type->tp_free((PyObject*)element);
+	Py_DECREF(type);
+}
+
+// converts the element to a string, writing points of G1 and G2 in the
+// compressed (sign + X) format if compressed is set
+static PyObject *Element_format(Element *py_ele, int compressed) {
+	PyObject *result = NULL;
+	int ii, jj, pad, size = 0;
+	// int ii = 0;
+	// build the string buffer- AIEEE! MAGIC CONSTANT!
+	unsigned char string[4096];
+	unsigned char hex_value[4096];
+	// query the element dimension
+	int dim = element_item_count(py_ele->pbc_element);
+	switch(py_ele->group) {
+		case G1:
+		case G2:
+			// printf("G1/G2 point dimension %d\n", element_item_count(py_ele->pbc_element));
+			if (element_is0(py_ele->pbc_element) == 1) {
+				size = (2 * element_length_in_bytes_compressed(py_ele->pbc_element)) - 1;
+				for (ii = 0; ii < size; ii++) {
+					string[ii] = 0x00 ;
+				}
+			} else {
+				if (compressed) {
+					size = element_to_bytes_compressed(&string[1], py_ele->pbc_element);
+					string[0] = 0x02 | string[size];
+					string[size] = 0;
+				} else {
+					if (dim != 2) {
+						PyErr_SetString(PyExc_ValueError, "Invalid Elliptic Curve Point Dimension.");
+						return NULL;
+					}
+					element_ptr ex, ey;
+					string[0] = 0x04;
+					size = 1;
+					ex = element_item(py_ele->pbc_element, 0);
+					ey = element_item(py_ele->pbc_element, 1);
+					size += element_to_bytes(&string[size], ex);
+					size += element_to_bytes(&string[size], ey);
+					string[size] = 0;
+				}
+			}
+			for (ii = 0 ; ii < size; ii++) {
+				sprintf((char *)&hex_value[2*ii], "%02X", string[ii]);
+			}
+			return PyUnicode_FromStringAndSize(hex_value, size * 2);
+		case GT:
+			// printf("GT vector dimension %d\n", dim);
+			size = 0;
+			sprintf((char *)&hex_value[0], "(0x");
+			pad = 3;
+			for (ii = 0; ii < dim; ii++) {
+				size = element_to_bytes(string, element_item(py_ele->pbc_element, ii));
+				if (ii != 0 ) {
+					sprintf((char *)&hex_value[pad], ", 0x") ;
+					pad += 4;
+				}
+				for (jj = 0 ; jj < size; jj++) {
+					sprintf((char *)&hex_value[(2*jj)+pad], "%02X", string[jj]);
+				}
+				pad += 2*size;
+			}
+			sprintf((char *)&hex_value[pad],")");
+			return PyUnicode_FromStringAndSize(hex_value, pad + 1);
+		case Zr:
+			// printf("Zr vector dimension %d\n", dim);
+			size = element_to_bytes(string, py_ele->pbc_element);
+			sprintf((char *)&hex_value[0], "0x");
+			for (ii = 0 ; ii < size; ii++) {
+				sprintf((char *)&hex_value[2*(ii+1)], "%02X", string[ii]);
+			}
+			return PyUnicode_FromStringAndSize(hex_value, (size+1) * 2);
+		default:
+			break;
+	}
+	PyErr_SetString(PyExc_ValueError, "Invalid group.");
+	return NULL;
+}
+
+// str(element), in this interpreter's default point format
+PyObject *Element_str(PyObject *element) {
+	pypbc_state *state = pypbc_state_of(element);
+	if (state == NULL) {
+		return NULL;
+	}
+	uint64_t start = stats_begin();
+	PyObject *result = Element_format((Element*)element, state->point_compressed);
+	if (result != NULL) {
+		stats_end(STAT_STR, (Element*)element, NULL, NULL, start);
+	}
+	return result;
+}
+
+PyDoc_STRVAR(Element_to_str__doc__,
+"element.to_str(compressed=None) -> str\n\n\
+The same as str(element), except that points of G1 and G2 are written in\n\
+the compressed (sign + X) format if compressed is true and uncompressed\n\
+(X,Y) if it is false, whatever set_point_format_* last chose.");
+PyObject *Element_to_str(PyObject *self, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"compressed", NULL};
+	PyObject *compressed = Py_None;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keys, &compressed)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	if (compressed == Py_None) {
+		return Element_str(self);
+	}
+	int flag = PyObject_IsTrue(compressed);
+	if (flag < 0) {
+		return NULL;
+	}
+	uint64_t start = stats_begin();
+	PyObject *result = Element_format((Element*)self, flag);
+	if (result != NULL) {
+		stats_end(STAT_STR, (Element*)self, NULL, NULL, start);
+	}
+	return result;
+}
+
+// the subgroups a combination of a and b may have components in
+static unsigned int subgroups_join(Element *a, Element *b) {
+	return a->subgroups && b->subgroups ? a->subgroups | b->subgroups : 0;
+}
+
+// adds two elements together
+PyObject *Element_add(PyObject* a, PyObject *b) {
+	// make sure we've got two elements
+	pypbc_state *state = pypbc_state_of_either(a, b);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType) || !PyObject_TypeCheck(b, state->ElementType)) {
+		Py_RETURN_NOTIMPLEMENTED;
+	}
+	// convert both objects to Elements
+	Element *e1 = (Element*)a;
+	Element *e2 = (Element*)b;
+	// make sure they're in the same ring
+	if (e1->group != e2->group) {
+		PyErr_SetString(PyExc_ValueError, "elements must be members of the same group.");
+		return NULL;
+	}
+	// build the result element
+	Element *e3 = Element_create(state);
+	// note that the result is in the same ring *and pairing*
+	element_init_same_as(e3->pbc_element, e1->pbc_element);
+	e3->group = e1->group;
+	Py_INCREF(e1->pairing);
+	e3->pairing = e1->pairing;
+	
+	// add the elements and store the result in e3
+	element_add(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+	e3->subgroups = subgroups_join(e1, e2);
+	// cast and return
+	e3->ready = 1;
+	return (PyObject*)e3;
+}
+
+// subtracts two elements
+PyObject *Element_sub(PyObject* a, PyObject *b) {
+	// make sure we've got two elements
+	pypbc_state *state = pypbc_state_of_either(a, b);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType) || !PyObject_TypeCheck(b, state->ElementType)) {
+		Py_RETURN_NOTIMPLEMENTED;
+	}
+	// convert both objects to Elements
+	Element *e1 = (Element*)a;
+	Element *e2 = (Element*)b;
+	// make sure they're in the same ring
+	if (e1->group != e2->group) {
+		PyErr_SetString(PyExc_ValueError, "elements must be members of the same group.");
+		return NULL;
+	}
+	// build the result element
+	Element *e3 = Element_create(state);
+	// note that the result is in the same ring *and pairing*
+	element_init_same_as(e3->pbc_element, e1->pbc_element);
+	e3->group = e1->group;
+	Py_INCREF(e1->pairing);
+	e3->pairing = e1->pairing;
+	// add the elements and store the result in e3
+	element_sub(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+	e3->subgroups = subgroups_join(e1, e2);
+	// cast and return
+	e3->ready = 1;
+	return (PyObject*)e3;
+}
+
+// multiplies two elements
+// note that elements from any ring can be multiplied by those in Zr.
+PyObject *Element_mult(PyObject* a, PyObject *b) {
+	// the element has to come first
+	pypbc_state *state = pypbc_state_of_either(a, b);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		Py_RETURN_NOTIMPLEMENTED;
+	}
+
+	// convert a to an element
+	Element *e1 = (Element*)a;
+
+	// b has to be an integer, or an element of the same group or Zr
+	if (PyObject_TypeCheck(b, state->ElementType)) {
+		Element *e2 = (Element*)b;
+		if (e1->group != e2->group && e2->group != Zr) {
+			PyErr_SetString(PyExc_ValueError, "elements must be in the same group or Zr.");
+			return NULL;
+		}
+	} else if (!PyLong_Check(b)) {
+		Py_RETURN_NOTIMPLEMENTED;
+	}
+	
+	// build the result element
+	uint64_t start = stats_begin();
+	Element *e3 = Element_create(state);
+	if (e3 == NULL) {
+		return NULL;
+	}
+	
+	// note that the result is in the same ring *and pairing*
+	element_init_same_as(e3->pbc_element, e1->pbc_element);
+	e3->group = e1->group;
+	Py_INCREF(e1->pairing);
+	e3->pairing = e1->pairing;
+	e3->ready = 1;
+
+	// in G1 and G2 this is a power, which stays in whatever subgroups its
+	// base is in, and which the pairing may have been set up to work out
+	// its own way (GLV, a chosen method, or the CRT)
+	e3->subgroups = e1->group != Zr ? e1->subgroups : 0;
+	int custom = (e1->group == G1 || e1->group == G2) && element_pow_is_custom(e1);
+
+	// check to see if b is an integer
+	if(PyLong_Check(b)) {
+		// cast it to an MPZ
+		mpz_t i;
+		int ret = pynum_to_mpz(b, i);
+		if (ret == 0 && !custom) {
+			element_mul_mpz(e3->pbc_element, e1->pbc_element, i);
+		} else if (ret == 0) {
+			ret = element_pow_custom(e3->pbc_element, e1, i);
+		}
+		mpz_clear(i);
+		if (ret < 0) {
+			Py_DECREF(e3);
+			return NULL;
+		}
+	} else {
+		Element *e2 = (Element*)b;
+		// add the elements and store the result in e3
+		if (e2->group != Zr) {
+			element_mul(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+			e3->subgroups = subgroups_join(e1, e2);
+		} else if (!custom) {
+			element_mul_zn(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+		} else {
+			mpz_t k;
+			mpz_init(k);
+			element_to_mpz(k, e2->pbc_element);
+			int ret = element_pow_custom(e3->pbc_element, e1, k);
+			mpz_clear(k);
+			if (ret < 0) {
+				Py_DECREF(e3);
+				return NULL;
+			}
+		}
+	}
+	stats_end(STAT_MULT, e3, a, b, start);
+	// cast and return
+	return (PyObject*)e3;
+}
+
+// divide element a by element b
+PyObject *Element_div(PyObject* a, PyObject *b) {
+	// make sure we've got two elements
+	pypbc_state *state = pypbc_state_of_either(a, b);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType) || !PyObject_TypeCheck(b, state->ElementType)) {
+		Py_RETURN_NOTIMPLEMENTED;
+	}
+	// convert both objects to Elements
+	Element *e1 = (Element*)a;
+	Element *e2 = (Element*)b;
+	// make sure they're in the same ring
+	if (e1->group != e2->group) {
+		PyErr_SetString(PyExc_ValueError, "elements must be in the same group.");
+		return NULL;
+	}
+	// build the result element
+	Element *e3 = Element_create(state);
+	// note that the result is in the same ring *and pairing*
+	element_init_same_as(e3->pbc_element, e1->pbc_element);
+	e3->group = e1->group;
+	Py_INCREF(e1->pairing);
+	e3->pairing = e1->pairing;
+	// add the elements and store the result in e3
+	element_div(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+	e3->subgroups = subgroups_join(e1, e2);
+	// cast and return
+	e3->ready = 1;
+	return (PyObject*)e3;
+}
+
+// raises element a to the power of b
+// b can be either an element or an integer
+PyObject *Element_pow(PyObject* a, PyObject *b, PyObject *c) {
+
+	// check the types
+	pypbc_state *state = pypbc_state_of_either(a, b);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "Argument 1 must be an element.");
+		return NULL;
+	}
+	
+	// convert a to a pbc type
+	Element *e1 = (Element*)a;
+
+	// b has to be an integer or an element of Zr
+	if (PyObject_TypeCheck(b, state->ElementType)) {
+		if (((Element*)b)->group != Zr) {
+			PyErr_SetString(PyExc_ValueError, "element must be in Zr.");
+			return NULL;
+		}
+	} else if (!PyLong_Check(b)) {
+		PyErr_SetString(PyExc_TypeError, "Argument 2 must be an integer or element.");
+		return NULL;
+	}
+	
+	// build the result element
+	uint64_t start = stats_begin();
+	Element *e3 = Element_create(state);
+	if (e3 == NULL) {
+		return NULL;
+	}
+	e3->group = e1->group;
+	Py_INCREF(e1->pairing);
+	e3->pairing = e1->pairing;
+	element_init_same_as(e3->pbc_element, e1->pbc_element);
+	e3->ready = 1;
+
+	// a power stays in whatever subgroups its base is in. The pairing may
+	// have been set up to work it out its own way (GLV, a chosen method, or
+	// the CRT) instead of leaving it to PBC.
+	e3->subgroups = e1->subgroups;
+	int custom = element_pow_is_custom(e1);
+	int ret = 0;
+
+	// convert b to pbc type
+	if (PyLong_Check(b)) {	
+		// convert it to an mpz
+		mpz_t new_n;
+		ret = pynum_to_mpz(b, new_n);
+		// perform the pow op
+		if (ret == 0 && !custom) {
+			element_pow_mpz(e3->pbc_element, e1->pbc_element, new_n);
+		} else if (ret == 0) {
+			ret = element_pow_custom(e3->pbc_element, e1, new_n);
+		}
+		mpz_clear(new_n);
+	} else {
+		// convert it to an element
+		Element *e2 = (Element*)b;
+		if (!custom) {
+			element_pow_zn(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+		} else {
+			mpz_t k;
+			mpz_init(k);
+			element_to_mpz(k, e2->pbc_element);
+			ret = element_pow_custom(e3->pbc_element, e1, k);
+			mpz_clear(k);
+		}
+	}
+	if (ret < 0) {
+		Py_DECREF(e3);
+		return NULL;
+	}
+	stats_end(STAT_POW, e3, a, b, start);
+	
+	// cast and return
+	return (PyObject*)e3;
+}
+
+// returns -a
+PyObject *Element_neg(PyObject *a) {
+	// check the type of a
+	pypbc_state *state = pypbc_state_of(a);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
+		return NULL;
+	}
+	
+	// cast it
+	Element *e1 = (Element*)a;
+	
+	// make sure we aren't in a bad group
+	if (e1->group == GT) {
+		PyErr_SetString(PyExc_ValueError, "Can't invert an element in GT.");
+		return NULL;
+	}		
+	
+	// build the result element
+	Element *e2 = Element_create(state);
+	element_init_same_as(e2->pbc_element, e1->pbc_element);
+	e2->group = e1->group;
+	Py_INCREF(e1->pairing);
+	e2->pairing = e1->pairing;
+	
+	// perform the neg op
+	element_neg(e2->pbc_element, e1->pbc_element);
+	e2->subgroups = e1->subgroups;
+	
+	// you're ready	
+	e2->ready = 1;
+	// cast and return
+	return (PyObject*)e2;
+}
+
+// returns a**-1
+PyObject *Element_invert(PyObject *a) {
+	// check the type of a
+	pypbc_state *state = pypbc_state_of(a);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
+		return NULL;
+	}
+	
+	// cast it
+	Element *e1 = (Element*)a;
+	
+	// make sure we aren't in a bad group
+	if (e1->group == GT) {
+		PyErr_SetString(PyExc_ValueError, "Can't invert an element in GT.");
+		return NULL;
+	}	
+	
+	// build the result element
+	Element *e2 = Element_create(state);
+	element_init_same_as(e2->pbc_element, e1->pbc_element);
+	e2->group = e1->group;
+	Py_INCREF(e1->pairing);
+	e2->pairing = e1->pairing;
+	
+	// perform the neg op
+	element_invert(e2->pbc_element, e1->pbc_element);
+	e2->subgroups = e1->subgroups;
+	
+	// you're ready	
+	e2->ready = 1;
+	// cast and return
+	return (PyObject*)e2;
+}
+
+// returns python Integer representation for Element (only for Zr)
+PyObject *Element_int(PyObject *a) {
+	// build the string buffer- AIEEE! MAGIC CONSTANT!
+	unsigned char string[4096];
+	unsigned char hex_value[4096];
+	int size,ii;
+	
+	// check the type of a
+	pypbc_state *state = pypbc_state_of(a);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
+		return NULL;
+	}
+	
+	Element *py_ele = (Element*)a;
+	if (py_ele->group != Zr) {
+		PyErr_SetString(PyExc_ValueError, "Cannot convert multidimensional point to int.");
+		return NULL;
+	}
+	
+	// printf("Zr vector dimension %d\n", dim);
+	size = element_to_bytes(string, py_ele->pbc_element);
+	sprintf((char *)&hex_value[0], "0x");
+	for (ii = 0 ; ii < size; ii++) {
+		sprintf((char *)&hex_value[2*ii], "%02X", string[ii]);
+	}
+	// terminate string with NULL
+	hex_value[2*size] = NULL;
+	// translate hex (base 16) to python long 
+	return PyLong_FromString(hex_value, NULL, 16);
+}
+
+PyObject *Element_cmp(PyObject *a, PyObject *b, int op) {
+
+	// typecheck a
+	pypbc_state *state = pypbc_state_of(a);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "Cannot compare elements with non-elements.");
+		return NULL;
+	}
+	
+	// it's safe, cast it to an element
+	Element *e1 = (Element*)a;
+	
+	// opcheck- only == and != are defined
+	if(op != Py_EQ && op != Py_NE) {
+		PyErr_SetString(PyExc_TypeError, "Invalid comparison between objects.");
+		return NULL;
+	}
+	
+	// type-and-value check b
+	if (!PyObject_TypeCheck(b, state->ElementType)) {
+		if (PyLong_Check(b)) {
+			size_t i = PyNumber_AsSsize_t(b, NULL);
+			if (i == 1) {
+				if(element_is1(e1->pbc_element)) {
+					if (op == Py_EQ) Py_RETURN_TRUE; else Py_RETURN_FALSE;
+				} else {
+					if (op == Py_EQ) Py_RETURN_FALSE; else Py_RETURN_TRUE;
+				}
+			} else if (i == 0) {
+				if(element_is0(e1->pbc_element)) {
+					if (op == Py_EQ) Py_RETURN_TRUE; else Py_RETURN_FALSE;
+				} else {
+					if (op == Py_EQ) Py_RETURN_FALSE; else Py_RETURN_TRUE;
+				}
+			}
+		}
+		PyErr_SetString(PyExc_TypeError, "Cannot compare elements with non-elements other than 1 and 0.");
+		return NULL;
+	}
+	
+	// cast b to element
+	Element *e2 = (Element*)b;
+	// perform the comparison
+	if(!element_cmp(e1->pbc_element, e2->pbc_element)) {
+		if (op == Py_EQ) Py_RETURN_TRUE; else Py_RETURN_FALSE;
+	} else {
+		if (op == Py_EQ) Py_RETURN_FALSE; else Py_RETURN_TRUE;
+	}
+}
+
+// returns dimension of Element (PBC convention is zero for Zr)
+Py_ssize_t  Element_len(PyObject *a) {
+	Py_ssize_t e_dim = 0;
+	// check the type of a
+	pypbc_state *state = pypbc_state_of(a);
+	if (state == NULL) {
+		return -1;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
+		return -1;
+	}
+	
+	Element *py_ele = (Element*)a;
+	if (py_ele->group == Zr) {
+		PyErr_SetString(PyExc_TypeError, "Elements of type Zr have no len()");
+		return -1;
+	}
+	
+	// query the element dimension
+	e_dim = element_item_count(py_ele->pbc_element);
+	 
+	return e_dim;
+}
+
+// returns python Integer representation for ith item of Element (error for Zr)
+PyObject *Element_GetItem(PyObject *a, Py_ssize_t i) {
+	// build the string buffer- AIEEE! MAGIC CONSTANT!
+	unsigned char string[4096];
+	unsigned char hex_value[4096];
+	int size,ii;
+	element_ptr ith_element;
+	Py_ssize_t e_dim = 0;
+	
+	// check the type of a
+	pypbc_state *state = pypbc_state_of(a);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(a, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
+		return NULL;
+	}
+	
+	Element *py_ele = (Element*)a;
+	if (py_ele->group == Zr) {
+		PyErr_SetString(PyExc_ValueError, "Elements of type Zr are not dimensioned.");
+		return NULL;
+	}
+	
+	// query the element dimension
+	e_dim = element_item_count(py_ele->pbc_element);
+	
+	if ((i < 0) || (i >= e_dim)) {
+		PyErr_SetString(PyExc_ValueError, "Index out of range.");
+		return NULL;
+	}
+
+	ith_element = element_item(py_ele->pbc_element, i);
+
+	// printf("Zr vector dimension %d\n", dim);
+	size = element_to_bytes(string, ith_element);
+	sprintf((char *)&hex_value[0], "0x");
+	for (ii = 0 ; ii < size; ii++) {
+		sprintf((char *)&hex_value[2*ii], "%02X", string[ii]);
+	}
+	// terminate string with NULL
+	hex_value[2*size] = NULL;
+	// translate hex (base 16) to python long 
+	return PyLong_FromString(hex_value, NULL, 16);
+}
+
+// GT on type A and A1 curves sits in Fq[i], with i^2 = -1, as elements
+// a + bi of norm a^2 + b^2 = 1. That subgroup is cheap to square and to
+// invert in, and each of its elements is fixed by a single element of Fq,
+// which halves its encoding. Other types have GT in larger extensions, or
+// in Fq itself (type E), and get none of this.
+
+// whether e lives in a quadratic extension of a prime field
+int gt_is_quadratic(element_ptr e) {
+	return element_item_count(e) == 2 && element_item_count(element_item(e, 0)) == 0;
+}
+
+// whether e = a + bi has norm a^2 + b^2 = 1
+static int gt_is_unitary(element_ptr e) {
+	element_ptr a = element_item(e, 0), b = element_item(e, 1);
+	element_t n, t;
+	element_init_same_as(n, a);
+	element_init_same_as(t, a);
+	element_square(n, a);
+	element_square(t, b);
+	element_add(n, n, t);
+	int unitary = element_is1(n);
+	element_clear(n);
+	element_clear(t);
+	return unitary;
+}
+
+// out = x^2 for a unitary x = a + bi: since a^2 + b^2 = 1, that's
+// (2a^2 - 1) + 2ab i, for one squaring and one multiplication in Fq. t is
+// scratch in Fq, and out may be x.
+static void gt_square(element_ptr out, element_ptr x, element_ptr t) {
+	element_ptr a = element_item(x, 0), b = element_item(x, 1);
+	element_ptr oa = element_item(out, 0), ob = element_item(out, 1);
+	element_mul(t, a, b);
+	element_square(oa, a);
+	element_double(oa, oa);
+	// b is finished with, so its slot can hold the one
+	element_set1(ob);
+	element_sub(oa, oa, ob);
+	element_double(ob, t);
+}
+
+// out = 1/x for a unitary x, which is just its conjugate a - bi
+static void gt_conjugate(element_ptr out, element_ptr x) {
+	element_set(out, x);
+	element_neg(element_item(out, 1), element_item(out, 1));
+}
+
+// the torus compression of a unitary a + bi, c = (1 + a) / b. The identity
+// is the group's only element with b = 0, and becomes c = 0. Returns -1 if
+// e isn't in the group.
+static int gt_compress(element_ptr c, element_ptr e) {
+	element_ptr a = element_item(e, 0), b = element_item(e, 1);
+	if (!gt_is_unitary(e)) {
+		return -1;
+	}
+	if (element_is0(b)) {
+		if (!element_is1(a)) {
+			return -1;
+		}
+		element_set0(c);
+		return 0;
+	}
+	element_t t;
+	element_init_same_as(t, a);
+	element_set1(t);
+	element_add(t, t, a);
+	element_div(c, t, b);
+	element_clear(t);
+	return 0;
+}
+
+// the inverse of gt_compress: a = (c^2 - 1) / (c^2 + 1), b = 2c / (c^2 + 1).
+// With q = 3 (mod 4), c^2 + 1 is never zero.
+static void gt_decompress(element_ptr e, element_ptr c) {
+	element_ptr a = element_item(e, 0), b = element_item(e, 1);
+	if (element_is0(c)) {
+		element_set1(e);
+		return;
+	}
+	element_t s, d;
+	element_init_same_as(s, c);
+	element_init_same_as(d, c);
+	element_square(s, c);
+	element_set1(d);
+	element_add(d, s, d);
+	if (element_is0(d)) {
+		// no compression gives this; don't divide by it
+		element_set1(e);
+	} else {
+		element_invert(d, d);
+		element_set1(a);
+		element_sub(a, s, a);
+		element_mul(a, a, d);
+		element_double(b, c);
+		element_mul(b, b, d);
+	}
+	element_clear(s);
+	element_clear(d);
+}
+
+// the number of bytes element_encode writes for e, or -1 with an exception
+// set if it can't be encoded that way
+int element_encoded_length(element_ptr e, enum Group group, int compressed) {
+	if (!compressed) {
+		return element_length_in_bytes(e);
+	}
+	if (group == GT && gt_is_quadratic(e)) {
+		return element_length_in_bytes(element_item(e, 0));
+	}
+	if (group != G1 && group != G2) {
+		PyErr_SetString(PyExc_ValueError, "only points of G1 and G2, and elements of GT on type A and A1 curves, can be compressed.");
+		return -1;
+	}
+	return element_length_in_bytes_compressed(e);
+}
+
+// writes the element's encoding to out, which must hold
+// element_encoded_length bytes. As in str(), the point at infinity is all
+// zeroes, which no point of G1 or G2 encodes to. Compressed GT is its torus
+// compression. Returns -1, without setting an exception, for an element of
+// GT that is outside the group and so has none. Safe without the GIL.
+int element_encode(unsigned char *out, element_ptr e, enum Group group, int compressed) {
+	if (group == GT && compressed) {
+		element_t c;
+		element_init_same_as(c, element_item(e, 0));
+		int ret = gt_compress(c, e);
+		if (ret == 0) {
+			element_to_bytes(out, c);
+		}
+		element_clear(c);
+		return ret;
+	}
+	if ((group == G1 || group == G2) && element_is0(e)) {
+		memset(out, 0, compressed ? element_length_in_bytes_compressed(e) : element_length_in_bytes(e));
+	} else if (compressed) {
+		element_to_bytes_compressed(out, e);
+	} else {
+		element_to_bytes(out, e);
+	}
+	return 0;
+}
+
+// the inverse of element_encode, into an element already initialised in
+// the right group. Safe without the GIL.
+void element_decode(element_ptr e, enum Group group, unsigned char *in, int len, int compressed) {
+	if (group == G1 || group == G2) {
+		int i;
+		for (i = 0; i < len && in[i] == 0; i++);
+		if (i == len) {
+			element_set0(e);
+			return;
+		}
+	}
+	if (group == GT && compressed) {
+		element_t c;
+		element_init_same_as(c, element_item(e, 0));
+		element_from_bytes(c, in);
+		gt_decompress(e, c);
+		element_clear(c);
+	} else if (compressed) {
+		element_from_bytes_compressed(e, in);
+	} else {
+		element_from_bytes(e, in);
+	}
+}
+
+PyDoc_STRVAR(Element_to_bytes__doc__,
+"element.to_bytes(compressed=False) -> bytes\n\n\
+PBC's fixed-length encoding of the element: big-endian coordinates for\n\
+points and elements of GT, and a big-endian integer for Zr. Points of G1\n\
+and G2 can be compressed to their X coordinate and a sign byte, and on type\n\
+A and A1 curves elements of GT to the single coordinate of their torus\n\
+compression, at half the size. The point at infinity is all zeroes.\n\
+Element.from_bytes reverses it.");
+PyObject *Element_to_bytes(PyObject *self, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"compressed", NULL};
+	int compressed = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|p", keys, &compressed)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	Element *e = (Element *)self;
+	int len = element_encoded_length(e->pbc_element, e->group, compressed);
+	if (len < 0) {
+		return NULL;
+	}
+	PyObject *result = PyBytes_FromStringAndSize(NULL, len);
+	if (result == NULL) {
+		return NULL;
+	}
+	if (element_encode((unsigned char *)PyBytes_AS_STRING(result), e->pbc_element, e->group, compressed) < 0) {
+		Py_DECREF(result);
+		PyErr_SetString(PyExc_ValueError, "element is not in the subgroup GT, so has no compressed form.");
+		return NULL;
+	}
+	return result;
+}
+
+PyDoc_STRVAR(Element_from_bytes__doc__,
+"Element.from_bytes(pairing, group, data, compressed=False) -> Element\n\n\
+Decodes what element.to_bytes wrote. data is any bytes-like object of\n\
+exactly the encoded length. Points are not checked to be on the curve.");
+PyObject *Element_from_bytes(PyObject *cls, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"pairing", "group", "data", "compressed", NULL};
+	PyObject *pypairing;
+	enum Group group;
+	Py_buffer data;
+	int compressed = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oiy*|p", keys, &pypairing, &group, &data, &compressed)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+
+	// check the type of arguments
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)cls);
+	if (state == NULL) {
+		PyBuffer_Release(&data);
+		return NULL;
+	}
+	if(!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyBuffer_Release(&data);
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return NULL;
+	}
+
+	// build ourselves
+	Element *self = Element_create(state);
+	if (self == NULL || Element_init_group(self, pypairing, group) < 0) {
+		PyBuffer_Release(&data);
+		Py_XDECREF(self);
+		return NULL;
+	}
+	int len = element_encoded_length(self->pbc_element, group, compressed);
+	if (len < 0 || data.len != len) {
+		if (len >= 0) {
+			PyErr_Format(PyExc_ValueError, "expected %d bytes, got %zd.", len, data.len);
+		}
+		PyBuffer_Release(&data);
+		Py_DECREF(self);
+		return NULL;
+	}
+	element_decode(self->pbc_element, group, data.buf, len, compressed);
+	PyBuffer_Release(&data);
+	return (PyObject *)self;
+}
+
+PyMemberDef Element_members[] = {
+	{NULL}
+};
+
+PyMethodDef Element_methods[] = {
+	{"from_hash", (PyCFunction)(void(*)(void))Element_from_hash, METH_FASTCALL | METH_CLASS, "Creates an Element from the given hash value."},
+	{"from_hash_many", (PyCFunction)Element_from_hash_many, METH_VARARGS | METH_CLASS, Element_from_hash_many__doc__},
+	{"random", (PyCFunction)(void(*)(void))Element_random, METH_FASTCALL | METH_CLASS, "Creates a random element from the given group."},
+	{"random_many", (PyCFunction)Element_random_many, METH_VARARGS | METH_CLASS, Element_random_many__doc__},
+	{"zero", (PyCFunction)(void(*)(void))Element_zero, METH_FASTCALL | METH_CLASS, "Creates an element representing the additive identity for its group."},
+	{"one", (PyCFunction)(void(*)(void))Element_one, METH_FASTCALL | METH_CLASS, "Creates an element representing the multiplicative identity for its group."},
+	{"pow_async", (PyCFunction)Element_pow_async, METH_O, "Raises the element to a power on a worker thread; returns an awaitable."},
+	{"to_str", (PyCFunction)Element_to_str, METH_VARARGS | METH_KEYWORDS, Element_to_str__doc__},
+	{"to_bytes", (PyCFunction)Element_to_bytes, METH_VARARGS | METH_KEYWORDS, Element_to_bytes__doc__},
+	{"from_bytes", (PyCFunction)Element_from_bytes, METH_VARARGS | METH_KEYWORDS | METH_CLASS, Element_from_bytes__doc__},
+	{"__sizeof__", (PyCFunction)Element_sizeof, METH_NOARGS, Element_sizeof__doc__},
+	{NULL, NULL}
+};
+
+PyType_Slot Element_slots[] = {
+	{Py_tp_dealloc, Element_dealloc},
+	{Py_tp_repr, Element_str},
+	{Py_tp_str, Element_str},
+	{Py_tp_doc, (void *)Element__doc__},
+	{Py_tp_richcompare, Element_cmp},
+	{Py_tp_methods, Element_methods},
+	{Py_tp_members, Element_members},
+	{Py_tp_init, Element_init},
+	{Py_tp_new, Element_new},
+	{Py_nb_add, Element_add},
+	{Py_nb_subtract, Element_sub},
+	{Py_nb_multiply, Element_mult},
+	{Py_nb_power, Element_pow},
+	{Py_nb_negative, Element_neg},
+	{Py_nb_invert, Element_invert},
+	{Py_nb_int, Element_int},
+	{Py_nb_true_divide, Element_div},
+	{Py_sq_length, Element_len},
+	{Py_sq_item, Element_GetItem},
+	{0, NULL}
+};
+
+PyType_Spec Element_spec = {
+	"pypbc.Element",
+	sizeof(Element),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	Element_slots
+};
+
+/*******************************************************************************
+*						HashToGroup							      *
+*******************************************************************************/
+
+PyDoc_STRVAR(HashToGroup__doc__,
+"HashToGroup(pairing, G1||G2||GT||Zr, data=None) -> HashToGroup object\n\n\
+Incrementally digests a message with SHA-256 and maps it into a group, so\n\
+that large messages can be fed in chunks instead of being joined in memory.\n\
+\n\
+h.update(chunk) -> feeds more of the message (str or bytes-like).\n\
+h.digest() -> the SHA-256 digest of everything fed so far.\n\
+h.element() -> the Element the message maps to; this is the same as\n\
+Element.from_hash_many(pairing, group, [message])[0].");
+
+// allocate the object
+PyObject *HashToGroup_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+	// create the new HashToGroup object
+	HashToGroup *self = (HashToGroup *)type->tp_alloc(type, 0);
+	// make sure it actually worked
+	if (!self) {
+		PyErr_SetString(PyExc_TypeError, "could not create HashToGroup object.");
+		return NULL;
+	}
+	self->pairing = NULL;
+	self->ready = 0;
+	return (PyObject *)self;
+}
+
+// feeds one chunk of the message into the digest
+static int HashToGroup_feed(HashToGroup *self, PyObject *data) {
+	Py_buffer chunk;
+	if (hash_input_get_buffer(data, &chunk) < 0) {
+		return -1;
+	}
+	sha256_update(&self->ctx, chunk.buf, chunk.len);
+	PyBuffer_Release(&chunk);
+	return 0;
+}
+
+// HashToGroup(pairing, group, data=None) -> HashToGroup
+int HashToGroup_init(HashToGroup *self, PyObject *args, PyObject *kwargs) {
+	PyObject *pypairing;
+	int group;
+	PyObject *data = NULL;
+	char *keys[] = {"pairing", "group", "data", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|O", keys, &pypairing, &group, &data)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return -1;
+	}
+
+	// check the type of arguments
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return -1;
+	}
+	if(!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return -1;
+	}
+	if (group < G1 || group > Zr) {
+		PyErr_SetString(PyExc_ValueError, "Invalid group.");
+		return -1;
+	}
+
+	// store the pairing and incref it, since we depend on its existence
+	int ret = 0;
+	Py_INCREF(pypairing);
+	Py_BEGIN_CRITICAL_SECTION(self);
+	Py_XSETREF(self->pairing, pypairing);
+	self->group = group;
+	sha256_init(&self->ctx);
+	self->ready = 1;
+
+	// take the first chunk if we were given one
+	if (data != NULL && data != Py_None) {
+		ret = HashToGroup_feed(self, data);
+	}
+	Py_END_CRITICAL_SECTION();
+	return ret;
+}
+
+// deallocates the object when done
+void HashToGroup_dealloc(HashToGroup *self) {
+	Py_XDECREF(self->pairing);
+	// free the object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(self);
+	type->tp_free((PyObject*)self);
+	Py_DECREF(type);
+}
+
+// takes a consistent copy of the digest state; the critical section keeps
+// it from tearing against an update on another thread
+static int HashToGroup_snapshot(HashToGroup *self, sha256_ctx *ctx) {
+	int ready;
+	Py_BEGIN_CRITICAL_SECTION(self);
+	ready = self->ready;
+	*ctx = self->ctx;
+	Py_END_CRITICAL_SECTION();
+	if (!ready) {
+		PyErr_SetString(PyExc_ValueError, "HashToGroup has not been initialised.");
+		return -1;
+	}
+	return 0;
+}
+
+// h.update(chunk) -> None
+PyObject *HashToGroup_update(HashToGroup *self, PyObject *data) {
+	int ret = -1;
+	Py_BEGIN_CRITICAL_SECTION(self);
+	if (!self->ready) {
+		PyErr_SetString(PyExc_ValueError, "HashToGroup has not been initialised.");
+	} else {
+		ret = HashToGroup_feed(self, data);
+	}
+	Py_END_CRITICAL_SECTION();
+	if (ret < 0) {
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+// h.digest() -> bytes
+PyObject *HashToGroup_digest(HashToGroup *self, PyObject *unused) {
+	unsigned char digest[SHA256_DIGEST_SIZE];
+	// finalise a copy so the caller can keep feeding us
+	sha256_ctx ctx;
+	if (HashToGroup_snapshot(self, &ctx) < 0) {
+		return NULL;
+	}
+	sha256_final(&ctx, digest);
+	return PyBytes_FromStringAndSize((char *)digest, SHA256_DIGEST_SIZE);
+}
+
+// h.element() -> Element
+PyObject *HashToGroup_element(HashToGroup *self, PyObject *unused) {
+	unsigned char digest[SHA256_DIGEST_SIZE];
+	sha256_ctx ctx;
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL || HashToGroup_snapshot(self, &ctx) < 0) {
+		return NULL;
+	}
+	sha256_final(&ctx, digest);
+
+	// build the result and map the digest into its group
+	Element *e = Element_create(state);
+	if (e == NULL) {
+		return NULL;
+	}
+	if (Element_init_group(e, self->pairing, self->group) < 0) {
+		Py_DECREF(e);
+		return NULL;
+	}
+	element_from_hash(e->pbc_element, digest, SHA256_DIGEST_SIZE);
+	return (PyObject *)e;
+}
+
+PyMethodDef HashToGroup_methods[] = {
+	{"update", (PyCFunction)HashToGroup_update, METH_O, "Feeds another chunk of the message."},
+	{"digest", (PyCFunction)HashToGroup_digest, METH_NOARGS, "Returns the SHA-256 digest of the message so far."},
+	{"element", (PyCFunction)HashToGroup_element, METH_NOARGS, "Returns the Element the message so far maps to."},
+	{NULL, NULL}
+};
+
+PyType_Slot HashToGroup_slots[] = {
+	{Py_tp_dealloc, HashToGroup_dealloc},
+	{Py_tp_doc, (void *)HashToGroup__doc__},
+	{Py_tp_methods, HashToGroup_methods},
+	{Py_tp_init, HashToGroup_init},
+	{Py_tp_new, HashToGroup_new},
+	{0, NULL}
+};
+
+PyType_Spec HashToGroup_spec = {
+	"pypbc.HashToGroup",
+	sizeof(HashToGroup),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	HashToGroup_slots
+};
+
+/*******************************************************************************
+*						RandomSource							      *
+*******************************************************************************/
+
+PyDoc_STRVAR(RandomSource__doc__,
+"RandomSource(seed=None) -> RandomSource object\n\n\
+A ChaCha20 based CSPRNG for PBC. Each thread that draws from an installed\n\
+source gets its own keystream, so drawing takes no system calls and no locks.\n\
+\n\
+RandomSource() -> keyed from os.urandom.\n\
+RandomSource(seed=s) -> keyed from the SHA-256 of s (an int, str or\n\
+bytes-like object). Two sources with the same seed produce the same values\n\
+in the same order on each thread, which is meant for reproducible tests\n\
+and benchmarks, not for keys; a process forked while one is installed goes\n\
+on with the same values as its parent. An unseeded source is rekeyed from\n\
+the OS in the child of every fork, so forked workers draw apart.\n\
+\n\
+source.install() is the same as set_random_source(source).");
+
+// allocate the object
+PyObject *RandomSource_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+	// create the new RandomSource object
+	RandomSource *self = (RandomSource *)type->tp_alloc(type, 0);
+	// make sure it actually worked
+	if (!self) {
+		PyErr_SetString(PyExc_TypeError, "could not create RandomSource object.");
+		return NULL;
+	}
+	self->ready = 0;
+	return (PyObject *)self;
+}
+
+// RandomSource(seed=None) -> RandomSource
+int RandomSource_init(RandomSource *self, PyObject *args, PyObject *kwargs) {
+	PyObject *seed = Py_None;
+	char *keys[] = {"seed", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O", keys, &seed)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return -1;
+	}
+
+	unsigned char key[SHA256_DIGEST_SIZE];
+	PyObject *material;
+	if (seed == Py_None) {
+		// no seed, so key ourselves from the OS
+		PyObject *os = PyImport_ImportModule("os");
+		if (os == NULL) {
+			return -1;
+		}
+		material = PyObject_CallMethod(os, "urandom", "i", SHA256_DIGEST_SIZE);
+		Py_DECREF(os);
+		self->deterministic = 0;
+	} else if (PyLong_Check(seed)) {
+		// ints are hashed by their decimal representation
+		material = PyObject_Str(seed);
+		self->deterministic = 1;
+	} else {
+		Py_INCREF(seed);
+		material = seed;
+		self->deterministic = 1;
+	}
+	if (material == NULL) {
+		return -1;
+	}
+
+	// the key is the SHA-256 of whatever we were given
+	Py_buffer view;
+	if (hash_input_get_buffer(material, &view) < 0) {
+		Py_DECREF(material);
+		return -1;
+	}
+	sha256_ctx ctx;
+	sha256_init(&ctx);
+	sha256_update(&ctx, view.buf, view.len);
+	sha256_final(&ctx, key);
+	PyBuffer_Release(&view);
+	Py_DECREF(material);
+
+	int i;
+	for (i = 0; i < 8; i++) {
+		self->key[i] = (uint32_t)key[4*i] | ((uint32_t)key[4*i+1] << 8) |
+			((uint32_t)key[4*i+2] << 16) | ((uint32_t)key[4*i+3] << 24);
+	}
+	self->ready = 1;
+	return 0;
+}
+
+// deallocates the object when done
+void RandomSource_dealloc(RandomSource *self) {
+	// free the object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(self);
+	type->tp_free((PyObject*)self);
+	Py_DECREF(type);
+}
+
+// source.install() -> None
+PyObject *RandomSource_install(RandomSource *self, PyObject *unused) {
+	if (!self->ready) {
+		PyErr_SetString(PyExc_ValueError, "RandomSource has not been initialised.");
+		return NULL;
+	}
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	return random_source_install(state, (PyObject *)self);
+}
+
+PyMemberDef RandomSource_members[] = {
+	{"deterministic", T_INT, offsetof(RandomSource, deterministic), READONLY, "True if the source was seeded."},
+	{NULL}
+};
+
+PyMethodDef RandomSource_methods[] = {
+	{"install", (PyCFunction)RandomSource_install, METH_NOARGS, "Makes PBC draw its randomness from this source."},
+	{NULL, NULL}
+};
+
+PyType_Slot RandomSource_slots[] = {
+	{Py_tp_dealloc, RandomSource_dealloc},
+	{Py_tp_doc, (void *)RandomSource__doc__},
+	{Py_tp_methods, RandomSource_methods},
+	{Py_tp_members, RandomSource_members},
+	{Py_tp_init, RandomSource_init},
+	{Py_tp_new, RandomSource_new},
+	{0, NULL}
+};
+
+PyType_Spec RandomSource_spec = {
+	"pypbc.RandomSource",
+	sizeof(RandomSource),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	RandomSource_slots
+};
+
+/*******************************************************************************
+*						ElementBuffer							      *
+*******************************************************************************/
+
+PyDoc_STRVAR(ElementBuffer__doc__,
+"A packed array of element encodings, as built by pack_elements.\n\n\
+Exports a read-only 2-D uint8 buffer of shape (n, itemsize) holding one\n\
+element per row in the format of element.to_bytes, so numpy.asarray(buf)\n\
+or memoryview(buf) can read it without copying.\n\
+\n\
+buf.unpack() -> the list of Elements it holds.\n\
+len(buf) -> the number of elements.");
+
+// the length every element of the group encodes to, or -1 with an
+// exception set
+static int group_encoded_length(PyObject *pypairing, enum Group group, int compressed) {
+	Pairing *pairing = (Pairing *)pypairing;
+	element_t e;
+	int len;
+	switch(group) {
+		case G1: element_init_G1(e, pairing->pbc_pairing); break;
+		case G2: element_init_G2(e, pairing->pbc_pairing); break;
+		case GT: element_init_GT(e, pairing->pbc_pairing); break;
+		case Zr: element_init_Zr(e, pairing->pbc_pairing); break;
+		default: PyErr_SetString(PyExc_ValueError, "Invalid group."); return -1;
+	}
+	len = element_encoded_length(e, group, compressed);
+	element_clear(e);
+	return len;
+}
+
+// decodes count rows of len bytes into a new list of Elements; the
+// decoding runs without the GIL
+static PyObject *unpack_rows(pypbc_state *state, PyObject *pypairing, enum Group group, unsigned char *data, Py_ssize_t count, int len, int compressed) {
+	Py_ssize_t i;
+	Element **elements = PyMem_Calloc(count ? count : 1, sizeof(Element *));
+	PyObject *result = PyList_New(count);
+	if (elements == NULL || result == NULL) {
+		PyMem_Free(elements);
+		Py_XDECREF(result);
+		return PyErr_NoMemory();
+	}
+
+	// build all of the output elements while we still hold the GIL
+	for (i = 0; i < count; i++) {
+		Element *e = Element_create(state);
+		if (e == NULL) {
+			goto error;
+		}
+		PyList_SET_ITEM(result, i, (PyObject *)e);
+		if (Element_init_group(e, pypairing, group) < 0) {
+			goto error;
+		}
+		elements[i] = e;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	for (i = 0; i < count; i++) {
+		element_decode(elements[i]->pbc_element, group, data + i * len, len, compressed);
+	}
+	Py_END_ALLOW_THREADS
+
+	PyMem_Free(elements);
+	return result;
+
+error:
+	PyMem_Free(elements);
+	Py_DECREF(result);
+	return NULL;
+}
+
+PyDoc_STRVAR(pack_elements__doc__,
+"pack_elements(elements, compressed=False) -> ElementBuffer\n\n\
+Encodes a non-empty sequence of Elements, all of the same pairing and\n\
+group, into one ElementBuffer of shape (len(elements), itemsize). The\n\
+encoding runs in a single loop without the GIL.");
+PyObject *pack_elements(PyObject *self, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"elements", "compressed", NULL};
+	PyObject *elements;
+	int compressed = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", keys, &elements, &compressed)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	pypbc_state *state = PyModule_GetState(self);
+
+	// a tuple of our own, since a list could lose elements to another
+	// thread while we encode them without the GIL
+	PyObject *seq = PySequence_Tuple(elements);
+	if (seq == NULL) {
+		return NULL;
+	}
+	Py_ssize_t n = PySequence_Fast_GET_SIZE(seq), i;
+	if (n == 0) {
+		Py_DECREF(seq);
+		PyErr_SetString(PyExc_ValueError, "can't pack an empty sequence.");
+		return NULL;
+	}
+
+	// everything has to match the first element
+	PyObject **items = PySequence_Fast_ITEMS(seq);
+	if (!PyObject_TypeCheck(items[0], state->ElementType)) {
+		Py_DECREF(seq);
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return NULL;
+	}
+	Element *first = (Element *)items[0];
+	for (i = 1; i < n; i++) {
+		if (!PyObject_TypeCheck(items[i], state->ElementType)) {
+			Py_DECREF(seq);
+			PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+			return NULL;
+		}
+		if (((Element *)items[i])->pairing != first->pairing || ((Element *)items[i])->group != first->group) {
+			Py_DECREF(seq);
+			PyErr_SetString(PyExc_ValueError, "elements must share a pairing and a group.");
+			return NULL;
+		}
+	}
+	int len = element_encoded_length(first->pbc_element, first->group, compressed);
+	if (len < 0) {
+		Py_DECREF(seq);
+		return NULL;
+	}
+
+	ElementBuffer *buffer = (ElementBuffer *)state->ElementBufferType->tp_alloc(state->ElementBufferType, 0);
+	if (buffer == NULL) {
+		Py_DECREF(seq);
+		return NULL;
+	}
+	buffer->data = PyMem_Malloc(n * len);
+	if (buffer->data == NULL) {
+		Py_DECREF(seq);
+		Py_DECREF(buffer);
+		return PyErr_NoMemory();
+	}
+	Py_INCREF(first->pairing);
+	buffer->pairing = first->pairing;
+	buffer->group = first->group;
+	buffer->compressed = compressed;
+	buffer->shape[0] = n;
+	buffer->shape[1] = len;
+	buffer->strides[0] = len;
+	buffer->strides[1] = 1;
+
+	// the tuple keeps every element alive while we work
+	int failed = 0;
+	Py_BEGIN_ALLOW_THREADS
+	for (i = 0; i < n; i++) {
+		if (element_encode(buffer->data + i * len, ((Element *)items[i])->pbc_element, first->group, compressed) < 0) {
+			failed = 1;
+		}
+	}
+	Py_END_ALLOW_THREADS
+
+	Py_DECREF(seq);
+	if (failed) {
+		Py_DECREF(buffer);
+		PyErr_SetString(PyExc_ValueError, "an element is not in the subgroup GT, so has no compressed form.");
+		return NULL;
+	}
+	return (PyObject *)buffer;
+}
+
+PyDoc_STRVAR(unpack_elements__doc__,
+"unpack_elements(pairing, group, data, compressed=False) -> list of Elements\n\n\
+The inverse of pack_elements: decodes every row of a C-contiguous bytes-like\n\
+object (an ElementBuffer, bytes, a uint8 numpy array, ...) whose size is a\n\
+multiple of the encoded length. The decoding runs without the GIL.");
+PyObject *unpack_elements(PyObject *self, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"pairing", "group", "data", "compressed", NULL};
+	PyObject *pypairing;
+	enum Group group;
+	Py_buffer data;
+	int compressed = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oiy*|p", keys, &pypairing, &group, &data, &compressed)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	pypbc_state *state = PyModule_GetState(self);
+	if(!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyBuffer_Release(&data);
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return NULL;
+	}
+
+	int len = group_encoded_length(pypairing, group, compressed);
+	if (len < 0 || data.len % len != 0) {
+		if (len >= 0) {
+			PyErr_Format(PyExc_ValueError, "data is not a whole number of %d byte elements.", len);
+		}
+		PyBuffer_Release(&data);
+		return NULL;
+	}
+	PyObject *result = unpack_rows(state, pypairing, group, data.buf, data.len / len, len, compressed);
+	PyBuffer_Release(&data);
+	return result;
+}
+
+// deallocates the object when done
+void ElementBuffer_dealloc(ElementBuffer *self) {
+	PyMem_Free(self->data);
+	Py_XDECREF(self->pairing);
+	// free the object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(self);
+	type->tp_free((PyObject*)self);
+	Py_DECREF(type);
+}
+
+// exports the rows as a read-only 2-D uint8 buffer
+static int ElementBuffer_getbuffer(ElementBuffer *self, Py_buffer *view, int flags) {
+	if (flags & PyBUF_WRITABLE) {
+		PyErr_SetString(PyExc_BufferError, "ElementBuffer is read-only.");
+		view->obj = NULL;
+		return -1;
+	}
+	Py_INCREF(self);
+	view->obj = (PyObject *)self;
+	view->buf = self->data;
+	view->len = self->shape[0] * self->shape[1];
+	view->readonly = 1;
+	view->itemsize = 1;
+	view->format = (flags & PyBUF_FORMAT) ? "B" : NULL;
+	// consumers that don't ask for a shape get plain contiguous bytes
+	view->ndim = (flags & PyBUF_ND) ? 2 : 1;
+	view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+	view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? self->strides : NULL;
+	view->suboffsets = NULL;
+	view->internal = NULL;
+	return 0;
+}
+
+// len(buf) -> the number of elements
+static Py_ssize_t ElementBuffer_len(ElementBuffer *self) {
+	return self->shape[0];
+}
+
+// buf.unpack() -> list of Elements
+PyObject *ElementBuffer_unpack(ElementBuffer *self, PyObject *unused) {
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	return unpack_rows(state, self->pairing, self->group, self->data, self->shape[0], (int)self->shape[1], self->compressed);
+}
+
+PyMemberDef ElementBuffer_members[] = {
+	{"pairing", T_OBJECT, offsetof(ElementBuffer, pairing), READONLY, "The Pairing of the elements."},
+	{"group", T_INT, offsetof(ElementBuffer, group), READONLY, "The group of the elements."},
+	{"compressed", T_INT, offsetof(ElementBuffer, compressed), READONLY, "True if points are compressed."},
+	{"itemsize", T_PYSSIZET, offsetof(ElementBuffer, shape) + sizeof(Py_ssize_t), READONLY, "The encoded length of one element."},
+	{NULL}
+};
+
+PyMethodDef ElementBuffer_methods[] = {
+	{"unpack", (PyCFunction)ElementBuffer_unpack, METH_NOARGS, "Decodes the buffer back into a list of Elements."},
+	{NULL, NULL}
+};
+
+PyType_Slot ElementBuffer_slots[] = {
+	{Py_tp_dealloc, ElementBuffer_dealloc},
+	{Py_tp_doc, (void *)ElementBuffer__doc__},
+	{Py_tp_methods, ElementBuffer_methods},
+	{Py_tp_members, ElementBuffer_members},
+	{Py_bf_getbuffer, ElementBuffer_getbuffer},
+	{Py_sq_length, ElementBuffer_len},
+	{0, NULL}
+};
+
+PyType_Spec ElementBuffer_spec = {
+	"pypbc.ElementBuffer",
+	sizeof(ElementBuffer),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_DISALLOW_INSTANTIATION,
+	ElementBuffer_slots
+};
+
+/*******************************************************************************
+*						PointAccumulator							      *
+*******************************************************************************/
+
+PyDoc_STRVAR(PointAccumulator__doc__,
+"PointAccumulator(pairing, G1||G2, start=None) -> PointAccumulator object\n\n\
+A running sum of points of G1 or G2, kept in Jacobian coordinates. Each +\n\
+between Elements gives back an affine point and so pays for a field\n\
+inversion; the accumulator only pays for one when its result is asked for.\n\
+Use it for long chains of additions, such as aggregating signatures.\n\
+\n\
+acc.add(P) -> acc = acc + P, for an Element or another PointAccumulator.\n\
+acc.sub(P) -> acc = acc - P.\n\
+acc.double() -> acc = acc + acc.\n\
+acc.add_scaled(P, k) -> acc = acc + k*P, for an integer or Zr element k.\n\
+acc.result() -> the sum as an Element.\n\
+PointAccumulator.results(accs) -> the results of many accumulators, which\n\
+share a single field inversion between them.");
+
+// the field the coordinates of points in G1 or G2 live in
+static field_ptr coordinate_field(Pairing *pairing, enum Group group) {
+	element_t p;
+	if (group == G1) {
+		element_init_G1(p, pairing->pbc_pairing);
+	} else {
+		element_init_G2(p, pairing->pbc_pairing);
+	}
+	field_ptr f = element_x(p)->field;
+	element_clear(p);
+	return f;
+}
+
+// initialises P over f as the point at infinity
+static void jacobian_init(jacobian_point *P, field_ptr f) {
+	element_init(P->X, f);
+	element_init(P->Y, f);
+	element_init(P->Z, f);
+	element_set1(P->X);
+	element_set1(P->Y);
+	element_set0(P->Z);
+}
+
+static void jacobian_clear(jacobian_point *P) {
+	element_clear(P->X);
+	element_clear(P->Y);
+	element_clear(P->Z);
+}
+
+// sets up the scratch space for points over f on a curve with coefficient a
+static void jacobian_ctx_init(jacobian_ctx *ctx, field_ptr f, element_ptr a) {
+	element_init(ctx->a, f);
+	element_set(ctx->a, a);
+	ctx->a_is0 = element_is0(ctx->a);
+	for (int i = 0; i < 7; i++) {
+		element_init(ctx->t[i], f);
+	}
+}
+
+static void jacobian_ctx_clear(jacobian_ctx *ctx) {
+	element_clear(ctx->a);
+	for (int i = 0; i < 7; i++) {
+		element_clear(ctx->t[i]);
+	}
+}
+
+// P = 2P, for the curve y^2 = x^3 + ax + b
+static void jacobian_double(jacobian_ctx *ctx, jacobian_point *P) {
+	element_ptr XX = ctx->t[0], YY = ctx->t[1], S = ctx->t[2], M = ctx->t[3], T = ctx->t[4];
+	// doubling infinity, or a point of order two, gives infinity
+	if (element_is0(P->Z) || element_is0(P->Y)) {
+		element_set0(P->Z);
+		return;
+	}
+	element_square(XX, P->X);
+	element_square(YY, P->Y);
+	// S = 4 X YY
+	element_mul(S, P->X, YY);
+	element_double(S, S);
+	element_double(S, S);
+	// M = 3 XX + a Z^4
+	element_double(M, XX);
+	element_add(M, M, XX);
+	if (!ctx->a_is0) {
+		element_square(T, P->Z);
+		element_square(T, T);
+		element_mul(T, T, ctx->a);
+		element_add(M, M, T);
+	}
+	// Z3 = 2 Y Z, before Y is overwritten
+	element_mul(P->Z, P->Y, P->Z);
+	element_double(P->Z, P->Z);
+	// X3 = M^2 - 2 S
+	element_square(P->X, M);
+	element_sub(P->X, P->X, S);
+	element_sub(P->X, P->X, S);
+	// Y3 = M (S - X3) - 8 YY^2
+	element_sub(S, S, P->X);
+	element_mul(S, M, S);
+	element_square(YY, YY);
+	element_double(YY, YY);
+	element_double(YY, YY);
+	element_double(YY, YY);
+	element_sub(P->Y, S, YY);
+}
+
+// P = P + Q, or P - Q if negate is set, where Q is (X2, Y2, Z2) or the
+// affine point (X2, Y2) if Z2 is NULL. Q is only read before P is written,
+// so it may be P itself.
+static void jacobian_add(jacobian_ctx *ctx, jacobian_point *P, element_ptr X2, element_ptr Y2, element_ptr Z2, int negate) {
+	element_ptr U1 = ctx->t[0], U2 = ctx->t[1], S1 = ctx->t[2], S2 = ctx->t[3], H = ctx->t[4], R = ctx->t[5], T = ctx->t[6];
+	// adding infinity changes nothing
+	if (Z2 != NULL && element_is0(Z2)) {
+		return;
+	}
+	// and adding to it just takes Q
+	if (element_is0(P->Z)) {
+		element_set(P->X, X2);
+		if (negate) {
+			element_neg(P->Y, Y2);
+		} else {
+			element_set(P->Y, Y2);
+		}
+		if (Z2 != NULL) {
+			element_set(P->Z, Z2);
+		} else {
+			element_set1(P->Z);
+		}
+		return;
+	}
+	// U2 = X2 Z1^2, S2 = Y2 Z1^3
+	element_square(T, P->Z);
+	element_mul(U2, X2, T);
+	element_mul(S2, Y2, T);
+	element_mul(S2, S2, P->Z);
+	if (negate) {
+		element_neg(S2, S2);
+	}
+	// U1 = X1 Z2^2, S1 = Y1 Z2^3, which for an affine Q are just X1 and Y1
+	if (Z2 == NULL) {
+		element_set(U1, P->X);
+		element_set(S1, P->Y);
+	} else {
+		element_square(T, Z2);
+		element_mul(U1, P->X, T);
+		element_mul(S1, P->Y, T);
+		element_mul(S1, S1, Z2);
+	}
+	element_sub(H, U2, U1);
+	element_sub(R, S2, S1);
+	// the same x coordinate means Q is either P or -P
+	if (element_is0(H)) {
+		if (element_is0(R)) {
+			jacobian_double(ctx, P);
+		} else {
+			element_set0(P->Z);
+		}
+		return;
+	}
+	// Z3 = Z1 Z2 H
+	if (Z2 != NULL) {
+		element_mul(P->Z, P->Z, Z2);
+	}
+	element_mul(P->Z, P->Z, H);
+	// HH = H^2 in T, HHH = H HH in H, V = U1 HH in U1
+	element_square(T, H);
+	element_mul(H, H, T);
+	element_mul(U1, U1, T);
+	// X3 = R^2 - HHH - 2 V
+	element_square(P->X, R);
+	element_sub(P->X, P->X, H);
+	element_sub(P->X, P->X, U1);
+	element_sub(P->X, P->X, U1);
+	// Y3 = R (V - X3) - S1 HHH
+	element_sub(U1, U1, P->X);
+	element_mul(U1, R, U1);
+	element_mul(S1, S1, H);
+	element_sub(P->Y, U1, S1);
+}
+
+// sum = sum + k*(x, y), or sum - k*(x, y) if negate is set, for k >= 0. The
+// multiple is built by double-and-add without leaving Jacobian coordinates.
+static void jacobian_add_scaled(PointAccumulator *acc, element_ptr x, element_ptr y, mpz_t k, int negate) {
+	jacobian_point *T = &acc->scaled;
+	element_set0(T->Z);
+	for (long i = (long)mpz_sizeinbase(k, 2) - 1; i >= 0; i--) {
+		jacobian_double(&acc->ctx, T);
+		if (mpz_tstbit(k, i)) {
+			jacobian_add(&acc->ctx, T, x, y, NULL, negate);
+		}
+	}
+	jacobian_add(&acc->ctx, &acc->sum, T->X, T->Y, T->Z, 0);
+}
+
+// sets the curve point out to (x, y). PBC only builds finite points through
+// from_bytes, so the coordinates go through their encoding. Needs no GIL,
+// and returns -1 if it runs out of memory, without setting an exception.
+static int point_set_affine(element_ptr out, element_ptr x, element_ptr y) {
+	int xlen = element_length_in_bytes(x);
+	unsigned char *buf = PyMem_RawMalloc(xlen + element_length_in_bytes(y));
+	if (buf == NULL) {
+		return -1;
+	}
+	element_to_bytes(buf, x);
+	element_to_bytes(buf + xlen, y);
+	element_from_bytes(out, buf);
+	PyMem_RawFree(buf);
+	return 0;
+}
+
+// stores P in the curve point out, given 1/Z in zinv, or NULL to work it
+// out in t[3]. Uses t[0] to t[3] as scratch. Fails as point_set_affine.
+static int jacobian_store(element_ptr out, jacobian_point *P, element_ptr zinv, element_t *t) {
+	if (element_is0(P->Z)) {
+		element_set0(out);
+		return 0;
+	}
+	if (zinv == NULL) {
+		element_invert(t[3], P->Z);
+		zinv = t[3];
+	}
+	// (x, y) = (X / Z^2, Y / Z^3)
+	element_square(t[0], zinv);
+	element_mul(t[1], P->X, t[0]);
+	element_mul(t[0], t[0], zinv);
+	element_mul(t[2], P->Y, t[0]);
+	return point_set_affine(out, t[1], t[2]);
+}
+
+// allocate the object
+PyObject *PointAccumulator_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+	PointAccumulator *self = (PointAccumulator *)type->tp_alloc(type, 0);
+	if (!self) {
+		PyErr_SetString(PyExc_TypeError, "could not create PointAccumulator object.");
+		return NULL;
+	}
+	self->pairing = NULL;
+	self->ready = 0;
+	return (PyObject *)self;
+}
+
+// clears everything the accumulator initialised
+static void PointAccumulator_clear_elements(PointAccumulator *self) {
+	jacobian_clear(&self->sum);
+	jacobian_clear(&self->scaled);
+	jacobian_ctx_clear(&self->ctx);
+}
+
+// checks that op is an Element or PointAccumulator on the same curve as
+// self; returns 1 for an Element, 2 for an accumulator, -1 on error
+static int accumulator_operand(PointAccumulator *self, PyObject *op) {
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return -1;
+	}
+	if (!self->ready) {
+		PyErr_SetString(PyExc_ValueError, "PointAccumulator has not been initialised.");
+		return -1;
+	}
+	if (PyObject_TypeCheck(op, state->ElementType)) {
+		Element *e = (Element *)op;
+		if (e->pairing != self->pairing || e->group != self->group) {
+			PyErr_SetString(PyExc_ValueError, "point must be in the accumulator's pairing and group.");
+			return -1;
+		}
+		return 1;
+	}
+	if (PyObject_TypeCheck(op, state->PointAccumulatorType)) {
+		PointAccumulator *other = (PointAccumulator *)op;
+		if (!other->ready || other->pairing != self->pairing || other->group != self->group) {
+			PyErr_SetString(PyExc_ValueError, "accumulators must share a pairing and a group.");
+			return -1;
+		}
+		return 2;
+	}
+	PyErr_SetString(PyExc_TypeError, "expected Element or PointAccumulator, got something else.");
+	return -1;
+}
+
+// adds or subtracts an Element or PointAccumulator; the caller holds the
+// critical sections on both
+static int accumulator_add(PointAccumulator *self, PyObject *op, int negate) {
+	int kind = accumulator_operand(self, op);
+	if (kind == 1) {
+		element_ptr e = ((Element *)op)->pbc_element;
+		if (!element_is0(e)) {
+			jacobian_add(&self->ctx, &self->sum, element_x(e), element_y(e), NULL, negate);
+		}
+	} else if (kind == 2) {
+		jacobian_point *Q = &((PointAccumulator *)op)->sum;
+		jacobian_add(&self->ctx, &self->sum, Q->X, Q->Y, Q->Z, negate);
+	}
+	return kind < 0 ? -1 : 0;
+}
+
+// PointAccumulator(pairing, group, start=None) -> PointAccumulator
+int PointAccumulator_init(PointAccumulator *self, PyObject *args, PyObject *kwargs) {
+	PyObject *pypairing;
+	int group;
+	PyObject *start = NULL;
+	char *keys[] = {"pairing", "group", "start", NULL};
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "Oi|O", keys, &pypairing, &group, &start)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return -1;
+	}
+
+	// check the type of arguments
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return -1;
+	}
+	if(!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return -1;
+	}
+	if (group != G1 && group != G2) {
+		PyErr_SetString(PyExc_ValueError, "PointAccumulator only works in G1 and G2.");
+		return -1;
+	}
+	if (start == Py_None) {
+		start = NULL;
+	}
+	if (start != NULL && !PyObject_TypeCheck(start, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return -1;
+	}
+
+	// set up the coordinates and scratch space over the curve's base field
+	Pairing *pairing = (Pairing *)pypairing;
+	field_ptr f = coordinate_field(pairing, group);
+	int ret = 0;
+	Py_INCREF(pypairing);
+	Py_BEGIN_CRITICAL_SECTION(self);
+	if (self->ready) {
+		PointAccumulator_clear_elements(self);
+	}
+	jacobian_init(&self->sum, f);
+	jacobian_init(&self->scaled, f);
+	jacobian_ctx_init(&self->ctx, f, curve_field_a_coeff(group == G1 ? pairing->pbc_pairing->G1 : pairing->pbc_pairing->G2));
+	Py_XSETREF(self->pairing, pypairing);
+	self->group = group;
+	self->ready = 1;
+
+	// take the starting point if we were given one
+	if (start != NULL) {
+		ret = accumulator_add(self, start, 0);
+	}
+	Py_END_CRITICAL_SECTION();
+	return ret;
+}
+
+// deallocates the object when done
+void PointAccumulator_dealloc(PointAccumulator *self) {
+	if (self->ready) {
+		PointAccumulator_clear_elements(self);
+	}
+	Py_XDECREF(self->pairing);
+	// free the object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(self);
+	type->tp_free((PyObject*)self);
+	Py_DECREF(type);
+}
+
+// acc.add(P) -> None
+PyObject *PointAccumulator_add(PointAccumulator *self, PyObject *op) {
+	int ret;
+	Py_BEGIN_CRITICAL_SECTION2(self, op);
+	ret = accumulator_add(self, op, 0);
+	Py_END_CRITICAL_SECTION2();
+	if (ret < 0) {
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+// acc.sub(P) -> None
+PyObject *PointAccumulator_sub(PointAccumulator *self, PyObject *op) {
+	int ret;
+	Py_BEGIN_CRITICAL_SECTION2(self, op);
+	ret = accumulator_add(self, op, 1);
+	Py_END_CRITICAL_SECTION2();
+	if (ret < 0) {
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+// acc.double() -> None
+PyObject *PointAccumulator_double(PointAccumulator *self, PyObject *unused) {
+	int ready;
+	Py_BEGIN_CRITICAL_SECTION(self);
+	ready = self->ready;
+	if (ready) {
+		jacobian_double(&self->ctx, &self->sum);
+	}
+	Py_END_CRITICAL_SECTION();
+	if (!ready) {
+		PyErr_SetString(PyExc_ValueError, "PointAccumulator has not been initialised.");
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+// acc.add_scaled(P, k) -> None
+PyObject *PointAccumulator_add_scaled(PointAccumulator *self, PyObject *args) {
+	PyObject *point, *k;
+	if (!PyArg_ParseTuple(args, "OO", &point, &k)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(point, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return NULL;
+	}
+
+	// get k as an integer, and move its sign onto the point
+	mpz_t m;
+	if (PyLong_Check(k)) {
+		if (pynum_to_mpz(k, m) < 0) {
+			mpz_clear(m);
+			return NULL;
+		}
+	} else if (PyObject_TypeCheck(k, state->ElementType) && ((Element *)k)->group == Zr) {
+		mpz_init(m);
+		element_to_mpz(m, ((Element *)k)->pbc_element);
+	} else {
+		PyErr_SetString(PyExc_TypeError, "k must be an integer or an element of Zr.");
+		return NULL;
+	}
+	int negate = mpz_sgn(m) < 0;
+	mpz_abs(m, m);
+
+	int kind;
+	Py_BEGIN_CRITICAL_SECTION(self);
+	kind = accumulator_operand(self, point);
+	element_ptr e = ((Element *)point)->pbc_element;
+	if (kind == 1 && !element_is0(e)) {
+		jacobian_add_scaled(self, element_x(e), element_y(e), m, negate);
+	}
+	Py_END_CRITICAL_SECTION();
+	mpz_clear(m);
+	if (kind < 0) {
+		return NULL;
+	}
+	Py_RETURN_NONE;
+}
+
+// acc.result() -> Element
+PyObject *PointAccumulator_result(PointAccumulator *self, PyObject *unused) {
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	Element *e = Element_create(state);
+	if (e == NULL) {
+		return NULL;
+	}
+	int ret;
+	Py_BEGIN_CRITICAL_SECTION(self);
+	if (!self->ready) {
+		PyErr_SetString(PyExc_ValueError, "PointAccumulator has not been initialised.");
+		ret = -1;
+	} else {
+		ret = Element_init_group(e, self->pairing, self->group);
+		if (ret == 0 && jacobian_store(e->pbc_element, &self->sum, NULL, self->ctx.t) < 0) {
+			PyErr_NoMemory();
+			ret = -1;
+		}
+	}
+	Py_END_CRITICAL_SECTION();
+	if (ret < 0) {
+		Py_DECREF(e);
+		return NULL;
+	}
+	return (PyObject *)e;
+}
+
+PyDoc_STRVAR(PointAccumulator_results__doc__,
+"PointAccumulator.results(accumulators) -> list of Elements\n\n\
+The result() of every accumulator in the sequence, which must all share a\n\
+pairing and a group. The conversions back to affine coordinates share one\n\
+field inversion between them (Montgomery's trick) instead of paying for\n\
+one each.");
+PyObject *PointAccumulator_results(PyObject *cls, PyObject *accumulators) {
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)cls);
+	if (state == NULL) {
+		return NULL;
+	}
+	PyObject *seq = PySequence_Fast(accumulators, "accumulators must be iterable.");
+	if (seq == NULL) {
+		return NULL;
+	}
+	Py_ssize_t n = PySequence_Fast_GET_SIZE(seq), i;
+	PyObject **items = PySequence_Fast_ITEMS(seq);
+	PyObject *pypairing = NULL;
+	enum Group group = G1;
+	int bad = 0;
+
+	// everything has to match the first accumulator
+	for (i = 0; i < n && !bad; i++) {
+		if (!PyObject_TypeCheck(items[i], state->PointAccumulatorType)) {
+			Py_DECREF(seq);
+			Py_XDECREF(pypairing);
+			PyErr_SetString(PyExc_TypeError, "expected PointAccumulator, got something else.");
+			return NULL;
+		}
+		PointAccumulator *acc = (PointAccumulator *)items[i];
+		Py_BEGIN_CRITICAL_SECTION(acc);
+		if (!acc->ready) {
+			bad = 1;
+		} else if (i == 0) {
+			pypairing = acc->pairing;
+			Py_INCREF(pypairing);
+			group = acc->group;
+		} else if (acc->pairing != pypairing || acc->group != group) {
+			bad = 1;
+		}
+		Py_END_CRITICAL_SECTION();
+	}
+	if (bad || n == 0) {
+		Py_DECREF(seq);
+		Py_XDECREF(pypairing);
+		if (bad) {
+			PyErr_SetString(PyExc_ValueError, "accumulators must be initialised and share a pairing and a group.");
+			return NULL;
+		}
+		return PyList_New(0);
+	}
+
+	// build all of the output elements up front
+	PyObject *result = PyList_New(n);
+	if (result == NULL) {
+		Py_DECREF(seq);
+		Py_DECREF(pypairing);
+		return NULL;
+	}
+	for (i = 0; i < n; i++) {
+		Element *e = Element_create(state);
+		if (e == NULL) {
+			goto error;
+		}
+		PyList_SET_ITEM(result, i, (PyObject *)e);
+		if (Element_init_group(e, pypairing, group) < 0) {
+			goto error;
+		}
+	}
+
+	// take a copy of every sum, so that none of them has to stay locked
+	field_ptr f = coordinate_field((Pairing *)pypairing, group);
+	jacobian_point *points = PyMem_Calloc(n, sizeof(jacobian_point));
+	element_t *prefix = PyMem_Calloc(n, sizeof(element_t));
+	if (points == NULL || prefix == NULL) {
+		PyMem_Free(points);
+		PyMem_Free(prefix);
+		PyErr_NoMemory();
+		goto error;
+	}
+	element_t t[4], zinv;
+	for (i = 0; i < 4; i++) {
+		element_init(t[i], f);
+	}
+	element_init(zinv, f);
+	for (i = 0; i < n; i++) {
+		PointAccumulator *acc = (PointAccumulator *)items[i];
+		jacobian_init(&points[i], f);
+		element_init(prefix[i], f);
+		Py_BEGIN_CRITICAL_SECTION(acc);
+		// it could have been re-initialised since we checked
+		if (acc->pairing != pypairing || acc->group != group) {
+			bad = 1;
+		} else {
+			element_set(points[i].X, acc->sum.X);
+			element_set(points[i].Y, acc->sum.Y);
+			element_set(points[i].Z, acc->sum.Z);
+		}
+		Py_END_CRITICAL_SECTION();
+	}
+
+	// prefix[i] is the product of every non-zero Z up to and including i
+	element_set1(t[3]);
+	for (i = 0; i < n && !bad; i++) {
+		if (!element_is0(points[i].Z)) {
+			element_mul(t[3], t[3], points[i].Z);
+		}
+		element_set(prefix[i], t[3]);
+	}
+
+	// invert the lot once, then peel the inverses off from the end: while
+	// working on i, t[3] holds 1/prefix[i]
+	if (!bad) {
+		element_invert(t[3], t[3]);
+	}
+	for (i = n - 1; i >= 0 && !bad; i--) {
+		element_ptr out = ((Element *)PyList_GET_ITEM(result, i))->pbc_element;
+		if (element_is0(points[i].Z)) {
+			element_set0(out);
+			continue;
+		}
+		if (i > 0) {
+			element_mul(zinv, t[3], prefix[i - 1]);
+		} else {
+			element_set(zinv, t[3]);
+		}
+		element_mul(t[3], t[3], points[i].Z);
+		// jacobian_store leaves t[3] alone when given zinv
+		if (jacobian_store(out, &points[i], zinv, t) < 0) {
+			bad = 2;
+		}
+	}
+
+	// clean up
+	for (i = 0; i < n; i++) {
+		jacobian_clear(&points[i]);
+		element_clear(prefix[i]);
+	}
+	for (i = 0; i < 4; i++) {
+		element_clear(t[i]);
+	}
+	element_clear(zinv);
+	PyMem_Free(points);
+	PyMem_Free(prefix);
+	if (bad == 1) {
+		PyErr_SetString(PyExc_ValueError, "accumulators must be initialised and share a pairing and a group.");
+	} else if (bad == 2) {
+		PyErr_NoMemory();
+	}
+	if (bad) {
+		goto error;
+	}
+	Py_DECREF(seq);
+	Py_DECREF(pypairing);
+	return result;
+
+error:
+	Py_DECREF(seq);
+	Py_DECREF(pypairing);
+	Py_DECREF(result);
+	return NULL;
+}
+
+PyMemberDef PointAccumulator_members[] = {
+	{"pairing", T_OBJECT, offsetof(PointAccumulator, pairing), READONLY, "The Pairing of the accumulated points."},
+	{"group", T_INT, offsetof(PointAccumulator, group), READONLY, "The group of the accumulated points."},
+	{NULL}
+};
+
+PyMethodDef PointAccumulator_methods[] = {
+	{"add", (PyCFunction)PointAccumulator_add, METH_O, "Adds an Element or another PointAccumulator."},
+	{"sub", (PyCFunction)PointAccumulator_sub, METH_O, "Subtracts an Element or another PointAccumulator."},
+	{"double", (PyCFunction)PointAccumulator_double, METH_NOARGS, "Doubles the sum."},
+	{"add_scaled", (PyCFunction)PointAccumulator_add_scaled, METH_VARARGS, "Adds k times an Element."},
+	{"result", (PyCFunction)PointAccumulator_result, METH_NOARGS, "Returns the sum as an Element."},
+	{"results", (PyCFunction)PointAccumulator_results, METH_O | METH_CLASS, PointAccumulator_results__doc__},
+	{NULL, NULL}
+};
+
+PyType_Slot PointAccumulator_slots[] = {
+	{Py_tp_dealloc, PointAccumulator_dealloc},
+	{Py_tp_doc, (void *)PointAccumulator__doc__},
+	{Py_tp_methods, PointAccumulator_methods},
+	{Py_tp_members, PointAccumulator_members},
+	{Py_tp_init, PointAccumulator_init},
+	{Py_tp_new, PointAccumulator_new},
+	{0, NULL}
+};
+
+PyType_Spec PointAccumulator_spec = {
+	"pypbc.PointAccumulator",
+	sizeof(PointAccumulator),
+	0,
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+	PointAccumulator_slots
+};
+
+/*******************************************************************************
+*						PowTable							      *
+*******************************************************************************/
+
+PyDoc_STRVAR(PowTable__doc__,
+"PowTable(base, window=4) -> PowTable object\n\n\
+A fixed-base table for raising one element of G1, G2 or GT to many powers.\n\
+It holds base^(d * 2^(window * i)) for every window-bit digit d and window\n\
+position i, so table.pow(k) is a product of one entry per window of k, with\n\
+no squarings at all. A bigger window means fewer products and a table\n\
+2^window / window times the size.\n\
+\n\
+The table is one block of bytes with no pointers in it, which the object\n\
+exports read-only through the buffer protocol. Copy it into a\n\
+multiprocessing.shared_memory block or a file, and other processes can\n\
+attach to it with PowTable.from_buffer(pairing, buf) without building or\n\
+copying it, so N workers on a host share a single copy.\n\
+\n\
+table.pow(k) -> base^k, for an integer or Zr element k.\n\
+PowTable.from_buffer(pairing, data) -> a table using data in place.");
+
+// FNV-1a of the parameters' text form, which ties a table to its pairing
+static int pow_table_fingerprint(Pairing *pairing, uint64_t *out) {
+	PyObject *text = PyObject_Str(pairing->parameters);
+	if (text == NULL) {
+		return -1;
+	}
+	Py_ssize_t len, i;
+	const char *s = PyUnicode_AsUTF8AndSize(text, &len);
+	if (s == NULL) {
+		Py_DECREF(text);
+		return -1;
+	}
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (i = 0; i < len; i++) {
+		h = (h ^ (unsigned char)s[i]) * 0x100000001b3ULL;
+	}
+	Py_DECREF(text);
+	*out = h;
+	return 0;
+}
+
+// where the entry for digit d of window i starts
+static unsigned char *pow_table_entry(PowTable *self, int i, int d) {
+	return self->data + sizeof(pow_table_header) + ((size_t)i * ((1u << self->window) - 1) + d - 1) * self->entry_size;
+}
+
+// fills in the entries after the header from base; needs no GIL
+static void pow_table_build(PowTable *self, element_ptr base) {
+	element_t g, e;
+	element_init_same_as(g, base);
+	element_init_same_as(e, base);
+	element_set(g, base);
+	int n = 1 << self->window;
+	for (int i = 0; i < self->windows; i++) {
+		// g is base^(2^(window * i)), and e runs through its multiples
+		element_set(e, g);
+		for (int d = 1; d < n; d++) {
+			if (d > 1) {
+				element_mul(e, e, g);
+			}
+			element_encode(pow_table_entry(self, i, d), e, self->group, 0);
+		}
+		element_mul(g, e, g);
+	}
+	element_clear(e);
+	element_clear(g);
+}
+
+// the Element the table was built for, from its first entry
+static Element *pow_table_base(pypbc_state *state, PowTable *self) {
+	Element *base = Element_create(state);
+	if (base == NULL || Element_init_group(base, self->pairing, self->group) < 0) {
+		Py_XDECREF(base);
+		return NULL;
+	}
+	element_decode(base->pbc_element, self->group, pow_table_entry(self, 0, 1), self->entry_size, 0);
+	return base;
+}
+
+// whether the table's last window starts at base^(2^(window * (windows - 1)));
+// needs no GIL
+static int pow_table_check(PowTable *self, element_ptr base) {
+	element_t expected, entry;
+	element_init_same_as(expected, base);
+	element_init_same_as(entry, base);
+	mpz_t k;
+	mpz_init(k);
+	mpz_setbit(k, (mp_bitcnt_t)self->window * (self->windows - 1));
+	element_pow_mpz(expected, base, k);
+	element_decode(entry, self->group, pow_table_entry(self, self->windows - 1, 1), self->entry_size, 0);
+	int ok = !element_cmp(expected, entry);
+	mpz_clear(k);
+	element_clear(entry);
+	element_clear(expected);
+	return ok;
+}
+
+// the number of windows needed to cover every exponent below the order
+static int pow_table_windows(Pairing *pairing, int window) {
+	int bits = (int)mpz_sizeinbase(pairing->pbc_pairing->r, 2);
+	return (bits + window - 1) / window;
+}
+
+static size_t pow_table_size(int window, int windows, int entry_size) {
+	return sizeof(pow_table_header) + (size_t)windows * ((1u << window) - 1) * entry_size;
+}
+
+PyObject *PowTable_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"base", "window", NULL};
+	PyObject *pybase;
+	int window = 4;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", keys, &pybase, &window)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	pypbc_state *state = pypbc_state_from_type(type);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(pybase, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return NULL;
+	}
+	Element *base = (Element *)pybase;
+	if (base->group != G1 && base->group != G2 && base->group != GT) {
+		PyErr_SetString(PyExc_ValueError, "PowTable only works in G1, G2 and GT.");
+		return NULL;
+	}
+	if (window < 1 || window > POW_TABLE_MAX_WINDOW) {
+		PyErr_Format(PyExc_ValueError, "window must be between 1 and %d.", POW_TABLE_MAX_WINDOW);
+		return NULL;
+	}
+	Pairing *pairing = (Pairing *)base->pairing;
+	int entry_size = element_encoded_length(base->pbc_element, base->group, 0);
+	uint64_t fingerprint;
+	if (entry_size < 0 || pow_table_fingerprint(pairing, &fingerprint) < 0) {
+		return NULL;
+	}
+
+	PowTable *self = (PowTable *)type->tp_alloc(type, 0);
+	if (self == NULL) {
+		return NULL;
+	}
+	self->window = window;
+	self->windows = pow_table_windows(pairing, window);
+	self->entry_size = entry_size;
+	self->size = pow_table_size(window, self->windows, entry_size);
+	self->data = PyMem_Calloc(1, self->size);
+	if (self->data == NULL) {
+		Py_DECREF(self);
+		return PyErr_NoMemory();
+	}
+	Py_INCREF(base->pairing);
+	self->pairing = base->pairing;
+	self->group = base->group;
+	Py_INCREF(pybase);
+	self->base = pybase;
+
+	pow_table_header header = {PYPBC_POW_TABLE_MAGIC, POW_TABLE_VERSION, self->group, window, self->windows, entry_size, 0, fingerprint};
+	memcpy(self->data, &header, sizeof(header));
+	Py_BEGIN_ALLOW_THREADS
+	pow_table_build(self, base->pbc_element);
+	Py_END_ALLOW_THREADS
+	return (PyObject *)self;
+}
+
+PyDoc_STRVAR(PowTable_from_buffer__doc__,
+"PowTable.from_buffer(pairing, data) -> PowTable\n\n\
+Uses a table some PowTable exported, in place: data is any contiguous\n\
+bytes-like object starting with it, such as the buf of a\n\
+multiprocessing.shared_memory.SharedMemory or an mmap of a file. Nothing\n\
+is copied and the table is only read, and data stays exported (so a\n\
+SharedMemory can't be closed) until the PowTable is gone. The table has to\n\
+have been built for the same parameters, on a host of the same byte order.");
+PyObject *PowTable_from_buffer(PyObject *cls, PyObject *args) {
+	PyObject *pypairing;
+	PyObject *source;
+	if (!PyArg_ParseTuple(args, "OO", &pypairing, &source)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	pypbc_state *state = pypbc_state_from_type((PyTypeObject *)cls);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (!PyObject_TypeCheck(pypairing, state->PairingType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+		return NULL;
+	}
+	Pairing *pairing = (Pairing *)pypairing;
+	if (!pairing->ready) {
+		PyErr_SetString(PyExc_ValueError, "Pairing has not been initialised.");
+		return NULL;
+	}
+	uint64_t fingerprint;
+	if (pow_table_fingerprint(pairing, &fingerprint) < 0) {
+		return NULL;
+	}
+
+	Py_buffer view;
+	if (PyObject_GetBuffer(source, &view, PyBUF_SIMPLE) < 0) {
+		return NULL;
+	}
+	// the header may sit anywhere, so it's copied out rather than cast
+	pow_table_header header;
+	const char *problem = NULL;
+	if ((size_t)view.len < sizeof(header)) {
+		problem = "data is too short to hold a PowTable.";
+	} else {
+		memcpy(&header, view.buf, sizeof(header));
+		if (memcmp(header.magic, PYPBC_POW_TABLE_MAGIC, sizeof(header.magic)) != 0) {
+			problem = "data does not hold a PowTable.";
+		} else if (header.version != POW_TABLE_VERSION) {
+			problem = "the PowTable is of another version or byte order.";
+		} else if (header.fingerprint != fingerprint) {
+			problem = "the PowTable was built for other parameters.";
+		} else if ((header.group != G1 && header.group != G2 && header.group != GT) ||
+				header.window < 1 || header.window > POW_TABLE_MAX_WINDOW ||
+				(int)header.windows != pow_table_windows(pairing, header.window) ||
+				(int)header.entry_size != group_encoded_length(pypairing, header.group, 0)) {
+			problem = "the PowTable's header is corrupt.";
+		} else if ((size_t)view.len < pow_table_size(header.window, header.windows, header.entry_size)) {
+			problem = "data is too short to hold the whole PowTable.";
+		}
+	}
+	if (problem != NULL) {
+		PyBuffer_Release(&view);
+		PyErr_SetString(PyExc_ValueError, problem);
+		return NULL;
+	}
+
+	PowTable *self = (PowTable *)((PyTypeObject *)cls)->tp_alloc((PyTypeObject *)cls, 0);
+	if (self == NULL) {
+		PyBuffer_Release(&view);
+		return NULL;
+	}
+	// the view is ours now, and goes with the table
+	self->source = view;
+	self->attached = 1;
+	self->data = view.buf;
+	self->size = pow_table_size(header.window, header.windows, header.entry_size);
+	Py_INCREF(pypairing);
+	self->pairing = pypairing;
+	self->group = header.group;
+	self->window = header.window;
+	self->windows = header.windows;
+	self->entry_size = header.entry_size;
+	self->base = (PyObject *)pow_table_base(state, self);
+	if (self->base == NULL) {
+		Py_DECREF(self);
+		return NULL;
+	}
+	// the header says nothing about the entries, so check the last window
+	// against the base the first one starts with, which catches a table
+	// that was cut short or shifted
+	int consistent;
+	Py_BEGIN_ALLOW_THREADS
+	consistent = pow_table_check(self, ((Element *)self->base)->pbc_element);
+	Py_END_ALLOW_THREADS
+	if (!consistent) {
+		Py_DECREF(self);
+		PyErr_SetString(PyExc_ValueError, "the PowTable's entries don't match its base.");
+		return NULL;
+	}
+	return (PyObject *)self;
+}
+
+// deallocates the object when done
+void PowTable_dealloc(PowTable *self) {
+	if (self->attached) {
+		PyBuffer_Release(&self->source);
+	} else {
+		PyMem_Free(self->data);
+	}
+	Py_XDECREF(self->base);
+	Py_XDECREF(self->pairing);
+	// free the object, and let go of our heap type
+	PyTypeObject *type = Py_TYPE(self);
+	type->tp_free((PyObject*)self);
+	Py_DECREF(type);
+}
+
+// exports the table as read-only bytes
+static int PowTable_getbuffer(PowTable *self, Py_buffer *view, int flags) {
+	return PyBuffer_FillInfo(view, (PyObject *)self, self->data, self->size, 1, flags);
+}
+
+// len(table) -> the size of the table in bytes
+static Py_ssize_t PowTable_len(PowTable *self) {
+	return self->size;
+}
+
+// table.__sizeof__() -> int, counting the table unless it's someone else's
+PyObject *PowTable_sizeof(PowTable *self, PyObject *unused) {
+	return PyLong_FromSsize_t(Py_TYPE(self)->tp_basicsize + (self->attached ? 0 : self->size));
+}
+
+// table.pow(k) -> Element
+PyObject *PowTable_pow(PowTable *self, PyObject *exponent) {
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	Pairing *pairing = (Pairing *)self->pairing;
+	mpz_t k;
+	if (PyLong_Check(exponent)) {
+		if (pynum_to_mpz(exponent, k) < 0) {
+			mpz_clear(k);
+			return NULL;
+		}
+	} else if (PyObject_TypeCheck(exponent, state->ElementType) && ((Element *)exponent)->group == Zr) {
+		mpz_init(k);
+		element_to_mpz(k, ((Element *)exponent)->pbc_element);
+	} else {
+		PyErr_SetString(PyExc_TypeError, "exponent must be an integer or an element of Zr.");
+		return NULL;
+	}
+	// the order is the base's, so this loses nothing and makes k fit
+	mpz_mod(k, k, pairing->pbc_pairing->r);
+
+	Element *out = Element_create(state);
+	if (out == NULL || Element_init_group(out, self->pairing, self->group) < 0) {
+		Py_XDECREF(out);
+		mpz_clear(k);
+		return NULL;
+	}
+	uint64_t start = stats_begin();
+	Py_BEGIN_ALLOW_THREADS
+	element_t entry;
+	element_init_same_as(entry, out->pbc_element);
+	element_set1(out->pbc_element);
+	for (int i = 0; i < self->windows; i++) {
+		int d = 0;
+		for (int j = self->window - 1; j >= 0; j--) {
+			d = (d << 1) | mpz_tstbit(k, (mp_bitcnt_t)i * self->window + j);
+		}
+		if (d) {
+			element_decode(entry, self->group, pow_table_entry(self, i, d), self->entry_size, 0);
+			element_mul(out->pbc_element, out->pbc_element, entry);
+		}
+	}
+	element_clear(entry);
+	Py_END_ALLOW_THREADS
+	stats_end(STAT_POW, out, self->base, exponent, start);
+	mpz_clear(k);
+	return (PyObject *)out;
+}
+
+PyMemberDef PowTable_members[] = {
+	{"pairing", T_OBJECT, offsetof(PowTable, pairing), READONLY, "The Pairing of the base."},
+	{"group", T_INT, offsetof(PowTable, group), READONLY, "The group of the base."},
+	{"base", T_OBJECT, offsetof(PowTable, base), READONLY, "The Element the table raises to powers."},
+	{"window", T_INT, offsetof(PowTable, window), READONLY, "The bits of the exponent each entry covers."},
+	{"attached", T_INT, offsetof(PowTable, attached), READONLY, "True if the table is in another object's buffer."},
+	{NULL}
+};
+
+PyMethodDef PowTable_methods[] = {
+	{"pow", (PyCFunction)PowTable_pow, METH_O, "Raises the base to a power: an integer or an element of Zr."},
+	{"from_buffer", (PyCFunction)PowTable_from_buffer, METH_VARARGS | METH_CLASS, PowTable_from_buffer__doc__},
+	{"__sizeof__", (PyCFunction)PowTable_sizeof, METH_NOARGS, "returns the size of the object and, unless attached, of its table."},
+	{NULL, NULL}
+};
+
+PyType_Slot PowTable_slots[] = {
+	{Py_tp_dealloc, PowTable_dealloc},
+	{Py_tp_doc, (void *)PowTable__doc__},
+	{Py_tp_methods, PowTable_methods},
+	{Py_tp_members, PowTable_members},
+	{Py_tp_new, PowTable_new},
+	{Py_bf_getbuffer, PowTable_getbuffer},
+	{Py_sq_length, PowTable_len},
+	{0, NULL}
+};
+
+PyType_Spec PowTable_spec = {
+	"pypbc.PowTable",
+	sizeof(PowTable),
+	0,
+	Py_TPFLAGS_DEFAULT,
+	PowTable_slots
+};
+
+/*******************************************************************************
+*						GLV							      *
+*******************************************************************************/
+
+// The GLV method splits k*P into k1*P + k2*phi(P), where k1 and k2 are
+// about half as long as k, and works both out in one pass so that they
+// share their doublings. It needs phi to be an endomorphism that is cheap to
+// compute and multiplies the group by some lambda. Curves y^2 = x^3 + b over
+// Fq with q = 1 (mod 3), like type F, have one: phi(x, y) = (beta x, y),
+// for beta a cube root of unity.
+//
+// Type A has nothing to offer. y^2 = x^3 + x over Fq with q = 3 (mod 4) is
+// supersingular, and its one cheap endomorphism, (x, y) -> (-x, iy), needs
+// i from Fq^2: it's the distortion map the pairing itself uses, and takes
+// points out of E(Fq) altogether.
+
+// the width of the NAF digits, so that the tables hold 2^(w-2) points
+#define GLV_WINDOW 4
+
+// the width-w NAF of k >= 0, least significant digit first: every digit is
+// zero or odd and below 2^(w-1) in size, and of any w consecutive digits at
+// most one is non-zero. Returns the number of digits, at most bits(k) + 1.
+static int wnaf_recode(signed char *digits, mpz_t k, int w) {
+	mpz_t t;
+	mpz_init_set(t, k);
+	int n = 0;
+	while (mpz_sgn(t) > 0) {
+		int d = 0;
+		if (mpz_odd_p(t)) {
+			d = (int)mpz_fdiv_ui(t, 1 << w);
+			if (d >= 1 << (w - 1)) {
+				d -= 1 << w;
+			}
+			if (d > 0) {
+				mpz_sub_ui(t, t, d);
+			} else {
+				mpz_add_ui(t, t, -d);
+			}
+		}
+		digits[n++] = (signed char)d;
+		mpz_fdiv_q_2exp(t, t, 1);
+	}
+	mpz_clear(t);
+	return n;
+}
+
+// out = k*base, as k1*base + k2*phi(base); base must have order r. Needs
+// no GIL, and returns -1 if it runs out of memory, without setting an
+// exception.
+int element_pow_glv(element_ptr out, element_ptr base, mpz_t k, mpz_t r, glv_data *g) {
+	int i, j, ret = 0;
+	if (element_is0(base)) {
+		element_set0(out);
+		return 0;
+	}
+
+	// split k mod r into k1 + k2 lambda, rounding it onto the lattice:
+	// c1 = round(b2 k / r), c2 = round(-b1 k / r),
+	// k1 = k - c1 a1 - c2 a2, k2 = -c1 b1 - c2 b2
+	mpz_t k1, k2, c1, c2, half;
+	mpz_inits(k1, k2, c1, c2, half, NULL);
+	mpz_mod(k1, k, r);
+	mpz_fdiv_q_2exp(half, r, 1);
+	mpz_mul(c1, g->b2, k1);
+	mpz_add(c1, c1, half);
+	mpz_fdiv_q(c1, c1, r);
+	mpz_mul(c2, g->b1, k1);
+	mpz_neg(c2, c2);
+	mpz_add(c2, c2, half);
+	mpz_fdiv_q(c2, c2, r);
+	mpz_submul(k1, c1, g->a1);
+	mpz_submul(k1, c2, g->a2);
+	mpz_set_ui(k2, 0);
+	mpz_submul(k2, c1, g->b1);
+	mpz_submul(k2, c2, g->b2);
+	int neg1 = mpz_sgn(k1) < 0;
+	int neg2 = mpz_sgn(k2) < 0;
+	mpz_abs(k1, k1);
+	mpz_abs(k2, k2);
+
+	// recode both halves
+	size_t len = mpz_sizeinbase(k1, 2) + mpz_sizeinbase(k2, 2) + 2;
+	signed char *d1 = PyMem_RawCalloc(2, len);
+	if (d1 == NULL) {
+		mpz_clears(k1, k2, c1, c2, half, NULL);
+		return -1;
+	}
+	signed char *d2 = d1 + len;
+	int n1 = wnaf_recode(d1, k1, GLV_WINDOW);
+	int n2 = wnaf_recode(d2, k2, GLV_WINDOW);
+
+	// table[j] = (2j + 1) base, and ptable[j] = phi(table[j]), which in
+	// Jacobian coordinates is just (beta X, Y, Z)
+	field_ptr f = element_x(base)->field;
+	jacobian_ctx ctx;
+	jacobian_point table[1 << (GLV_WINDOW - 2)], ptable[1 << (GLV_WINDOW - 2)], twice, acc;
+	jacobian_ctx_init(&ctx, f, curve_field_a_coeff(base->field));
+	jacobian_init(&twice, f);
+	jacobian_init(&acc, f);
+	for (j = 0; j < 1 << (GLV_WINDOW - 2); j++) {
+		jacobian_init(&table[j], f);
+		jacobian_init(&ptable[j], f);
+	}
+	element_set(table[0].X, element_x(base));
+	element_set(table[0].Y, element_y(base));
+	element_set1(table[0].Z);
+	jacobian_add(&ctx, &twice, table[0].X, table[0].Y, table[0].Z, 0);
+	jacobian_double(&ctx, &twice);
+	for (j = 0; j < 1 << (GLV_WINDOW - 2); j++) {
+		if (j > 0) {
+			element_set(table[j].X, table[j - 1].X);
+			element_set(table[j].Y, table[j - 1].Y);
+			element_set(table[j].Z, table[j - 1].Z);
+			jacobian_add(&ctx, &table[j], twice.X, twice.Y, twice.Z, 0);
+		}
+		element_mul(ptable[j].X, table[j].X, g->beta);
+		element_set(ptable[j].Y, table[j].Y);
+		element_set(ptable[j].Z, table[j].Z);
+	}
+
+	// interleave the two digit strings from the top
+	for (i = (n1 > n2 ? n1 : n2) - 1; i >= 0; i--) {
+		jacobian_double(&ctx, &acc);
+		if (i < n1 && d1[i]) {
+			jacobian_point *T = &table[abs(d1[i]) / 2];
+			jacobian_add(&ctx, &acc, T->X, T->Y, T->Z, (d1[i] < 0) ^ neg1);
+		}
+		if (i < n2 && d2[i]) {
+			jacobian_point *T = &ptable[abs(d2[i]) / 2];
+			jacobian_add(&ctx, &acc, T->X, T->Y, T->Z, (d2[i] < 0) ^ neg2);
+		}
+	}
+	ret = jacobian_store(out, &acc, NULL, ctx.t);
+
+	// clean up
+	for (j = 0; j < 1 << (GLV_WINDOW - 2); j++) {
+		jacobian_clear(&table[j]);
+		jacobian_clear(&ptable[j]);
+	}
+	jacobian_clear(&twice);
+	jacobian_clear(&acc);
+	jacobian_ctx_clear(&ctx);
+	PyMem_RawFree(d1);
+	mpz_clears(k1, k2, c1, c2, half, NULL);
+	return ret;
+}
+
+// a short basis of the pairs (a, b) with a + b lambda = 0 (mod r), from
+// the extended Euclidean algorithm on r and lambda: each remainder r_i
+// has r_i = t_i lambda (mod r), so (r_i, -t_i) is such a pair, and the
+// shortest ones are found where the remainders pass sqrt(r)
+static void glv_basis(glv_data *g, mpz_t r) {
+	mpz_t root, r0, r1, r2, t0, t1, t2, q, n0, n2;
+	mpz_inits(root, r0, r1, r2, t0, t1, t2, q, n0, n2, NULL);
+	mpz_sqrt(root, r);
+	mpz_set(r0, r);
+	mpz_set(r1, g->lambda);
+	mpz_set_ui(t0, 0);
+	mpz_set_ui(t1, 1);
+	// step until r0 is the last remainder at or above sqrt(r)
+	while (mpz_cmp(r1, root) >= 0) {
+		mpz_fdiv_qr(q, r2, r0, r1);
+		mpz_set(t2, t0);
+		mpz_submul(t2, q, t1);
+		mpz_swap(r0, r1);
+		mpz_swap(r1, r2);
+		mpz_swap(t0, t1);
+		mpz_swap(t1, t2);
+	}
+	mpz_init_set(g->a1, r1);
+	mpz_init(g->b1);
+	mpz_neg(g->b1, t1);
+	// the second vector is whichever of its neighbours is shorter
+	mpz_fdiv_qr(q, r2, r0, r1);
+	mpz_set(t2, t0);
+	mpz_submul(t2, q, t1);
+	mpz_mul(n0, r0, r0);
+	mpz_addmul(n0, t0, t0);
+	mpz_mul(n2, r2, r2);
+	mpz_addmul(n2, t2, t2);
+	mpz_init(g->a2);
+	mpz_init(g->b2);
+	if (mpz_cmp(n0, n2) <= 0) {
+		mpz_set(g->a2, r0);
+		mpz_neg(g->b2, t0);
+	} else {
+		mpz_set(g->a2, r2);
+		mpz_neg(g->b2, t2);
+	}
+	mpz_clears(root, r0, r1, r2, t0, t1, t2, q, n0, n2, NULL);
+}
+
+// the first base^((m - 1) / 3) mod m that isn't 1: a cube root of unity
+static void glv_cube_root(mpz_t root, mpz_t m) {
+	mpz_t e;
+	mpz_init(e);
+	mpz_sub_ui(e, m, 1);
+	mpz_divexact_ui(e, e, 3);
+	for (unsigned long base = 2; ; base++) {
+		mpz_set_ui(root, base);
+		mpz_powm(root, root, e, m);
+		if (mpz_cmp_ui(root, 1) != 0) {
+			break;
+		}
+	}
+	mpz_clear(e);
+}
+
+// works out the GLV data for one group of the pairing, leaving g->ready at
+// zero if the group doesn't have the endomorphism. Everything found is
+// checked against PBC's own arithmetic before it's used.
+static void glv_setup(Pairing *pairing, enum Group group, glv_data *g) {
+	pairing_ptr p = pairing->pbc_pairing;
+	g->ready = 0;
+	// the curve has to be y^2 = x^3 + b, and the cube roots of unity have to
+	// be in the prime field under it and in Zr
+	if (!element_is0(curve_field_a_coeff(group == G1 ? p->G1 : p->G2))) {
+		return;
+	}
+	field_ptr fq = coordinate_field(pairing, G1);
+	if (mpz_fdiv_ui(fq->order, 3) != 1 || mpz_fdiv_ui(p->r, 3) != 1) {
+		return;
+	}
+
+	// beta, and the lambda that goes with it: phi multiplies by one of the
+	// two cube roots of unity mod r, so try one on a point, then the other
+	mpz_t beta, k;
+	mpz_inits(beta, k, NULL);
+	glv_cube_root(beta, fq->order);
+	element_init(g->beta, coordinate_field(pairing, group));
+	element_set_mpz(g->beta, beta);
+	mpz_init(g->lambda);
+	glv_cube_root(g->lambda, p->r);
+	element_t P, Q, R;
+	if (group == G1) {
+		element_init_G1(P, p);
+	} else {
+		element_init_G2(P, p);
+	}
+	element_init_same_as(Q, P);
+	element_init_same_as(R, P);
+	element_from_hash(P, "pypbc glv", 9);
+	element_set(Q, P);
+	element_mul(element_x(Q), element_x(Q), g->beta);
+	element_pow_mpz(R, P, g->lambda);
+	if (element_cmp(Q, R)) {
+		mpz_mul(g->lambda, g->lambda, g->lambda);
+		mpz_mod(g->lambda, g->lambda, p->r);
+		element_pow_mpz(R, P, g->lambda);
+	}
+	int ok = !element_is0(P) && !element_cmp(Q, R);
+
+	// then the basis, and one multiplication done both ways
+	glv_basis(g, p->r);
+	if (ok) {
+		mpz_sub_ui(k, p->r, 2);
+		element_pow_mpz(Q, P, k);
+		ok = element_pow_glv(R, P, k, p->r, g) == 0 && !element_cmp(Q, R);
+	}
+	element_clear(P);
+	element_clear(Q);
+	element_clear(R);
+	mpz_clears(beta, k, NULL);
+	if (!ok) {
+		element_clear(g->beta);
+		mpz_clears(g->lambda, g->a1, g->b1, g->a2, g->b2, NULL);
+		return;
+	}
+	g->ready = 1;
+}
+
+// clears whatever glv_setup left behind
+void glv_clear(glv_data *g) {
+	if (g->ready) {
+		element_clear(g->beta);
+		mpz_clears(g->lambda, g->a1, g->b1, g->a2, g->b2, NULL);
+		g->ready = 0;
+	}
+}
+
+// the GLV data for a group, or NULL if it shouldn't be used
+glv_data *pairing_glv(Pairing *pairing, enum Group group) {
+	if ((group != G1 && group != G2) || !__atomic_load_n(&pairing->glv, __ATOMIC_ACQUIRE)) {
+		return NULL;
+	}
+	glv_data *g = &pairing->glv_groups[group == G1 ? 0 : 1];
+	return g->ready ? g : NULL;
+}
+
+// pairing.set_glv(enabled) -> bool
+// switches the GLV method for element**k and element*k in G1 and G2 on or
+// off; it is off by default. Returns whether it is now in use for at least
+// one group, which is never the case for types A and A1.
+PyObject *Pairing_set_glv(Pairing *self, PyObject *args) {
+	int enabled;
+	if (!PyArg_ParseTuple(args, "p", &enabled)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	if (!self->ready) {
+		PyErr_SetString(PyExc_ValueError, "Pairing has not been initialised.");
+		return NULL;
+	}
+
+	// work out what we can do the first time we're asked
+	int on;
+	Py_BEGIN_CRITICAL_SECTION(self);
+	if (!self->glv_checked) {
+		long long before = native_thread_bytes;
+		glv_setup(self, G1, &self->glv_groups[0]);
+		glv_setup(self, G2, &self->glv_groups[1]);
+		__atomic_fetch_add(&self->native_size, native_thread_bytes - before, __ATOMIC_RELAXED);
+		self->glv_checked = 1;
+	}
+	on = enabled && (self->glv_groups[0].ready || self->glv_groups[1].ready);
+	__atomic_store_n(&self->glv, on, __ATOMIC_RELEASE);
+	Py_END_CRITICAL_SECTION();
+	return PyBool_FromLong(on);
+}
+
+/*******************************************************************************
+*						Exponentiation							      *
+*******************************************************************************/
+
+// PBC raises everything to a power with one general-purpose method. These
+// are the alternatives a Pairing can be set to use instead, per group. They
+// only use PBC's group operations, so they work in every group, and in G1
+// and G2, where PBC writes the group multiplicatively, a "square" is a point
+// doubling and an inversion is a negation. That last is what makes wNAF pay
+// off on curves, while in GT an inversion costs about as much as the
+// multiplications it saves.
+
+static const char *pow_method_names[] = {"pbc", "fixed", "sliding", "wnaf", "cyclotomic"};
+
+// a window width that suits an exponent of the given length
+static int pow_default_window(size_t bits) {
+	if (bits <= 32) return 2;
+	if (bits <= 128) return 3;
+	if (bits <= 256) return 4;
+	if (bits <= 768) return 5;
+	return 6;
+}
+
+// table[j] = base^(2j + 1) for j < n
+static void pow_odd_powers(element_t *table, element_ptr base, int n) {
+	element_t square;
+	element_init_same_as(square, base);
+	element_square(square, base);
+	for (int j = 0; j < n; j++) {
+		element_init_same_as(table[j], base);
+		if (j == 0) {
+			element_set(table[j], base);
+		} else {
+			element_mul(table[j], table[j - 1], square);
+		}
+	}
+	element_clear(square);
+}
+
+// out = base^k for k >= 0, w bits at a time from a table of every power
+// below 2^w
+static void pow_fixed(element_ptr out, element_ptr base, mpz_t k, int w, element_t *table) {
+	int j, n = 1 << w;
+	for (j = 0; j < n; j++) {
+		element_init_same_as(table[j], base);
+		if (j == 0) {
+			element_set1(table[j]);
+		} else {
+			element_mul(table[j], table[j - 1], base);
+		}
+	}
+	long bits = (long)mpz_sizeinbase(k, 2);
+	element_set1(out);
+	for (long i = ((bits + w - 1) / w) * w - w; i >= 0; i -= w) {
+		int digit = 0;
+		for (j = w - 1; j >= 0; j--) {
+			element_square(out, out);
+			digit = (digit << 1) | mpz_tstbit(k, i + j);
+		}
+		if (digit) {
+			element_mul(out, out, table[digit]);
+		}
+	}
+	for (j = 0; j < n; j++) {
+		element_clear(table[j]);
+	}
+}
+
+// out = base^k for k >= 0, skipping runs of zero bits and taking up to w
+// bits that start and end with a one at a time, from a table of odd powers
+static void pow_sliding(element_ptr out, element_ptr base, mpz_t k, int w, element_t *table) {
+	int j, n = 1 << (w - 1);
+	pow_odd_powers(table, base, n);
+	element_set1(out);
+	long i = (long)mpz_sizeinbase(k, 2) - 1;
+	while (i >= 0) {
+		if (!mpz_tstbit(k, i)) {
+			element_square(out, out);
+			i--;
+			continue;
+		}
+		// the window runs from i down to the lowest one bit within reach
+		long low = i - w + 1 < 0 ? 0 : i - w + 1;
+		while (!mpz_tstbit(k, low)) {
+			low++;
+		}
+		int digit = 0;
+		for (long b = i; b >= low; b--) {
+			element_square(out, out);
+			digit = (digit << 1) | mpz_tstbit(k, b);
+		}
+		element_mul(out, out, table[digit >> 1]);
+		i = low - 1;
+	}
+	for (j = 0; j < n; j++) {
+		element_clear(table[j]);
+	}
+}
+
+// out = base^k for k >= 0 from its width-w NAF, with tables of the odd
+// powers and of their inverses for the negative digits
+static int pow_wnaf(element_ptr out, element_ptr base, mpz_t k, int w, element_t *table) {
+	int j, n = 1 << (w - 2);
+	signed char *digits = PyMem_RawMalloc(mpz_sizeinbase(k, 2) + 1);
+	if (digits == NULL) {
+		return -1;
+	}
+	int count = wnaf_recode(digits, k, w);
+	pow_odd_powers(table, base, n);
+	for (j = 0; j < n; j++) {
+		element_init_same_as(table[n + j], base);
+		element_invert(table[n + j], table[j]);
+	}
+	element_set1(out);
+	for (int i = count - 1; i >= 0; i--) {
+		element_square(out, out);
+		if (digits[i] > 0) {
+			element_mul(out, out, table[digits[i] >> 1]);
+		} else if (digits[i] < 0) {
+			element_mul(out, out, table[n + (-digits[i] >> 1)]);
+		}
+	}
+	for (j = 0; j < 2 * n; j++) {
+		element_clear(table[j]);
+	}
+	PyMem_RawFree(digits);
+	return 0;
+}
+
+// pow_wnaf for a unitary base in GT on type A and A1 curves: its squarings
+// are cyclotomic ones, and the inverses of the odd powers are conjugates
+static int pow_cyclotomic(element_ptr out, element_ptr base, mpz_t k, int w, element_t *table) {
+	int j, n = 1 << (w - 2);
+	signed char *digits = PyMem_RawMalloc(mpz_sizeinbase(k, 2) + 1);
+	if (digits == NULL) {
+		return -1;
+	}
+	int count = wnaf_recode(digits, k, w);
+	pow_odd_powers(table, base, n);
+	for (j = 0; j < n; j++) {
+		element_init_same_as(table[n + j], base);
+		gt_conjugate(table[n + j], table[j]);
+	}
+	element_t t;
+	element_init_same_as(t, element_item(base, 0));
+	element_set1(out);
+	for (int i = count - 1; i >= 0; i--) {
+		gt_square(out, out, t);
+		if (digits[i] > 0) {
+			element_mul(out, out, table[digits[i] >> 1]);
+		} else if (digits[i] < 0) {
+			element_mul(out, out, table[n + (-digits[i] >> 1)]);
+		}
+	}
+	element_clear(t);
+	for (j = 0; j < 2 * n; j++) {
+		element_clear(table[j]);
+	}
+	PyMem_RawFree(digits);
+	return 0;
+}
+
+// out = base^k by the given method; k may be negative. Needs no GIL, and
+// returns -1 if it runs out of memory, without setting an exception.
+static int pow_with(element_ptr out, element_ptr base, mpz_t k, int config) {
+	int method = POW_CONFIG_METHOD(config);
+	// anything outside the cyclotomic subgroup, like the element whose
+	// encoding is all zeroes, is left to PBC
+	if (method == POW_PBC || (method == POW_CYCLOTOMIC && !gt_is_unitary(base))) {
+		element_pow_mpz(out, base, k);
+		return 0;
+	}
+	mpz_t m;
+	mpz_init(m);
+	mpz_abs(m, k);
+	int w = POW_CONFIG_WINDOW(config);
+	if (w == 0) {
+		w = pow_default_window(mpz_sizeinbase(m, 2));
+	}
+	// the tables never need more than 2^w entries; work in a temporary in
+	// case out is base
+	element_t *table = PyMem_RawMalloc(sizeof(element_t) << w);
+	element_t result;
+	if (table == NULL) {
+		mpz_clear(m);
+		return -1;
+	}
+	element_init_same_as(result, base);
+	int ret = 0;
+	switch (method) {
+		case POW_FIXED: pow_fixed(result, base, m, w, table); break;
+		case POW_SLIDING: pow_sliding(result, base, m, w, table); break;
+		case POW_CYCLOTOMIC: ret = pow_cyclotomic(result, base, m, w, table); break;
+		default: ret = pow_wnaf(result, base, m, w, table); break;
+	}
+	if (mpz_sgn(k) < 0) {
+		if (method == POW_CYCLOTOMIC) {
+			gt_conjugate(result, result);
+		} else {
+			element_invert(result, result);
+		}
+	}
+	element_set(out, result);
+	element_clear(result);
+	PyMem_RawFree(table);
+	mpz_clear(m);
+	return ret;
+}
+
+// whether Element_pow should hand base over to element_pow_custom rather
+// than call PBC directly
+int element_pow_is_custom(Element *base) {
+	Pairing *pairing = (Pairing *)base->pairing;
+	if (pairing->nfactors > 0 && (base->group == Zr || base->subgroups != 0)) {
+		return 1;
+	}
+	return pairing_glv(pairing, base->group) != NULL || __atomic_load_n(&pairing->pow_config[base->group], __ATOMIC_RELAXED) != POW_CONFIG(POW_PBC, 0);
+}
+
+// reads what the pairing is set up to do for a power of base and reduces k
+// for it, as element_pow_custom would; needs the GIL
+void pow_plan_init(pow_plan *plan, Element *base, mpz_t k) {
+	Pairing *pairing = (Pairing *)base->pairing;
+	plan->pairing = pairing;
+	plan->glv = NULL;
+	plan->config = POW_CONFIG(POW_PBC, 0);
+	plan->crt = pairing->nfactors > 0 && base->group == Zr && mpz_sgn(k) >= 0;
+	mpz_init_set(plan->k, k);
+	if (plan->crt) {
+		return;
+	}
+	// a power of an element known to lie in some of the subgroups only
+	// needs the exponent modulo their order
+	if (pairing->nfactors > 0 && base->subgroups != 0) {
+		mpz_t order;
+		mpz_init(order);
+		composite_order(order, pairing, base->subgroups);
+		mpz_mod(plan->k, k, order);
+		mpz_clear(order);
+	}
+	plan->glv = pairing_glv(pairing, base->group);
+	plan->config = __atomic_load_n(&pairing->pow_config[base->group], __ATOMIC_RELAXED);
+}
+
+// out = base^k as planned: by the CRT in Zr, by GLV if that was on, else by
+// the group's configured method. Needs no GIL, and returns -1 if it runs
+// out of memory, without setting an exception.
+int pow_plan_run(element_ptr out, element_ptr base, pow_plan *plan) {
+	if (plan->crt) {
+		composite_pow_zr(out, base, plan->k, plan->pairing);
+		return 0;
+	}
+	if (plan->glv != NULL) {
+		return element_pow_glv(out, base, plan->k, plan->pairing->pbc_pairing->r, plan->glv);
+	}
+	return pow_with(out, base, plan->k, plan->config);
+}
+
+void pow_plan_clear(pow_plan *plan) {
+	mpz_clear(plan->k);
+}
+
+// out = base^k, by the CRT in Zr and with k reduced modulo the order of the
+// subgroups base is known to lie in where the pairing has factors, then by
+// GLV or the group's configured method; returns -1 with an exception set
+// on failure
+int element_pow_custom(element_ptr out, Element *base, mpz_t k) {
+	pow_plan plan;
+	pow_plan_init(&plan, base, k);
+	int ret = pow_plan_run(out, base->pbc_element, &plan);
+	pow_plan_clear(&plan);
+	if (ret < 0) {
+		PyErr_NoMemory();
+	}
+	return ret;
+}
+
+// nanoseconds on the monotonic clock
+static long long pow_clock(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// times every method and window on a full-length exponent in each of G1,
+// G2 and GT, and keeps the fastest. Needs no GIL: it only reads the pairing,
+// and each group's choice is swapped in whole.
+void pairing_tune_pow(Pairing *pairing) {
+	pairing_ptr p = pairing->pbc_pairing;
+	element_t base, out, k;
+	mpz_t m;
+	mpz_init(m);
+	element_init_Zr(k, p);
+	element_from_hash(k, "pypbc tune exponent", 19);
+	element_to_mpz(m, k);
+	element_clear(k);
+	for (int group = G1; group <= GT; group++) {
+		switch (group) {
+			case G1: element_init_G1(base, p); break;
+			case G2: element_init_G2(base, p); break;
+			default: element_init_GT(base, p); break;
+		}
+		element_init_same_as(out, base);
+		if (group != GT) {
+			element_from_hash(base, "pypbc tune base", 15);
+		} else {
+			// a pairing output, which is in the subgroup
+			element_t g1, g2;
+			element_init_G1(g1, p);
+			element_init_G2(g2, p);
+			element_from_hash(g1, "pypbc tune base", 15);
+			element_from_hash(g2, "pypbc tune base", 15);
+			pairing_apply(base, g1, g2, p);
+			element_clear(g1);
+			element_clear(g2);
+		}
+		int best = POW_CONFIG(POW_PBC, 0);
+		long long best_time = -1;
+		for (int method = POW_PBC; method <= POW_CYCLOTOMIC; method++) {
+			if (method == POW_CYCLOTOMIC && (group != GT || !pairing->gt_quadratic)) {
+				continue;
+			}
+			for (int w = (method >= POW_WNAF ? 3 : 2); w <= (method == POW_PBC ? 2 : 6); w++) {
+				int config = method == POW_PBC ? POW_CONFIG(POW_PBC, 0) : POW_CONFIG(method, w);
+				// the best of three runs
+				long long time = -1;
+				for (int run = 0; run < 3; run++) {
+					long long start = pow_clock();
+					if (pow_with(out, base, m, config) < 0) {
+						time = -1;
+						break;
 					}
-					str[2+(2*bytesize)] = 0x00;
-					//printf("smushed tuple %s\n", &str[2]);
-					//printf("length = %d, bytesize=%d\n", strlen(&str[2]), bytesize);
-					// unhandled type, fail hard
-					//PyErr_SetString(PyExc_TypeError, "invalid type for argument 'value'");
-					//return -1;
-					for (ii = 0 ; ii < bytesize ; ii++ ) {
-						sscanf(&str[2+(2*ii)], "%2hhx", &byteval[ii]);
+					long long elapsed = pow_clock() - start;
+					if (time < 0 || elapsed < time) {
+						time = elapsed;
 					}
-					//printf("compressed\n");
-					ii = element_from_bytes(self->pbc_element, byteval);
-					// you're ready!
-					self->ready = 1;
-					// we're clear
-					return 0;
-				printf("parsed\n");
-				} else if (strncmp(str, "00", 2) == 0) {
-					// assume EC Point at infinity
-					element_set0(self->pbc_element);
-					self->ready = 1;
-					return 0;
-				} else if (strncmp(str, "02", 2) == 0) {
-					// even EC Point?
-					// printf("even, compressed EC Point\n");
-					bytesize = (s_str >> 1) - 1;
-					byteval[bytesize] = 0x00;
-				} else if (strncmp(str, "03", 2) == 0) {
-					// odd EC Point?
-					// printf("odd, compressed EC Point\n");
-					bytesize = (s_str >> 1) - 1;
-					byteval[bytesize] = 0x01;
-				} else if (strncmp(str, "04", 2) == 0) {
-					// uncompressed EC Point?
-					// printf("uncompressed EC Point"\n);
-					bytesize = ((s_str >> 1) - 1) >> 1;
-					sscanf(&str[s_str - 1], "%2hhx", &byteval[bytesize]);
-					byteval[bytesize] &= 0x01;
 				}
-				for (ii = 0 ; ii < bytesize ; ii++ ) {
-					sscanf(&str[2+(2*ii)], "%2hhx", &byteval[ii]);
+				if (time >= 0 && (best_time < 0 || time < best_time)) {
+					best = config;
+					best_time = time;
 				}
-				ii = element_from_bytes_compressed(self->pbc_element, byteval);
-				// printf("element_from_bytes_compressed returned %d\n", ii);
+			}
+		}
+		__atomic_store_n(&pairing->pow_config[group], best, __ATOMIC_RELAXED);
+		element_clear(out);
+		element_clear(base);
+	}
+	mpz_clear(m);
+}
+
+// pairing.set_pow_method(group, method, window=0) -> None
+// sets how elements of the group are raised to powers: "pbc" (PBC's own),
+// "fixed", "sliding", "wnaf", or for GT on type A and A1 curves "cyclotomic",
+// with a window width, or 0 to pick one from the length of each exponent.
+// The default is "cyclotomic" where it's available and "pbc" elsewhere.
+PyObject *Pairing_set_pow_method(Pairing *self, PyObject *args, PyObject *kwargs) {
+	char *keys[] = {"group", "method", "window", NULL};
+	int group;
+	const char *name;
+	int window = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "is|i", keys, &group, &name, &window)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	if (group < G1 || group > Zr) {
+		PyErr_SetString(PyExc_ValueError, "Invalid group.");
+		return NULL;
+	}
+	int method;
+	for (method = POW_PBC; method <= POW_CYCLOTOMIC; method++) {
+		if (strcmp(name, pow_method_names[method]) == 0) {
+			break;
+		}
+	}
+	if (method > POW_CYCLOTOMIC) {
+		PyErr_SetString(PyExc_ValueError, "method must be one of 'pbc', 'fixed', 'sliding', 'wnaf' or 'cyclotomic'.");
+		return NULL;
+	}
+	if (method == POW_CYCLOTOMIC && (group != GT || !self->gt_quadratic)) {
+		PyErr_SetString(PyExc_ValueError, "'cyclotomic' is only for GT on type A and A1 curves.");
+		return NULL;
+	}
+	// a wNAF window of w has digits up to 2^(w-1), and the tables top out
+	// at 2^8 entries
+	int low = method >= POW_WNAF ? 2 : 1;
+	int high = method >= POW_WNAF ? 7 : 8;
+	if (method == POW_PBC) {
+		window = 0;
+	} else if (window != 0 && (window < low || window > high)) {
+		PyErr_Format(PyExc_ValueError, "window must be 0 or from %d to %d for %s.", low, high, name);
+		return NULL;
+	}
+	__atomic_store_n(&self->pow_config[group], POW_CONFIG(method, window), __ATOMIC_RELAXED);
+	Py_RETURN_NONE;
+}
+
+// pairing.get_pow_method(group) -> (method, window)
+PyObject *Pairing_get_pow_method(Pairing *self, PyObject *args) {
+	int group;
+	if (!PyArg_ParseTuple(args, "i", &group)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
+	if (group < G1 || group > Zr) {
+		PyErr_SetString(PyExc_ValueError, "Invalid group.");
+		return NULL;
+	}
+	int config = __atomic_load_n(&self->pow_config[group], __ATOMIC_RELAXED);
+	return Py_BuildValue("(si)", pow_method_names[POW_CONFIG_METHOD(config)], POW_CONFIG_WINDOW(config));
+}
+
+// pairing.tune_pow() -> {group: (method, window)}
+// times each method on G1, G2 and GT and keeps the fastest
+PyObject *Pairing_tune_pow(Pairing *self, PyObject *unused) {
+	if (!self->ready) {
+		PyErr_SetString(PyExc_ValueError, "Pairing has not been initialised.");
+		return NULL;
+	}
+	Py_BEGIN_ALLOW_THREADS
+	pairing_tune_pow(self);
+	Py_END_ALLOW_THREADS
+	PyObject *result = PyDict_New();
+	if (result == NULL) {
+		return NULL;
+	}
+	for (int group = G1; group <= GT; group++) {
+		int config = __atomic_load_n(&self->pow_config[group], __ATOMIC_RELAXED);
+		PyObject *key = PyLong_FromLong(group);
+		PyObject *value = Py_BuildValue("(si)", pow_method_names[POW_CONFIG_METHOD(config)], POW_CONFIG_WINDOW(config));
+		if (key == NULL || value == NULL || PyDict_SetItem(result, key, value) < 0) {
+			Py_XDECREF(key);
+			Py_XDECREF(value);
+			Py_DECREF(result);
+			return NULL;
+		}
+		Py_DECREF(key);
+		Py_DECREF(value);
+	}
+	return result;
+}
+
+/*******************************************************************************
+*						Composite order							      *
+*******************************************************************************/
+
+// Type A1 pairings have a group order n that is a product of primes, and
+// schemes built on them work in the subgroups of each prime. Given those
+// primes, powers in Zr split into one small power per prime, and a power of
+// an element known to lie in some of the subgroups only needs an exponent
+// modulo the product of their primes.
+
+// builds a generator of each factor's subgroup of G1, G2 and GT: hashes
+// into the group and raises the result to n/p until it isn't the identity.
+// Returns -1 if it can't get the memory, having built none of them.
+static int composite_generators(Pairing *pairing) {
+	pairing_ptr p = pairing->pbc_pairing;
+	for (int group = G1; group <= GT; group++) {
+		pairing->subgroup_gens[group] = PyMem_Malloc(pairing->nfactors * sizeof(element_t));
+	}
+	if (pairing->subgroup_gens[G1] == NULL || pairing->subgroup_gens[G2] == NULL || pairing->subgroup_gens[GT] == NULL) {
+		for (int group = G1; group <= GT; group++) {
+			PyMem_Free(pairing->subgroup_gens[group]);
+			pairing->subgroup_gens[group] = NULL;
+		}
+		return -1;
+	}
+	mpz_t cofactor;
+	mpz_init(cofactor);
+	for (int i = 0; i < pairing->nfactors; i++) {
+		mpz_divexact(cofactor, p->r, pairing->factors[i]);
+		for (int group = G1; group <= G2; group++) {
+			element_ptr g = pairing->subgroup_gens[group][i];
+			if (group == G1) {
+				element_init_G1(g, p);
 			} else {
-				// unrecognized type, fail hard
-				PyErr_SetString(PyExc_TypeError, "invalid type for argument 'value'");
-				return -1;
+				element_init_G2(g, p);
 			}
+			unsigned char seed[24] = "pypbc subgroup";
+			for (unsigned int counter = 0; ; counter++) {
+				memcpy(seed + 16, &counter, sizeof(counter));
+				element_from_hash(g, seed, sizeof(seed));
+				element_pow_mpz(g, g, cofactor);
+				if (!element_is1(g)) {
+					break;
+				}
+			}
+		}
+		element_init_GT(pairing->subgroup_gens[GT][i], p);
+		pairing_apply(pairing->subgroup_gens[GT][i], pairing->subgroup_gens[G1][i], pairing->subgroup_gens[G2][i], p);
+	}
+	mpz_clear(cofactor);
+	return 0;
+}
+
+// takes the factors from a sequence of ints, checks they are distinct
+// primes whose product is the group order, and sets up everything built on
+// them. Returns -1 with an exception set on failure, after which
+// composite_clear undoes whatever was done.
+int composite_setup(Pairing *pairing, PyObject *factors) {
+	PyObject *tuple = PySequence_Tuple(factors);
+	if (tuple == NULL) {
+		return -1;
+	}
+	Py_ssize_t count = PyTuple_GET_SIZE(tuple);
+	if (count < 1 || count > COMPOSITE_MAX_FACTORS) {
+		Py_DECREF(tuple);
+		PyErr_Format(PyExc_ValueError, "expected between 1 and %d factors.", COMPOSITE_MAX_FACTORS);
+		return -1;
+	}
+	for (Py_ssize_t i = 0; i < count; i++) {
+		if (!PyLong_Check(PyTuple_GET_ITEM(tuple, i))) {
+			Py_DECREF(tuple);
+			PyErr_SetString(PyExc_TypeError, "factors must be integers.");
+			return -1;
+		}
+	}
+	pairing->factor_tuple = tuple;
+
+	// the factors, and their idempotents
+	pairing->factors = PyMem_Malloc(count * sizeof(mpz_t));
+	pairing->idempotents = PyMem_Malloc(count * sizeof(mpz_t));
+	if (pairing->factors == NULL || pairing->idempotents == NULL) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	int failed = 0;
+	for (Py_ssize_t i = 0; i < count; i++) {
+		failed |= pynum_to_mpz(PyTuple_GET_ITEM(tuple, i), pairing->factors[i]) < 0;
+		mpz_init(pairing->idempotents[i]);
+	}
+	pairing->nfactors = (int)count;
+	if (failed) {
+		return -1;
+	}
+
+	// distinct primes, multiplying out to the order
+	mpz_t product;
+	mpz_init_set_ui(product, 1);
+	int valid = 1;
+	for (int i = 0; i < pairing->nfactors && valid; i++) {
+		valid = mpz_sgn(pairing->factors[i]) > 0 && mpz_probab_prime_p(pairing->factors[i], 25) > 0;
+		for (int j = 0; j < i && valid; j++) {
+			valid = mpz_cmp(pairing->factors[i], pairing->factors[j]) != 0;
 		}
-	} else {
-		element_set0(self->pbc_element);
+		mpz_mul(product, product, pairing->factors[i]);
+	}
+	valid = valid && mpz_cmp(product, pairing->pbc_pairing->r) == 0;
+	mpz_clear(product);
+	if (!valid) {
+		PyErr_SetString(PyExc_ValueError, "factors must be distinct primes whose product is the group order.");
+		return -1;
+	}
+
+	// e_i = (n/p_i) * ((n/p_i)^-1 mod p_i), which is 1 mod p_i and 0 mod
+	// the others
+	mpz_t cofactor;
+	mpz_init(cofactor);
+	for (int i = 0; i < pairing->nfactors; i++) {
+		mpz_divexact(cofactor, pairing->pbc_pairing->r, pairing->factors[i]);
+		mpz_invert(pairing->idempotents[i], cofactor, pairing->factors[i]);
+		mpz_mul(pairing->idempotents[i], pairing->idempotents[i], cofactor);
+	}
+	mpz_clear(cofactor);
+
+	if (composite_generators(pairing) < 0) {
+		PyErr_NoMemory();
+		return -1;
 	}
-	
-	// you're ready!
-	self->ready = 1;
-	// we're clear
 	return 0;
 }
 
-PyObject *Element_from_hash(PyObject *cls, PyObject *args) {
-	// required arguments are the pairing, the group, and the hashed value
-	PyObject *pypairing;
-	enum Group group;
-	char *hash;
-	size_t hash_size;
-	if (!PyArg_ParseTuple(args, "Ois#", &pypairing, &group, &hash, &hash_size)) {
-		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
-		return NULL;
+// lets go of everything composite_setup built
+void composite_clear(Pairing *pairing) {
+	for (int group = G1; group <= GT; group++) {
+		// the generators were all made together, or not at all
+		if (pairing->subgroup_gens[group] != NULL) {
+			for (int i = 0; i < pairing->nfactors; i++) {
+				element_clear(pairing->subgroup_gens[group][i]);
+			}
+			PyMem_Free(pairing->subgroup_gens[group]);
+			pairing->subgroup_gens[group] = NULL;
+		}
 	}
-	
-	// build ourselves
-	Element *self = Element_create();
-
-	// check the type of arguments
-	if(!PyObject_TypeCheck(pypairing, &PairingType)) {
-		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
-		return NULL;
+	for (int i = 0; i < pairing->nfactors; i++) {
+		mpz_clear(pairing->factors[i]);
+		mpz_clear(pairing->idempotents[i]);
 	}
-	
-	// store the pairing and incref it, since we depend on its existence
-	Py_INCREF(pypairing);
-	self->pairing = pypairing;
-	
-	// cast the arguments
-	Pairing *prepairing = (Pairing*)pypairing;
-	
-	// use the arguments to init the element
-	switch(group) {
-		case G1: element_init_G1(self->pbc_element, prepairing->pbc_pairing); break;
-		case G2: element_init_G2(self->pbc_element, prepairing->pbc_pairing); break;
-		case GT: element_init_GT(self->pbc_element, prepairing->pbc_pairing); break;
-		case Zr: element_init_Zr(self->pbc_element, prepairing->pbc_pairing); break;
-		default: PyErr_SetString(PyExc_ValueError, "Invalid group."); return NULL;
+	PyMem_Free(pairing->factors);
+	PyMem_Free(pairing->idempotents);
+	pairing->factors = NULL;
+	pairing->idempotents = NULL;
+	pairing->nfactors = 0;
+	Py_CLEAR(pairing->factor_tuple);
+}
+
+// the product of the factors whose bits are set in subgroups
+void composite_order(mpz_t order, Pairing *pairing, unsigned int subgroups) {
+	mpz_set_ui(order, 1);
+	for (int i = 0; i < pairing->nfactors; i++) {
+		if (subgroups & (1u << i)) {
+			mpz_mul(order, order, pairing->factors[i]);
+		}
 	}
-	
-	// set the group argument
-	self->group = group;
+}
 
-	// make the element from the hash
-	element_from_hash(self->pbc_element, hash, hash_size);
+// out = base^k in Zr for k >= 0, one prime at a time: modulo p the exponent
+// can be taken modulo p - 1, and the pieces are put back together with the
+// idempotents
+void composite_pow_zr(element_ptr out, element_ptr base, mpz_t k, Pairing *pairing) {
+	mpz_t b, part, e, sum;
+	mpz_init(b);
+	mpz_init(part);
+	mpz_init(e);
+	mpz_init_set_ui(sum, 0);
+	element_to_mpz(b, base);
+	for (int i = 0; i < pairing->nfactors; i++) {
+		mpz_mod(part, b, pairing->factors[i]);
+		if (mpz_sgn(part) == 0) {
+			// 0^k is 0, but 0^0 is 1
+			mpz_set_ui(part, mpz_sgn(k) == 0);
+		} else {
+			mpz_sub_ui(e, pairing->factors[i], 1);
+			mpz_mod(e, k, e);
+			mpz_powm(part, part, e, pairing->factors[i]);
+		}
+		mpz_addmul(sum, part, pairing->idempotents[i]);
+	}
+	mpz_mod(sum, sum, pairing->pbc_pairing->r);
+	element_set_mpz(out, sum);
+	mpz_clear(b);
+	mpz_clear(part);
+	mpz_clear(e);
+	mpz_clear(sum);
+}
 
-	// you're ready!
-	self->ready = 1;
-	// we're clear
-	return (PyObject*)self;
+// the factor index from args, checked against the pairing; -1 with an
+// exception set if it's out of range or the pairing has no factors
+static int composite_index(Pairing *pairing, Py_ssize_t index) {
+	if (pairing->nfactors == 0) {
+		PyErr_SetString(PyExc_ValueError, "the pairing was not given the factors of its order.");
+		return -1;
+	}
+	if (index < 0 || index >= pairing->nfactors) {
+		PyErr_SetString(PyExc_IndexError, "no such factor.");
+		return -1;
+	}
+	return (int)index;
 }
 
-PyObject *Element_random(PyObject *cls, PyObject *args) {
-	assert(cls != NULL);
-	// required arguments are the pairing and the group
-	PyObject *pypairing;
-	enum Group group;
-	if (!PyArg_ParseTuple(args, "Oi", &pypairing, &group)) {
+// pairing.project(element, i) -> Element
+PyObject *Pairing_project(Pairing *self, PyObject *args) {
+	PyObject *element;
+	Py_ssize_t index;
+	if (!PyArg_ParseTuple(args, "On", &element, &index)) {
 		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
 		return NULL;
 	}
-
-	// check the type of arguments
-	if(!PyObject_TypeCheck(pypairing, &PairingType)) {
-		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
 		return NULL;
 	}
-
-	// build ourselves
-	Element *self = Element_create();
-
-	// store the pairing and incref it, since we depend on its existence
-	Py_INCREF(pypairing);
-	self->pairing = pypairing;
-	
-	// cast the arguments
-	Pairing *prepairing = (Pairing*)pypairing;
-
-	// use the arguments to init the element
-	switch(group) {
-		case G1: element_init_G1(self->pbc_element, prepairing->pbc_pairing); break;
-		case G2: element_init_G2(self->pbc_element, prepairing->pbc_pairing); break;
-		case Zr: element_init_Zr(self->pbc_element, prepairing->pbc_pairing); break;
-		default: PyErr_SetString(PyExc_ValueError, "Invalid group.");return NULL;
+	if (!PyObject_TypeCheck(element, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return NULL;
+	}
+	Element *e1 = (Element *)element;
+	if (e1->pairing != (PyObject *)self) {
+		PyErr_SetString(PyExc_ValueError, "element belongs to a different pairing.");
+		return NULL;
+	}
+	int i = composite_index(self, index);
+	if (i < 0) {
+		return NULL;
 	}
 
-	// set the group argument
-	self->group = group;
-	
-	// make the element random
-	element_random(self->pbc_element);
-	
-	// you're ready!
-	self->ready = 1;
-	// we're clear
-	return (PyObject*)self;
+	// x^e_i, or e_i x in Zr, is the component of x in the i-th subgroup
+	Element *e2 = Element_create(state);
+	if (e2 == NULL || Element_init_group(e2, (PyObject *)self, e1->group) < 0) {
+		Py_XDECREF(e2);
+		return NULL;
+	}
+	if (e1->group == Zr) {
+		element_mul_mpz(e2->pbc_element, e1->pbc_element, self->idempotents[i]);
+	} else if (element_pow_custom(e2->pbc_element, e1, self->idempotents[i]) < 0) {
+		Py_DECREF(e2);
+		return NULL;
+	} else {
+		e2->subgroups = 1u << i;
+	}
+	return (PyObject *)e2;
 }
 
-PyObject *Element_zero(PyObject *cls, PyObject *args) {
-	// required arguments are the pairing and the group
-	PyObject *pypairing;
+// pairing.random_subgroup(group, i) -> Element
+PyObject *Pairing_random_subgroup(Pairing *self, PyObject *args) {
 	enum Group group;
-	if (!PyArg_ParseTuple(args, "Oi", &pypairing, &group)) {
+	Py_ssize_t index;
+	if (!PyArg_ParseTuple(args, "in", &group, &index)) {
 		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
 		return NULL;
 	}
-
-	// check the type of arguments
-	if(!PyObject_TypeCheck(pypairing, &PairingType)) {
-		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	if (group != G1 && group != G2 && group != GT) {
+		PyErr_SetString(PyExc_ValueError, "Invalid group.");
+		return NULL;
+	}
+	int i = composite_index(self, index);
+	if (i < 0) {
 		return NULL;
 	}
-	
-	// build ourselves
-	Element *self = Element_create();
 
-	// store the pairing and incref it, since we depend on its existence
-	Py_INCREF(pypairing);
-	self->pairing = pypairing;
-	
-	// cast the arguments
-	Pairing *prepairing = (Pairing*)pypairing;
-	
-	// use the arguments to init the element
-	switch(group) {
-		case G1: element_init_G1(self->pbc_element, prepairing->pbc_pairing); break;
-		case G2: element_init_G2(self->pbc_element, prepairing->pbc_pairing); break;
-		case GT: element_init_GT(self->pbc_element, prepairing->pbc_pairing); break;
-		case Zr: element_init_Zr(self->pbc_element, prepairing->pbc_pairing); break;
-		default: PyErr_SetString(PyExc_ValueError, "Invalid group.");return NULL;
+	Element *e = Element_create(state);
+	if (e == NULL || Element_init_group(e, (PyObject *)self, group) < 0) {
+		Py_XDECREF(e);
+		return NULL;
 	}
-	
-	// set the group argument
-	self->group = group;
-		
-	// set the element to 0
-	element_set0(self->pbc_element);
-	
-	// you're ready!
-	self->ready = 1;
-	// we're clear
-	return (PyObject*)self;
+	// the subgroup's generator to a random power, which only needs to run
+	// up to its prime
+	element_t r;
+	mpz_t k;
+	element_init_Zr(r, self->pbc_pairing);
+	element_random(r);
+	mpz_init(k);
+	element_to_mpz(k, r);
+	element_clear(r);
+	mpz_mod(k, k, self->factors[i]);
+	element_pow_mpz(e->pbc_element, self->subgroup_gens[group][i], k);
+	mpz_clear(k);
+	e->subgroups = 1u << i;
+	return (PyObject *)e;
 }
 
-PyObject *Element_one(PyObject *cls, PyObject *args, PyObject *kwargs) {
-	// required arguments are the pairing and the group
-	PyObject *pypairing;
-	enum Group group;
-	if (!PyArg_ParseTuple(args, "Oi", &pypairing, &group)) {
-		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
-		return NULL;
+/*******************************************************************************
+*						Async							      *
+*******************************************************************************/
+
+// the most jobs a worker takes off the queue at once; everything in one
+// batch is handed back to its event loop with a single wakeup
+#define ASYNC_BATCH_MAX 32
+
+enum AsyncKind {ASYNC_APPLY, ASYNC_PRODUCT, ASYNC_POW};
+
+typedef struct async_job {
+	struct async_job *next;
+	enum AsyncKind kind;
+	// the output, built with the GIL held before the job is queued
+	Element *result;
+	// the inputs; we hold references so they outlive the job
+	PyObject *keep;
+	element_ptr in1;
+	element_ptr in2;
+	// multi-pairings alias the inputs' element structs
+	struct element_s *in1s;
+	struct element_s *in2s;
+	int count;
+	// how a power is to be worked out, read off the pairing when it was
+	// asked for
+	pow_plan pow;
+	// where the result goes
+	PyObject *future;
+	PyObject *loop;
+	pypbc_interp *owner;
+} async_job;
+
+static async_job *pool_head = NULL;
+static async_job *pool_tail = NULL;
+static int pool_started = 0;
+
+// does the arithmetic; runs on a worker without the GIL
+static void async_job_run(async_job *job) {
+	switch (job->kind) {
+		case ASYNC_APPLY:
+			element_pairing(job->result->pbc_element, job->in1, job->in2);
+			break;
+		case ASYNC_PRODUCT:
+			element_prod_pairing(job->result->pbc_element, (element_t *)job->in1s, (element_t *)job->in2s, job->count);
+			break;
+		case ASYNC_POW:
+			if (pow_plan_run(job->result->pbc_element, job->in1, &job->pow) < 0) {
+				// PBC's own way needs none of the tables that didn't fit
+				element_pow_mpz(job->result->pbc_element, job->in1, job->pow.k);
+			}
+			break;
 	}
-	
-	// check the type of arguments
-	if(!PyObject_TypeCheck(pypairing, &PairingType)) {
-		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
-		return NULL;
+}
+
+// frees the native parts of a job
+static void async_job_free_raw(async_job *job) {
+	if (job->kind == ASYNC_POW) {
+		pow_plan_clear(&job->pow);
 	}
-	
-	// build ourselves
-	Element *self = Element_create();
-		
-	// store the pairing and incref it, since we depend on its existence
-	Py_INCREF(pypairing);
-	self->pairing = pypairing;
-	
-	// cast the arguments
-	Pairing *prepairing = (Pairing*)pypairing;
-	
-	// use the arguments to init the element
-	switch(group) {
-		case G1: element_init_G1(self->pbc_element, prepairing->pbc_pairing); break;
-		case G2: element_init_G2(self->pbc_element, prepairing->pbc_pairing); break;
-		case GT: element_init_GT(self->pbc_element, prepairing->pbc_pairing); break;
-		case Zr: element_init_Zr(self->pbc_element, prepairing->pbc_pairing); break;
-		default: PyErr_SetString(PyExc_ValueError, "Invalid group.");return NULL;
+	if (job->owner) {
+		interp_release(job->owner);
 	}
+	PyMem_RawFree(job->in1s);
+	PyMem_RawFree(job->in2s);
+	PyMem_RawFree(job);
+}
 
-	// set the group argument
-	self->group = group;
-		
-	// set the element to 1
-	element_set1(self->pbc_element);
-	
-	// you're ready!
-	self->ready = 1;
-	// we're clear
-	return (PyObject*)self;
+// releases everything a job holds; needs the GIL of its interpreter
+static void async_job_free(async_job *job) {
+	Py_XDECREF(job->result);
+	Py_XDECREF(job->keep);
+	Py_XDECREF(job->future);
+	Py_XDECREF(job->loop);
+	async_job_free_raw(job);
 }
 
-// deallocates the object when done
-void Element_dealloc(Element *element) {
-	// clear the internal element
-	if (element->ready){
-		element_clear(element->pbc_element);
+PyDoc_STRVAR(resolve_futures__doc__,
+	"Sets the results of a batch of (future, result) pairs; runs on the event loop.");
+PyObject *resolve_futures(PyObject *self, PyObject *pairs) {
+	Py_ssize_t i;
+	for (i = 0; i < PyList_GET_SIZE(pairs); i++) {
+		PyObject *pair = PyList_GET_ITEM(pairs, i);
+		PyObject *future = PyTuple_GET_ITEM(pair, 0);
+		// anything cancelled while we worked just drops its result
+		PyObject *done = PyObject_CallMethod(future, "done", NULL);
+		if (done == NULL) {
+			return NULL;
+		}
+		int is_done = PyObject_IsTrue(done);
+		Py_DECREF(done);
+		if (is_done) {
+			continue;
+		}
+		PyObject *ret = PyObject_CallMethod(future, "set_result", "O", PyTuple_GET_ITEM(pair, 1));
+		if (ret == NULL) {
+			return NULL;
+		}
+		Py_DECREF(ret);
 	}
-	// decref the pairing
-	Py_XDECREF(element->pairing);
-	// free the object
-	Py_TYPE(element)->tp_free((PyObject*)element);
+	Py_RETURN_NONE;
 }
 
-// converts the element to a string
-PyObject *Element_str(PyObject *element) {
-	// extract the internal element
-	Element *py_ele = (Element*)element;
-	PyObject *result = NULL;
-	int ii, jj, pad, size = 0;
-	// int ii = 0;
-	// build the string buffer- AIEEE! MAGIC CONSTANT!
-	unsigned char string[4096];
-	unsigned char hex_value[4096];
-	// query the element dimension
-	int dim = element_item_count(py_ele->pbc_element);
-	switch(py_ele->group) {
-		case G1:
-		case G2:
-			// printf("G1/G2 point dimension %d\n", element_item_count(py_ele->pbc_element));
-			if (element_is0(py_ele->pbc_element) == 1) {
-				size = (2 * element_length_in_bytes_compressed(py_ele->pbc_element)) - 1;
-				for (ii = 0; ii < size; ii++) {
-					string[ii] = 0x00 ;
-				}
-			} else {
-				if (PBC_EC_Compressed) {
-					size = element_to_bytes_compressed(&string[1], py_ele->pbc_element);
-					string[0] = 0x02 | string[size];
-					string[size] = 0;
-				} else {
-					if (dim != 2) {
-						PyErr_SetString(PyExc_ValueError, "Invalid Elliptic Curve Point Dimension.");
-						return NULL;
-					}
-					element_ptr ex, ey;
-					string[0] = 0x04;
-					size = 1;
-					ex = element_item(py_ele->pbc_element, 0);
-					ey = element_item(py_ele->pbc_element, 1);
-					size += element_to_bytes(&string[size], ex);
-					size += element_to_bytes(&string[size], ey);
-					string[size] = 0;
-				}
-			}
-			for (ii = 0 ; ii < size; ii++) {
-				sprintf((char *)&hex_value[2*ii], "%02X", string[ii]);
+PyMethodDef resolve_futures_def = {
+	"_resolve_futures", resolve_futures, METH_O, resolve_futures__doc__
+};
+
+// hands a finished batch back to the event loops that asked for it, one
+// call_soon_threadsafe per loop; needs the GIL
+static void async_batch_complete(async_job *batch) {
+	PyObject *resolve = PyCFunction_New(&resolve_futures_def, NULL);
+	if (resolve == NULL) {
+		PyErr_WriteUnraisable(NULL);
+	}
+
+	while (batch != NULL) {
+		PyObject *loop = batch->loop;
+		PyObject *pairs = PyList_New(0);
+		async_job **link = &batch;
+		Py_INCREF(loop);
+
+		// pull out every job for this loop
+		while (*link != NULL) {
+			async_job *job = *link;
+			if (job->loop != loop) {
+				link = &job->next;
+				continue;
 			}
-			return PyUnicode_FromStringAndSize(hex_value, size * 2);
-		case GT:
-			// printf("GT vector dimension %d\n", dim);
-			size = 0;
-			sprintf((char *)&hex_value[0], "(0x");
-			pad = 3;
-			for (ii = 0; ii < dim; ii++) {
-				size = element_to_bytes(string, element_item(py_ele->pbc_element, ii));
-				if (ii != 0 ) {
-					sprintf((char *)&hex_value[pad], ", 0x") ;
-					pad += 4;
+			*link = job->next;
+			if (pairs != NULL) {
+				PyObject *pair = PyTuple_Pack(2, job->future, (PyObject *)job->result);
+				if (pair == NULL || PyList_Append(pairs, pair) < 0) {
+					Py_CLEAR(pairs);
 				}
-				for (jj = 0 ; jj < size; jj++) {
-					sprintf((char *)&hex_value[(2*jj)+pad], "%02X", string[jj]);
+				Py_XDECREF(pair);
+			}
+			async_job_free(job);
+		}
+
+		if (pairs != NULL && resolve != NULL) {
+			PyObject *ret = PyObject_CallMethod(loop, "call_soon_threadsafe", "OO", resolve, pairs);
+			// a loop that has closed under us has nobody left to tell
+			if (ret == NULL) {
+				PyErr_Clear();
+			}
+			Py_XDECREF(ret);
+		} else {
+			PyErr_WriteUnraisable(loop);
+		}
+		Py_XDECREF(pairs);
+		Py_DECREF(loop);
+	}
+	Py_XDECREF(resolve);
+}
+
+static void *async_worker(void *arg) {
+	for (;;) {
+		// wait for work
+		pthread_mutex_lock(&pool_lock);
+		while (pool_head == NULL) {
+			pthread_cond_wait(&pool_cond, &pool_lock);
+		}
+		// take a batch off the front of the queue
+		async_job *batch = pool_head, *last = pool_head;
+		int taken = 1;
+		while (last->next != NULL && taken < ASYNC_BATCH_MAX) {
+			last = last->next;
+			taken++;
+		}
+		pool_head = last->next;
+		if (pool_head == NULL) {
+			pool_tail = NULL;
+		}
+		last->next = NULL;
+		pthread_mutex_unlock(&pool_lock);
+
+		async_job *job;
+		for (job = batch; job != NULL; job = job->next) {
+			async_job_run(job);
+		}
+
+		// a batch can mix jobs from several interpreters, so go into each
+		// of them in turn with its own share of the batch
+		while (batch != NULL) {
+			pypbc_interp *owner = batch->owner;
+			async_job *mine = NULL, **tail = &mine, **link = &batch;
+			while (*link != NULL) {
+				job = *link;
+				if (job->owner != owner) {
+					link = &job->next;
+					continue;
 				}
-				pad += 2*size;
+				*link = job->next;
+				job->next = NULL;
+				*tail = job;
+				tail = &job->next;
 			}
-			sprintf((char *)&hex_value[pad],")");
-			return PyUnicode_FromStringAndSize(hex_value, pad + 1);
-		case Zr:
-			// printf("Zr vector dimension %d\n", dim);
-			size = element_to_bytes(string, py_ele->pbc_element);
-			sprintf((char *)&hex_value[0], "0x");
-			for (ii = 0 ; ii < size; ii++) {
-				sprintf((char *)&hex_value[2*(ii+1)], "%02X", string[ii]);
+
+			// hold on to the owner, since the jobs' references go with them
+			interp_retain(owner);
+			PyThreadState *tstate = interp_attach(owner);
+			if (tstate != NULL) {
+				async_batch_complete(mine);
+				interp_detach(owner, tstate);
+			} else {
+				// the interpreter is on its way out, so its objects are
+				// abandoned with it
+				while (mine != NULL) {
+					job = mine;
+					mine = job->next;
+					async_job_free_raw(job);
+				}
 			}
-			return PyUnicode_FromStringAndSize(hex_value, (size+1) * 2);
-		default:
-			break;
+			interp_release(owner);
+		}
 	}
-	PyErr_SetString(PyExc_ValueError, "Invalid group.");
 	return NULL;
 }
 
-// adds two elements together
-PyObject *Element_add(PyObject* a, PyObject *b) {
-	// convert both objects to Elements
-	Element *e1 = (Element*)a;
-	Element *e2 = (Element*)b;
-	// make sure they're in the same ring
-	if (e1->group != e2->group) {
-		PyErr_SetString(PyExc_ValueError, "elements must be members of the same group.");
+// starts one worker per core the first time they're needed. The pool is
+// shared by every interpreter in the process.
+static int async_pool_start(void) {
+	if (__atomic_load_n(&pool_started, __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	long i;
+	int started = 0;
+	if (cores < 1) {
+		cores = 1;
+	}
+	pthread_mutex_lock(&pool_lock);
+	if (!pool_started) {
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		for (i = 0; i < cores; i++) {
+			pthread_t thread;
+			if (pthread_create(&thread, &attr, async_worker, NULL) == 0) {
+				started++;
+			}
+		}
+		pthread_attr_destroy(&attr);
+		__atomic_store_n(&pool_started, started, __ATOMIC_RELEASE);
+	}
+	started = pool_started;
+	pthread_mutex_unlock(&pool_lock);
+	if (!started) {
+		PyErr_SetString(PyExc_RuntimeError, "could not start worker threads.");
+		return -1;
+	}
+	return 0;
+}
+
+// allocates a job bound to the running event loop, with its future
+static async_job *async_job_new(pypbc_state *state, enum AsyncKind kind) {
+	PyObject *asyncio = PyImport_ImportModule("asyncio");
+	if (asyncio == NULL) {
 		return NULL;
 	}
-	// build the result element
-	Element *e3 = Element_create();
-	// note that the result is in the same ring *and pairing*
-	element_init_same_as(e3->pbc_element, e1->pbc_element);
-	e3->group = e1->group;
-	Py_INCREF(e1->pairing);
-	e3->pairing = e1->pairing;
-	
-	// add the elements and store the result in e3
-	element_add(e3->pbc_element, e1->pbc_element, e2->pbc_element);
-	// cast and return
-	e3->ready = 1;
-	return (PyObject*)e3;
+	// this raises RuntimeError for us when there's no running loop
+	PyObject *loop = PyObject_CallMethod(asyncio, "get_running_loop", NULL);
+	Py_DECREF(asyncio);
+	if (loop == NULL) {
+		return NULL;
+	}
+	PyObject *future = PyObject_CallMethod(loop, "create_future", NULL);
+	if (future == NULL) {
+		Py_DECREF(loop);
+		return NULL;
+	}
+	async_job *job = PyMem_RawCalloc(1, sizeof(async_job));
+	if (job == NULL) {
+		Py_DECREF(future);
+		Py_DECREF(loop);
+		PyErr_NoMemory();
+		return NULL;
+	}
+	job->kind = kind;
+	job->loop = loop;
+	job->future = future;
+	interp_retain(state->interp);
+	job->owner = state->interp;
+	return job;
 }
 
-// subtracts two elements
-PyObject *Element_sub(PyObject* a, PyObject *b) {
-	// convert both objects to Elements
-	Element *e1 = (Element*)a;
-	Element *e2 = (Element*)b;
-	// make sure they're in the same ring
-	if (e1->group != e2->group) {
-		PyErr_SetString(PyExc_ValueError, "elements must be members of the same group.");
+// queues the job and returns its future; needs the GIL
+static PyObject *async_job_submit(async_job *job) {
+	if (async_pool_start() < 0) {
+		async_job_free(job);
 		return NULL;
 	}
-	// build the result element
-	Element *e3 = Element_create();
-	// note that the result is in the same ring *and pairing*
-	element_init_same_as(e3->pbc_element, e1->pbc_element);
-	e3->group = e1->group;
-	Py_INCREF(e1->pairing);
-	e3->pairing = e1->pairing;
-	// add the elements and store the result in e3
-	element_sub(e3->pbc_element, e1->pbc_element, e2->pbc_element);
-	// cast and return
-	e3->ready = 1;
-	return (PyObject*)e3;
+	PyObject *future = job->future;
+	Py_INCREF(future);
+
+	pthread_mutex_lock(&pool_lock);
+	if (pool_tail != NULL) {
+		pool_tail->next = job;
+	} else {
+		pool_head = job;
+	}
+	pool_tail = job;
+	pthread_cond_signal(&pool_cond);
+	pthread_mutex_unlock(&pool_lock);
+	return future;
 }
 
-// multiplies two elements
-// note that elements from any ring can be multiplied by those in Zr.
-PyObject *Element_mult(PyObject* a, PyObject *b) {
-	// convert a to an element
-	Element *e1 = (Element*)a;
-	
-	// build the result element
-	Element *e3 = (Element *)ElementType.tp_alloc(&ElementType, 0);
-	
-	// note that the result is in the same ring *and pairing*
-	element_init_same_as(e3->pbc_element, e1->pbc_element);
-	e3->group = e1->group;
-	Py_INCREF(e1->pairing);
-	e3->pairing = e1->pairing;
+// Applies the pairing on a native worker thread without the GIL. Must be
+// called from a running asyncio event loop; the result is delivered back to
+// it together with any other results that finished in the same batch.
+PyObject *Pairing_apply_async(PyObject *self, PyObject *args) {
+	PyObject *element_1;
+	PyObject *element_2;
+	if (!PyArg_ParseTuple(args, "OO", &element_1, &element_2)) {
+		PyErr_SetString(PyExc_TypeError, "could not parse arguments");
+		return NULL;
+	}
 
-	// check to see if b is an integer
-	if(PyLong_Check(b)) {
-		// cast it to an MPZ
-		mpz_t i;
-		mpz_init(i);
-		pynum_to_mpz(b, i);
-		element_mul_mpz(e3->pbc_element, e1->pbc_element, i);
-		mpz_clear(i);	
-	} else if (PyObject_TypeCheck(b, &ElementType)) {
-		Element *e2 = (Element*)b;
-		// make sure they're in the same group
-		if (e1->group != e2->group && e2->group != Zr) {
-			PyErr_SetString(PyExc_ValueError, "elements must be in the same group or Zr.");
+	// check the types on the arguments
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	if(!PyObject_TypeCheck(element_1, state->ElementType) || !PyObject_TypeCheck(element_2, state->ElementType)) {
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
+		return NULL;
+	}
+	Element *e1 = (Element*)element_1;
+	Element *e2 = (Element*)element_2;
+	if (pairing_check_inputs((Pairing *)self, e1, e2) < 0) {
+		return NULL;
+	}
+
+	async_job *job = async_job_new(state, ASYNC_APPLY);
+	if (job == NULL) {
+		return NULL;
+	}
+	job->keep = PyTuple_Pack(2, element_1, element_2);
+	job->result = Element_create(state);
+	if (job->keep == NULL || job->result == NULL || Element_init_group(job->result, self, GT) < 0) {
+		async_job_free(job);
+		return NULL;
+	}
+	job->in1 = e1->pbc_element;
+	job->in2 = e2->pbc_element;
+	return async_job_submit(job);
+}
+
+// Computes e(a1, b1) * e(a2, b2) * ... as a single multi-pairing on a native
+// worker thread, which is cheaper than pairing each term and multiplying.
+PyObject *Pairing_apply_product_async(PyObject *self, PyObject *pairs) {
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
+		return NULL;
+	}
+	PyObject *seq = PySequence_Tuple(pairs);
+	if (seq == NULL) {
+		return NULL;
+	}
+	Py_ssize_t n = PyTuple_GET_SIZE(seq), i;
+	if (n < 1 || n > INT_MAX) {
+		Py_DECREF(seq);
+		PyErr_SetString(PyExc_ValueError, "expected at least one pair of Elements.");
+		return NULL;
+	}
+
+	async_job *job = async_job_new(state, ASYNC_PRODUCT);
+	if (job == NULL) {
+		Py_DECREF(seq);
+		return NULL;
+	}
+	// the tuple of pairs keeps every input alive
+	job->keep = seq;
+	job->count = (int)n;
+	job->in1s = PyMem_RawCalloc(n, sizeof(struct element_s));
+	job->in2s = PyMem_RawCalloc(n, sizeof(struct element_s));
+	if (job->in1s == NULL || job->in2s == NULL) {
+		async_job_free(job);
+		return PyErr_NoMemory();
+	}
+	for (i = 0; i < n; i++) {
+		PyObject *pair = PyTuple_GET_ITEM(seq, i);
+		if (!PyTuple_Check(pair) || PyTuple_GET_SIZE(pair) != 2 ||
+				!PyObject_TypeCheck(PyTuple_GET_ITEM(pair, 0), state->ElementType) ||
+				!PyObject_TypeCheck(PyTuple_GET_ITEM(pair, 1), state->ElementType)) {
+			async_job_free(job);
+			PyErr_SetString(PyExc_TypeError, "expected a sequence of (Element, Element) tuples.");
 			return NULL;
 		}
-		// add the elements and store the result in e3
-		if (e2->group != Zr) {
-			element_mul(e3->pbc_element, e1->pbc_element, e2->pbc_element);
-		} else {
-			element_mul_zn(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+		if (pairing_check_inputs((Pairing *)self, (Element *)PyTuple_GET_ITEM(pair, 0), (Element *)PyTuple_GET_ITEM(pair, 1)) < 0) {
+			async_job_free(job);
+			return NULL;
 		}
+		// PBC only reads these, so a shallow copy of the struct will do
+		job->in1s[i] = ((Element *)PyTuple_GET_ITEM(pair, 0))->pbc_element[0];
+		job->in2s[i] = ((Element *)PyTuple_GET_ITEM(pair, 1))->pbc_element[0];
 	}
-	// cast and return
-	e3->ready = 1;
-	return (PyObject*)e3;
-}
-
-// divide element a by element b
-PyObject *Element_div(PyObject* a, PyObject *b) {
-	// convert both objects to Elements
-	Element *e1 = (Element*)a;
-	Element *e2 = (Element*)b;
-	// make sure they're in the same ring
-	if (e1->group != e2->group) {
-		PyErr_SetString(PyExc_ValueError, "elements must be in the same group.");
+	job->result = Element_create(state);
+	if (job->result == NULL || Element_init_group(job->result, self, GT) < 0) {
+		async_job_free(job);
 		return NULL;
 	}
-	// build the result element
-	Element *e3 = (Element *)ElementType.tp_alloc(&ElementType, 0);
-	// note that the result is in the same ring *and pairing*
-	element_init_same_as(e3->pbc_element, e1->pbc_element);
-	e3->group = e1->group;
-	Py_INCREF(e1->pairing);
-	e3->pairing = e1->pairing;
-	// add the elements and store the result in e3
-	element_div(e3->pbc_element, e1->pbc_element, e2->pbc_element);
-	// cast and return
-	e3->ready = 1;
-	return (PyObject*)e3;
+	return async_job_submit(job);
 }
 
-// raises element a to the power of b
-// b can be either an element or an integer
-PyObject *Element_pow(PyObject* a, PyObject *b, PyObject *c) {
-
-	// check the types
-	if (!PyObject_TypeCheck(a, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "Argument 1 must be an element.");
+// Computes element**k on a native worker thread without the GIL; k is an int
+// or an element of Zr. Must be called from a running asyncio event loop.
+PyObject *Element_pow_async(PyObject *self, PyObject *exponent) {
+	Element *e1 = (Element *)self;
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
 		return NULL;
 	}
-	
-	// convert a to a pbc type
-	Element *e1 = (Element*)a;
-	
-	// build the result element
-	Element *e3 = (Element *)ElementType.tp_alloc(&ElementType, 0);
-	e3->group = e1->group;
-	Py_INCREF(e1->pairing);
-	e3->pairing = e1->pairing;
-	element_init_same_as(e3->pbc_element, e1->pbc_element);
 
-	// convert b to pbc type
-	if (PyLong_Check(b)) {	
-		// convert it to an mpz
-		mpz_t new_n;
-		pynum_to_mpz(b, new_n);
-		// perform the pow op
-		element_pow_mpz(e3->pbc_element, e1->pbc_element, new_n);
-	} else if (PyObject_TypeCheck(b, &ElementType)) {
-		// convert it to an element
-		Element *e2 = (Element*)b;
-		// make sure its in the right ring
-		if (e2->group != Zr) {
-			PyErr_SetString(PyExc_ValueError, "element must be in Zr.");
+	// take the exponent now, while we can still look at it
+	mpz_t k;
+	if (PyLong_Check(exponent)) {
+		if (pynum_to_mpz(exponent, k) < 0) {
+			mpz_clear(k);
 			return NULL;
 		}
-		element_pow_zn(e3->pbc_element, e1->pbc_element, e2->pbc_element);
+	} else if (PyObject_TypeCheck(exponent, state->ElementType) && ((Element *)exponent)->group == Zr) {
+		mpz_init(k);
+		element_to_mpz(k, ((Element *)exponent)->pbc_element);
 	} else {
-		PyErr_SetString(PyExc_TypeError, "Argument 2 must be an integer or element.");
+		PyErr_SetString(PyExc_TypeError, "exponent must be an integer or an element of Zr.");
 		return NULL;
 	}
-	
-	// cast and return
-	e3->ready = 1;
-	return (PyObject*)e3;
-}
 
-// returns -a
-PyObject *Element_neg(PyObject *a) {
-	// check the type of a
-	if (!PyObject_TypeCheck(a, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
+	async_job *job = async_job_new(state, ASYNC_POW);
+	if (job == NULL) {
+		mpz_clear(k);
 		return NULL;
 	}
-	
-	// cast it
-	Element *e1 = (Element*)a;
-	
-	// make sure we aren't in a bad group
-	if (e1->group == GT) {
-		PyErr_SetString(PyExc_ValueError, "Can't invert an element in GT.");
+	// and whatever the pairing is set up to do with it, as Element_pow would
+	pow_plan_init(&job->pow, e1, k);
+	mpz_clear(k);
+
+	Py_INCREF(self);
+	job->keep = self;
+	job->in1 = e1->pbc_element;
+	job->result = Element_create(state);
+	if (job->result == NULL) {
+		async_job_free(job);
 		return NULL;
-	}		
-	
-	// build the result element
-	Element *e2 = Element_create();
-	element_init_same_as(e2->pbc_element, e1->pbc_element);
-	e2->group = e1->group;
+	}
+	element_init_same_as(job->result->pbc_element, e1->pbc_element);
+	job->result->group = e1->group;
+	job->result->subgroups = e1->subgroups;
 	Py_INCREF(e1->pairing);
-	e2->pairing = e1->pairing;
-	
-	// perform the neg op
-	element_neg(e2->pbc_element, e1->pbc_element);
-	
-	// you're ready	
-	e2->ready = 1;
-	// cast and return
-	return (PyObject*)e2;
+	job->result->pairing = e1->pairing;
+	job->result->ready = 1;
+	return async_job_submit(job);
+}
+
+/*******************************************************************************
+*						Batches							      *
+*******************************************************************************/
+
+// one request in a batch: e(a, b), or a product of pairings, into out. The
+// input structs alias the Elements', which PBC only reads.
+typedef struct {
+	element_ptr out;
+	struct element_s *in1s;
+	struct element_s *in2s;
+	int count;
+	// the Element the first argument came from, for spotting repeats
+	PyObject *first;
+} batch_item;
+
+// a request's place in the order the batch is worked through: single
+// pairings sorted by their first argument, then products
+typedef struct {
+	uintptr_t key;
+	Py_ssize_t index;
+} batch_slot;
+
+// the work a thread takes at once: a span of the order, which is either one
+// request or several single pairings with the same first argument
+typedef struct {
+	Py_ssize_t start;
+	Py_ssize_t count;
+} batch_unit;
+
+typedef struct {
+	batch_item *items;
+	batch_slot *order;
+	batch_unit *units;
+	Py_ssize_t nunits;
+	Py_ssize_t next;
+	struct pairing_s *pairing;
+} pairing_batch;
+
+static int batch_slot_compare(const void *x, const void *y) {
+	const batch_slot *a = x, *b = y;
+	if (a->key != b->key) {
+		return a->key < b->key ? -1 : 1;
+	}
+	return a->index < b->index ? -1 : a->index > b->index;
+}
+
+static void *pairing_batch_worker(void *arg) {
+	pairing_batch *batch = arg;
+	Py_ssize_t u;
+	while ((u = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->nunits) {
+		batch_unit *unit = &batch->units[u];
+		batch_item *item = &batch->items[batch->order[unit->start].index];
+		if (unit->count > 1) {
+			// the Miller loop's lines for the shared argument are worked out
+			// once and used for every pairing with it
+			pairing_pp_t pp;
+			Py_ssize_t i;
+			pairing_pp_init(pp, item->in1s, batch->pairing);
+			for (i = 0; i < unit->count; i++) {
+				item = &batch->items[batch->order[unit->start + i].index];
+				pairing_pp_apply(item->out, item->in2s, pp);
+			}
+			pairing_pp_clear(pp);
+		} else if (item->count == 1) {
+			element_pairing(item->out, item->in1s, item->in2s);
+		} else {
+			element_prod_pairing(item->out, (element_t *)item->in1s, (element_t *)item->in2s, item->count);
+		}
+	}
+	return NULL;
+}
+
+// groups the requests into units, then runs them on up to one native thread
+// per core; safe to call without the GIL
+static void pairing_batch_run(pairing_batch *batch, Py_ssize_t n) {
+	Py_ssize_t i;
+	for (i = 0; i < n; i++) {
+		batch_item *item = &batch->items[i];
+		batch->order[i].key = item->count == 1 ? (uintptr_t)item->first : UINTPTR_MAX;
+		batch->order[i].index = i;
+	}
+	qsort(batch->order, n, sizeof(batch_slot), batch_slot_compare);
+	batch->nunits = 0;
+	for (i = 0; i < n; i++) {
+		batch_item *item = &batch->items[batch->order[i].index];
+		if (batch->nunits > 0) {
+			batch_unit *last = &batch->units[batch->nunits - 1];
+			batch_item *prev = &batch->items[batch->order[last->start].index];
+			if (item->count == 1 && prev->count == 1 && item->first == prev->first) {
+				last->count++;
+				continue;
+			}
+		}
+		batch->units[batch->nunits].start = i;
+		batch->units[batch->nunits].count = 1;
+		batch->nunits++;
+	}
+
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	Py_ssize_t nthreads = batch->nunits < cores ? batch->nunits : cores;
+	pthread_t threads[256];
+	Py_ssize_t started = 0;
+	if (nthreads > 256) {
+		nthreads = 256;
+	}
+	batch->next = 0;
+	// the calling thread is one of the workers
+	for (i = 1; i < nthreads; i++) {
+		if (pthread_create(&threads[started], NULL, pairing_batch_worker, batch) == 0) {
+			started++;
+		}
+	}
+	pairing_batch_worker(batch);
+	for (i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
 }
 
-// returns a**-1
-PyObject *Element_invert(PyObject *a) {
-	// check the type of a
-	if (!PyObject_TypeCheck(a, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
-		return NULL;
+// checks one request and points its item at the inputs; needs the GIL
+static int batch_item_setup(Pairing *self, pypbc_state *state, batch_item *item, PyObject *request) {
+	PyObject *first = PySequence_Check(request) && PySequence_Size(request) > 0 ? PySequence_GetItem(request, 0) : NULL;
+	int single;
+	Py_ssize_t n, i;
+	if (first == NULL) {
+		PyErr_Clear();
+		PyErr_SetString(PyExc_TypeError, "expected (Element, Element) or a sequence of them.");
+		return -1;
 	}
-	
-	// cast it
-	Element *e1 = (Element*)a;
-	
-	// make sure we aren't in a bad group
-	if (e1->group == GT) {
-		PyErr_SetString(PyExc_ValueError, "Can't invert an element in GT.");
-		return NULL;
-	}	
-	
-	// build the result element
-	Element *e2 = Element_create();
-	element_init_same_as(e2->pbc_element, e1->pbc_element);
-	e2->group = e1->group;
-	Py_INCREF(e1->pairing);
-	e2->pairing = e1->pairing;
-	
-	// perform the neg op
-	element_invert(e2->pbc_element, e1->pbc_element);
-	
-	// you're ready	
-	e2->ready = 1;
-	// cast and return
-	return (PyObject*)e2;
-}
+	single = PyObject_TypeCheck(first, state->ElementType);
+	Py_DECREF(first);
 
-// returns python Integer representation for Element (only for Zr)
-PyObject *Element_int(PyObject *a) {
-	// build the string buffer- AIEEE! MAGIC CONSTANT!
-	unsigned char string[4096];
-	unsigned char hex_value[4096];
-	int size,ii;
-	
-	// check the type of a
-	if (!PyObject_TypeCheck(a, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
-		return NULL;
+	// either the pair itself, or the pairs in a product
+	n = single ? 1 : PyTuple_GET_SIZE(request);
+	if (n < 1 || n > INT_MAX) {
+		PyErr_SetString(PyExc_ValueError, "expected at least one pair of Elements.");
+		return -1;
 	}
-	
-	Element *py_ele = (Element*)a;
-	if (py_ele->group != Zr) {
-		PyErr_SetString(PyExc_ValueError, "Cannot convert multidimensional point to int.");
-		return NULL;
+	item->in1s = PyMem_RawCalloc(n, sizeof(struct element_s));
+	item->in2s = PyMem_RawCalloc(n, sizeof(struct element_s));
+	if (item->in1s == NULL || item->in2s == NULL) {
+		PyErr_NoMemory();
+		return -1;
 	}
-	
-	// printf("Zr vector dimension %d\n", dim);
-	size = element_to_bytes(string, py_ele->pbc_element);
-	sprintf((char *)&hex_value[0], "0x");
-	for (ii = 0 ; ii < size; ii++) {
-		sprintf((char *)&hex_value[2*ii], "%02X", string[ii]);
+	item->count = (int)n;
+	for (i = 0; i < n; i++) {
+		PyObject *pair = single ? request : PyTuple_GET_ITEM(request, i);
+		if (!PyTuple_Check(pair) || PyTuple_GET_SIZE(pair) != 2 ||
+				!PyObject_TypeCheck(PyTuple_GET_ITEM(pair, 0), state->ElementType) ||
+				!PyObject_TypeCheck(PyTuple_GET_ITEM(pair, 1), state->ElementType)) {
+			PyErr_SetString(PyExc_TypeError, "expected (Element, Element) or a sequence of them.");
+			return -1;
+		}
+		Element *e1 = (Element *)PyTuple_GET_ITEM(pair, 0);
+		Element *e2 = (Element *)PyTuple_GET_ITEM(pair, 1);
+		if (pairing_check_inputs(self, e1, e2) < 0) {
+			return -1;
+		}
+		item->in1s[i] = e1->pbc_element[0];
+		item->in2s[i] = e2->pbc_element[0];
+		item->first = (PyObject *)e1;
 	}
-	// terminate string with NULL
-	hex_value[2*size] = NULL;
-	// translate hex (base 16) to python long 
-	return PyLong_FromString(hex_value, NULL, 16);
+	return 0;
 }
 
-PyObject *Element_cmp(PyObject *a, PyObject *b, int op) {
-
-	// typecheck a
-	if (!PyObject_TypeCheck(a, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "Cannot compare elements with non-elements.");
+// pairing.apply_batch(requests) -> list
+// Answers many pairing requests at once. A request is a tuple (a, b), for
+// e(a, b), or a tuple of such pairs, for the product of their pairings as
+// one multi-pairing. The work is spread over a native thread per core
+// without the GIL, and single pairings that share their first argument (the
+// same Element object) share its Miller loop preprocessing.
+PyObject *Pairing_apply_batch(PyObject *self, PyObject *requests) {
+	pypbc_state *state = pypbc_state_of(self);
+	if (state == NULL) {
 		return NULL;
 	}
-	
-	// it's safe, cast it to an element
-	Element *e1 = (Element*)a;
-	
-	// opcheck- only == and != are defined
-	if(op != Py_EQ && op != Py_NE) {
-		PyErr_SetString(PyExc_TypeError, "Invalid comparison between objects.");
+	// our own list of the requests keeps every input alive while we work
+	// without the GIL
+	PyObject *seq = PySequence_List(requests);
+	if (seq == NULL) {
 		return NULL;
 	}
-	
-	// type-and-value check b
-	if (!PyObject_TypeCheck(b, &ElementType)) {
-		if (PyLong_Check(b)) {
-			size_t i = PyNumber_AsSsize_t(b, NULL);
-			if (i == 1) {
-				if(element_is1(e1->pbc_element)) {
-					if (op == Py_EQ) Py_RETURN_TRUE; else Py_RETURN_FALSE;
-				} else {
-					if (op == Py_EQ) Py_RETURN_FALSE; else Py_RETURN_TRUE;
-				}
-			} else if (i == 0) {
-				if(element_is0(e1->pbc_element)) {
-					if (op == Py_EQ) Py_RETURN_TRUE; else Py_RETURN_FALSE;
-				} else {
-					if (op == Py_EQ) Py_RETURN_FALSE; else Py_RETURN_TRUE;
-				}
+	Py_ssize_t n = PyList_GET_SIZE(seq), i;
+	PyObject *result = PyList_New(n);
+	pairing_batch batch = {NULL};
+	batch.pairing = ((Pairing *)self)->pbc_pairing;
+	batch.items = PyMem_RawCalloc(n ? n : 1, sizeof(batch_item));
+	batch.order = PyMem_RawCalloc(n ? n : 1, sizeof(batch_slot));
+	batch.units = PyMem_RawCalloc(n ? n : 1, sizeof(batch_unit));
+	if (result == NULL || batch.items == NULL || batch.order == NULL || batch.units == NULL) {
+		if (result != NULL) {
+			PyErr_NoMemory();
+		}
+		goto fail;
+	}
+	for (i = 0; i < n; i++) {
+		PyObject *request = PyList_GET_ITEM(seq, i);
+		// requests are taken as tuples, so they can't change under us
+		if (PySequence_Check(request) && !PyTuple_Check(request)) {
+			request = PySequence_Tuple(request);
+			if (request == NULL || PyList_SetItem(seq, i, request) < 0) {
+				goto fail;
 			}
 		}
-		PyErr_SetString(PyExc_TypeError, "Cannot compare elements with non-elements other than 1 and 0.");
-		return NULL;
+		if (batch_item_setup((Pairing *)self, state, &batch.items[i], request) < 0) {
+			goto fail;
+		}
+		Element *out = Element_create(state);
+		if (out == NULL || Element_init_group(out, self, GT) < 0) {
+			Py_XDECREF(out);
+			goto fail;
+		}
+		PyList_SET_ITEM(result, i, (PyObject *)out);
+		batch.items[i].out = out->pbc_element;
 	}
-	
-	// cast b to element
-	Element *e2 = (Element*)b;
-	// perform the comparison
-	if(!element_cmp(e1->pbc_element, e2->pbc_element)) {
-		if (op == Py_EQ) Py_RETURN_TRUE; else Py_RETURN_FALSE;
-	} else {
-		if (op == Py_EQ) Py_RETURN_FALSE; else Py_RETURN_TRUE;
+
+	if (n > 0) {
+		Py_BEGIN_ALLOW_THREADS
+		pairing_batch_run(&batch, n);
+		Py_END_ALLOW_THREADS
+	}
+	goto done;
+
+fail:
+	Py_CLEAR(result);
+done:
+	if (batch.items != NULL) {
+		for (i = 0; i < n; i++) {
+			PyMem_RawFree(batch.items[i].in1s);
+			PyMem_RawFree(batch.items[i].in2s);
+		}
 	}
+	PyMem_RawFree(batch.items);
+	PyMem_RawFree(batch.order);
+	PyMem_RawFree(batch.units);
+	Py_DECREF(seq);
+	return result;
 }
 
-// returns dimension of Element (PBC convention is zero for Zr)
-Py_ssize_t  Element_len(PyObject *a) {
-	Py_ssize_t e_dim = 0;
-	// check the type of a
-	if (!PyObject_TypeCheck(a, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
-		return -1;
+/*******************************************************************************
+*						C API							      *
+*******************************************************************************/
+
+// the other modules' view of our objects. None of this can keep type
+// pointers, since every interpreter has its own types, so each call finds
+// the module state through the object it's given.
+
+static int capi_Pairing_Check(PyObject *op) {
+	PyObject *module = PyType_GetModuleByDef(Py_TYPE(op), &pypbc_module);
+	if (module == NULL) {
+		PyErr_Clear();
+		return 0;
 	}
-	
-	Element *py_ele = (Element*)a;
-	if (py_ele->group == Zr) {
-		PyErr_SetString(PyExc_TypeError, "Elements of type Zr have no len()");
-		return NULL;
+	return PyObject_TypeCheck(op, ((pypbc_state *)PyModule_GetState(module))->PairingType);
+}
+
+static int capi_Element_Check(PyObject *op) {
+	PyObject *module = PyType_GetModuleByDef(Py_TYPE(op), &pypbc_module);
+	if (module == NULL) {
+		PyErr_Clear();
+		return 0;
 	}
-	
-	// query the element dimension
-	e_dim = element_item_count(py_ele->pbc_element);
-	 
-	return e_dim;
+	return PyObject_TypeCheck(op, ((pypbc_state *)PyModule_GetState(module))->ElementType);
 }
 
-// returns python Integer representation for ith item of Element (error for Zr)
-PyObject *Element_GetItem(PyObject *a, Py_ssize_t i) {
-	// build the string buffer- AIEEE! MAGIC CONSTANT!
-	unsigned char string[4096];
-	unsigned char hex_value[4096];
-	int size,ii;
-	element_ptr ith_element;
-	Py_ssize_t e_dim = 0;
-	
-	// check the type of a
-	if (!PyObject_TypeCheck(a, &ElementType)) {
-		PyErr_SetString(PyExc_TypeError, "argument must be an element.");
+static struct pairing_s *capi_Pairing_AsPairing(PyObject *op) {
+	if (!capi_Pairing_Check(op)) {
+		PyErr_SetString(PyExc_TypeError, "expected Pairing, got something else.");
 		return NULL;
 	}
-	
-	Element *py_ele = (Element*)a;
-	if (py_ele->group == Zr) {
-		PyErr_SetString(PyExc_ValueError, "Elements of type Zr are not dimensioned.");
+	if (!((Pairing *)op)->ready) {
+		PyErr_SetString(PyExc_ValueError, "Pairing has not been initialised.");
 		return NULL;
 	}
-	
-	// query the element dimension
-	e_dim = element_item_count(py_ele->pbc_element);
-	
-	if ((i < 0) || (i >= e_dim)) {
-		PyErr_SetString(PyExc_ValueError, "Index out of range.");
+	return ((Pairing *)op)->pbc_pairing;
+}
+
+// checks op is a usable Element for the calls below
+static Element *capi_element(PyObject *op) {
+	if (!capi_Element_Check(op)) {
+		PyErr_SetString(PyExc_TypeError, "expected Element, got something else.");
 		return NULL;
 	}
-
-	ith_element = element_item(py_ele->pbc_element, i);
-
-	// printf("Zr vector dimension %d\n", dim);
-	size = element_to_bytes(string, ith_element);
-	sprintf((char *)&hex_value[0], "0x");
-	for (ii = 0 ; ii < size; ii++) {
-		sprintf((char *)&hex_value[2*ii], "%02X", string[ii]);
+	if (!((Element *)op)->ready) {
+		PyErr_SetString(PyExc_ValueError, "Element has not been initialised.");
+		return NULL;
 	}
-	// terminate string with NULL
-	hex_value[2*size] = NULL;
-	// translate hex (base 16) to python long 
-	return PyLong_FromString(hex_value, NULL, 16);
+	return (Element *)op;
 }
 
-PyMemberDef Element_members[] = {
-	{NULL}
-};
+static struct element_s *capi_Element_AsElement(PyObject *op) {
+	Element *e = capi_element(op);
+	return e ? e->pbc_element : NULL;
+}
 
-PyMethodDef Element_methods[] = {
-	{"from_hash", (PyCFunction)Element_from_hash, METH_VARARGS | METH_CLASS, "Creates an Element from the given hash value."},
-	{"random", (PyCFunction)Element_random, METH_VARARGS | METH_CLASS, "Creates a random element from the given group."},
-	{"zero", (PyCFunction)Element_zero, METH_VARARGS | METH_CLASS, "Creates an element representing the additive identity for its group."},
-	{"one", (PyCFunction)Element_one, METH_VARARGS | METH_CLASS, "Creates an element representing the multiplicative identity for its group."},
-	{NULL, NULL}
-};
+static int capi_Element_Group(PyObject *op) {
+	Element *e = capi_element(op);
+	return e ? (int)e->group : -1;
+}
 
-PyNumberMethods Element_num_meths = {
-	Element_add,		//binaryfunc nb_add;
-	Element_sub,		//binaryfunc nb_subtract;
-	Element_mult,		//binaryfunc nb_multiply;
-	0,				//binaryfunc nb_remainder;
-	0,				//binaryfunc nb_divmod;
-	Element_pow,		//ternaryfunc nb_power;
-	(unaryfunc)Element_neg,		//unaryfunc nb_negative;
-	0,				//unaryfunc nb_positive;
-	0,				//unaryfunc nb_absolute;
-	0,	//inquiry nb_bool;
-	(unaryfunc)Element_invert,	//unaryfunc nb_invert;
-	0,				//binaryfunc nb_lshift;
-	0,				//binaryfunc nb_rshift;
-	0,				//binaryfunc nb_and;
-	0,				//binaryfunc nb_xor;
-	0,				//binaryfunc nb_or;
-	(unaryfunc)Element_int,		//unaryfunc nb_int;
-	0,				//void *nb_reserved;
-	0,				//unaryfunc nb_float;
-
-	0,				//binaryfunc nb_inplace_add;
-	0,				//binaryfunc nb_inplace_subtract;
-	0,				//binaryfunc nb_inplace_multiply;
-	0,				//binaryfunc nb_inplace_remainder;
-	0,				//ternaryfunc nb_inplace_power;
-	0,				//binaryfunc nb_inplace_lshift;
-	0,				//binaryfunc nb_inplace_rshift;
-	0,				//binaryfunc nb_inplace_and;
-	0,				//binaryfunc nb_inplace_xor;
-	0,				//binaryfunc nb_inplace_or;
-	0,
-	0,				//binaryfunc nb_floor_divide;
-	Element_div,		//binaryfunc nb_true_divide;
-	0,				//binaryfunc nb_inplace_floor_divide;
-	0,				//binaryfunc nb_inplace_true_divide;
-};
+static PyObject *capi_Element_Pairing(PyObject *op) {
+	Element *e = capi_element(op);
+	return e ? e->pairing : NULL;
+}
+
+// an uninitialised Element bound to the pairing's interpreter
+static Element *capi_element_for(PyObject *pairing, int group) {
+	if (capi_Pairing_AsPairing(pairing) == NULL) {
+		return NULL;
+	}
+	if (group < G1 || group > Zr) {
+		PyErr_SetString(PyExc_ValueError, "Invalid group.");
+		return NULL;
+	}
+	return Element_create(pypbc_state_of(pairing));
+}
 
+// the field elements of a group of p live in
+static field_ptr capi_group_field(struct pairing_s *p, int group) {
+	switch (group) {
+		case G1: return p->G1;
+		case G2: return p->G2;
+		case GT: return p->GT;
+		default: return p->Zr;
+	}
+}
 
-PySequenceMethods Element_sq_meths = {
-    Element_len,       /* inquiry sq_length;             /* __len__ */
-    0,    /* binaryfunc sq_concat;          /* __add__ */
-    0,    /* intargfunc sq_repeat;          /* __mul__ */
-    Element_GetItem,   /* intargfunc sq_item;            /* __getitem__ */
-    0,  /* intintargfunc sq_slice;        /* __getslice__ */
-    0,   /* intobjargproc sq_ass_item;     /* __setitem__ */
-    0,  /* intintobjargproc sq_ass_slice; /* __setslice__ */
-};
+static PyObject *capi_Element_FromElement(PyObject *pairing, int group, struct element_s *e) {
+	Element *self = capi_element_for(pairing, group);
+	if (self == NULL) {
+		// it's ours either way, so don't leak it
+		element_clear(e);
+		return NULL;
+	}
+	// an element of some other field would be read as if it were of this one
+	if (e->field != capi_group_field(((Pairing *)pairing)->pbc_pairing, group)) {
+		Py_DECREF(self);
+		element_clear(e);
+		PyErr_SetString(PyExc_ValueError, "element is not in that group of that pairing.");
+		return NULL;
+	}
+	// move the element into the new object
+	self->pbc_element[0] = *e;
+	Py_INCREF(pairing);
+	self->pairing = pairing;
+	self->group = group;
+	self->ready = 1;
+	return (PyObject *)self;
+}
 
+static PyObject *capi_Element_New(PyObject *pairing, int group) {
+	Element *self = capi_element_for(pairing, group);
+	if (self == NULL) {
+		return NULL;
+	}
+	if (Element_init_group(self, pairing, group) < 0) {
+		Py_DECREF(self);
+		return NULL;
+	}
+	element_set0(self->pbc_element);
+	return (PyObject *)self;
+}
 
-PyTypeObject ElementType = {
-	PyVarObject_HEAD_INIT(NULL, 0)
-	"pypbc.Element",             /*tp_name*/
-	sizeof(Element),             /*tp_basicsize*/
-	0,                         /*tp_itemsize*/
-	(destructor)Element_dealloc, /*tp_dealloc*/
-	0,                         /*tp_print*/
-	0,                         /*tp_getattr*/
-	0,                         /*tp_setattr*/
-	0,			   /*tp_reserved*/
-	Element_str,                         /*tp_repr*/
-	&Element_num_meths,                         /*tp_as_number*/
-	&Element_sq_meths,                         /*tp_as_sequence*/
-	0,                         /*tp_as_mapping*/
-	0,                         /*tp_hash */
-	0,                         /*tp_call*/
-	Element_str,                         /*tp_str*/
-	0,                         /*tp_getattro*/
-	0,                         /*tp_setattro*/
-	0,                         /*tp_as_buffer*/
-	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
-	Element__doc__,           /* tp_doc */
-	0,		               /* tp_traverse */
-	0,		               /* tp_clear */
-	Element_cmp,		               /* tp_richcompare */
-	0,		               /* tp_weaklistoffset */
-	0,		               /* tp_iter */
-	0,		               /* tp_iternext */
-	Element_methods,             /* tp_methods */
-	Element_members,             /* tp_members */
-	0,                         /* tp_getset */
-	0,                         /* tp_base */
-	0,                         /* tp_dict */
-	0,                         /* tp_descr_get */
-	0,                         /* tp_descr_set */
-	0,                         /* tp_dictoffset */
-	(initproc)Element_init,      /* tp_init */
-	0,                         /* tp_alloc */
-	Element_new,                 /* tp_new */
+// the groups are numbered the same on both sides
+static PyPBC_CAPI pypbc_capi = {
+	PYPBC_CAPI_VERSION,
+	capi_Pairing_Check,
+	capi_Element_Check,
+	capi_Pairing_AsPairing,
+	capi_Element_AsElement,
+	capi_Element_Group,
+	capi_Element_Pairing,
+	capi_Element_FromElement,
+	capi_Element_New
 };
 
 /*******************************************************************************
@@ -1402,51 +7805,188 @@ PyTypeObject ElementType = {
 PyMethodDef pypbc_methods[] = {
 	{"get_random_prime", get_random_prime, METH_VARARGS, "get a random n-bit prime"},
 	{"get_random", get_random, METH_VARARGS, "get a random value less than n"},
+	{"get_random_primes", get_random_primes, METH_VARARGS, get_random_primes__doc__},
+	{"get_random_primes_async", get_random_primes_async, METH_VARARGS, get_random_primes_async__doc__},
+	{"generate_parameters_async", (PyCFunction)generate_parameters_async, METH_VARARGS | METH_KEYWORDS, generate_parameters_async__doc__},
 	{"set_point_format_compressed", set_point_format_compressed, METH_NOARGS, "Set option to use compressed (sign + X) point format"},
 	{"set_point_format_uncompressed", set_point_format_uncompressed, METH_NOARGS, "Set option to use uncompressed (X,Y) point format"},
+	{"set_random_source", set_random_source, METH_O, set_random_source__doc__},
+	{"get_random_source", get_random_source, METH_NOARGS, get_random_source__doc__},
+	{"clear_pairing_cache", clear_pairing_cache, METH_NOARGS, clear_pairing_cache__doc__},
+	{"set_fp_backend", set_fp_backend, METH_VARARGS, set_fp_backend__doc__},
+	{"get_fp_backend", get_fp_backend, METH_NOARGS, get_fp_backend__doc__},
+	{"set_stats_enabled", set_stats_enabled, METH_O, set_stats_enabled__doc__},
+	{"get_stats_enabled", get_stats_enabled, METH_NOARGS, get_stats_enabled__doc__},
+	{"_stats_scope_enter", _stats_scope_enter, METH_NOARGS, _stats_scope_enter__doc__},
+	{"_stats_scope_exit", _stats_scope_exit, METH_NOARGS, _stats_scope_exit__doc__},
+	{"start_trace", (PyCFunction)start_trace, METH_VARARGS | METH_KEYWORDS, start_trace__doc__},
+	{"stop_trace", stop_trace, METH_NOARGS, stop_trace__doc__},
+	{"pack_elements", (PyCFunction)pack_elements, METH_VARARGS | METH_KEYWORDS, pack_elements__doc__},
+	{"unpack_elements", (PyCFunction)unpack_elements, METH_VARARGS | METH_KEYWORDS, unpack_elements__doc__},
 	{NULL, NULL, 0, NULL}
 };
 
-PyModuleDef pypbc_module = {
-	PyModuleDef_HEAD_INIT,
-	"pypbc",
-	"pypbc",
-	-1,
-	pypbc_methods
-};
+// builds the types and state for one import of the module
+static int pypbc_exec(PyObject *m) {
+	pypbc_state *state = PyModule_GetState(m);
 
-PyMODINIT_FUNC
-PyInit_pypbc(void) 
-{
-	PyObject* m;
-	
-	if (PyType_Ready(&ParametersType) < 0)
-		return NULL;
+	// the types, which belong to this module object alone
+	state->ParametersType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &Parameters_spec, NULL);
+	if (state->ParametersType == NULL)
+		return -1;
+	state->PairingType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &Pairing_spec, NULL);
+	if (state->PairingType == NULL)
+		return -1;
+	state->ElementType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &Element_spec, NULL);
+	if (state->ElementType == NULL)
+		return -1;
+	// Element(...) is called far more than any other constructor, so it gets
+	// a vectorcall entry point; subclasses don't inherit it
+	state->ElementType->tp_vectorcall = Element_vectorcall;
+	state->HashToGroupType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &HashToGroup_spec, NULL);
+	if (state->HashToGroupType == NULL)
+		return -1;
+	state->RandomSourceType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &RandomSource_spec, NULL);
+	if (state->RandomSourceType == NULL)
+		return -1;
+	state->ElementBufferType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &ElementBuffer_spec, NULL);
+	if (state->ElementBufferType == NULL)
+		return -1;
+	state->PointAccumulatorType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &PointAccumulator_spec, NULL);
+	if (state->PointAccumulatorType == NULL)
+		return -1;
+	state->PowTableType = (PyTypeObject *)PyType_FromModuleAndSpec(m, &PowTable_spec, NULL);
+	if (state->PowTableType == NULL)
+		return -1;
 
-	if (PyType_Ready(&PairingType) < 0)
-		return NULL;
+	// the table behind Pairing.intern
+	state->pairing_intern = PyDict_New();
+	if (state->pairing_intern == NULL)
+		return -1;
 
-	if (PyType_Ready(&ElementType) < 0)
-		return NULL;
+	// points are compressed unless asked otherwise
+	state->point_compressed = 1;
+	// and Fp is PBC's default
+	state->fp_backend = fp_backends[0];
 
-	m = PyModule_Create(&pypbc_module);
+	// count what PBC and GMP allocate, and tell tracemalloc about it
+	native_hooks_install();
 
-	if (m == NULL)
-		return NULL;
+	// let native threads find their way back into this interpreter...
+	state->interp = interp_new();
+	if (state->interp == NULL)
+		return -1;
+
+	// ...until it goes away
+	PyObject *atexit = PyImport_ImportModule("atexit");
+	if (atexit == NULL)
+		return -1;
+	PyObject *hook = PyCFunction_New(&background_atexit_def, m);
+	PyObject *ret = hook ? PyObject_CallMethod(atexit, "register", "O", hook) : NULL;
+	Py_XDECREF(hook);
+	Py_DECREF(atexit);
+	if (ret == NULL)
+		return -1;
+	Py_DECREF(ret);
 
-	Py_INCREF(&PairingType);
-	Py_INCREF(&ParametersType);
-	Py_INCREF(&ElementType);
 	// add the objects
-	PyModule_AddObject(m, "Parameters", (PyObject *)&ParametersType);
-	PyModule_AddObject(m, "Pairing", (PyObject *)&PairingType);
-	PyModule_AddObject(m, "Element", (PyObject *)&ElementType);
+	if (PyModule_AddType(m, state->ParametersType) < 0 ||
+			PyModule_AddType(m, state->PairingType) < 0 ||
+			PyModule_AddType(m, state->ElementType) < 0 ||
+			PyModule_AddType(m, state->HashToGroupType) < 0 ||
+			PyModule_AddType(m, state->RandomSourceType) < 0 ||
+			PyModule_AddType(m, state->ElementBufferType) < 0 ||
+			PyModule_AddType(m, state->PointAccumulatorType) < 0 ||
+			PyModule_AddType(m, state->PowTableType) < 0)
+		return -1;
 	// add the constants
-	PyModule_AddObject(m, "G1", PyLong_FromLong(G1));
-	PyModule_AddObject(m, "G2", PyLong_FromLong(G2));
-	PyModule_AddObject(m, "GT", PyLong_FromLong(GT));
-	PyModule_AddObject(m, "Zr", PyLong_FromLong(Zr));
-	// expose point format
-	PyModule_AddObject(m, "PBC_EC_Compressed", PyLong_FromLong(PBC_EC_Compressed));
-	return m;
+	if (PyModule_AddIntConstant(m, "G1", G1) < 0 ||
+			PyModule_AddIntConstant(m, "G2", G2) < 0 ||
+			PyModule_AddIntConstant(m, "GT", GT) < 0 ||
+			PyModule_AddIntConstant(m, "Zr", Zr) < 0)
+		return -1;
+	// expose the default point format
+	if (PyModule_AddIntConstant(m, "PBC_EC_Compressed", state->point_compressed) < 0)
+		return -1;
+	// and the tracemalloc domain of native allocations
+	if (PyModule_AddIntConstant(m, "TRACEMALLOC_DOMAIN", PYPBC_TRACEMALLOC_DOMAIN) < 0)
+		return -1;
+	// and the C API
+	PyObject *capi = PyCapsule_New(&pypbc_capi, PYPBC_CAPI_NAME, NULL);
+	if (capi == NULL || PyModule_AddObject(m, "_C_API", capi) < 0) {
+		Py_XDECREF(capi);
+		return -1;
+	}
+	return 0;
+}
+
+static int pypbc_traverse(PyObject *m, visitproc visit, void *arg) {
+	pypbc_state *state = PyModule_GetState(m);
+	Py_VISIT(state->ParametersType);
+	Py_VISIT(state->PairingType);
+	Py_VISIT(state->ElementType);
+	Py_VISIT(state->HashToGroupType);
+	Py_VISIT(state->RandomSourceType);
+	Py_VISIT(state->ElementBufferType);
+	Py_VISIT(state->PointAccumulatorType);
+	Py_VISIT(state->PowTableType);
+	Py_VISIT(state->pairing_intern);
+	Py_VISIT(state->random_source);
+	return 0;
+}
+
+static int pypbc_clear(PyObject *m) {
+	pypbc_state *state = PyModule_GetState(m);
+	Py_CLEAR(state->ParametersType);
+	Py_CLEAR(state->PairingType);
+	Py_CLEAR(state->ElementType);
+	Py_CLEAR(state->HashToGroupType);
+	Py_CLEAR(state->RandomSourceType);
+	Py_CLEAR(state->ElementBufferType);
+	Py_CLEAR(state->PointAccumulatorType);
+	Py_CLEAR(state->PowTableType);
+	Py_CLEAR(state->pairing_intern);
+	Py_CLEAR(state->random_source);
+	return 0;
+}
+
+static void pypbc_free(void *m) {
+	pypbc_state *state = PyModule_GetState((PyObject *)m);
+	pypbc_clear((PyObject *)m);
+	if (state->interp != NULL) {
+		interp_release(state->interp);
+		state->interp = NULL;
+	}
+}
+
+static PyModuleDef_Slot pypbc_slots[] = {
+	{Py_mod_exec, pypbc_exec},
+#ifdef Py_mod_multiple_interpreters
+	// nothing is shared between interpreters except through our own locks
+	{Py_mod_multiple_interpreters, Py_MOD_PER_INTERPRETER_GIL_SUPPORTED},
+#endif
+#ifdef Py_mod_gil
+	// and nothing leans on the GIL either
+	{Py_mod_gil, Py_MOD_GIL_NOT_USED},
+#endif
+	{0, NULL}
+};
+
+// the native half of the pypbc package, which re-exports all of it
+PyModuleDef pypbc_module = {
+	PyModuleDef_HEAD_INIT,
+	"pypbc._pypbc",
+	"pypbc",
+	sizeof(pypbc_state),
+	pypbc_methods,
+	pypbc_slots,
+	pypbc_traverse,
+	pypbc_clear,
+	pypbc_free
+};
+
+PyMODINIT_FUNC
+PyInit__pypbc(void) 
+{
+	return PyModuleDef_Init(&pypbc_module);
 }
@@ -1,4 +1,5 @@
 // python stuff
+#define PY_SSIZE_T_CLEAN
 #include <Python.h>
 #include "structmember.h"
 
@@ -25,7 +26,90 @@ from Python3
 // used to see which group a given element is in
 enum Group {G1, G2, GT, Zr};
 
+// how a Pairing raises elements of each group to a power: PBC's own method,
+// or a fixed window, sliding window or width-w NAF of our own, or for GT on
+// type A and A1 curves a width-w NAF with cyclotomic squarings
+enum PowMethod {POW_PBC, POW_FIXED, POW_SLIDING, POW_WNAF, POW_CYCLOTOMIC};
+// packs a method and window width into one int, so both change together
+#define POW_CONFIG(method, window) ((method) | ((window) << 8))
+#define POW_CONFIG_METHOD(config) ((config) & 0xff)
+#define POW_CONFIG_WINDOW(config) ((config) >> 8)
+
+// SHA-256 state, used to digest messages before mapping them into a group
+#define SHA256_DIGEST_SIZE 32
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    unsigned char block[64];
+    size_t used;
+} sha256_ctx;
+
+void sha256_init(sha256_ctx *ctx);
+void sha256_update(sha256_ctx *ctx, const unsigned char *data, size_t len);
+void sha256_final(sha256_ctx *ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+// ChaCha20 keystream state, one per thread drawing from a RandomSource
+typedef struct {
+    uint32_t input[16];
+    unsigned char block[64];
+    int available;
+    uint64_t generation;
+} chacha20_stream;
+
+void chacha20_keystream(chacha20_stream *stream, unsigned char *out, size_t len);
+
+// critical sections only exist on free-threaded builds (3.13+); everywhere
+// else the GIL already serialises what they guard
+#ifndef Py_BEGIN_CRITICAL_SECTION
+#define Py_BEGIN_CRITICAL_SECTION(op) {
+#define Py_END_CRITICAL_SECTION() }
+#define Py_BEGIN_CRITICAL_SECTION2(a, b) {
+#define Py_END_CRITICAL_SECTION2() }
+#endif
+
+// one per interpreter that imports us. Native threads use it to find their
+// way back into that interpreter, and to find out when they no longer can.
+typedef struct {
+    PyInterpreterState *interp;
+    int alive;
+    int attached;
+    int refs;
+} pypbc_interp;
+
+// everything the module keeps per interpreter
+typedef struct {
+    PyTypeObject *ParametersType;
+    PyTypeObject *PairingType;
+    PyTypeObject *ElementType;
+    PyTypeObject *HashToGroupType;
+    PyTypeObject *RandomSourceType;
+    PyTypeObject *ElementBufferType;
+    PyTypeObject *PointAccumulatorType;
+    PyTypeObject *PowTableType;
+    // SHA-256 of the parameter string -> Pairing, behind Pairing.intern
+    PyObject *pairing_intern;
+    // the RandomSource this interpreter installed, and when
+    PyObject *random_source;
+    uint64_t random_installed;
+    // the point format str() uses when none is asked for
+    int point_compressed;
+    // the Fp implementation new Pairings use
+    const char *fp_backend;
+    pypbc_interp *interp;
+} pypbc_state;
+
+extern PyModuleDef pypbc_module;
+
+pypbc_state *pypbc_state_from_type(PyTypeObject *type);
+#define pypbc_state_of(op) pypbc_state_from_type(Py_TYPE(op))
+
 // We're going to need a few types
+// the tracemalloc domain PBC and GMP allocations are reported in
+#define PYPBC_TRACEMALLOC_DOMAIN 0x70626300
+
+// routes PBC's and GMP's allocations through our accounting
+void native_hooks_install(void);
+
 // the param type
 typedef struct {
     PyObject_HEAD
@@ -36,26 +120,106 @@ typedef struct {
 PyObject *Parameters_new(PyTypeObject *type, PyObject *args, PyObject *kwds);
 int Parameters_init(Parameters *self, PyObject *args, PyObject *kwargs);
 void Parameters_dealloc(Parameters *parameter);
+PyObject *Parameters_str(Parameters *parameters);
+PyObject *Parameters_sizeof(Parameters *self, PyObject *unused);
 
 PyMemberDef Parameters_members[];
 PyMethodDef Parameters_methods[];
-PyTypeObject ParametersType;
+PyType_Spec Parameters_spec;
+
+// what the GLV method needs for one group: the endomorphism (x, y) ->
+// (beta x, y), the lambda it multiplies the group by, and a short basis
+// (a1, b1), (a2, b2) of the pairs with a + b lambda = 0 (mod r)
+typedef struct {
+    int ready;
+    element_t beta;
+    mpz_t lambda;
+    mpz_t a1, b1, a2, b2;
+} glv_data;
+
+// what Pairing.stats() counts and times: pairings, powers, products,
+// hashes into a group, Elements built from a value, and str()
+enum StatOp {STAT_APPLY, STAT_POW, STAT_MULT, STAT_FROM_HASH, STAT_PARSE, STAT_STR, STAT_COUNT};
+
+// a count and the total nanoseconds spent on each of them
+typedef struct {
+    uint64_t count[STAT_COUNT];
+    uint64_t ns[STAT_COUNT];
+} pypbc_stats;
+
+// the clock reading an operation started at, or 0 if statistics and
+// tracing are both off
+uint64_t stats_begin(void);
 
 // the pairing type
 typedef struct {
     PyObject_HEAD
     pairing_t pbc_pairing;
     int ready;
+    // set by pairing.set_glv(); glv_groups is worked out the first time,
+    // marked by glv_checked, and never changes after that
+    int glv;
+    int glv_checked;
+    glv_data glv_groups[2];
+    // a POW_CONFIG for each group, indexed by enum Group
+    int pow_config[4];
+    // set if GT sits in a quadratic extension of Fq, as on types A and A1
+    int gt_quadratic;
+    // the name of the Fp implementation it was built with, and a dict of
+    // the fields "native" put kernels on
+    const char *fp_backend;
+    PyObject *fp_kernels;
+    // set up by factors=: the prime factors of a composite group order, the
+    // CRT idempotents (1 modulo one factor and 0 modulo the rest), and a
+    // generator of each factor's subgroup of G1, G2 and GT
+    int nfactors;
+    mpz_t *factors;
+    mpz_t *idempotents;
+    element_t *subgroup_gens[3];
+    PyObject *factor_tuple;
+    // operation counts and times, while statistics are switched on
+    pypbc_stats stats;
+    // the Parameters it was built from, and its id in the current trace
+    PyObject *parameters;
+    uint64_t trace_id;
+    // bytes PBC and GMP allocated for it, and for its GLV and CRT data
+    long long native_size;
 } Pairing;
 
 PyObject *Pairing_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
-int Pairing_init(Pairing *self, PyObject *args);
+int Pairing_init(Pairing *self, PyObject *args, PyObject *kwargs);
 void Pairing_dealloc(Pairing *pairing);
-PyObject* Pairing_apply(PyObject *self, PyObject *args);
+PyObject* Pairing_apply(PyObject *self, PyObject *const *args, Py_ssize_t nargs);
+PyObject *Pairing_intern(PyObject *cls, PyObject *parameters);
+PyObject *Pairing_apply_async(PyObject *self, PyObject *args);
+PyObject *Pairing_apply_product_async(PyObject *self, PyObject *pairs);
+PyObject *Pairing_apply_batch(PyObject *self, PyObject *requests);
+PyObject *Pairing_set_glv(Pairing *self, PyObject *args);
+PyObject *Pairing_set_pow_method(Pairing *self, PyObject *args, PyObject *kwargs);
+PyObject *Pairing_get_pow_method(Pairing *self, PyObject *args);
+PyObject *Pairing_tune_pow(Pairing *self, PyObject *unused);
+PyObject *Pairing_is_symmetric(Pairing *self, PyObject *unused);
+PyObject *Pairing_project(Pairing *self, PyObject *args);
+PyObject *Pairing_random_subgroup(Pairing *self, PyObject *args);
+PyObject *Pairing_stats(Pairing *self, PyObject *unused);
+PyObject *Pairing_reset_stats(Pairing *self, PyObject *unused);
+PyObject *Pairing_sizeof(Pairing *self, PyObject *unused);
+
+// arithmetic on pairings of composite order whose factors are known
+#define COMPOSITE_MAX_FACTORS 32
+int composite_setup(Pairing *pairing, PyObject *factors);
+void composite_clear(Pairing *pairing);
+void composite_order(mpz_t order, Pairing *pairing, unsigned int subgroups);
+void composite_pow_zr(element_ptr out, element_ptr base, mpz_t k, Pairing *pairing);
+
+// scalar multiplication by the GLV method, for pairings that have it on
+glv_data *pairing_glv(Pairing *pairing, enum Group group);
+void glv_clear(glv_data *g);
+int element_pow_glv(element_ptr out, element_ptr base, mpz_t k, mpz_t r, glv_data *g);
 
 PyMemberDef Pairing_members[];
 PyMethodDef Pairing_methods[];
-PyTypeObject PairingType;
+PyType_Spec Pairing_spec;
 
 // the element type
 typedef struct {
@@ -64,14 +228,182 @@ typedef struct {
     PyObject *pairing;
     element_t pbc_element;
     int ready;
+    // on a pairing with factors, bit i is set if the element may have a
+    // component in the subgroup of factor i; 0 if that isn't known
+    unsigned int subgroups;
+    // its id in the current trace, if it has been in one
+    uint64_t trace_id;
 } Element;
 
+// adds an operation begun at start, which made out from a and b (either
+// of which may be NULL), to the stats of out's pairing and of this thread,
+// and to the trace if one is being written
+void stats_end(enum StatOp op, Element *out, PyObject *a, PyObject *b, uint64_t start);
+
 PyMemberDef Element_members[];
 PyMethodDef Element_methods[];
-PyTypeObject ElementType;
+PyType_Spec Element_spec;
 
 PyObject *Element_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
 int Element_init(PyObject *self, PyObject *args, PyObject *kwargs);
+PyObject *Element_vectorcall(PyObject *type, PyObject *const *args, size_t nargsf, PyObject *kwnames);
 void Element_dealloc(Element *element);
+Element *Element_create(pypbc_state *state);
+PyObject *Element_from_hash_many(PyObject *cls, PyObject *args);
+PyObject *Element_random_many(PyObject *cls, PyObject *args);
+PyObject *Element_pow_async(PyObject *self, PyObject *exponent);
+PyObject *Element_sizeof(Element *self, PyObject *unused);
+
+// exponentiation by whatever the pairing is set up to use for the group
+int element_pow_is_custom(Element *base);
+int element_pow_custom(element_ptr out, Element *base, mpz_t k);
+
+// element_pow_custom in two halves, for powers worked out on another
+// thread: pow_plan_init reads the pairing's settings and reduces the
+// exponent with the GIL held, and pow_plan_run needs no GIL
+typedef struct {
+    Pairing *pairing;
+    glv_data *glv;
+    int config;
+    // a power in Zr by the CRT
+    int crt;
+    mpz_t k;
+} pow_plan;
+void pow_plan_init(pow_plan *plan, Element *base, mpz_t k);
+int pow_plan_run(element_ptr out, element_ptr base, pow_plan *plan);
+void pow_plan_clear(pow_plan *plan);
+void pairing_tune_pow(Pairing *pairing);
+
+// byte encodings of elements, shared by Element.to_bytes and ElementBuffer
+int element_encoded_length(element_ptr e, enum Group group, int compressed);
+int element_encode(unsigned char *out, element_ptr e, enum Group group, int compressed);
+int gt_is_quadratic(element_ptr e);
+void element_decode(element_ptr e, enum Group group, unsigned char *in, int len, int compressed);
+
+// the streaming hash-to-group type
+typedef struct {
+    PyObject_HEAD
+    PyObject *pairing;
+    enum Group group;
+    sha256_ctx ctx;
+    int ready;
+} HashToGroup;
+
+PyMethodDef HashToGroup_methods[];
+PyType_Spec HashToGroup_spec;
+
+PyObject *HashToGroup_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+int HashToGroup_init(HashToGroup *self, PyObject *args, PyObject *kwargs);
+void HashToGroup_dealloc(HashToGroup *self);
+
+// the random source type
+typedef struct {
+    PyObject_HEAD
+    uint32_t key[8];
+    int deterministic;
+    int ready;
+} RandomSource;
+
+PyMethodDef RandomSource_methods[];
+PyType_Spec RandomSource_spec;
+
+PyObject *RandomSource_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+int RandomSource_init(RandomSource *self, PyObject *args, PyObject *kwargs);
+void RandomSource_dealloc(RandomSource *self);
+
+// a packed array of element encodings, exported as a 2-D uint8 buffer
+typedef struct {
+    PyObject_HEAD
+    PyObject *pairing;
+    enum Group group;
+    int compressed;
+    Py_ssize_t shape[2];
+    Py_ssize_t strides[2];
+    unsigned char *data;
+} ElementBuffer;
+
+PyMemberDef ElementBuffer_members[];
+PyMethodDef ElementBuffer_methods[];
+PyType_Spec ElementBuffer_spec;
+
+void ElementBuffer_dealloc(ElementBuffer *self);
+
+// a curve point in Jacobian coordinates, standing for (X/Z^2, Y/Z^3); Z == 0
+// is the point at infinity
+typedef struct {
+    element_t X, Y, Z;
+} jacobian_point;
+
+// the curve's a coefficient, and scratch space for the Jacobian formulas
+typedef struct {
+    element_t a;
+    int a_is0;
+    element_t t[7];
+} jacobian_ctx;
+
+// the point accumulator type
+typedef struct {
+    PyObject_HEAD
+    PyObject *pairing;
+    enum Group group;
+    jacobian_point sum;
+    // add_scaled builds k*P here before adding it in
+    jacobian_point scaled;
+    jacobian_ctx ctx;
+    int ready;
+} PointAccumulator;
+
+PyMemberDef PointAccumulator_members[];
+PyMethodDef PointAccumulator_methods[];
+PyType_Spec PointAccumulator_spec;
+
+PyObject *PointAccumulator_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+int PointAccumulator_init(PointAccumulator *self, PyObject *args, PyObject *kwargs);
+void PointAccumulator_dealloc(PointAccumulator *self);
+
+// the layout a PowTable exports: this header, then windows * (2^window - 1)
+// uncompressed element encodings of entry_size bytes each, the one for digit
+// d of window i being base^(d * 2^(window * i)). There are only offsets in
+// it, so it can be mapped at any address, in any process.
+#define PYPBC_POW_TABLE_MAGIC "PBCPOWT"
+#define POW_TABLE_VERSION 1
+#define POW_TABLE_MAX_WINDOW 12
+
+typedef struct {
+    char magic[8];
+    // in the writer's byte order, so a reader on the other sees it swapped
+    uint32_t version;
+    uint32_t group;
+    uint32_t window;
+    uint32_t windows;
+    uint32_t entry_size;
+    uint32_t reserved;
+    // FNV-1a of the parameters' text form
+    uint64_t fingerprint;
+} pow_table_header;
+
+// the fixed-base power table type
+typedef struct {
+    PyObject_HEAD
+    PyObject *pairing;
+    PyObject *base;
+    enum Group group;
+    int window;
+    int windows;
+    int entry_size;
+    // the header and entries: our own memory, or when attached, that of the
+    // buffer in source
+    unsigned char *data;
+    Py_ssize_t size;
+    Py_buffer source;
+    int attached;
+} PowTable;
+
+PyMemberDef PowTable_members[];
+PyMethodDef PowTable_methods[];
+PyType_Spec PowTable_spec;
+
+PyObject *PowTable_new(PyTypeObject *type, PyObject *args, PyObject *kwargs);
+void PowTable_dealloc(PowTable *self);
 
 #endif
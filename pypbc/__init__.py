@@ -0,0 +1,16 @@
+"""
+pypbc
+
+Licensed under GPLv3
+
+Python bindings to PBC. The bindings themselves are the native module
+pypbc._pypbc, all of which is re-exported here (including the _C_API
+capsule other extension modules import), along with the helpers written in
+Python.
+"""
+
+from pypbc._pypbc import *
+from pypbc._pypbc import _C_API
+
+from pypbc.advisor import advise, advice_table
+from pypbc.stats import scope as stats_scope
@@ -0,0 +1,176 @@
+"""
+advisor.py
+
+Licensed under GPLv3
+
+Picks pairing parameters for a security level by timing candidates on this
+host. Which curve type is fastest depends on the CPU and on the mix of
+pairings and powers a scheme does, so rather than guess, advise() builds a
+curve of each type big enough for the security level, times the operations
+the workload names, and ranks the curves by the weighted sum.
+
+Type A1 curves are left out: their composite order makes their security a
+question of factoring as well, which is up to the scheme.
+"""
+
+import json
+import os
+import platform
+import timeit
+
+from pypbc._pypbc import *
+
+# the bits of a finite field whose discrete logarithms are about as hard as
+# each security level, after NIST SP 800-57. GT lives in such a field, so it
+# has to be at least this big.
+FIELD_BITS = {80: 1024, 112: 2048, 128: 3072, 192: 7680, 256: 15360}
+
+# the sizes of q the known type D and G discriminants give (see Parameters)
+CM_QBITS = {"d": [159, 201, 224], "g": [149]}
+
+# what each workload entry times; g1, g2 and gt are random, k is in Zr
+KERNELS = {
+	"pairing": "pairing.apply(g1, g2)",
+	"g1_pow": "g1**k",
+	"g2_pow": "g2**k",
+	"gt_pow": "gt**k",
+	"g1_mul": "g1 * h1",
+	"gt_mul": "gt * gt",
+	"hash_g1": "Element.from_hash(pairing, G1, b'message')",
+}
+
+TYPES = ("a", "e", "f", "d", "g")
+
+def field_bits(security):
+	"""The size of GT needed for the given security level, in bits."""
+	for level in sorted(FIELD_BITS):
+		if security <= level:
+			return FIELD_BITS[level]
+	raise ValueError("security levels above %d bits are not supported" % max(FIELD_BITS))
+
+def candidates(security, types=TYPES):
+	"""Yields (type, keyword arguments for Parameters) for each of the given
+	curve types that can reach the security level. G1 needs a subgroup of
+	twice the security level, and GT a field of field_bits(security); the
+	embedding degree (2 for A, 1 for E, 12 for F, 6 for D, 10 for G) decides
+	how big q has to be for that."""
+	rbits = 2 * security
+	gt = field_bits(security)
+	for t in types:
+		if t == "a":
+			yield t, {"qbits": gt // 2, "rbits": rbits}
+		elif t == "e":
+			yield t, {"qbits": gt, "rbits": rbits, "short": True}
+		elif t == "f":
+			yield t, {"n": max(rbits, -(-gt // 12)), "short": True}
+		elif t in CM_QBITS:
+			need = max(rbits, -(-gt // (6 if t == "d" else 10)))
+			fits = [qbits for qbits in CM_QBITS[t] if qbits >= need]
+			if fits:
+				yield t, {"family": t, "qbits": min(fits)}
+		else:
+			raise ValueError("unknown curve type %r" % t)
+
+def host_key():
+	"""Identifies this host and Python in the cache, since timings from
+	anywhere else mean nothing here."""
+	return "%s/%s/%d/%s" % (platform.machine(), platform.processor(), os.cpu_count() or 0, platform.python_version())
+
+def measure(params, kernels, number=20, repeat=3):
+	"""Returns ({kernel: seconds per call}, {group: bytes per element}) for
+	a pairing built from params. Points are counted compressed, as is GT
+	where it can be."""
+	pairing = Pairing(params)
+	g1 = Element.random(pairing, G1)
+	g2 = Element.random(pairing, G2)
+	env = {
+		"pairing": pairing,
+		"Element": Element,
+		"G1": G1,
+		"g1": g1,
+		"g2": g2,
+		"h1": Element.random(pairing, G1),
+		"gt": pairing.apply(g1, g2),
+		"k": Element.random(pairing, Zr),
+	}
+	times = {}
+	for kernel in kernels:
+		timer = timeit.Timer(KERNELS[kernel], globals=env)
+		times[kernel] = min(timer.repeat(repeat=repeat, number=number)) / number
+	sizes = {"G1": len(g1.to_bytes(compressed=True)), "G2": len(g2.to_bytes(compressed=True))}
+	try:
+		sizes["GT"] = len(env["gt"].to_bytes(compressed=True))
+	except ValueError:
+		sizes["GT"] = len(env["gt"].to_bytes())
+	return times, sizes
+
+def _load_cache(path):
+	try:
+		with open(path) as f:
+			return json.load(f)
+	except FileNotFoundError:
+		return {}
+	except ValueError:
+		# unreadable, so start over rather than fail
+		return {}
+
+def _save_cache(path, data):
+	# write it whole and then swap it in, so readers never see half a file
+	tmp = "%s.%d.tmp" % (path, os.getpid())
+	with open(tmp, "w") as f:
+		json.dump(data, f, indent=1, sort_keys=True)
+	os.replace(tmp, path)
+
+def advise(security_bits, workload=None, types=TYPES, cache=None, number=20, repeat=3):
+	"""Ranks curve types for a security level by their cost on this host.
+
+	workload maps the names in KERNELS to how many of each the scheme does,
+	{"pairing": 1} if not given. Returns a list of dicts, cheapest first,
+	each with the curve "type", its "parameters", the weighted "cost" in
+	seconds, the "times" of each kernel, and the "sizes" in bytes of
+	elements of G1, G2 and GT.
+
+	Generating the curves and timing them can take minutes at the higher
+	levels. With cache set to a path, the parameters and timings are kept
+	there as JSON and reused on later calls from the same host; kernels a
+	later workload adds are timed and added to it."""
+	if workload is None:
+		workload = {"pairing": 1}
+	for kernel in workload:
+		if kernel not in KERNELS:
+			raise ValueError("unknown workload entry %r; expected one of %s" % (kernel, ", ".join(sorted(KERNELS))))
+	data = _load_cache(cache) if cache else {}
+	known = data.setdefault(host_key(), {}).setdefault(str(security_bits), {})
+	changed = False
+
+	rows = []
+	for t, kwargs in candidates(security_bits, types):
+		entry = known.get(t)
+		if entry is None:
+			params = Parameters(**kwargs)
+			entry = {"parameters": str(params), "times": {}, "sizes": {}}
+			known[t] = entry
+		else:
+			params = Parameters(param_string=entry["parameters"])
+		missing = [kernel for kernel in workload if kernel not in entry["times"]]
+		if missing or not entry["sizes"]:
+			times, sizes = measure(params, missing, number, repeat)
+			entry["times"].update(times)
+			entry["sizes"] = sizes
+			changed = True
+		cost = sum(weight * entry["times"][kernel] for kernel, weight in workload.items())
+		rows.append({"type": t, "parameters": params, "cost": cost, "times": dict(entry["times"]), "sizes": dict(entry["sizes"])})
+
+	if cache and changed:
+		_save_cache(cache, data)
+	rows.sort(key=lambda row: row["cost"])
+	return rows
+
+def advice_table(rows):
+	"""Formats what advise() returned as a table, one curve per line."""
+	kernels = sorted(set(kernel for row in rows for kernel in row["times"]))
+	lines = ["%-4s %10s %s %6s %6s %6s" % ("type", "cost us", " ".join("%10s" % k for k in kernels), "G1 B", "G2 B", "GT B")]
+	for row in rows:
+		times = " ".join("%10.1f" % (row["times"][k] * 1e6) if k in row["times"] else "%10s" % "-" for k in kernels)
+		lines.append("%-4s %10.1f %s %6d %6d %6d" % (row["type"], row["cost"] * 1e6, times, row["sizes"]["G1"], row["sizes"]["G2"], row["sizes"]["GT"]))
+	return "\n".join(lines)
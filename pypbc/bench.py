@@ -0,0 +1,523 @@
+#! /usr/bin/env python3
+
+"""
+bench.py
+
+Licensed under GPLv3
+
+Benchmarks for pypbc, run as python3 -m pypbc.bench.
+
+The default suite, "primitives", times every basic operation (the pairing,
+add, mul, pow and invert in each group, from_hash, random, str and parse
+round trips, and int conversion) on type A, A1, E and F curves of a few
+sizes. Each is timed over several runs and reported in operations per
+second with a 95% confidence interval. --json writes the results out, and
+--compare reads an earlier file back and flags every operation that got
+slower by more than the noise, exiting with status 1 if any did, so two
+builds can be compared before one is rolled out.
+
+The other suites are narrower:
+	overhead    the cost of calling into pypbc, as opposed to the cost of
+	            the arithmetic: each entry point on the cheapest input
+	            available (Zr and small G1 elements of a small type A1
+	            curve), so what is left is mostly argument parsing, type
+	            checks and object creation
+	powers      powers on each curve type, by each exponentiation method a
+	            Pairing can be set to use, and the wire size of GT
+	fp          field arithmetic by each Fp backend, PBC's and native
+	composite   composite-order powers with and without the factorisation
+	startup     how long a worker takes to get a Pairing ready, each time in
+	            a fresh process: generating the parameters and building the
+	            Pairing from scratch, against Parameters.load of a saved
+	            copy and Pairing.intern; --quick does type A only
+	ksw         the KSW predicate encryption scheme end to end, over a sweep
+	            of vector lengths (--ksw-security) and prime sizes
+	            (--ksw-bits), each in a fresh process so its peak RSS is its
+	            own; needs KSW.py importable from the working directory
+	soak        millions of operations (--soak-ops) on a small curve, error
+	            paths included, checking that RSS and the reference counts
+	            of the objects involved stay flat; exits with status 1 if
+	            they don't
+
+--json records whichever of primitives, startup, ksw and soak ran.
+"""
+
+import argparse
+import gc
+import json
+import math
+import os
+import statistics
+import subprocess
+import sys
+import tempfile
+import timeit
+
+from pypbc._pypbc import *
+from pypbc.advisor import host_key
+
+# two-sided 95% points of Student's t, by degrees of freedom
+T95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086]
+
+def measure(stmt, env, number, repeat):
+	"""Returns the best time per call of stmt, in nanoseconds."""
+	timer = timeit.Timer(stmt, globals=env)
+	return min(timer.repeat(repeat=repeat, number=number)) / number * 1e9
+
+def rate(stmt, env, number, repeat):
+	"""Returns (mean, half-width of the 95% confidence interval) of the
+	operations per second stmt manages, over repeat runs of number calls."""
+	timer = timeit.Timer(stmt, globals=env)
+	samples = [number / t for t in timer.repeat(repeat=repeat, number=number)]
+	mean = statistics.mean(samples)
+	if len(samples) < 2:
+		return mean, 0.0
+	t = T95[len(samples) - 2] if len(samples) - 2 < len(T95) else 1.960
+	return mean, t * statistics.stdev(samples) / math.sqrt(len(samples))
+
+def curves(quick):
+	"""Yields (name, Parameters) for the curves the primitives suite covers;
+	just the smallest of each type if quick."""
+	yield "A 512/160", Parameters(qbits=512, rbits=160)
+	if not quick:
+		yield "A 1024/224", Parameters(qbits=1024, rbits=224)
+	yield "A1 2x256", Parameters(n=get_random_prime(256)*get_random_prime(256))
+	if not quick:
+		yield "A1 2x512", Parameters(n=get_random_prime(512)*get_random_prime(512))
+	yield "E 1024/160", Parameters(qbits=1024, rbits=160, short=True)
+	yield "F 160", Parameters(n=160, short=True)
+	if not quick:
+		yield "F 224", Parameters(n=224, short=True)
+
+def primitive_cases():
+	"""Returns [(name, statement, heavy)] for every primitive; the
+	statements use the names primitive_env sets up, and heavy ones (around
+	a thousand times slower than an add) get fewer calls per run."""
+	cases = [("pairing", "pairing.apply(g1, g2)", True)]
+	for group in ("G1", "G2", "GT", "Zr"):
+		x, y = group.lower() + "a", group.lower() + "b"
+		points = group in ("G1", "G2")
+		cases += [
+			("%s add" % group, "%s + %s" % (x, y), False),
+			("%s mul" % group, "%s * %s" % (x, y), False),
+			("%s pow" % group, "%s ** k" % x, group != "Zr"),
+			("%s from_hash" % group, "Element.from_hash(pairing, %s, b'message')" % group, points),
+		]
+		# pypbc can't invert in GT, nor draw from it directly
+		if group != "GT":
+			cases += [
+				("%s invert" % group, "~%s" % x, False),
+				("%s random" % group, "Element.random(pairing, %s)" % group, points),
+			]
+		if group != "Zr":
+			cases.append(("%s str/parse" % group, "Element(pairing, %s, value=str(%s))" % (group, x), points))
+	cases.append(("Zr int", "int(zra)", False))
+	return cases
+
+def primitive_env(params):
+	pairing = Pairing(params)
+	g1 = Element.random(pairing, G1)
+	g2 = Element.random(pairing, G2)
+	env = {"Element": Element, "pairing": pairing, "G1": G1, "G2": G2, "GT": GT, "Zr": Zr,
+		"g1": g1, "g2": g2, "k": Element.random(pairing, Zr)}
+	for suffix in "ab":
+		env["g1" + suffix] = Element.random(pairing, G1)
+		env["g2" + suffix] = Element.random(pairing, G2)
+		env["gt" + suffix] = pairing.apply(Element.random(pairing, G1), g2)
+		env["zr" + suffix] = Element.random(pairing, Zr)
+	return env
+
+def primitives(args):
+	"""Times every primitive on every curve, printing as it goes; returns
+	{curve: {operation: {"ops": mean, "ci": half-width}}}."""
+	results = {}
+	cases = primitive_cases()
+	width = max(len(name) for name, stmt, heavy in cases)
+	for curve, params in curves(args.quick):
+		env = primitive_env(params)
+		print(curve)
+		results[curve] = {}
+		for name, stmt, heavy in cases:
+			number = max(1, args.number // (1000 if heavy else 10))
+			ops, ci = rate(stmt, env, number, args.repeat)
+			results[curve][name] = {"ops": ops, "ci": ci}
+			print("  %-*s %14.1f ops/s +- %.1f%%" % (width, name, ops, 100 * ci / ops if ops else 0))
+	return results
+
+def compare(results, baseline):
+	"""Prints how results stand against a baseline from an earlier --json,
+	and returns the operations that got slower by more than both their
+	confidence intervals allow."""
+	slower = []
+	for curve, ops in sorted(results.items()):
+		for name, now in sorted(ops.items()):
+			then = baseline.get(curve, {}).get(name)
+			if then is None:
+				continue
+			ratio = now["ops"] / then["ops"]
+			flag = ""
+			if now["ops"] + now["ci"] < then["ops"] - then["ci"]:
+				flag = "  SLOWER"
+				slower.append((curve, name))
+			elif now["ops"] - now["ci"] > then["ops"] + then["ci"]:
+				flag = "  faster"
+			print("%-12s %-20s %6.2fx%s" % (curve, name, ratio, flag))
+	return slower
+
+def overhead(args):
+	params = Parameters(n=3559*3571)
+	pairing = Pairing(params)
+	env = {
+		"Element": Element,
+		"PointAccumulator": PointAccumulator,
+		"pairing": pairing,
+		"G1": G1,
+		"Zr": Zr,
+		"a": Element.random(pairing, G1),
+		"b": Element.random(pairing, G1),
+		"k": Element.random(pairing, Zr),
+		"nothing": lambda x, y: None,
+	}
+
+	cases = [
+		("python call (reference)", "nothing(pairing, G1)"),
+		("Element(pairing, Zr)", "Element(pairing, Zr)"),
+		("Element(pairing, Zr, 5)", "Element(pairing, Zr, 5)"),
+		("Element(pairing, Zr, value=5)", "Element(pairing, Zr, value=5)"),
+		("Element.zero(pairing, G1)", "Element.zero(pairing, G1)"),
+		("Element.one(pairing, G1)", "Element.one(pairing, G1)"),
+		("Element.random(pairing, Zr)", "Element.random(pairing, Zr)"),
+		("Element.from_hash(pairing, Zr, b'x')", "Element.from_hash(pairing, Zr, b'x')"),
+		("a + b (G1)", "a + b"),
+		("k * k (Zr)", "k * k"),
+		("pairing.apply(a, b)", "pairing.apply(a, b)"),
+		("a**k + b**k (Elements)", "a**k + b**k"),
+		("acc.add_scaled x2 + result()", "acc = PointAccumulator(pairing, G1); acc.add_scaled(a, k); acc.add_scaled(b, k); acc.result()"),
+	]
+
+	width = max(len(name) for name, stmt in cases)
+	for name, stmt in cases:
+		print("%-*s %10.1f ns" % (width, name, measure(stmt, env, args.number, args.repeat)))
+
+def powers(args):
+	# powers per curve type: G1 and GT by each method (with the window
+	# picked from the exponent length), by what tune_pow picks, and in G1 by
+	# GLV where the curve supports it
+	curves = [
+		("A", Parameters(qbits=512, rbits=160)),
+		("A1", Parameters(n=get_random_prime(256)*get_random_prime(256))),
+		("E", Parameters(qbits=1024, rbits=160, short=True)),
+		("F", Parameters(n=160, short=True)),
+	]
+	methods = ["pbc", "fixed", "sliding", "wnaf", "cyclotomic"]
+	number = max(1, args.number // 100)
+	print("%-8s %s %8s %8s" % ("power", " ".join("%8s" % m for m in methods), "tuned", "glv"))
+	for name, params in curves:
+		pairing = Pairing(params)
+		picked = pairing.tune_pow()
+		for group, label in ((G1, "G1"), (GT, "GT")):
+			# GT's base is a pairing output, the unitary kind cyclotomic is for
+			if group == GT:
+				x = pairing.apply(Element.random(pairing, G1), Element.random(pairing, G2))
+			else:
+				x = Element.random(pairing, group)
+			env = {"x": x, "k": Element.random(pairing, Zr)}
+			row = []
+			for method, window in [(m, 0) for m in methods] + [picked[group]]:
+				try:
+					pairing.set_pow_method(group, method, window)
+				except ValueError:
+					# cyclotomic only applies to GT on types A and A1
+					row.append("%8s" % "-")
+					continue
+				row.append("%8.1f" % (measure("x**k", env, number, args.repeat) / 1000))
+			if group == G1 and pairing.set_glv(True):
+				row.append("%8.1f" % (measure("x**k", env, number, args.repeat) / 1000))
+				pairing.set_glv(False)
+			else:
+				row.append("%8s" % "-")
+			print("%-8s %s" % (name + " " + label, " ".join(row)))
+	print("(microseconds per power)")
+
+	# the wire size of a pairing output, with and without compression
+	print()
+	for name, params in curves:
+		pairing = Pairing(params)
+		x = pairing.apply(Element.random(pairing, G1), Element.random(pairing, G2))
+		try:
+			short = "%d" % len(x.to_bytes(compressed=True))
+		except ValueError:
+			short = "-"
+		print("%-8s %6d bytes, %6s compressed" % (name + " GT", len(x.to_bytes()), short))
+
+def fp(args):
+	# field arithmetic by each of PBC's Fp backends and pypbc's own, on a
+	# type A curve
+	params = Parameters(qbits=512, rbits=160)
+	backends = ["mont", "fast", "faster", "naive", "native"]
+	number = max(1, args.number // 100)
+	print("%-8s %s" % ("fp", " ".join("%8s" % b for b in backends)))
+	cases = [("k * k", "Zr mul"), ("a + b", "G1 add"), ("a**k", "G1 pow")]
+	rows = {label: [] for stmt, label in cases}
+	for backend in backends:
+		pairing = Pairing(params, fp=backend)
+		env = {"a": Element.random(pairing, G1), "b": Element.random(pairing, G1), "k": Element.random(pairing, Zr)}
+		for stmt, label in cases:
+			rows[label].append("%8.1f" % (measure(stmt, env, number, args.repeat) / 1000))
+	for stmt, label in cases:
+		print("%-8s %s" % (label, " ".join(rows[label])))
+	print("(microseconds per operation)")
+
+def composite(args):
+	# composite order: the same powers on a three-prime type A1 curve, with
+	# and without the factors given to the pairing
+	primes = get_random_primes(3, 256)
+	params = Parameters(n=primes[0]*primes[1]*primes[2])
+	number = max(1, args.number // 100)
+	print("%-12s %8s %8s" % ("composite", "plain", "factors"))
+	rows = {"Zr pow": [], "G_p pow": [], "G_p sample": []}
+	for pairing in (Pairing(params), Pairing(params, factors=primes)):
+		if pairing.factors:
+			g = pairing.random_subgroup(G1, 0)
+			sample = "pairing.random_subgroup(G1, 0)"
+		else:
+			g = Element.random(pairing, G1)**(primes[1]*primes[2])
+			sample = "Element.random(pairing, G1)**cofactor"
+		env = {"pairing": pairing, "Element": Element, "G1": G1, "g": g, "x": Element.random(pairing, Zr),
+			"k": Element.random(pairing, Zr), "cofactor": primes[1]*primes[2]}
+		rows["Zr pow"].append("%8.1f" % (measure("x**k", env, number, args.repeat) / 1000))
+		rows["G_p pow"].append("%8.1f" % (measure("g**k", env, number, args.repeat) / 1000))
+		rows["G_p sample"].append("%8.1f" % (measure(sample, env, number, args.repeat) / 1000))
+	for label, row in rows.items():
+		print("%-12s %s" % (label, " ".join(row)))
+	print("(microseconds per operation)")
+
+# what a worker runs on startup, timed phase by phase; the first %s makes
+# the parameters and the second the Pairing
+STARTUP_CHILD = """
+import json, time
+start = time.perf_counter()
+from pypbc import *
+imported = time.perf_counter()
+%s
+made = time.perf_counter()
+%s
+ready = time.perf_counter()
+pairing.apply(Element.random(pairing, G1), Element.random(pairing, G2))
+done = time.perf_counter()
+print(json.dumps({"import": imported - start, "parameters": made - imported, "pairing": ready - made, "first apply": done - ready}))
+"""
+
+STARTUP_PHASES = ["import", "parameters", "pairing", "first apply"]
+
+def startup(args):
+	"""Times worker startup in fresh processes, cold and from a saved copy
+	of the parameters, printing the median of each phase over args.repeat
+	runs; returns {curve: {"cold" or "load": {phase: seconds}}}, with the
+	whole child process under "process"."""
+	generators = [("A 512/160", "Parameters(qbits=512, rbits=160)")]
+	if not args.quick:
+		generators.append(("A1 2x256", "Parameters(n=%d)" % (get_random_prime(256) * get_random_prime(256))))
+	results = {}
+	print("%-10s %-5s %s %10s" % ("startup", "", " ".join("%11s" % phase for phase in STARTUP_PHASES), "process"))
+	with tempfile.TemporaryDirectory() as tmp:
+		for curve, generate in generators:
+			path = os.path.join(tmp, "params")
+			eval(generate).save(path)
+			results[curve] = {}
+			for way, make, ready in (("cold", "params = " + generate, "pairing = Pairing(params)"),
+					("load", "params = Parameters.load(%r)" % path, "pairing = Pairing.intern(params)")):
+				runs = []
+				for i in range(args.repeat):
+					begin = timeit.default_timer()
+					child = subprocess.run([sys.executable, "-c", STARTUP_CHILD % (make, ready)], capture_output=True, text=True)
+					elapsed = timeit.default_timer() - begin
+					if child.returncode != 0:
+						raise RuntimeError("startup child failed: %s" % child.stderr.strip())
+					run = json.loads(child.stdout)
+					run["process"] = elapsed
+					runs.append(run)
+				median = {phase: statistics.median(run[phase] for run in runs) for phase in STARTUP_PHASES + ["process"]}
+				results[curve][way] = median
+				print("%-10s %-5s %s %10.1f" % (curve, way, " ".join("%11.1f" % (1000 * median[phase]) for phase in STARTUP_PHASES),
+					1000 * median["process"]))
+	print("(milliseconds, median of %d fresh processes)" % args.repeat)
+	return results
+
+def ksw(args):
+	"""Runs KSW.benchmark for each configuration in a child process, printing
+	a row for each; returns the list of what they reported."""
+	rows = []
+	print("%8s %5s %10s %10s %10s %10s %9s %9s %10s" % ("security", "bits", "setup s", "keygen s", "encrypt s", "decrypt s", "pairings", "pows", "peak MB"))
+	for bits in args.ksw_bits:
+		for security in args.ksw_security:
+			code = "import json, KSW; print(json.dumps(KSW.benchmark(%d, %d)))" % (security, bits)
+			try:
+				child = subprocess.run([sys.executable, "-c", code], capture_output=True, text=True, timeout=args.ksw_timeout)
+			except subprocess.TimeoutExpired:
+				rows.append({"security": security, "bits": bits, "error": "timed out after %ds" % args.ksw_timeout})
+				print("%8d %5d timed out" % (security, bits))
+				continue
+			if child.returncode != 0:
+				lines = child.stderr.strip().splitlines()
+				rows.append({"security": security, "bits": bits, "error": lines[-1] if lines else "exit status %d" % child.returncode})
+				print("%8d %5d failed: %s" % (security, bits, child.stderr.strip()))
+				continue
+			row = json.loads(child.stdout)
+			rows.append(row)
+			times = row["times"]
+			# the pairings pypbc counted, where it did
+			if "stats" in row:
+				pairings = sum(phase["apply"]["count"] for phase in row["stats"].values())
+			else:
+				pairings = sum(phase["pairings"] for phase in row["operations"].values())
+			pows = sum(phase["pows"] for phase in row["operations"].values())
+			print("%8d %5d %10.3f %10.3f %10.3f %10.3f %9d %9d %10.1f" % (security, bits, times["setup"], times["keygen"],
+				times["encrypt"], times["decrypt"], pairings, pows, row["peak_rss_kb"] / 1024))
+	return rows
+
+def rss_kb():
+	"""The resident set size of this process now, in kilobytes."""
+	try:
+		with open("/proc/self/statm") as f:
+			pages = int(f.read().split()[1])
+		return pages * os.sysconf("SC_PAGE_SIZE") // 1024
+	except OSError:
+		# no /proc: the peak is the best there is
+		import resource
+		return resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+
+# what the soak suite runs over and over; the ones that raise are there for
+# their error paths
+SOAK_CASES = [
+	"Element(pairing, Zr, 123456789)",
+	"Element(pairing, G1, a)",
+	"Element(pairing, G1, str(a))",
+	"a**123456789",
+	"a**k",
+	"a * 123456789",
+	"a * k",
+	"a * b",
+	"pairing.apply(a, b)",
+	"Element.from_hash(pairing, G1, b'message')",
+	"str(a)",
+	"get_random(123456789)",
+	"a**'x'",
+	"a**b",
+	"a * x",
+	"a * 'x'",
+	"Element(pairing, G1, 'x' * 5000)",
+	"Element(pairing, 7, 1)",
+]
+
+def soak(args):
+	"""Runs SOAK_CASES round after round, printing RSS after each, and
+	returns a dict of the operations done, the RSS after each round, how
+	much it grew after the first, how far each object's reference count
+	moved, and whether all of that stayed within bounds."""
+	params = Parameters(n=3559*3571)
+	pairing = Pairing(params)
+	env = {
+		"Element": Element,
+		"get_random": get_random,
+		"params": params,
+		"pairing": pairing,
+		"G1": G1,
+		"Zr": Zr,
+		"a": Element.random(pairing, G1),
+		"b": Element.random(pairing, G1),
+		"k": Element.random(pairing, Zr),
+		"x": pairing.apply(Element.random(pairing, G1), Element.random(pairing, G1)),
+	}
+	code = [compile("try:\n\t%s\nexcept (TypeError, ValueError):\n\tpass" % stmt, stmt, "exec") for stmt in SOAK_CASES]
+	per_round = max(1, args.soak_ops // (args.soak_rounds * len(code)))
+	watched = ["params", "pairing", "a", "b", "k", "x"]
+
+	def run():
+		for c in code:
+			for i in range(per_round):
+				exec(c, env)
+		gc.collect()
+
+	# the first round fills the allocator's free lists and PBC's caches
+	run()
+	refs = {name: sys.getrefcount(env[name]) for name in watched}
+	samples = [rss_kb()]
+	print("%6s %12s %10s" % ("round", "operations", "RSS MB"))
+	for r in range(args.soak_rounds):
+		run()
+		samples.append(rss_kb())
+		print("%6d %12d %10.1f" % (r + 1, (r + 1) * per_round * len(code), samples[-1] / 1024))
+	moved = {name: sys.getrefcount(env[name]) - refs[name] for name in watched}
+	growth = samples[-1] - samples[0]
+	ok = growth <= args.soak_rss_kb and not any(moved.values())
+	print("RSS grew %d kB over %d operations (limit %d kB)" % (growth, args.soak_rounds * per_round * len(code), args.soak_rss_kb))
+	for name, delta in moved.items():
+		if delta:
+			print("reference count of %s moved by %d" % (name, delta))
+	print("ok" if ok else "LEAKING")
+	return {"operations": args.soak_rounds * per_round * len(code), "rss_kb": samples, "growth_kb": growth, "refcounts": moved, "ok": ok}
+
+SUITES = {"overhead": overhead, "powers": powers, "fp": fp, "composite": composite, "startup": startup, "ksw": ksw, "soak": soak}
+
+def main(argv=None):
+	parser = argparse.ArgumentParser(prog="python3 -m pypbc.bench", description="pypbc benchmarks")
+	parser.add_argument("suites", nargs="*", metavar="suite",
+		help="primitives, %s, or all but ksw and soak (default primitives)" % ", ".join(sorted(SUITES)))
+	parser.add_argument("-n", "--number", type=int, default=20000, help="calls per timing run of the cheapest operations")
+	parser.add_argument("-r", "--repeat", type=int, default=5, help="timing runs per operation")
+	parser.add_argument("-q", "--quick", action="store_true", help="only the smallest curve of each type")
+	parser.add_argument("--json", metavar="PATH", help="write the primitives results here")
+	parser.add_argument("--compare", metavar="PATH", help="compare the primitives results with an earlier --json")
+	parser.add_argument("--ksw-security", type=int, nargs="+", default=[3, 10, 30, 100, 300, 1000], metavar="N", help="vector lengths for the ksw suite")
+	parser.add_argument("--ksw-bits", type=int, nargs="+", default=[100, 160, 256], metavar="B", help="prime sizes for the ksw suite")
+	parser.add_argument("--ksw-timeout", type=int, default=3600, metavar="S", help="seconds to give each ksw configuration")
+	parser.add_argument("--soak-ops", type=int, default=2000000, metavar="N", help="operations for the soak suite to run")
+	parser.add_argument("--soak-rounds", type=int, default=10, metavar="N", help="rounds to split them into, measuring RSS after each")
+	parser.add_argument("--soak-rss-kb", type=int, default=1024, metavar="KB", help="how far RSS may grow after the first round")
+	args = parser.parse_args(argv)
+	for suite in args.suites:
+		if suite not in SUITES and suite not in ("primitives", "all"):
+			parser.error("unknown suite %r" % suite)
+	# all leaves out ksw and soak, which take hours
+	suites = ["primitives"] + sorted(set(SUITES) - {"ksw", "soak"}) if "all" in args.suites else args.suites or ["primitives"]
+
+	status = 0
+	record = {"host": host_key(), "number": args.number, "repeat": args.repeat}
+	for i, suite in enumerate(suites):
+		if i:
+			print()
+		if suite == "ksw":
+			record["ksw"] = ksw(args)
+			continue
+		if suite == "startup":
+			record["startup"] = startup(args)
+			continue
+		if suite == "soak":
+			record["soak"] = soak(args)
+			if not record["soak"]["ok"]:
+				status = 1
+			continue
+		if suite != "primitives":
+			SUITES[suite](args)
+			continue
+		results = primitives(args)
+		record["results"] = results
+		if args.compare:
+			with open(args.compare) as f:
+				baseline = json.load(f)
+			print()
+			if baseline.get("host") != host_key():
+				print("warning: the baseline is from %s, not this host" % baseline.get("host"))
+			slower = compare(results, baseline["results"])
+			if slower:
+				print("%d operations got slower" % len(slower))
+				status = 1
+	if args.json:
+		with open(args.json, "w") as f:
+			json.dump(record, f, indent=1, sort_keys=True)
+	return status
+
+if __name__ == "__main__":
+	sys.exit(main())
@@ -0,0 +1,320 @@
+"""
+server.py
+
+Licensed under GPLv3
+
+A per-host pairing daemon. Worker processes that each do a few pairings
+per request never have enough work of their own for multi-pairings or
+preprocessing to pay off, but together they do. Run
+
+	python -m pypbc.server /run/pypbc.sock params.txt
+
+once per host, and in each worker
+
+	client = pypbc.server.Client("/run/pypbc.sock")
+	client.apply(a, b)                       # like pairing.apply(a, b)
+	client.apply_product([(a1, b1), (a2, b2)])
+
+The daemon holds one Pairing for the parameters in params.txt (any file
+Parameters.load reads). It gathers whatever requests came in from every
+worker while the last batch ran, and answers them all with one
+Pairing.apply_batch call on native threads. First arguments it has seen
+recently are kept decoded, so workers pairing against the same key share
+that key's Miller loop preprocessing within a batch.
+
+On the socket everything is a frame: a 4-byte big-endian length and then
+that many bytes. The server opens with a frame holding MAGIC and the
+parameters in PBC's text format. A request is a 2-byte count of pairs
+followed by, for each pair, a and then b, each as a 2-byte length and
+to_bytes(); one pair asks for e(a, b), and more for the product of their
+pairings. The answer is a status byte, 0 followed by the result's
+to_bytes() or 1 followed by an error message in UTF-8. The server hangs up
+on a request frame longer than the most pairs it takes could need.
+"""
+
+import argparse
+import asyncio
+import collections
+import os
+import socket
+import stat
+import struct
+import sys
+import threading
+
+from pypbc._pypbc import *
+
+MAGIC = b"PBCSRV1\n"
+
+_length = struct.Struct("!I")
+_count = struct.Struct("!H")
+
+
+def encode_request(pairs):
+	"""The body of a request for the product of the pairings of pairs."""
+	parts = [_count.pack(len(pairs))]
+	for a, b in pairs:
+		for e in (a, b):
+			data = e.to_bytes()
+			parts.append(_count.pack(len(data)))
+			parts.append(data)
+	return b"".join(parts)
+
+
+def decode_request(pairing, body, cache=None):
+	"""The pairs a request body asks about. First arguments are looked up in
+	cache, a dict from encodings to Elements, when one is given, so repeats
+	come back as the same Element."""
+	view = memoryview(body)
+	if len(view) < _count.size:
+		raise ValueError("truncated request")
+	(n,), offset = _count.unpack_from(view), _count.size
+	if n < 1:
+		raise ValueError("expected at least one pair of Elements.")
+	pairs = []
+	for i in range(n):
+		pair = []
+		for group in (G1, G2):
+			if len(view) < offset + _count.size:
+				raise ValueError("truncated request")
+			(size,), offset = _count.unpack_from(view, offset), offset + _count.size
+			data = bytes(view[offset:offset + size])
+			if len(data) != size:
+				raise ValueError("truncated request")
+			offset += size
+			if group == G1 and cache is not None:
+				e = cache.get(data)
+				if e is None:
+					e = cache[data] = Element.from_bytes(pairing, G1, data)
+			else:
+				e = Element.from_bytes(pairing, group, data)
+			pair.append(e)
+		pairs.append(tuple(pair))
+	if offset != len(view):
+		raise ValueError("trailing bytes after request")
+	return pairs
+
+
+class _Cache(collections.OrderedDict):
+	"""A dict keeping only the size most recently used entries."""
+
+	def __init__(self, size):
+		collections.OrderedDict.__init__(self)
+		self.size = size
+
+	def get(self, key):
+		value = collections.OrderedDict.get(self, key)
+		if value is not None:
+			self.move_to_end(key)
+		return value
+
+	def __setitem__(self, key, value):
+		collections.OrderedDict.__setitem__(self, key, value)
+		if len(self) > self.size:
+			self.popitem(last=False)
+
+
+class Server(object):
+	"""Answers pairing requests on the Unix socket at path, batching those
+	that arrive together. max_batch bounds the requests handed to one
+	apply_batch call, linger is how many seconds to wait for more requests
+	to join a batch, cache_size how many first arguments to keep, and
+	max_pairs how many pairs one request may ask about."""
+
+	def __init__(self, path, parameters, max_batch=1024, linger=0.0, cache_size=1024, max_pairs=1024):
+		self.path = path
+		self.parameters = parameters
+		self.pairing = Pairing.intern(parameters)
+		# the longest request a client has any business sending; the length
+		# comes from the peer, so we don't read more than that
+		encoding = max(len(Element.zero(self.pairing, group).to_bytes()) for group in (G1, G2))
+		self.max_frame = _count.size + max_pairs * 2 * (_count.size + encoding)
+		self.max_batch = max_batch
+		self.linger = linger
+		self.cache = _Cache(cache_size)
+		self.hello = MAGIC + str(parameters).encode()
+		self.batches = 0
+		self.requests = 0
+		self._pending = []
+		self._wakeup = None
+		self._batcher = None
+		self._server = None
+
+	async def start(self):
+		"""Starts listening and batching on the running loop, and returns the
+		asyncio server."""
+		self._wakeup = asyncio.Event()
+		self._batcher = asyncio.ensure_future(self._batch_loop())
+		self._server = await asyncio.start_unix_server(self._connection, path=self.path)
+		return self._server
+
+	async def close(self):
+		"""Stops listening and batching; requests still waiting on a batch
+		are dropped."""
+		if self._server is not None:
+			self._server.close()
+			await self._server.wait_closed()
+		if self._batcher is not None:
+			self._batcher.cancel()
+			try:
+				await self._batcher
+			except asyncio.CancelledError:
+				pass
+
+	async def serve_forever(self):
+		server = await self.start()
+		try:
+			await server.serve_forever()
+		finally:
+			await self.close()
+
+	async def _connection(self, reader, writer):
+		loop = asyncio.get_running_loop()
+		try:
+			writer.write(_length.pack(len(self.hello)) + self.hello)
+			while True:
+				try:
+					(size,) = _length.unpack(await reader.readexactly(_length.size))
+					if size > self.max_frame:
+						break
+					body = await reader.readexactly(size)
+				except asyncio.IncompleteReadError:
+					break
+				try:
+					pairs = decode_request(self.pairing, body, self.cache)
+				except (TypeError, ValueError) as e:
+					answer = b"\x01" + str(e).encode()
+				else:
+					future = loop.create_future()
+					self._pending.append((pairs, future))
+					self._wakeup.set()
+					answer = await future
+				writer.write(_length.pack(len(answer)) + answer)
+				await writer.drain()
+		except ConnectionError:
+			pass
+		finally:
+			writer.close()
+
+	async def _batch_loop(self):
+		loop = asyncio.get_running_loop()
+		while True:
+			await self._wakeup.wait()
+			if self.linger:
+				await asyncio.sleep(self.linger)
+			self._wakeup.clear()
+			batch, self._pending = self._pending[:self.max_batch], self._pending[self.max_batch:]
+			if self._pending:
+				self._wakeup.set()
+			requests = [pairs[0] if len(pairs) == 1 else tuple(pairs) for pairs, future in batch]
+			try:
+				results = await loop.run_in_executor(None, self.pairing.apply_batch, requests)
+				answers = [b"\x00" + r.to_bytes() for r in results]
+			except Exception:
+				# find out which of them it was
+				answers = [self._answer_one(request) for request in requests]
+			self.batches += 1
+			self.requests += len(batch)
+			for (pairs, future), answer in zip(batch, answers):
+				if not future.done():
+					future.set_result(answer)
+
+	def _answer_one(self, request):
+		try:
+			return b"\x00" + self.pairing.apply_batch([request])[0].to_bytes()
+		except Exception as e:
+			return b"\x01" + str(e).encode()
+
+
+class ServerError(Exception):
+	"""The server could not answer a request."""
+
+
+class Client(object):
+	"""A connection to a Server at path. The pairing's parameters come from
+	the server unless pairing is given, in which case it has to be for the
+	same ones. A Client can be shared between threads, which take turns."""
+
+	def __init__(self, path, pairing=None):
+		self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+		self.sock.connect(path)
+		self.lock = threading.Lock()
+		hello = self._receive()
+		if not hello.startswith(MAGIC):
+			self.sock.close()
+			raise ServerError("not a pypbc server")
+		if pairing is None:
+			pairing = Pairing.intern(Parameters(param_string=hello[len(MAGIC):].decode()))
+		self.pairing = pairing
+
+	def _receive_exactly(self, n):
+		parts = []
+		while n:
+			data = self.sock.recv(n)
+			if not data:
+				raise ServerError("the server closed the connection")
+			parts.append(data)
+			n -= len(data)
+		return b"".join(parts)
+
+	def _receive(self):
+		(size,) = _length.unpack(self._receive_exactly(_length.size))
+		return self._receive_exactly(size)
+
+	def apply_product(self, pairs):
+		"""e(a1, b1) * e(a2, b2) * ... for the (a, b) in pairs, computed by
+		the server."""
+		body = encode_request(list(pairs))
+		with self.lock:
+			self.sock.sendall(_length.pack(len(body)) + body)
+			answer = self._receive()
+		if answer[:1] != b"\x00":
+			raise ServerError(answer[1:].decode(errors="replace"))
+		return Element.from_bytes(self.pairing, GT, answer[1:])
+
+	def apply(self, a, b):
+		"""e(a, b), computed by the server."""
+		return self.apply_product([(a, b)])
+
+	def close(self):
+		self.sock.close()
+
+	def __enter__(self):
+		return self
+
+	def __exit__(self, *exc):
+		self.close()
+		return False
+
+
+def main(argv=None):
+	parser = argparse.ArgumentParser(prog="python -m pypbc.server", description="Serves pairings to the processes on this host over a Unix socket.")
+	parser.add_argument("path", help="the socket to listen on")
+	parser.add_argument("parameters", help="a file of parameters in PBC's text format")
+	parser.add_argument("--max-batch", type=int, default=1024, metavar="N", help="the most requests to answer at once")
+	parser.add_argument("--linger", type=float, default=0.0, metavar="S", help="seconds to wait for more requests to join a batch")
+	parser.add_argument("--cache", type=int, default=1024, metavar="N", help="first arguments to keep decoded")
+	parser.add_argument("--max-pairs", type=int, default=1024, metavar="N", help="the most pairs one request may ask about")
+	args = parser.parse_args(argv)
+
+	# a socket left behind by a server that's gone would stop us binding
+	try:
+		if stat.S_ISSOCK(os.stat(args.path).st_mode):
+			os.unlink(args.path)
+	except FileNotFoundError:
+		pass
+	server = Server(args.path, Parameters.load(args.parameters), args.max_batch, args.linger, args.cache, args.max_pairs)
+	try:
+		asyncio.run(server.serve_forever())
+	except KeyboardInterrupt:
+		pass
+	finally:
+		try:
+			os.unlink(args.path)
+		except OSError:
+			pass
+	return 0
+
+
+if __name__ == "__main__":
+	sys.exit(main())
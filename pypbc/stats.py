@@ -0,0 +1,34 @@
+"""
+stats.py
+
+Licensed under GPLv3
+
+Attributes operation counts and times to a stretch of code, such as the
+handling of one request. Inside
+
+	with pypbc.stats_scope() as scope:
+		handle(request)
+
+every pairing, power, product, hash into a group, parse and str() this
+thread does is counted, and scope.stats holds the totals afterwards in the
+form Pairing.stats() uses. Statistics have to be switched on with
+pypbc.set_stats_enabled(True) for anything to be counted. Scopes nest, and
+work a thread hands to another (including the *_async methods) is not seen.
+"""
+
+from pypbc._pypbc import _stats_scope_enter, _stats_scope_exit
+
+
+class scope(object):
+	"""A context manager counting what this thread does inside it."""
+
+	def __init__(self):
+		self.stats = None
+
+	def __enter__(self):
+		_stats_scope_enter()
+		return self
+
+	def __exit__(self, *exc):
+		self.stats = _stats_scope_exit()
+		return False
@@ -0,0 +1,101 @@
+/*******************************************************************************
+pypbc_capi.h
+
+Licensed under GPLv3
+
+The C API pypbc exports to other extension modules, through the capsule
+pypbc._C_API. It lets native code work on the PBC objects behind Pairings
+and Elements directly, and hand results back to Python as Elements.
+
+Exactly one translation unit of the other module defines the table pointer,
+by including this header with PYPBC_CAPI_DEFINE defined:
+
+	#define PYPBC_CAPI_DEFINE
+	#include <pypbc_capi.h>
+
+and the rest include it plainly. Then, from the module's init function:
+
+	if (PyPBC_ImportAPI() < 0)
+		return NULL;
+
+after which PyPBC_API points at the table below in every unit. Everything in it needs the
+GIL (or an attached thread state on free-threaded builds), but the pairing_t
+and element_t pointers it hands out can be used without it for as long as
+the Python objects they came from are kept alive.
+*******************************************************************************/
+
+#ifndef PYPBC_CAPI_H
+#define PYPBC_CAPI_H
+
+#include <Python.h>
+#include <pbc/pbc.h>
+
+// bumped whenever something is added to the end of PyPBC_CAPI; nothing is
+// ever removed or reordered
+#define PYPBC_CAPI_VERSION 1
+#define PYPBC_CAPI_NAME "pypbc._C_API"
+
+// the groups, as in pypbc.G1, pypbc.G2, pypbc.GT and pypbc.Zr
+#define PYPBC_G1 0
+#define PYPBC_G2 1
+#define PYPBC_GT 2
+#define PYPBC_Zr 3
+
+typedef struct {
+    // PYPBC_CAPI_VERSION of the pypbc that exported the table
+    int version;
+
+    // 1 if op is a Pairing or Element (or a subclass of one), else 0
+    int (*Pairing_Check)(PyObject *op);
+    int (*Element_Check)(PyObject *op);
+
+    // the PBC object behind a Pairing or Element, borrowed from it; NULL
+    // with TypeError or ValueError set if op isn't a usable one
+    struct pairing_s *(*Pairing_AsPairing)(PyObject *op);
+    struct element_s *(*Element_AsElement)(PyObject *op);
+
+    // the group of an Element (one of PYPBC_G1...PYPBC_Zr), or -1 with an
+    // exception set
+    int (*Element_Group)(PyObject *op);
+
+    // the Pairing an Element belongs to, borrowed; NULL with an exception set
+    PyObject *(*Element_Pairing)(PyObject *op);
+
+    // wraps e, which must have been initialised in the given group of the
+    // given Pairing, into a new Element without copying it. The Element
+    // takes e over: the caller must not clear it, or use it again, whether
+    // or not the call succeeds.
+    PyObject *(*Element_FromElement)(PyObject *pairing, int group, struct element_s *e);
+
+    // a new Element of the given group, set to zero, for native code to
+    // write a result into through Element_AsElement
+    PyObject *(*Element_New)(PyObject *pairing, int group);
+} PyPBC_CAPI;
+
+#ifndef PYPBC_MODULE
+
+#ifdef PYPBC_CAPI_DEFINE
+PyPBC_CAPI *PyPBC_API = NULL;
+#else
+extern PyPBC_CAPI *PyPBC_API;
+#endif
+
+// imports pypbc and fetches its table; returns -1 with an exception set
+// if it can't, or if the installed pypbc is older than this header
+static inline int PyPBC_ImportAPI(void) {
+    PyPBC_API = (PyPBC_CAPI *)PyCapsule_Import(PYPBC_CAPI_NAME, 0);
+    if (PyPBC_API == NULL) {
+        return -1;
+    }
+    if (PyPBC_API->version < PYPBC_CAPI_VERSION) {
+        PyErr_Format(PyExc_ImportError, "pypbc C API version %d is older than the %d this module was built against.",
+            PyPBC_API->version, PYPBC_CAPI_VERSION);
+        PyPBC_API = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,210 @@
+/*******************************************************************************
+pypbc_mont.h
+
+Licensed under GPLv3
+
+Fixed-limb Montgomery multiplication for the "native" Fp backend.
+
+Each kernel computes c = a * b / R mod p for a, b < p, with R = 2^(64 * n)
+and n one of the sizes below, the way PBC's montfp.c does, so the result is
+the same limbs PBC's own multiplication would give. They work one row of
+the product and one row of the reduction at a time (CIOS), with every loop
+over the limbs unrolled for its size, and end with a subtraction of p that
+is kept or dropped by a mask rather than a branch.
+
+The portable kernels multiply through unsigned __int128, and only come in
+the sizes where they beat GMP's mpn_addmul_1: not 512 bits. On x86-64 there
+is a second set in assembly, which keeps each row's low and high halves in
+separate carry chains with mulx, adcx and adox; pypbc_mont_pick gives those
+when CPUID says the processor has BMI2 and ADX.
+
+There is no AVX2 kernel: a single product of 64-bit limbs has nothing for
+it to work on side by side, and it would only pay for itself multiplying
+several independent elements at once, which PBC's field interface never
+asks for.
+*******************************************************************************/
+
+#ifndef PYPBC_MONT_H
+#define PYPBC_MONT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SIZEOF_INT128__)
+#define PYPBC_MONT 1
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define PYPBC_MONT_MULX 1
+#include <cpuid.h>
+#endif
+
+// c = a * b / R mod p, where negpinv is -1/p mod 2^64
+typedef void (*pypbc_mont_fn)(uint64_t *c, const uint64_t *a, const uint64_t *b, const uint64_t *p, uint64_t negpinv);
+
+typedef struct {
+	const char *name;
+	size_t limbs;
+	pypbc_mont_fn mul;
+	// set if it needs BMI2 and ADX
+	int mulx;
+} pypbc_mont_kernel;
+
+// t (n + 1 limbs, t < 2p) less p if that doesn't go below zero, into c
+static inline __attribute__((always_inline)) void
+pypbc_mont_final(uint64_t *c, const uint64_t *t, const uint64_t *p, int n) {
+	uint64_t d[8];
+	unsigned char borrow = 0;
+	_Pragma("GCC unroll 8")
+	for (int j = 0; j < n; j++) {
+		unsigned __int128 diff = (unsigned __int128)t[j] - p[j] - borrow;
+		d[j] = (uint64_t)diff;
+		borrow = (unsigned char)(diff >> 64) & 1;
+	}
+	// keep the difference unless it borrowed past the top limb
+	uint64_t keep = -(uint64_t)((t[n] != 0) | (borrow == 0));
+	_Pragma("GCC unroll 8")
+	for (int j = 0; j < n; j++) {
+		c[j] = (d[j] & keep) | (t[j] & ~keep);
+	}
+}
+
+static inline __attribute__((always_inline)) void
+pypbc_mont_portable(uint64_t *c, const uint64_t *a, const uint64_t *b, const uint64_t *p, uint64_t negpinv, int n) {
+	uint64_t t[10] = {0};
+	_Pragma("GCC unroll 8")
+	for (int i = 0; i < n; i++) {
+		// t += a[i] * b
+		uint64_t carry = 0;
+		_Pragma("GCC unroll 8")
+		for (int j = 0; j < n; j++) {
+			unsigned __int128 acc = (unsigned __int128)a[i] * b[j] + t[j] + carry;
+			t[j] = (uint64_t)acc;
+			carry = (uint64_t)(acc >> 64);
+		}
+		unsigned __int128 top = (unsigned __int128)t[n] + carry;
+		t[n] = (uint64_t)top;
+		t[n + 1] = (uint64_t)(top >> 64);
+		// t = (t + m * p) / 2^64, with m chosen to clear the bottom limb
+		uint64_t m = t[0] * negpinv;
+		unsigned __int128 acc = (unsigned __int128)m * p[0] + t[0];
+		carry = (uint64_t)(acc >> 64);
+		_Pragma("GCC unroll 8")
+		for (int j = 1; j < n; j++) {
+			acc = (unsigned __int128)m * p[j] + t[j] + carry;
+			t[j - 1] = (uint64_t)acc;
+			carry = (uint64_t)(acc >> 64);
+		}
+		top = (unsigned __int128)t[n] + carry;
+		t[n - 1] = (uint64_t)top;
+		t[n] = t[n + 1] + (uint64_t)(top >> 64);
+	}
+	pypbc_mont_final(c, t, p, n);
+}
+
+#define PYPBC_MONT_PORTABLE(n) \
+static void pypbc_mont_portable_##n(uint64_t *c, const uint64_t *a, const uint64_t *b, const uint64_t *p, uint64_t negpinv) { \
+	pypbc_mont_portable(c, a, b, p, negpinv, n); \
+}
+PYPBC_MONT_PORTABLE(3)
+PYPBC_MONT_PORTABLE(4)
+
+#ifdef PYPBC_MONT_MULX
+
+// one limb of a row: lo:hi = x * y[j]; t[j] = lo + carry + the previous
+// high half, in the adcx chain; and the high half picks up t[j + 1] in the
+// adox chain, to be stored by the next limb
+#define PYPBC_MONT_STEP(j, lo, hi, prev) \
+	"mulx " #j "*8(%[y]), %[" lo "], %[" hi "]\n\t" \
+	"adcx %[" prev "], %[" lo "]\n\t" \
+	"movq %[" lo "], " #j "*8(%[t])\n\t" \
+	"adox " #j "*8+8(%[t]), %[" hi "]\n\t"
+#define PYPBC_MONT_STEP0(j) PYPBC_MONT_STEP(j, "lo0", "hi0", "hi1")
+#define PYPBC_MONT_STEP1(j) PYPBC_MONT_STEP(j, "lo1", "hi1", "hi0")
+
+// t[0 .. n + 1] += x * y, where n is odd or even as the steps alternate
+#define PYPBC_MONT_ROW(n, steps, last) \
+	uint64_t lo0, hi0, lo1, hi1, zero; \
+	__asm__ volatile( \
+		"xorl %k[zero], %k[zero]\n\t" \
+		"movq (%[t]), %[hi1]\n\t" \
+		steps \
+		"adcx %[zero], %[" last "]\n\t" \
+		"movq %[" last "], " #n "*8(%[t])\n\t" \
+		"movq " #n "*8+8(%[t]), %[lo0]\n\t" \
+		"adcx %[zero], %[lo0]\n\t" \
+		"adox %[zero], %[lo0]\n\t" \
+		"movq %[lo0], " #n "*8+8(%[t])\n\t" \
+		: [lo0] "=&r" (lo0), [hi0] "=&r" (hi0), [lo1] "=&r" (lo1), [hi1] "=&r" (hi1), [zero] "=&r" (zero) \
+		: [t] "r" (t), [y] "r" (y), "d" (x) \
+		: "cc", "memory")
+
+static inline __attribute__((always_inline)) void pypbc_mont_row_3(uint64_t *t, uint64_t x, const uint64_t *y) {
+	PYPBC_MONT_ROW(3, PYPBC_MONT_STEP0(0) PYPBC_MONT_STEP1(1) PYPBC_MONT_STEP0(2), "hi0");
+}
+
+static inline __attribute__((always_inline)) void pypbc_mont_row_4(uint64_t *t, uint64_t x, const uint64_t *y) {
+	PYPBC_MONT_ROW(4, PYPBC_MONT_STEP0(0) PYPBC_MONT_STEP1(1) PYPBC_MONT_STEP0(2) PYPBC_MONT_STEP1(3), "hi1");
+}
+
+static inline __attribute__((always_inline)) void pypbc_mont_row_8(uint64_t *t, uint64_t x, const uint64_t *y) {
+	PYPBC_MONT_ROW(8, PYPBC_MONT_STEP0(0) PYPBC_MONT_STEP1(1) PYPBC_MONT_STEP0(2) PYPBC_MONT_STEP1(3)
+		PYPBC_MONT_STEP0(4) PYPBC_MONT_STEP1(5) PYPBC_MONT_STEP0(6) PYPBC_MONT_STEP1(7), "hi1");
+}
+
+// each row adds into the window of t starting at limb i, which the
+// reduction then clears the bottom limb of, so the result ends up in the
+// top half of t
+#define PYPBC_MONT_MULX_N(n) \
+static void pypbc_mont_mulx_##n(uint64_t *c, const uint64_t *a, const uint64_t *b, const uint64_t *p, uint64_t negpinv) { \
+	uint64_t t[2 * n + 2] = {0}; \
+	for (int i = 0; i < n; i++) { \
+		pypbc_mont_row_##n(t + i, a[i], b); \
+		pypbc_mont_row_##n(t + i, t[i] * negpinv, p); \
+	} \
+	pypbc_mont_final(c, t + n, p, n); \
+}
+PYPBC_MONT_MULX_N(3)
+PYPBC_MONT_MULX_N(4)
+PYPBC_MONT_MULX_N(8)
+
+// whether this processor has mulx (BMI2) and adcx/adox (ADX)
+static int pypbc_mont_has_mulx(void) {
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+		return 0;
+	}
+	return (ebx & (1u << 8)) && (ebx & (1u << 19));
+}
+
+#endif
+
+static const pypbc_mont_kernel pypbc_mont_kernels[] = {
+#ifdef PYPBC_MONT_MULX
+	{"mulx", 3, pypbc_mont_mulx_3, 1},
+	{"mulx", 4, pypbc_mont_mulx_4, 1},
+	{"mulx", 8, pypbc_mont_mulx_8, 1},
+#endif
+	{"portable", 3, pypbc_mont_portable_3, 0},
+	{"portable", 4, pypbc_mont_portable_4, 0},
+	{NULL, 0, NULL, 0}
+};
+
+// the best kernel this processor can run for p of the given number of
+// limbs, or NULL if there isn't one that size
+static const pypbc_mont_kernel *pypbc_mont_pick(size_t limbs) {
+#ifdef PYPBC_MONT_MULX
+	int mulx = pypbc_mont_has_mulx();
+#else
+	int mulx = 0;
+#endif
+	for (const pypbc_mont_kernel *k = pypbc_mont_kernels; k->name != NULL; k++) {
+		if (k->limbs == limbs && (mulx || !k->mulx)) {
+			return k;
+		}
+	}
+	return NULL;
+}
+
+#endif
+
+#endif
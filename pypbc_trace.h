@@ -0,0 +1,85 @@
+/*******************************************************************************
+pypbc_trace.h
+
+Licensed under GPLv3
+
+The format of the traces pypbc.start_trace() writes and pbc_replay reads.
+
+A trace is a pypbc_trace_header followed by records, each a fixed-size
+pypbc_trace_record and then length bytes of payload. Everything is in the
+byte order of the host that wrote it; a reader on the other byte order sees
+the version byte-swapped and gives up.
+
+Pairings and Elements are named by ids unique within one trace. Before
+anything uses a Pairing, a TRACE_PAIRING record describes it: its payload
+is the parameters in PBC's text format, and its flags name the Fp backend
+(0 to 4 for "mont", "fast", "faster", "naive" and "native"). An Element made outside
+the traced operations (or before the trace began) appears first as an
+operand; when values are recorded, a TRACE_VALUE record giving its value
+comes just before that, and otherwise the replayer picks a random one.
+TRACE_FREE marks an Element the program let go of.
+
+Integer and byte string operands are described by their size in the a or b
+field. Their contents, and the value of each operation's result, are only
+in the payload when values are recorded: first a's, then b's, then the
+result's. Integers are written as big-endian magnitudes (with
+TRACE_A_NEGATIVE or TRACE_B_NEGATIVE in flags for negative ones), and
+elements in element_to_bytes format.
+*******************************************************************************/
+
+#ifndef PYPBC_TRACE_H
+#define PYPBC_TRACE_H
+
+#include <stdint.h>
+
+#define PYPBC_TRACE_MAGIC "PBCTRACE"
+#define PYPBC_TRACE_VERSION 1
+
+// header flags: the payloads carry values
+#define TRACE_VALUES 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+} pypbc_trace_header;
+
+// the operations; the first six match pypbc's StatOp
+enum {
+    TRACE_APPLY, TRACE_POW, TRACE_MULT, TRACE_FROM_HASH, TRACE_PARSE, TRACE_STR,
+    TRACE_PAIRING = 16, TRACE_VALUE, TRACE_FREE
+};
+
+// what an operand is
+enum {TRACE_ARG_NONE, TRACE_ARG_ELEMENT, TRACE_ARG_INTEGER, TRACE_ARG_BYTES};
+
+// record flags
+#define TRACE_A_NEGATIVE 1
+#define TRACE_B_NEGATIVE 2
+
+// the groups, numbered as in pypbc
+#define TRACE_G1 0
+#define TRACE_G2 1
+#define TRACE_GT 2
+#define TRACE_Zr 3
+
+typedef struct {
+    // a TRACE_* operation, and the group of its result
+    uint8_t op;
+    uint8_t group;
+    // the kinds of the operands, and the groups of element operands
+    uint8_t a_kind, b_kind;
+    uint8_t a_group, b_group;
+    uint16_t flags;
+    // the pairing the operation belongs to
+    uint32_t pairing;
+    // bytes of payload after the record
+    uint32_t length;
+    // the id of the result (for TRACE_STR, of the element printed); of
+    // element operands; or the bits of integers and bytes of strings
+    uint64_t out, a, b;
+    // nanoseconds the operation took in pypbc
+    uint64_t ns;
+} pypbc_trace_record;
+
+#endif
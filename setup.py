@@ -2,9 +2,12 @@
 
 from distutils.core import setup, Extension
 
-pbc = Extension(	"pypbc",
+pbc = Extension(	"pypbc._pypbc",
 				libraries=["pbc"],
-				sources=["pypbc.c"]
+				sources=["pypbc.c"],
+				depends=["pypbc.h", "pypbc_capi.h", "pypbc_trace.h", "pypbc_mont.h"],
+				extra_compile_args=["-pthread"],
+				extra_link_args=["-pthread"]
 			)
 
 setup(	name="pypbc",
@@ -13,6 +16,8 @@ setup(	name="pypbc",
 		author="Geremy Condra",
 		author_email="debatem1@gmail.com",
 		url="geremycondra.net",
+		packages=["pypbc"],
 		py_modules=["test", "KSW"],
+		headers=["pypbc_capi.h"],
 		ext_modules=[pbc]
 )
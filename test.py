@@ -8,6 +8,13 @@ Licensed under GPLv3
 Released 11 October 2009
 """
 
+import asyncio
+import concurrent.futures
+import ctypes
+import hashlib
+import os
+import tempfile
+import threading
 import unittest
 
 from pypbc import *
@@ -67,6 +74,125 @@ class TestParameters(unittest.TestCase):
 		self.assertRaises(Exception, Parameters, 1.0)
 		pass
 
+	def test_cm_families(self):
+		params = Parameters(family="d", D=9563, qbits=159)
+		self.assertTrue(str(params).startswith("type d"))
+		self.assertTrue(str(Parameters(family="d")).startswith("type d"))
+		self.assertRaises(ValueError, Parameters, family="x")
+		self.assertRaises(ValueError, Parameters, family="d", D=9563)
+		self.assertRaises(ValueError, Parameters, family="d", qbits=100)
+		self.assertRaises(ValueError, Parameters, family="d", n=35)
+		self.assertRaises(ValueError, Parameters, D=9563, qbits=159)
+		# type D pairings are asymmetric, with the short side in G1
+		pairing = Pairing(params)
+		self.assertFalse(pairing.is_symmetric())
+		self.assertTrue(Pairing(Parameters(n=3559*3571)).is_symmetric())
+		P, Q = Element.random(pairing, G1), Element.random(pairing, G2)
+		self.assertTrue(len(P.to_bytes()) < len(Q.to_bytes()))
+		k = Element.random(pairing, Zr)
+		self.assertEqual(pairing.apply(P**k, Q), pairing.apply(P, Q**k))
+		self.assertRaises(ValueError, pairing.apply, Q, P)
+		self.assertRaises(ValueError, pairing.apply, P, P)
+		future = generate_parameters_async(family="d", D=9563, qbits=159)
+		self.assertTrue(str(future.result(timeout=60)).startswith("type d"))
+
+	def test_save_load(self):
+		params = Parameters(param_string=stored_params)
+		with tempfile.TemporaryDirectory() as tmp:
+			path = os.path.join(tmp, "params")
+			params.save(path)
+			loaded = Parameters.load(path)
+			self.assertEqual(str(loaded), str(params))
+			with open(path, "w") as f:
+				f.write("garbage")
+			self.assertRaises(ValueError, Parameters.load, path)
+			self.assertRaises(OSError, Parameters.load, os.path.join(tmp, "missing"))
+
+	def test_str_large(self):
+		# more than the 4096 bytes the old fixed buffer could hold; the
+		# numbers are never used for a pairing, so they needn't make sense
+		big = stored_params.replace("q 8780", "q " + "9" * 5000 + "8780")
+		params = Parameters(param_string=big)
+		self.assertTrue(len(str(params)) > 5000)
+		self.assertEqual(str(Parameters(param_string=str(params))), str(params))
+
+class TestGeneration(unittest.TestCase):
+
+	def is_probable_prime(self, n):
+		return all(pow(a, n - 1, n) == 1 for a in (2, 3, 5, 7, 11))
+
+	def test_get_random_primes(self):
+		primes = get_random_primes(5, 100)
+		self.assertEqual(len(primes), 5)
+		self.assertEqual(len(set(primes)), 5)
+		for p in primes:
+			self.assertTrue(self.is_probable_prime(p))
+			self.assertTrue(p.bit_length() <= 101)
+		self.assertEqual(get_random_primes(0, 100), [])
+		self.assertRaises(ValueError, get_random_primes, -1, 100)
+		self.assertRaises(ValueError, get_random_primes, 1, 0)
+
+	def test_get_random_primes_async(self):
+		future = get_random_primes_async(3, 64)
+		primes = future.result(timeout=60)
+		self.assertEqual(len(primes), 3)
+		for p in primes:
+			self.assertTrue(self.is_probable_prime(p))
+
+	def test_generate_parameters_async(self):
+		futures = [generate_parameters_async(qbits=512, rbits=160), generate_parameters_async(n=3559*3571)]
+		for future in futures:
+			params = future.result(timeout=60)
+			self.assertTrue(isinstance(params, Parameters))
+			pairing = Pairing(params)
+			e = pairing.apply(Element.random(pairing, G1), Element.random(pairing, G2))
+		self.assertRaises(ValueError, generate_parameters_async)
+		self.assertRaises(ValueError, generate_parameters_async, n=35, qbits=512)
+
+	def test_generate_alongside_backends(self):
+		# generations hold the Fp lock for reading and then come back in for
+		# the GIL; pairings on other backends take it for writing without
+		# the GIL, so neither may wait on the other while holding what the
+		# other needs
+		import tracemalloc
+		params = Parameters(param_string=stored_params)
+		pairing = Pairing(params)
+		expected = pairing.apply(Element.from_hash(pairing, G1, b"P"), Element.from_hash(pairing, G2, b"Q"))
+		tracemalloc.start()
+		try:
+			futures = [generate_parameters_async(n=3559*3571) for i in range(8)]
+			futures += [generate_parameters_async(qbits=256, rbits=80) for i in range(2)]
+			errors = []
+			def build():
+				try:
+					for i in range(20):
+						pairing = Pairing(params, fp="naive")
+						P = Element.from_hash(pairing, G1, b"P")
+						Q = Element.from_hash(pairing, G2, b"Q")
+						if pairing.apply(P, Q).to_bytes() != expected.to_bytes():
+							errors.append("mismatch")
+				except Exception as e:
+					errors.append(e)
+			threads = [threading.Thread(target=build) for i in range(4)]
+			for thread in threads:
+				thread.start()
+			generated = [future.result(timeout=60) for future in futures]
+			for thread in threads:
+				thread.join()
+		finally:
+			tracemalloc.stop()
+		self.assertEqual(errors, [])
+		for params in generated:
+			pairing = Pairing(params)
+			P = Element.random(pairing, G1)
+			self.assertEqual(pairing.apply(P, P ** 2), pairing.apply(P, P) ** 2)
+
+	def test_generate_parameters_asyncio(self):
+		async def generate():
+			return await asyncio.wrap_future(generate_parameters_async(qbits=512, rbits=160))
+		params = asyncio.run(generate())
+		self.assertTrue(str(params).startswith("type a"))
+
 class TestPairing(unittest.TestCase):
 
 	def setUp(self):
@@ -81,6 +207,23 @@ class TestPairing(unittest.TestCase):
 	def test_bad_init(self):
 		#self.assertRaises(Exception, Pairing)
 		self.assertRaises(Exception, Pairing, "hello world")
+
+	def test_intern(self):
+		clear_pairing_cache()
+		pairing = Pairing.intern(self.params)
+		self.assertTrue(Pairing.intern(self.params) is pairing)
+		self.assertTrue(Pairing.intern(Parameters(param_string=str(self.params))) is pairing)
+		self.assertFalse(Pairing.intern(Parameters(param_string=stored_params)) is pairing)
+		clear_pairing_cache()
+		self.assertFalse(Pairing.intern(self.params) is pairing)
+		self.assertRaises(TypeError, Pairing.intern, "hello world")
+		# subclasses get their own
+		class MyPairing(Pairing):
+			pass
+		mine = MyPairing.intern(self.params)
+		self.assertTrue(type(mine) is MyPairing)
+		self.assertTrue(MyPairing.intern(self.params) is mine)
+		self.assertTrue(type(Pairing.intern(self.params)) is Pairing)
 		
 	def test_apply(self):
 		pairing = Pairing(self.params)
@@ -99,7 +242,387 @@ class TestPairing(unittest.TestCase):
 		self.assertRaises(Exception, pairing.apply, e1)
 		self.assertRaises(Exception, pairing.apply, "hi", 1.5)
 
+	def test_foreign_apply(self):
+		# elements of another Pairing, even one with the same parameters
+		pairing = Pairing(self.params)
+		other = Pairing(Parameters(param_string=stored_params))
+		e1 = Element.random(pairing, G1)
+		e2 = Element.random(pairing, G2)
+		f1 = Element.random(other, G1)
+		f2 = Element.random(other, G2)
+		twin = Element.random(Pairing(self.params), G2)
+		self.assertRaises(ValueError, pairing.apply, f1, e2)
+		self.assertRaises(ValueError, pairing.apply, e1, f2)
+		self.assertRaises(ValueError, pairing.apply, e1, twin)
+		self.assertRaises(ValueError, pairing.apply_batch, [(f1, e2)])
+		self.assertRaises(ValueError, pairing.apply_batch, [((e1, e2), (e1, f2))])
+		async def run():
+			with self.assertRaises(ValueError):
+				await pairing.apply_async(f1, f2)
+			with self.assertRaises(ValueError):
+				await pairing.apply_product_async([(e1, e2), (f1, e2)])
+		asyncio.run(run())
+
+	def test_apply_async(self):
+		pairing = Pairing(self.params)
+		a = [Element.random(pairing, G1) for i in range(8)]
+		b = [Element.random(pairing, G2) for i in range(8)]
+		async def run():
+			single = await pairing.apply_async(a[0], b[0])
+			many = await asyncio.gather(*[pairing.apply_async(x, y) for x, y in zip(a, b)])
+			product = await pairing.apply_product_async(list(zip(a, b)))
+			return single, many, product
+		single, many, product = asyncio.run(run())
+		self.assertEqual(single, pairing.apply(a[0], b[0]))
+		expected = Element.one(pairing, GT)
+		for x, y, result in zip(a, b, many):
+			self.assertEqual(result, pairing.apply(x, y))
+			expected *= result
+		self.assertEqual(product, expected)
+		# there's no loop to hand the result back to outside of one
+		self.assertRaises(RuntimeError, pairing.apply_async, a[0], b[0])
+
+	def test_apply_batch(self):
+		pairing = Pairing(self.params)
+		a = [Element.random(pairing, G1) for i in range(4)]
+		b = [Element.random(pairing, G2) for i in range(4)]
+		# singles sharing a first argument, others, and a product
+		requests = [(a[0], y) for y in b] + [(x, b[0]) for x in a[1:]] + [tuple(zip(a, b))]
+		results = pairing.apply_batch(requests)
+		self.assertEqual(len(results), len(requests))
+		for (x, y), result in zip(requests[:-1], results):
+			self.assertEqual(result, pairing.apply(x, y))
+		expected = Element.one(pairing, GT)
+		for x, y in zip(a, b):
+			expected *= pairing.apply(x, y)
+		self.assertEqual(results[-1], expected)
+		self.assertEqual(pairing.apply_batch([]), [])
+		self.assertRaises(TypeError, pairing.apply_batch, [(a[0], 1)])
+		self.assertRaises(ValueError, pairing.apply_batch, [(a[0], pairing.apply(a[0], b[0]))])
+
+
+	def test_glv(self):
+		# type A1 has no endomorphism to use
+		self.assertFalse(Pairing(self.params).set_glv(True))
+		pairing = Pairing(Parameters(n=160, short=True))
+		points = [Element.random(pairing, G1), Element.random(pairing, G2)]
+		scalars = [Element.random(pairing, Zr) for i in range(4)]
+		generic = [[P**k for k in scalars] + [P**12345, P*scalars[0], P*7] for P in points]
+		self.assertTrue(pairing.set_glv(True))
+		glv = [[P**k for k in scalars] + [P**12345, P*scalars[0], P*7] for P in points]
+		self.assertEqual(glv, generic)
+		self.assertEqual(Element.zero(pairing, G1)**scalars[0], Element.zero(pairing, G1))
+		self.assertFalse(pairing.set_glv(False))
+
+	def test_pow_method(self):
+		pairing = Pairing(self.params)
+		# GT has no random elements of its own, and a pairing's output is the
+		# unitary kind the cyclotomic method is for
+		P, Q = Element.random(pairing, G1), Element.random(pairing, G2)
+		bases = [P, Q, pairing.apply(P, Q), Element.random(pairing, Zr)]
+		k = Element.random(pairing, Zr)
+		# GT starts out cyclotomic on this curve
+		self.assertEqual(pairing.get_pow_method(GT), ("cyclotomic", 0))
+		pairing.set_pow_method(GT, "pbc")
+		expected = [[x**k, x**1000003, x*k] for x in bases[:2]] + [[x**k, x**1000003] for x in bases[2:]]
+		for method, window in [("fixed", 0), ("fixed", 1), ("fixed", 5), ("sliding", 0), ("sliding", 3), ("wnaf", 0), ("wnaf", 2), ("wnaf", 6)]:
+			for group in (G1, G2, GT, Zr):
+				pairing.set_pow_method(group, method, window)
+				self.assertEqual(pairing.get_pow_method(group), (method, window))
+			got = [[x**k, x**1000003, x*k] for x in bases[:2]] + [[x**k, x**1000003] for x in bases[2:]]
+			self.assertEqual(got, expected)
+			self.assertEqual(bases[0]**(-5) * bases[0]**5, Element.zero(pairing, G1))
+		pairing.set_pow_method(GT, "cyclotomic", 4)
+		self.assertEqual(bases[2]**k, expected[2][0])
+		self.assertEqual(bases[2]**(-k), expected[2][0]**(-1))
+		self.assertRaises(ValueError, pairing.set_pow_method, G1, "cyclotomic")
+		pairing.set_pow_method(G1, "pbc")
+		self.assertEqual(pairing.get_pow_method(G1), ("pbc", 0))
+		self.assertRaises(ValueError, pairing.set_pow_method, G1, "magic")
+		self.assertRaises(ValueError, pairing.set_pow_method, G1, "wnaf", 1)
+		self.assertRaises(ValueError, pairing.set_pow_method, 7, "fixed")
+		picked = pairing.tune_pow()
+		self.assertEqual(sorted(picked), [G1, G2, GT])
+		for group in picked:
+			self.assertEqual(pairing.get_pow_method(group), picked[group])
+		self.assertEqual(bases[2]**k, expected[2][0])
+		tuned = Pairing(self.params, tune=True)
+		self.assertTrue(tuned.get_pow_method(GT)[0] in ("pbc", "fixed", "sliding", "wnaf", "cyclotomic"))
+
+	def test_fp_backend(self):
+		self.assertEqual(get_fp_backend(), "mont")
+		results = []
+		for backend in ("mont", "fast", "faster", "naive", "native"):
+			pairing = Pairing(self.params, fp=backend)
+			self.assertEqual(pairing.fp_backend, backend)
+			if backend != "native":
+				self.assertEqual(pairing.fp_kernels, {})
+			k = Element.from_hash(pairing, Zr, b"exponent")
+			P = Element.from_hash(pairing, G1, b"point")
+			results.append([(k*k).to_bytes(), (P**k).to_bytes(), (P + P).to_bytes(), pairing.apply(P, P).to_bytes()])
+		# every backend computes the same things
+		for got in results[1:]:
+			self.assertEqual(got, results[0])
+		# the native kernels multiply as PBC does, in both Zr and Fq
+		mont, native = Pairing(self.params), Pairing(self.params, fp="native")
+		for field, kernel in native.fp_kernels.items():
+			self.assertIn(field, ("Zr", "Fq"))
+			self.assertIn(kernel, ("mulx", "portable"))
+		for i in range(100):
+			x, y = [(Element.from_hash(p, Zr, b"x%d" % i), Element.from_hash(p, Zr, b"y%d" % i)) for p in (mont, native)]
+			self.assertEqual((x[0]*x[1]).to_bytes(), (y[0]*y[1]).to_bytes())
+			P, Q = [Element.from_hash(p, G1, b"P%d" % i) for p in (mont, native)]
+			self.assertEqual((P + P*P).to_bytes(), (Q + Q*Q).to_bytes())
+		try:
+			set_fp_backend("faster")
+			self.assertEqual(get_fp_backend(), "faster")
+			self.assertEqual(Pairing(self.params).fp_backend, "faster")
+			self.assertEqual(Pairing.intern(self.params).fp_backend, "faster")
+		finally:
+			set_fp_backend("mont")
+		self.assertEqual(Pairing.intern(self.params).fp_backend, "mont")
+		self.assertRaises(ValueError, set_fp_backend, "avx2")
+		self.assertRaises(ValueError, Pairing, self.params, fp="avx2")
+
+	def test_stats(self):
+		pairing = Pairing(self.params)
+		P = Element.from_hash(pairing, G1, b"point")
+		k = Element.from_hash(pairing, Zr, b"exponent")
+		# nothing is counted until statistics are switched on
+		self.assertFalse(get_stats_enabled())
+		pairing.apply(P, P)
+		self.assertEqual(pairing.stats()["apply"]["count"], 0)
+		try:
+			set_stats_enabled(True)
+			with stats_scope() as outer:
+				pairing.apply(P, P)
+				with stats_scope() as inner:
+					P**k
+					str(P)
+				Element(pairing, Zr, 5)
+		finally:
+			set_stats_enabled(False)
+		stats = pairing.stats()
+		self.assertEqual(sorted(stats), ["apply", "from_hash", "mult", "parse", "pow", "str"])
+		self.assertEqual(stats["apply"]["count"], 1)
+		self.assertEqual(stats["pow"]["count"], 1)
+		self.assertEqual(stats["str"]["count"], 1)
+		self.assertEqual(stats["parse"]["count"], 1)
+		self.assertTrue(stats["apply"]["ns"] > 0)
+		# scopes see what happened inside them, nested ones included
+		self.assertEqual(inner.stats["pow"]["count"], 1)
+		self.assertEqual(inner.stats["apply"]["count"], 0)
+		self.assertEqual(outer.stats["pow"]["count"], 1)
+		self.assertEqual(outer.stats["apply"]["count"], 1)
+		pairing.reset_stats()
+		self.assertEqual(pairing.stats()["apply"], {"count": 0, "ns": 0})
+
+	def test_trace(self):
+		import struct
+		pairing = Pairing(self.params)
+		P = Element.from_hash(pairing, G1, b"point")
+		with tempfile.TemporaryDirectory() as tmp:
+			path = os.path.join(tmp, "trace")
+			start_trace(path, values=True)
+			try:
+				self.assertRaises(RuntimeError, start_trace, path)
+				Q = P**5
+				pairing.apply(P, Q)
+				del Q
+			finally:
+				count = stop_trace()
+			with open(path, "rb") as f:
+				data = f.read()
+		self.assertEqual(data[:8], b"PBCTRACE")
+		version, flags = struct.unpack_from("=II", data, 8)
+		self.assertEqual((version, flags), (1, 1))
+		# the pairing, P's value, the power, the pairing of P and Q, and then
+		# the result of that and Q let go of
+		record = struct.Struct("=BBBBBBHIIQQQQ")
+		ops = []
+		at = 16
+		while at < len(data):
+			op, group, a_kind, b_kind, a_group, b_group, rflags, npairing, length, out, a, b, ns = record.unpack_from(data, at)
+			ops.append(op)
+			at += record.size + length
+			if op == 1:
+				# P**5: an element and a 3-bit integer
+				self.assertEqual((a_kind, b_kind, b), (1, 2, 3))
+		self.assertEqual(at, len(data))
+		self.assertEqual(ops, [16, 17, 1, 0, 18, 18])
+		self.assertEqual(count, 6)
+
+	def test_factors(self):
+		p, q = 3559, 3571
+		plain = Pairing(self.params)
+		self.assertEqual(plain.factors, None)
+		self.assertRaises(ValueError, plain.random_subgroup, G1, 0)
+		pairing = Pairing(self.params, factors=[p, q])
+		self.assertEqual(pairing.factors, (p, q))
+		self.assertRaises(ValueError, Pairing, self.params, factors=(p, p))
+		self.assertRaises(ValueError, Pairing, self.params, factors=(p*q,))
+		self.assertRaises(TypeError, Pairing, self.params, factors=(p, "q"))
+		self.assertRaises(IndexError, pairing.random_subgroup, G1, 2)
+		# Zr powers by the CRT agree with plain modular powers
+		x = Element.random(pairing, Zr)
+		for k in (0, 1, 2, 65537, p*q - 1, 10**30):
+			self.assertEqual(int(x**k), pow(int(x), k, p*q))
+		self.assertEqual(int(Element(pairing, Zr, p)**0), 1)
+		self.assertEqual(int(Element(pairing, Zr, p)**5), pow(p, 5, p*q))
+		# elements of each subgroup have the order of its prime
+		gp = pairing.random_subgroup(G1, 0)
+		gq = pairing.random_subgroup(G1, 1)
+		self.assertEqual(gp**p, Element.zero(pairing, G1))
+		self.assertEqual(gq**q, Element.zero(pairing, G1))
+		# a random one is zero once in p draws, so the non-zero check takes
+		# the first of some fixed points whose projection isn't
+		zero = Element.zero(pairing, G1)
+		hp = [h for h in (pairing.project(Element.from_hash(pairing, G1, b"gp%d" % i), 0) for i in range(8)) if h != zero][0]
+		self.assertEqual(hp**p, zero)
+		self.assertEqual(pairing.apply(gp, gq), Element.one(pairing, GT))
+		self.assertEqual(pairing.random_subgroup(GT, 0)**p, Element.one(pairing, GT))
+		# and reduced exponents give the same answers as full ones
+		k = Element.random(pairing, Zr)
+		self.assertEqual(gp**k, gp**(int(k) % p))
+		self.assertEqual(gp**-3, -(gp**3))
+		self.assertEqual((gp*gq)**k, gp**k * gq**k)
+		# projections split an element into its components
+		P = Element.random(pairing, G1)
+		self.assertEqual(pairing.project(P, 0) * pairing.project(P, 1), P)
+		self.assertEqual(pairing.project(P, 0)**p, Element.zero(pairing, G1))
+		self.assertEqual(pairing.project(gp, 0), gp)
+		self.assertEqual(pairing.project(gp, 1), Element.zero(pairing, G1))
+		self.assertEqual(int(pairing.project(x, 0)) % p, int(x) % p)
+		self.assertEqual(int(pairing.project(x, 0)) % q, 0)
 			
+class TestCAPI(unittest.TestCase):
+
+	def test_capsule(self):
+		import pypbc
+		is_valid = ctypes.pythonapi.PyCapsule_IsValid
+		is_valid.argtypes = [ctypes.py_object, ctypes.c_char_p]
+		self.assertTrue(is_valid(pypbc._C_API, b"pypbc._C_API"))
+		# the table starts with its version
+		get_pointer = ctypes.pythonapi.PyCapsule_GetPointer
+		get_pointer.argtypes = [ctypes.py_object, ctypes.c_char_p]
+		get_pointer.restype = ctypes.POINTER(ctypes.c_int)
+		self.assertTrue(get_pointer(pypbc._C_API, b"pypbc._C_API")[0] >= 1)
+		# the package re-exports the native module's capsule
+		self.assertTrue(pypbc._C_API is pypbc._pypbc._C_API)
+
+class TestBench(unittest.TestCase):
+
+	def test_compare(self):
+		from pypbc import bench
+		baseline = {"A": {"add": {"ops": 1000.0, "ci": 10.0}, "pow": {"ops": 10.0, "ci": 1.0}}}
+		# within the noise, and newly added operations, are fine
+		results = {"A": {"add": {"ops": 995.0, "ci": 10.0}, "pow": {"ops": 10.5, "ci": 1.0}, "new": {"ops": 1.0, "ci": 0.0}}}
+		self.assertEqual(bench.compare(results, baseline), [])
+		results["A"]["add"] = {"ops": 900.0, "ci": 10.0}
+		self.assertEqual(bench.compare(results, baseline), [("A", "add")])
+
+	def test_ksw(self):
+		import KSW
+		row = KSW.benchmark(3, 64)
+		self.assertTrue(row["matched"])
+		self.assertEqual(sorted(row["times"]), ["decrypt", "encrypt", "keygen", "setup"])
+		self.assertEqual(row["operations"]["decrypt"]["pairings"], 7)
+		self.assertEqual(row["stats"]["decrypt"]["apply"]["count"], 7)
+		self.assertTrue(row["peak_rss_kb"] > 0)
+
+	def test_soak(self):
+		import argparse
+		from pypbc import bench
+		args = argparse.Namespace(soak_ops=len(bench.SOAK_CASES) * 40, soak_rounds=2, soak_rss_kb=1 << 20)
+		result = bench.soak(args)
+		self.assertEqual(result["operations"], len(bench.SOAK_CASES) * 40)
+		self.assertEqual(len(result["rss_kb"]), 3)
+		self.assertEqual(result["refcounts"], {name: 0 for name in ("params", "pairing", "a", "b", "k", "x")})
+		self.assertTrue(result["ok"])
+
+	def test_startup(self):
+		import argparse
+		from pypbc import bench
+		result = bench.startup(argparse.Namespace(repeat=1, quick=True))
+		self.assertEqual(list(result), ["A 512/160"])
+		for way in ("cold", "load"):
+			self.assertEqual(sorted(result["A 512/160"][way]), sorted(bench.STARTUP_PHASES + ["process"]))
+			self.assertTrue(result["A 512/160"][way]["process"] > 0)
+
+	def test_rate(self):
+		from pypbc import bench
+		ops, ci = bench.rate("x + 1", {"x": 1}, 100, 3)
+		self.assertTrue(ops > 0 and ci >= 0)
+
+class TestServer(unittest.TestCase):
+
+	def test_server(self):
+		from pypbc import server
+		params = Parameters(param_string=stored_params)
+		with tempfile.TemporaryDirectory() as tmp:
+			path = os.path.join(tmp, "pypbc.sock")
+			daemon = server.Server(path, params)
+			loop = asyncio.new_event_loop()
+			loop.run_until_complete(daemon.start())
+			thread = threading.Thread(target=loop.run_forever)
+			thread.start()
+			try:
+				with server.Client(path) as client:
+					pairing = client.pairing
+					a = [Element.random(pairing, G1) for i in range(3)]
+					b = [Element.random(pairing, G2) for i in range(3)]
+					self.assertEqual(client.apply(a[0], b[0]), pairing.apply(a[0], b[0]))
+					expected = Element.one(pairing, GT)
+					for x, y in zip(a, b):
+						expected *= pairing.apply(x, y)
+					self.assertEqual(client.apply_product(zip(a, b)), expected)
+					# a bad request is answered, and the connection goes on
+					client.sock.sendall(b"\x00\x00\x00\x02\x00\x00")
+					self.assertEqual(client._receive()[:1], b"\x01")
+					self.assertEqual(client.apply(a[1], b[1]), pairing.apply(a[1], b[1]))
+				# several workers at once share batches
+				def work(results):
+					with server.Client(path) as client:
+						results.append(client.apply(a[0], b[2]) == pairing.apply(a[0], b[2]))
+				results = []
+				workers = [threading.Thread(target=work, args=(results,)) for i in range(8)]
+				for worker in workers:
+					worker.start()
+				for worker in workers:
+					worker.join()
+				self.assertEqual(results, [True] * 8)
+				self.assertEqual(daemon.requests, 11)
+				# a frame too long for any request gets the connection closed
+				with server.Client(path) as client:
+					client.sock.sendall(b"\xff\xff\xff\xff")
+					self.assertRaises(server.ServerError, client._receive)
+			finally:
+				asyncio.run_coroutine_threadsafe(daemon.close(), loop).result()
+				loop.call_soon_threadsafe(loop.stop)
+				thread.join()
+				loop.close()
+
+class TestAdvise(unittest.TestCase):
+
+	def test_advise(self):
+		workload = {"pairing": 1, "g1_pow": 2}
+		with tempfile.TemporaryDirectory() as tmp:
+			path = os.path.join(tmp, "advice.json")
+			rows = advise(80, workload, types=("a",), cache=path, number=1, repeat=1)
+			self.assertEqual([row["type"] for row in rows], ["a"])
+			row = rows[0]
+			self.assertTrue(str(row["parameters"]).startswith("type a"))
+			self.assertEqual(sorted(row["times"]), ["g1_pow", "pairing"])
+			self.assertAlmostEqual(row["cost"], row["times"]["pairing"] + 2 * row["times"]["g1_pow"])
+			self.assertEqual(sorted(row["sizes"]), ["G1", "G2", "GT"])
+			# the second time round it's all from the cache
+			again = advise(80, workload, types=("a",), cache=path, number=1, repeat=1)
+			self.assertEqual(str(again[0]["parameters"]), str(row["parameters"]))
+			self.assertEqual(again[0]["cost"], row["cost"])
+			self.assertTrue("a" in advice_table(again))
+		self.assertRaises(ValueError, advise, 80, {"teleport": 1})
+		self.assertRaises(ValueError, advise, 512)
+
 class TestElement(unittest.TestCase):
 
 	def setUp(self):
@@ -118,10 +641,302 @@ class TestElement(unittest.TestCase):
 		except Exception:
 			self.fail("Could not instantiate element")
 	 
+	def test_from_hash_bytes(self):
+		e1 = Element.from_hash(self.pairing, G1, "hello world!")
+		e2 = Element.from_hash(self.pairing, G1, b"hello world!")
+		e3 = Element.from_hash(self.pairing, G1, bytearray(b"hello world!"))
+		e4 = Element.from_hash(self.pairing, G1, memoryview(b"hello world!"))
+		self.assertEqual(e1, e2)
+		self.assertEqual(e1, e3)
+		self.assertEqual(e1, e4)
+		self.assertRaises(TypeError, Element.from_hash, self.pairing, G1, 1.5)
+
+	def test_from_hash_many(self):
+		messages = [b"", b"a", "node_id=22609", bytearray(1000)]
+		elements = Element.from_hash_many(self.pairing, G1, messages)
+		self.assertEqual(len(elements), len(messages))
+		for message, element in zip(messages, elements):
+			if isinstance(message, str):
+				message = message.encode()
+			digest = hashlib.sha256(message).digest()
+			self.assertEqual(element, Element.from_hash(self.pairing, G1, digest))
+		self.assertEqual(Element.from_hash_many(self.pairing, Zr, []), [])
+		self.assertRaises(TypeError, Element.from_hash_many, self.pairing, G1, [b"a", 1])
+		self.assertRaises(ValueError, Element.from_hash_many, self.pairing, 17, [b"a"])
+
+	def test_hash_to_group(self):
+		message = bytes(range(256)) * 1000
+		h = HashToGroup(self.pairing, G1)
+		for i in range(0, len(message), 4093):
+			h.update(message[i:i + 4093])
+		self.assertEqual(h.digest(), hashlib.sha256(message).digest())
+		self.assertEqual(h.element(), Element.from_hash_many(self.pairing, G1, [message])[0])
+		# finishing doesn't consume the state
+		h.update(b"more")
+		self.assertEqual(h.digest(), hashlib.sha256(message + b"more").digest())
+		self.assertEqual(HashToGroup(self.pairing, Zr, b"abc").digest(), hashlib.sha256(b"abc").digest())
+
+	def test_random_many(self):
+		elements = Element.random_many(self.pairing, G1, 20)
+		self.assertEqual(len(elements), 20)
+		self.assertNotEqual(elements[0], elements[1])
+		self.assertEqual(len(Element.random_many(self.pairing, Zr, 3)), 3)
+		self.assertEqual(Element.random_many(self.pairing, G2, 0), [])
+		self.assertRaises(ValueError, Element.random_many, self.pairing, GT, 2)
+		self.assertRaises(ValueError, Element.random_many, self.pairing, G1, -1)
+
+	def test_random_source(self):
+		try:
+			RandomSource(seed=42).install()
+			self.assertTrue(get_random_source().deterministic)
+			first = Element.random_many(self.pairing, Zr, 5) + [get_random(10**40), get_random_prime(64)]
+			set_random_source(RandomSource(seed=42))
+			second = Element.random_many(self.pairing, Zr, 5) + [get_random(10**40), get_random_prime(64)]
+			self.assertEqual(first, second)
+			set_random_source(RandomSource(seed=b"another seed"))
+			self.assertNotEqual(Element.random_many(self.pairing, Zr, 5), first[:5])
+			set_random_source(RandomSource())
+			self.assertFalse(get_random_source().deterministic)
+			self.assertNotEqual(Element.random(self.pairing, G1), Element.random(self.pairing, G1))
+		finally:
+			set_random_source(None)
+		self.assertEqual(get_random_source(), None)
+		self.assertRaises(TypeError, set_random_source, 42)
+
+	@unittest.skipUnless(hasattr(os, "fork"), "needs fork")
+	def test_random_source_fork(self):
+		try:
+			set_random_source(RandomSource())
+			get_random(2**128)
+			read, write = os.pipe()
+			pid = os.fork()
+			if pid == 0:
+				os.write(write, str(get_random(2**128)).encode())
+				os._exit(0)
+			os.close(write)
+			os.waitpid(pid, 0)
+			child = int(os.read(read, 100))
+			os.close(read)
+			# the child has its own key, not a copy of ours
+			self.assertNotEqual(child, get_random(2**128))
+		finally:
+			set_random_source(None)
+
 	def test_str(self):
 		self.e5 = Element(self.pairing, Zr, value=3559)
 		self.assertEqual("3559", str(self.e5))
 
+	def test_call_paths(self):
+		# positional calls take the vectorcall fast path; keywords and
+		# subclasses go through tp_init
+		self.assertEqual(Element(self.pairing, Zr, 5), Element(self.pairing, Zr, value=5))
+		self.assertEqual(Element(self.pairing, Zr), Element(pairing=self.pairing, group=Zr))
+		class Sub(Element):
+			pass
+		self.assertEqual(Sub(self.pairing, Zr, 5), Element(self.pairing, Zr, 5))
+		self.assertRaises(TypeError, Element.zero, self.pairing)
+		self.assertRaises(TypeError, Element.random, self.pairing, G1, 1)
+		self.assertRaises(TypeError, Element.from_hash, "pairing", G1, b"x")
+		self.assertRaises(TypeError, self.pairing.apply, Element.one(self.pairing, G1))
+
+	def test_to_str(self):
+		P = Element.random(self.pairing, G1)
+		compressed = P.to_str(compressed=True)
+		uncompressed = P.to_str(compressed=False)
+		self.assertTrue(compressed[:2] in ("02", "03"))
+		self.assertTrue(uncompressed.startswith("04"))
+		self.assertEqual(Element(self.pairing, G1, compressed), P)
+		self.assertEqual(Element(self.pairing, G1, uncompressed), P)
+		self.assertEqual(P.to_str(), str(P))
+
+	def test_to_bytes(self):
+		P = Element.random(self.pairing, G1)
+		Q = Element.random(self.pairing, G2)
+		# there's no drawing from GT, so take a pairing's output
+		for group, e in ((G1, P), (G2, Q), (GT, self.pairing.apply(P, Q)), (Zr, Element.random(self.pairing, Zr))):
+			self.assertEqual(Element.from_bytes(self.pairing, group, e.to_bytes()), e)
+		short = P.to_bytes(compressed=True)
+		self.assertTrue(len(short) < len(P.to_bytes()))
+		self.assertEqual(Element.from_bytes(self.pairing, G1, short, compressed=True), P)
+		O = Element.zero(self.pairing, G1)
+		self.assertEqual(Element.from_bytes(self.pairing, G1, O.to_bytes()), O)
+		self.assertRaises(ValueError, Element.from_bytes, self.pairing, G1, short)
+		self.assertRaises(ValueError, Element.random(self.pairing, Zr).to_bytes, compressed=True)
+
+	def test_gt_compression(self):
+		x = self.pairing.apply(Element.random(self.pairing, G1), Element.random(self.pairing, G2))
+		short = x.to_bytes(compressed=True)
+		self.assertEqual(2 * len(short), len(x.to_bytes()))
+		self.assertEqual(Element.from_bytes(self.pairing, GT, short, compressed=True), x)
+		one = Element.one(self.pairing, GT)
+		self.assertEqual(Element.from_bytes(self.pairing, GT, one.to_bytes(True), True), one)
+		# zero(GT) is the identity; all zeroes decode to something outside
+		# the cyclotomic subgroup, which has no compressed form
+		outside = Element.from_bytes(self.pairing, GT, bytes(len(x.to_bytes())))
+		self.assertRaises(ValueError, outside.to_bytes, compressed=True)
+		powers = [x**i for i in range(1, 6)]
+		self.assertEqual(pack_elements(powers, compressed=True).unpack(), powers)
+
+	def test_pow_table(self):
+		import sys
+		from multiprocessing import shared_memory
+		params = Parameters(param_string=stored_params)
+		pairing = Pairing(params)
+		for group in (G1, G2, GT):
+			base = Element.random(pairing, G1) if group == G1 else Element.random(pairing, G2) if group == G2 else pairing.apply(Element.random(pairing, G1), Element.random(pairing, G2))
+			table = PowTable(base, window=3)
+			self.assertEqual(table.group, group)
+			self.assertEqual(table.base, base)
+			k = Element.random(pairing, Zr)
+			for e in (0, 1, 12345, -12345, 2**200 + 7, k):
+				self.assertEqual(table.pow(e), base ** e)
+		self.assertRaises(TypeError, table.pow, 1.5)
+		self.assertRaises(ValueError, PowTable, k)
+		self.assertRaises(ValueError, PowTable, base, window=0)
+
+		# a copy in shared memory is used where it is
+		data = bytes(table)
+		self.assertEqual(len(data), len(table))
+		shm = shared_memory.SharedMemory(create=True, size=len(data))
+		try:
+			shm.buf[:len(data)] = data
+			attached = PowTable.from_buffer(pairing, shm.buf)
+			self.assertTrue(attached.attached)
+			self.assertEqual(attached.base, base)
+			self.assertEqual(attached.pow(k), base ** k)
+			self.assertTrue(sys.getsizeof(attached) < sys.getsizeof(table))
+			# it holds the buffer while it lives
+			self.assertRaises(BufferError, shm.close)
+			del attached
+		finally:
+			shm.close()
+			shm.unlink()
+
+		# it has to be the same parameters, and a whole table
+		other = Pairing(Parameters(n=3559*3571))
+		self.assertRaises(ValueError, PowTable.from_buffer, other, data)
+		self.assertRaises(ValueError, PowTable.from_buffer, pairing, data[:-1])
+		self.assertRaises(ValueError, PowTable.from_buffer, pairing, b"x" + data[1:])
+		# and the entries have to agree with the base
+		damaged = bytearray(data)
+		damaged[len(data) - (2**3 - 1) * len(base.to_bytes())] ^= 1
+		self.assertRaises(ValueError, PowTable.from_buffer, pairing, damaged)
+
+	def test_sizeof(self):
+		import sys
+		import tracemalloc
+		P = Element.random(self.pairing, G1)
+		x = self.pairing.apply(P, P)
+		# the limbs behind an element count, and GT's are the bigger
+		self.assertTrue(sys.getsizeof(P) > object.__sizeof__(P))
+		self.assertTrue(sys.getsizeof(x) > sys.getsizeof(P))
+		self.assertTrue(sys.getsizeof(self.pairing) > object.__sizeof__(self.pairing))
+		self.assertTrue(sys.getsizeof(self.params) > object.__sizeof__(self.params))
+		# native allocations show up in tracemalloc under their own domain
+		tracemalloc.start()
+		try:
+			elements = [self.pairing.apply(P, Element.random(self.pairing, G2)) for i in range(100)]
+			snapshot = tracemalloc.take_snapshot()
+		finally:
+			tracemalloc.stop()
+		native = snapshot.filter_traces([tracemalloc.DomainFilter(True, TRACEMALLOC_DOMAIN)])
+		self.assertTrue(sum(stat.size for stat in native.statistics("lineno")) > 0)
+
+	def test_tracemalloc_subinterpreter(self):
+		# with a subinterpreter about, the native threads behind pow_async
+		# and apply_batch mustn't think they can report to tracemalloc
+		try:
+			import _interpreters as interpreters
+		except ImportError:
+			try:
+				import _xxsubinterpreters as interpreters
+			except ImportError:
+				self.skipTest("no subinterpreters")
+		import tracemalloc
+		interp = interpreters.create()
+		try:
+			g = Element.random(self.pairing, G1)
+			h = Element.random(self.pairing, G2)
+			k = Element.random(self.pairing, Zr)
+			tracemalloc.start()
+			try:
+				async def run():
+					return await asyncio.gather(*[g.pow_async(k) for i in range(8)])
+				powers = asyncio.run(run())
+				results = self.pairing.apply_batch([(g, h)] * 8)
+			finally:
+				tracemalloc.stop()
+			self.assertEqual(powers, [g**k] * 8)
+			self.assertEqual(results, [self.pairing.apply(g, h)] * 8)
+		finally:
+			interpreters.destroy(interp)
+
+	def test_pack_elements(self):
+		points = [Element.random(self.pairing, G1) for i in range(10)]
+		for compressed in (False, True):
+			buf = pack_elements(points, compressed=compressed)
+			view = memoryview(buf)
+			self.assertEqual(view.shape, (10, buf.itemsize))
+			self.assertEqual(view.format, "B")
+			self.assertTrue(view.readonly)
+			self.assertEqual(len(buf), 10)
+			self.assertEqual(view.tobytes(), b"".join(P.to_bytes(compressed) for P in points))
+			self.assertEqual(buf.unpack(), points)
+			self.assertEqual(unpack_elements(self.pairing, G1, view.tobytes(), compressed), points)
+		self.assertRaises(ValueError, pack_elements, [])
+		self.assertRaises(ValueError, pack_elements, [points[0], Element.random(self.pairing, Zr)])
+		self.assertRaises(TypeError, pack_elements, [points[0], 1])
+		self.assertRaises(ValueError, unpack_elements, self.pairing, G1, b"\x00")
+
+	def test_point_accumulator(self):
+		import sys
+		points = [Element.random(self.pairing, G1) for i in range(8)]
+		k = Element.random(self.pairing, Zr)
+		acc = PointAccumulator(self.pairing, G1, points[0])
+		expected = points[0]
+		for P in points[1:]:
+			acc.add(P)
+			expected = expected + P
+		self.assertEqual(acc.result(), expected)
+		acc.sub(points[1])
+		acc.double()
+		expected = (expected - points[1]) * 2
+		self.assertEqual(acc.result(), expected)
+		acc.add_scaled(points[2], k)
+		acc.add_scaled(points[3], -5)
+		expected = expected + points[2]**k - points[3]**5
+		self.assertEqual(acc.result(), expected)
+		# P - P and adding the point at infinity
+		zero = PointAccumulator(self.pairing, G1)
+		self.assertEqual(zero.result(), Element.zero(self.pairing, G1))
+		zero.add(points[0])
+		zero.add(Element.zero(self.pairing, G1))
+		zero.sub(points[0])
+		self.assertEqual(zero.result(), Element.zero(self.pairing, G1))
+		# accumulators add, and share one inversion between their results
+		other = PointAccumulator(self.pairing, G1, points[4])
+		other.add(acc)
+		self.assertEqual(other.result(), expected + points[4])
+		self.assertEqual(PointAccumulator.results([acc, zero, other]), [acc.result(), zero.result(), other.result()])
+		# a bad entry after the first lets go of everything taken so far
+		before = sys.getrefcount(self.pairing)
+		self.assertRaises(TypeError, PointAccumulator.results, [acc, points[0]])
+		self.assertEqual(sys.getrefcount(self.pairing), before)
+		self.assertRaises(ValueError, PointAccumulator, self.pairing, GT)
+		self.assertRaises(ValueError, acc.add, Element.random(self.pairing, Zr))
+		self.assertRaises(TypeError, acc.add_scaled, points[0], "k")
+
+	def test_threads(self):
+		# pairings and their elements can be shared between threads
+		g = Element.random(self.pairing, G1)
+		ks = list(range(1, 65))
+		messages = [b"m%d" % k for k in ks]
+		with concurrent.futures.ThreadPoolExecutor(8) as pool:
+			powers = list(pool.map(lambda k: g**k, ks))
+			hashed = list(pool.map(lambda m: Element.from_hash(self.pairing, G1, m), messages))
+		self.assertEqual(powers, [g**k for k in ks])
+		self.assertEqual(hashed, [Element.from_hash(self.pairing, G1, m) for m in messages])
+
 	def test_bad_init(self):
 		self.assertRaises(TypeError, Element)
 		self.assertRaises(TypeError, Element, self.pairing)
@@ -192,6 +1007,27 @@ class TestElement(unittest.TestCase):
 			self.fail()
 		except: pass
 		
+	def test_pow_async(self):
+		pairing = Pairing(self.params)
+		g = Element.random(pairing, G1)
+		k = Element.random(pairing, Zr)
+		async def run():
+			return await asyncio.gather(g.pow_async(k), g.pow_async(12345))
+		by_element, by_int = asyncio.run(run())
+		self.assertEqual(by_element, g**k)
+		self.assertEqual(by_int, g**12345)
+		# powers are worked out as ** would: by the group's method, cyclotomic
+		# in GT, by the CRT in Zr, and modulo the order of a subgroup
+		pairing = Pairing(self.params, factors=[3559, 3571])
+		pairing.set_pow_method(G1, "wnaf", 4)
+		g = Element.random(pairing, G1)
+		k = Element.random(pairing, Zr)
+		x = pairing.apply(g, Element.random(pairing, G2))
+		jobs = [(g, k), (g, -7), (k, 65537), (x, k), (x, -12345), (pairing.random_subgroup(G1, 0), k)]
+		async def run_all():
+			return await asyncio.gather(*[base.pow_async(e) for base, e in jobs])
+		self.assertEqual(asyncio.run(run_all()), [base**e for base, e in jobs])
+
 	def test_neg(self):
 		self.e1 = Element.random(self.pairing, Zr)
 		self.e2 = -self.e1